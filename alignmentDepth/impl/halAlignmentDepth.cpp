@@ -0,0 +1,657 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "halAlignmentDepth.h"
+
+using namespace std;
+using namespace hal;
+
+/** Writes the depth of consecutive positions of a sequence, either as
+ * a fixedStep wiggle, as bedGraph runs of equal depth, or to a bigWig
+ * file if bigWig is not NULL */
+class DepthWriter
+{
+public:
+   DepthWriter(ostream& outStream, BigWigWriter* bigWig,
+               const Sequence* sequence, hal_size_t start, hal_size_t step,
+               bool bedGraph);
+   ~DepthWriter();
+
+   /** The next length bases (starting right after the previous
+    * call) have the given depth */
+   void write(hal_size_t depth, hal_size_t length);
+
+protected:
+   void flushRun();
+
+   ostream& _outStream;
+   BigWigWriter* _bigWig;
+   string _sequenceName;
+   hal_size_t _step;
+   bool _bedGraph;
+   hal_size_t _pos;
+   hal_size_t _nextSample;
+   hal_size_t _runStart;
+   hal_size_t _runDepth;
+};
+
+/** Range of a genome aligned to a range of the reference genome (of the
+ * same length).  If reversed, _start is aligned to the last base of the
+ * reference range */
+struct DepthInterval
+{
+   hal_index_t _start;
+   hal_index_t _refStart;
+   hal_size_t _length;
+   bool _reversed;
+};
+
+/** Follows a window of the reference genome through the tree, to count
+ * the genomes each base reaches */
+class DepthWalker
+{
+public:
+   DepthWalker(const Genome* refGenome, const set<const Genome*>& targetSet,
+               bool noAncestors);
+
+   /** Add one run of equal depth per change in depth of the window
+    * [start, end] (genome coordinates) to runs */
+   void walk(hal_index_t start, hal_index_t end,
+             vector<pair<hal_size_t, hal_size_t> >& runs);
+
+protected:
+
+   /** Map the intervals of genome to its parent, or to tops if they
+    * have no parent there */
+   void mapUp(const Genome* genome, const vector<DepthInterval>& intervals,
+              vector<DepthInterval>& parentIntervals,
+              vector<DepthInterval>& tops);
+   /** Map the intervals of genome to all their copies in a child */
+   void mapDown(const Genome* genome, hal_size_t childIndex,
+                const vector<DepthInterval>& intervals,
+                vector<DepthInterval>& childIntervals);
+   /** Count the intervals in genome and push them down each branch */
+   void pushDown(const Genome* genome,
+                 const vector<DepthInterval>& intervals);
+   /** Add the part of interval from start to end (positions in its
+    * genome) aligned to the segment starting at segStart to out, as
+    * the range of the other genome starting at otherStart */
+   static void addAligned(const DepthInterval& interval, hal_index_t start,
+                          hal_index_t end, hal_index_t segStart,
+                          hal_index_t segEnd, hal_index_t otherStart,
+                          bool reversed, vector<DepthInterval>& out);
+
+   const Genome* _refGenome;
+   /** genomes under the coalescence limit that are visited */
+   set<const Genome*> _scope;
+   const Genome* _coalescenceLimit;
+   /** index in _coverage of each counted genome */
+   map<const Genome*, size_t> _counted;
+   /** reference intervals reached in each counted genome */
+   vector<vector<pair<hal_index_t, hal_index_t> > > _coverage;
+   map<const Genome*, TopSegmentIteratorConstPtr> _topSegments;
+   map<const Genome*, BottomSegmentIteratorConstPtr> _bottomSegments;
+};
+
+/** Print the alignment depth wiggle for a subrange of a given sequence to
+ * the output stream. */
+static void printSequence(ostream& outStream, const Sequence* sequence,
+                          const set<const Genome*>& targetSet,
+                          hal_size_t start, hal_size_t length, hal_size_t step,
+                          bool countDupes, bool noAncestors, bool bedGraph,
+                          BigWigWriter* bigWig, bool useColumnIterator);
+
+/** Compute the depth (without dupes) of a subrange of a sequence by
+ * pushing it through the tree a segment at a time */
+static void printSequenceSegments(DepthWriter& writer,
+                                  const Sequence* sequence,
+                                  const set<const Genome*>& targetSet,
+                                  hal_size_t start, hal_size_t length,
+                                  bool noAncestors);
+
+/** Number of reference bases whose intervals are held in memory at once
+ * by printSequenceSegments */
+static const hal_size_t SegmentWindowSize = 1 << 20;
+
+/** Given a Sequence (chromosome) and a (sequence-relative) coordinate
+ * range, print the alignmability wiggle with respect to the genomes
+ * in the target set */
+void printSequence(ostream& outStream, const Sequence* sequence,
+                   const set<const Genome*>& targetSet,
+                   hal_size_t start, hal_size_t length, hal_size_t step,
+                   bool countDupes, bool noAncestors, bool bedGraph,
+                   BigWigWriter* bigWig, bool useColumnIterator)
+{
+  hal_size_t seqLen = sequence->getSequenceLength();
+  if (seqLen == 0)
+  {
+    return;
+  }
+  /** If the length is 0, we do from the start position until the end
+   * of the sequence */
+  if (length == 0)
+  {
+    length = seqLen - start;
+  }
+  hal_size_t last = start + length;
+  if (last > seqLen)
+  {
+    stringstream ss;
+    ss << "Specified range [" << start << "," << length << "] is"
+       << "out of range for sequence " << sequence->getName()
+       << ", which has length " << seqLen;
+    throw (hal_exception(ss.str()));
+  }
+
+  DepthWriter writer(outStream, bigWig, sequence, start, step, bedGraph);
+  if (countDupes == false && useColumnIterator == false)
+  {
+    printSequenceSegments(writer, sequence, targetSet, start, length,
+                          noAncestors);
+    return;
+  }
+
+  /** The ColumnIterator is fundamental structure used in this example to
+   * traverse the alignment.  It essientially generates the multiple alignment
+   * on the fly according to the given reference (in this case the target
+   * sequence).  Since this is the sequence interface, the positions
+   * are sequence relative.  Note that we must specify the last position
+   * in advance when we get the iterator.  This will limit it following
+   * duplications out of the desired range while we are iterating. */
+  hal_size_t pos = start;
+  ColumnIteratorConstPtr colIt = sequence->getColumnIterator(&targetSet,
+                                                             0, pos,
+                                                             last - 1,
+                                                             false,
+                                                             noAncestors);
+  /** Since the column iterator stores coordinates in Genome coordinates
+   * internally, we have to switch back to genome coordinates.  */
+  // convert to genome coordinates (and make last inclusive, as toSite
+  // expects)
+  pos += sequence->getStartPosition();
+  last += sequence->getStartPosition() - 1;
+  // keep track of unique genomes
+  set<const Genome*> genomeSet;
+  while (pos <= last)
+  {
+    /** ColumnIterator::FlatColumn lists the bases of the alignment
+     * column, grouped by Sequence */
+    const ColumnIterator::FlatColumn* column = colIt->getFlatColumn();
+    hal_size_t count = 0;
+    if (countDupes == true)
+    {
+      // countDupes enabled: we just count everything
+      count = column->size();
+    }
+    else
+    {
+      genomeSet.clear();
+      for (ColumnIterator::FlatColumn::const_iterator i = column->begin();
+           i != column->end(); ++i)
+      {
+        // just counting unique genomes
+        genomeSet.insert(i->_sequence->getGenome());
+      }
+      count = genomeSet.size();
+    }
+    // don't want to include reference base in output
+    --count;
+
+    writer.write(count, step);
+
+    /** lastColumn checks if we are at the last column (inclusive)
+     * in range.  So we need to check at end of iteration instead
+     * of beginning (which would be more convenient).  Need to
+     * merge global fix from other branch */
+    if (colIt->lastColumn() == true)
+    {
+      break;
+    }
+
+    pos += step;
+    if (pos > last)
+    {
+      break;
+    }
+    if (step == 1)
+    {
+      /** Move the iterator one position to the right */
+      colIt->toRight();
+
+      /** This is some tuning code that will probably be hidden from
+       * the interface at some point.  It is a good idea to use for now
+       * though */
+      // erase empty entries from the column.  helps when there are
+      // millions of sequences (ie from fastas with lots of scaffolds)
+      if (pos % 1000 == 0)
+      {
+        colIt->defragment();
+      }
+    }
+    else
+    {
+      /** Reset the iterator to a non-contiguous position */
+      colIt->toSite(pos, last);
+    }
+  }
+}
+
+/** Map a range of genome-level coordinates to potentially multiple sequence
+ * ranges.  For example, if a genome contains two chromosomes ChrA and ChrB,
+ * both of which are of length 500, then the genome-coordinates would be
+ * [0,499] for ChrA and [500,999] for ChrB. All aspects of the HAL API
+ * use these global coordinates (chromosomes concatenated together) except
+ * for the hal::Sequence interface.  We can convert between the two by
+ * adding or subtracting the sequence start position (in the example it woudl
+ * be 0 for ChrA and 500 for ChrB) */
+void hal::printAlignmentDepth(ostream& outStream,
+                              const Genome* genome, const Sequence* sequence,
+                              const set<const Genome*>& targetSet,
+                              hal_size_t start, hal_size_t length,
+                              hal_size_t step, bool countDupes,
+                              bool noAncestors, bool bedGraph,
+                              BigWigWriter* bigWig, bool useColumnIterator)
+{
+  if (sequence != NULL)
+  {
+    printSequence(outStream, sequence, targetSet, start, length, step,
+                  countDupes, noAncestors, bedGraph, bigWig,
+                  useColumnIterator);
+  }
+  else
+  {
+    if (start + length > genome->getSequenceLength())
+    {
+      stringstream ss;
+      ss << "Specified range [" << start << "," << length << "] is"
+         << "out of range for genome " << genome->getName()
+         << ", which has length " << genome->getSequenceLength();
+      throw (hal_exception(ss.str()));
+    }
+    if (length == 0)
+    {
+      length = genome->getSequenceLength() - start;
+    }
+
+    SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+    SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+    hal_size_t runningLength = 0;
+    for (; seqIt != seqEndIt; seqIt->toNext())
+    {
+      const Sequence* sequence = seqIt->getSequence();
+      hal_size_t seqLen = sequence->getSequenceLength();
+      hal_size_t seqStart = (hal_size_t)sequence->getStartPosition();
+
+      if (start + length >= seqStart &&
+          start < seqStart + seqLen &&
+          runningLength < length)
+      {
+        hal_size_t readStart = seqStart >= start ? 0 : start - seqStart;
+        hal_size_t readLen = min(seqLen - readStart, length);
+        readLen = min(readLen, length - runningLength);
+        printSequence(outStream, sequence, targetSet, readStart, readLen,
+                      step, countDupes, noAncestors, bedGraph, bigWig,
+                      useColumnIterator);
+        runningLength += readLen;
+      }
+    }
+  }
+}
+
+/** Count, for every base of the range, the genomes that the column
+ * iterator (without dupes) would include in its column.  This is done
+ * one window of the range at a time so that memory does not grow with
+ * the sequence length */
+void printSequenceSegments(DepthWriter& writer,
+                           const Sequence* sequence,
+                           const set<const Genome*>& targetSet,
+                           hal_size_t start, hal_size_t length,
+                           bool noAncestors)
+{
+  DepthWalker walker(sequence->getGenome(), targetSet, noAncestors);
+  hal_index_t seqStart = sequence->getStartPosition();
+  vector<pair<hal_size_t, hal_size_t> > runs;
+  for (hal_size_t windowStart = start; windowStart < start + length;
+       windowStart += SegmentWindowSize)
+  {
+    hal_index_t globalStart = seqStart + windowStart;
+    hal_index_t globalEnd = seqStart +
+       min(windowStart + SegmentWindowSize, start + length) - 1;
+    runs.clear();
+    walker.walk(globalStart, globalEnd, runs);
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+      writer.write(runs[i].first, runs[i].second);
+    }
+  }
+}
+
+DepthWalker::DepthWalker(const Genome* refGenome,
+                         const set<const Genome*>& targetSet,
+                         bool noAncestors) :
+  _refGenome(refGenome)
+{
+  /** Genomes the column iterator can visit: the spanning tree of the
+   * targets and the reference, or the whole tree if there are no
+   * targets.  Paralogies coalescing anywhere in this tree are followed */
+  const Alignment* alignment = refGenome->getAlignment();
+  if (targetSet.empty() == true)
+  {
+    _coalescenceLimit = alignment->openGenome(alignment->getRootName());
+    getGenomesInSubTree(_coalescenceLimit, _scope);
+  }
+  else
+  {
+    set<const Genome*> inputSet(targetSet);
+    inputSet.insert(refGenome);
+    getGenomesInSpanningTree(inputSet, _scope);
+    _coalescenceLimit = getLowestCommonAncestor(inputSet);
+  }
+
+  for (set<const Genome*>::const_iterator i = _scope.begin();
+       i != _scope.end(); ++i)
+  {
+    const Genome* genome = *i;
+    if (genome->getNumTopSegments() > 0)
+    {
+      _topSegments[genome] = genome->getTopSegmentIterator();
+    }
+    if (genome->getNumBottomSegments() > 0)
+    {
+      _bottomSegments[genome] = genome->getBottomSegmentIterator();
+    }
+    if (genome != refGenome &&
+        (targetSet.empty() == true || targetSet.count(genome) > 0) &&
+        (noAncestors == false || genome->getNumChildren() == 0))
+    {
+      _counted.insert(pair<const Genome*, size_t>(genome, _counted.size()));
+    }
+  }
+  _coverage.resize(_counted.size());
+}
+
+void DepthWalker::walk(hal_index_t start, hal_index_t end,
+                       vector<pair<hal_size_t, hal_size_t> >& runs)
+{
+  for (size_t i = 0; i < _coverage.size(); ++i)
+  {
+    _coverage[i].clear();
+  }
+
+  // every base is homologous to all the descendants of its oldest
+  // ancestor under the coalescence limit, so find those ancestors ...
+  vector<DepthInterval> intervals(1);
+  intervals[0]._start = start;
+  intervals[0]._refStart = start;
+  intervals[0]._length = end - start + 1;
+  intervals[0]._reversed = false;
+  vector<DepthInterval> parentIntervals;
+  vector<DepthInterval> tops;
+  const Genome* genome = _refGenome;
+  for (; genome != _coalescenceLimit && intervals.empty() == false;
+       genome = genome->getParent())
+  {
+    tops.clear();
+    parentIntervals.clear();
+    mapUp(genome, intervals, parentIntervals, tops);
+    // ... and push them down each branch below them
+    pushDown(genome, tops);
+    intervals.swap(parentIntervals);
+  }
+  pushDown(genome, intervals);
+
+  // a base counts once per genome no matter how often it gets there
+  // +1 where a genome's coverage starts and -1 one past where it ends
+  vector<pair<hal_index_t, int> > events;
+  for (size_t g = 0; g < _coverage.size(); ++g)
+  {
+    vector<pair<hal_index_t, hal_index_t> >& covered = _coverage[g];
+    sort(covered.begin(), covered.end());
+    for (size_t i = 0; i < covered.size(); ++i)
+    {
+      hal_index_t first = covered[i].first;
+      hal_index_t last = covered[i].second;
+      for (; i + 1 < covered.size() && covered[i + 1].first <= last + 1; ++i)
+      {
+        last = max(last, covered[i + 1].second);
+      }
+      events.push_back(pair<hal_index_t, int>(first, 1));
+      events.push_back(pair<hal_index_t, int>(last + 1, -1));
+    }
+  }
+
+  sort(events.begin(), events.end());
+  hal_index_t pos = start;
+  hal_size_t depth = 0;
+  for (size_t i = 0; i < events.size(); ++i)
+  {
+    if (events[i].first > pos)
+    {
+      runs.push_back(pair<hal_size_t, hal_size_t>(depth,
+                                                  events[i].first - pos));
+      pos = events[i].first;
+    }
+    depth += events[i].second;
+  }
+  if (pos <= end)
+  {
+    runs.push_back(pair<hal_size_t, hal_size_t>(depth, end + 1 - pos));
+  }
+}
+
+void DepthWalker::mapUp(const Genome* genome,
+                        const vector<DepthInterval>& intervals,
+                        vector<DepthInterval>& parentIntervals,
+                        vector<DepthInterval>& tops)
+{
+  map<const Genome*, TopSegmentIteratorConstPtr>::iterator topIt =
+     _topSegments.find(genome);
+  if (topIt == _topSegments.end())
+  {
+    tops.insert(tops.end(), intervals.begin(), intervals.end());
+    return;
+  }
+  const Genome* parent = genome->getParent();
+  TopSegmentIteratorConstPtr& top = topIt->second;
+  BottomSegmentIteratorConstPtr& parentBottom = _bottomSegments[parent];
+  hal_index_t numSegments = (hal_index_t)genome->getNumTopSegments();
+  for (size_t i = 0; i < intervals.size(); ++i)
+  {
+    const DepthInterval& interval = intervals[i];
+    hal_index_t end = interval._start + interval._length - 1;
+    for (top->toSite(interval._start, false);
+         top->getArrayIndex() < numSegments &&
+            top->getStartPosition() <= end; top->toRight())
+    {
+      hal_index_t first = max(interval._start, top->getStartPosition());
+      hal_index_t last = min(end, top->getEndPosition());
+      if (top->getTopSegment()->hasParent() == true)
+      {
+        parentBottom->setArrayIndex(parent,
+                                    top->getTopSegment()->getParentIndex());
+        addAligned(interval, first, last, top->getStartPosition(),
+                   top->getEndPosition(), parentBottom->getStartPosition(),
+                   top->getTopSegment()->getParentReversed(),
+                   parentIntervals);
+      }
+      else
+      {
+        addAligned(interval, first, last, top->getStartPosition(),
+                   top->getEndPosition(), top->getStartPosition(), false,
+                   tops);
+      }
+    }
+  }
+}
+
+void DepthWalker::mapDown(const Genome* genome, hal_size_t childIndex,
+                          const vector<DepthInterval>& intervals,
+                          vector<DepthInterval>& childIntervals)
+{
+  const Genome* child = genome->getChild(childIndex);
+  BottomSegmentIteratorConstPtr& bottom = _bottomSegments[genome];
+  TopSegmentIteratorConstPtr& childTop = _topSegments[child];
+  hal_index_t numSegments = (hal_index_t)genome->getNumBottomSegments();
+  for (size_t i = 0; i < intervals.size(); ++i)
+  {
+    const DepthInterval& interval = intervals[i];
+    hal_index_t end = interval._start + interval._length - 1;
+    for (bottom->toSite(interval._start, false);
+         bottom->getArrayIndex() < numSegments &&
+            bottom->getStartPosition() <= end; bottom->toRight())
+    {
+      if (bottom->getBottomSegment()->hasChild(childIndex) == false)
+      {
+        continue;
+      }
+      hal_index_t first = max(interval._start, bottom->getStartPosition());
+      hal_index_t last = min(end, bottom->getEndPosition());
+      // the child's paralogies of the segment all have it as parent
+      hal_index_t firstIndex =
+         bottom->getBottomSegment()->getChildIndex(childIndex);
+      hal_index_t index = firstIndex;
+      do
+      {
+        childTop->setArrayIndex(child, index);
+        addAligned(interval, first, last, bottom->getStartPosition(),
+                   bottom->getEndPosition(), childTop->getStartPosition(),
+                   childTop->getTopSegment()->getParentReversed(),
+                   childIntervals);
+        index = childTop->getTopSegment()->getNextParalogyIndex();
+      } while (index != NULL_INDEX && index != firstIndex);
+    }
+  }
+}
+
+void DepthWalker::pushDown(const Genome* genome,
+                           const vector<DepthInterval>& intervals)
+{
+  if (intervals.empty() == true)
+  {
+    return;
+  }
+  map<const Genome*, size_t>::iterator countedIt = _counted.find(genome);
+  if (countedIt != _counted.end())
+  {
+    vector<pair<hal_index_t, hal_index_t> >& covered =
+       _coverage[countedIt->second];
+    for (size_t i = 0; i < intervals.size(); ++i)
+    {
+      covered.push_back(pair<hal_index_t, hal_index_t>(
+                          intervals[i]._refStart,
+                          intervals[i]._refStart + intervals[i]._length - 1));
+    }
+  }
+  if (_bottomSegments.find(genome) == _bottomSegments.end())
+  {
+    return;
+  }
+  vector<DepthInterval> childIntervals;
+  for (hal_size_t i = 0; i < genome->getNumChildren(); ++i)
+  {
+    if (_scope.count(genome->getChild(i)) > 0)
+    {
+      childIntervals.clear();
+      mapDown(genome, i, intervals, childIntervals);
+      pushDown(genome->getChild(i), childIntervals);
+    }
+  }
+}
+
+void DepthWalker::addAligned(const DepthInterval& interval,
+                             hal_index_t start, hal_index_t end,
+                             hal_index_t segStart, hal_index_t segEnd,
+                             hal_index_t otherStart, bool reversed,
+                             vector<DepthInterval>& out)
+{
+  DepthInterval aligned;
+  aligned._length = end - start + 1;
+  hal_index_t offset = start - interval._start;
+  aligned._refStart = interval._reversed == false ?
+     interval._refStart + offset :
+     interval._refStart + (hal_index_t)interval._length - offset -
+     (hal_index_t)aligned._length;
+  aligned._start = reversed == false ? otherStart + (start - segStart) :
+     otherStart + (segEnd - end);
+  aligned._reversed = interval._reversed != reversed;
+  out.push_back(aligned);
+}
+
+DepthWriter::DepthWriter(ostream& outStream, BigWigWriter* bigWig,
+                         const Sequence* sequence, hal_size_t start,
+                         hal_size_t step, bool bedGraph) :
+  _outStream(outStream),
+  _bigWig(bigWig),
+  _sequenceName(sequence->getName()),
+  _step(step),
+  _bedGraph(bedGraph),
+  _pos(start),
+  _nextSample(start),
+  _runStart(start),
+  _runDepth(0)
+{
+  if (_bigWig != NULL)
+  {
+    _bigWig->setSequence(_sequenceName, sequence->getSequenceLength());
+  }
+  else if (_bedGraph == false)
+  {
+    // note wig coordinates are 1-based for some reason so we shift to right
+    _outStream << "fixedStep chrom=" << _sequenceName << " start="
+               << start + 1 << " step=" << step << "\n";
+  }
+}
+
+DepthWriter::~DepthWriter()
+{
+  flushRun();
+}
+
+void DepthWriter::write(hal_size_t depth, hal_size_t length)
+{
+  if (_bigWig != NULL)
+  {
+    // without a step, each sample of the wiggle covers one base
+    if (_step == 1)
+    {
+      _bigWig->addInterval(_pos, _pos + length, depth);
+    }
+    for (; _step > 1 && _nextSample < _pos + length; _nextSample += _step)
+    {
+      _bigWig->addInterval(_nextSample, _nextSample + 1, depth);
+    }
+  }
+  else if (_bedGraph == true)
+  {
+    if (depth != _runDepth)
+    {
+      flushRun();
+      _runStart = _pos;
+      _runDepth = depth;
+    }
+  }
+  else
+  {
+    for (; _nextSample < _pos + length; _nextSample += _step)
+    {
+      _outStream << depth << '\n';
+    }
+  }
+  _pos += length;
+}
+
+void DepthWriter::flushRun()
+{
+  if (_bedGraph == true && _pos > _runStart)
+  {
+    _outStream << _sequenceName << '\t' << _runStart << '\t' << _pos
+               << '\t' << _runDepth << '\n';
+  }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALALIGNMENTDEPTH_H
+#define _HALALIGNMENTDEPTH_H
+
+#include <iostream>
+#include <set>
+#include "hal.h"
+
+namespace hal {
+
+/** Write the alignment depth (the number of other genomes, or with
+ * countDupes of other positions, each base is aligned to) of a range
+ * of a genome.
+ * @param outStream stream for the wiggle or bedGraph
+ * @param genome reference genome
+ * @param sequence if not NULL, start is relative to this sequence of
+ * the genome instead of to the genome
+ * @param targetSet genomes to count (all if empty)
+ * @param start first position of the range
+ * @param length length of the range (to the end if 0)
+ * @param step distance between the positions written to a wiggle
+ * @param countDupes count every aligned position instead of genomes
+ * @param noAncestors do not count ancestral genomes
+ * @param bedGraph write bedGraph runs instead of a fixedStep wiggle
+ * @param bigWig if not NULL, write the wiggle to this instead of
+ * outStream
+ * @param useColumnIterator count genomes in the columns of a
+ * ColumnIterator instead of mapping segments (much slower, but shares
+ * the countDupes code path) */
+void printAlignmentDepth(std::ostream& outStream, const Genome* genome,
+                         const Sequence* sequence,
+                         const std::set<const Genome*>& targetSet,
+                         hal_size_t start, hal_size_t length,
+                         hal_size_t step, bool countDupes,
+                         bool noAncestors, bool bedGraph,
+                         BigWigWriter* bigWig,
+                         bool useColumnIterator = false);
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdio>
+#include <sstream>
+#include "hal.h"
+#include "halAlignmentDepth.h"
+#include "halAlignmentDepthTests.h"
+#include "halRandomData.h"
+
+using namespace std;
+using namespace hal;
+
+void AlignmentDepthSegmentsTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment,
+                        1.25,
+                        0.7,
+                        8,
+                        5,
+                        30,
+                        10,
+                        20,
+                        _seed);
+}
+
+void AlignmentDepthSegmentsTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  set<const Genome*> genomes;
+  getGenomesInSubTree(alignment->openGenome(alignment->getRootName()),
+                      genomes);
+  for (set<const Genome*>::const_iterator i = genomes.begin();
+       i != genomes.end(); ++i)
+  {
+    const Genome* genome = *i;
+    set<const Genome*> targetSet;
+    checkGenome(genome, targetSet, false);
+    if (genome->getNumChildren() == 0)
+    {
+      checkGenome(genome, targetSet, true);
+    }
+    // a target set restricts the tree to the targets' spanning tree
+    if (genome->getParent() != NULL)
+    {
+      targetSet.insert(genome->getParent());
+      if (genome->getParent()->getParent() != NULL)
+      {
+        targetSet.insert(genome->getParent()->getParent());
+      }
+      checkGenome(genome, targetSet, false);
+    }
+  }
+}
+
+void AlignmentDepthSegmentsTest::checkGenome(
+  const Genome* genome, const set<const Genome*>& targetSet, 
+  bool noAncestors)
+{
+  if (genome->getSequenceLength() == 0)
+  {
+    return;
+  }
+  // with and without --countDupes (which always uses the columns), as
+  // a wiggle, with a step, and as a bedGraph
+  hal_size_t steps[] = {1, 3, 1};
+  bool bedGraphs[] = {false, false, true};
+  for (size_t i = 0; i < 6; ++i)
+  {
+    bool countDupes = i >= 3;
+    stringstream segmentStream;
+    printAlignmentDepth(segmentStream, genome, NULL, targetSet, 0, 0,
+                        steps[i % 3], countDupes, noAncestors, 
+                        bedGraphs[i % 3], NULL, false);
+    stringstream columnStream;
+    printAlignmentDepth(columnStream, genome, NULL, targetSet, 0, 0,
+                        steps[i % 3], countDupes, noAncestors, 
+                        bedGraphs[i % 3], NULL, true);
+    CuAssertTrue(_testCase, segmentStream.str().empty() == false);
+    CuAssertTrue(_testCase, segmentStream.str() == columnStream.str());
+  }
+}
+
+void halAlignmentDepthSegmentsTest(CuTest *testCase)
+{
+  try
+  {
+    // seeds whose root genomes are not empty
+    int seeds[] = {0, 5, 6, 8};
+    for (size_t i = 0; i < 4; ++i)
+    {
+      AlignmentDepthSegmentsTest tester;
+      tester._seed = seeds[i];
+      tester.check(testCase);
+    }
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halAlignmentDepthTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halAlignmentDepthSegmentsTest);
+  return suite;
+}
+
+int halAlignmentDepthRunAllTests(void) {
+   CuString *output = CuStringNew();
+   CuSuite* suite = CuSuiteNew();
+   CuSuiteAddSuite(suite, halAlignmentDepthTestSuite());
+   CuSuiteRun(suite);
+   CuSuiteSummary(suite, output);
+   CuSuiteDetails(suite, output);
+   printf("%s\n", output->buffer);
+   return suite->failCount > 0;
+ }
+
+int main(int argc, char *argv[]) {
+   return halAlignmentDepthRunAllTests();
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALALIGNMENTDEPTHTESTS_H
+#define _HALALIGNMENTDEPTHTESTS_H
+
+#include "halAlignmentTest.h"
+
+extern "C" {
+#include "CuTest.h"
+}
+
+struct AlignmentDepthSegmentsTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkGenome(const hal::Genome* genome,
+                    const std::set<const hal::Genome*>& targetSet,
+                    bool noAncestors);
+   int _seed;
+};
+
+CuSuite *halAlignmentDepthTestSuite();
+
+#endif
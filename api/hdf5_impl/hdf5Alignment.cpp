@@ -42,8 +42,10 @@ HDF5Alignment::HDF5Alignment() :
   _flags(H5F_ACC_RDONLY),
   _metaData(NULL),
   _tree(NULL),
+  _genomeTree(NULL),
   _dirty(false),
-  _inMemory(false)
+  _inMemory(false),
+  _arrayCacheChunks(HDF5CLParser::DefaultArrayCacheChunks)
 {
   // set defaults from the command-line parser
   HDF5CLParser defaultOptions(true);  
@@ -59,8 +61,10 @@ HDF5Alignment::HDF5Alignment(const H5::FileCreatPropList& fileCreateProps,
   _flags(H5F_ACC_RDONLY),
   _metaData(NULL),
   _tree(NULL),
+  _genomeTree(NULL),
   _dirty(false),
-  _inMemory(inMemory)
+  _inMemory(inMemory),
+  _arrayCacheChunks(HDF5CLParser::DefaultArrayCacheChunks)
 {
   _cprops.copy(fileCreateProps);
   _aprops.copy(fileAccessProps);
@@ -98,6 +102,7 @@ void HDF5Alignment::createNew(const string& alignmentPath)
   delete _metaData;
   _metaData = new HDF5MetaData(_file, MetaGroupName);
   _tree = NULL;
+  resetGenomeTree();
   _dirty = true;
   writeVersion();
 }
@@ -148,6 +153,7 @@ void HDF5Alignment::close()
       stTree_destruct(_tree);
       _tree = NULL;
     }
+    resetGenomeTree();
     // todo: make sure there's no memory leak with metadata 
     // smart pointer should prevent
     if (_metaData != NULL)
@@ -187,6 +193,7 @@ void HDF5Alignment::close() const
       stTree_destruct(const_cast<HDF5Alignment*>(this)->_tree);
        const_cast<HDF5Alignment*>(this)->_tree = NULL;
     }
+    resetGenomeTree();
     // todo: make sure there's no memory leak with metadata 
     // smart pointer should prevent
     if (_metaData != NULL)
@@ -225,6 +232,7 @@ void HDF5Alignment::setOptionsFromParser(CLParserConstPtr parser) const
   hdf5Parser->applyToDCProps(_dcprops);
   hdf5Parser->applyToAProps(_aprops);
   _inMemory = hdf5Parser->getInMemory();
+  _arrayCacheChunks = hdf5Parser->getArrayCacheChunks();
   if (_inMemory == true)
   {
     int mdc;
@@ -277,8 +285,10 @@ Genome*  HDF5Alignment::insertGenome(const string& name,
   double lowerBranchLength = existingBranchLength - upperBranchLength;
   stTree_setParent(child, newNode);
   stTree_setBranchLength(child, lowerBranchLength);
+  resetGenomeTree();
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _arrayCacheChunks);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -308,8 +318,10 @@ Genome*  HDF5Alignment::addLeafGenome(const string& name,
   stTree_setParent(node, parent);
   stTree_setBranchLength(node, branchLength);
   _nodeMap.insert(pair<string, stTree*>(name, node));
+  resetGenomeTree();
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _arrayCacheChunks);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -336,8 +348,10 @@ Genome* HDF5Alignment::addRootGenome(const string& name,
   }
   _tree = node;
   _nodeMap.insert(pair<string, stTree*>(name, node));
+  resetGenomeTree();
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _arrayCacheChunks);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -453,6 +467,7 @@ void HDF5Alignment::removeGenome(const string& name)
   _file->unlink(name);
   _nodeMap.erase(findIt);
   stTree_destruct(node);
+  resetGenomeTree();
   _dirty = true;
 }
 
@@ -467,7 +482,7 @@ const Genome* HDF5Alignment::openGenome(const string& name) const
   if (_nodeMap.find(name) != _nodeMap.end())
   {
     genome = new HDF5Genome(name, const_cast<HDF5Alignment*>(this), 
-                            _file, _dcprops, _inMemory);
+                            _file, _dcprops, _inMemory, _arrayCacheChunks);
     genome->read();
     _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   }
@@ -484,7 +499,8 @@ Genome* HDF5Alignment::openGenome(const string& name)
   HDF5Genome* genome = NULL;
   if (_nodeMap.find(name) != _nodeMap.end())
   {
-    genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+    genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                            _arrayCacheChunks);
     genome->read();
     _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   }
@@ -642,6 +658,15 @@ hal_size_t HDF5Alignment::getNumGenomes() const
   }
 }
 
+const GenomeTree* HDF5Alignment::getGenomeTree() const
+{
+  if (_genomeTree == NULL)
+  {
+    _genomeTree = new GenomeTree(this);
+  }
+  return _genomeTree;
+}
+
 MetaData* HDF5Alignment::getMetaData()
 {
   return _metaData;
@@ -688,6 +713,27 @@ string HDF5Alignment::getVersion() const
   }
 }
 
+// the HDF5 library itself is not reentrant (unless built with
+// --enable-threadsafe, which just serializes every call anyway), and
+// the genomes share array buffers between iterators.
+bool HDF5Alignment::supportsConcurrentReads() const
+{
+  return false;
+}
+
+// the ids of the open genomes refer to the tree, so they are reset
+// along with it
+void HDF5Alignment::resetGenomeTree() const
+{
+  delete _genomeTree;
+  _genomeTree = NULL;
+  map<string, HDF5Genome*>::iterator mapIt;
+  for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt)
+  {
+    mapIt->second->resetTreeCache();
+  }
+}
+
 void HDF5Alignment::writeTree()
 {
   if (_dirty == false)
@@ -738,6 +784,7 @@ static void addNodeToMap(stTree* node, map<string, stTree*>& nodeMap)
 void HDF5Alignment::loadTree()
 {
   _nodeMap.clear();
+  resetGenomeTree();
   HDF5MetaData treeMeta(_file, TreeGroupName);
   map<string, string> metaMap = treeMeta.getMap();
   assert(metaMap.size() == 1);
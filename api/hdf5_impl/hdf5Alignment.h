@@ -75,6 +75,8 @@ public:
 
    hal_size_t getNumGenomes() const;
 
+   const GenomeTree* getGenomeTree() const;
+
    MetaData* getMetaData();
 
    const MetaData* getMetaData() const;
@@ -83,6 +85,8 @@ public:
 
    std::string getVersion() const;
 
+   bool supportsConcurrentReads() const;
+
 protected:
    // Nobody creates this class except through the interface. 
    friend AlignmentPtr hdf5AlignmentInstance();
@@ -107,6 +111,7 @@ protected:
    void loadTree();
    void writeTree();
    void writeVersion();
+   void resetGenomeTree() const;
    void addGenomeToTree(const std::string& name,
                         const std::pair<std::string, double>& parentName,
                         const std::vector<std::pair<std::string, double> >&
@@ -127,9 +132,11 @@ protected:
    static const H5std_string VersionGroupName;
    stTree* _tree;
    mutable std::map<std::string, stTree*> _nodeMap;
+   mutable GenomeTree* _genomeTree;
    bool _dirty;
    mutable std::map<std::string, HDF5Genome*> _openGenomes;
    mutable bool _inMemory;
+   mutable hsize_t _arrayCacheChunks;
 };
 
 }
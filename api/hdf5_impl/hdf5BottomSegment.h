@@ -24,6 +24,7 @@ public:
 
    friend class HDF5TopSegmentIterator;
    friend class HDF5BottomSegmentIterator;
+   friend class HDF5Genome;
 
     /** Constructor 
     * @param genome Smart pointer to genome to which segment belongs
@@ -59,7 +60,7 @@ public:
    hal_size_t getMappedSegments(
      std::set<MappedSegmentConstPtr>& outSegments,
      const Genome* tgtGenome,
-     const std::set<const Genome*>* genomesOnPath,
+     const GenomeSet* genomesOnPath,
      bool doDupes,
      hal_size_t minLength,
      const Genome *coalescenceLimit,
@@ -278,7 +279,7 @@ inline bool HDF5BottomSegment::isTop() const
 inline hal_size_t HDF5BottomSegment::getMappedSegments(
   std::set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const std::set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
@@ -21,6 +21,7 @@ const hsize_t HDF5CLParser::DefaultCacheRDCElems = 599999;
 const hsize_t HDF5CLParser::DefaultCacheRDCBytes = 15728640;
 const double HDF5CLParser::DefaultCacheW0 = 0.75;
 const bool HDF5CLParser::DefaultInMemory = false;
+const hsize_t HDF5CLParser::DefaultArrayCacheChunks = 4;
 
 HDF5CLParser::HDF5CLParser(bool createOptions) :
   CLParser()
@@ -41,6 +42,9 @@ HDF5CLParser::HDF5CLParser(bool createOptions) :
   addOption("cacheW0", "w0 parameter fro hdf5 cache", DefaultCacheW0);
   addOptionFlag("inMemory", "load all data in memory (and disable hdf5 cache)",
                 DefaultInMemory);
+  addOption("arrayCacheChunks", "number of chunks of each genome array to "
+            "keep in memory at once (least recently used chunk is replaced)."
+            "  ignored with --inMemory", DefaultArrayCacheChunks);
 #ifdef ENABLE_UDC
   addOption("udcCacheDir", "udc cache path for *input* hal file(s).",
             "\"\"");
@@ -75,3 +79,8 @@ bool HDF5CLParser::getInMemory() const
 {
   return getFlag("inMemory");
 }
+
+hsize_t HDF5CLParser::getArrayCacheChunks() const
+{
+  return getOption<hsize_t>("arrayCacheChunks");
+}
@@ -24,6 +24,7 @@ public:
    void applyToDCProps(H5::DSetCreatPropList& dcprops) const;
    void applyToAProps(H5::FileAccPropList& aprops) const;
    bool getInMemory() const;
+   hsize_t getArrayCacheChunks() const;
 
    static const hsize_t DefaultChunkSize;
    static const hsize_t DefaultDeflate;
@@ -32,6 +33,7 @@ public:
    static const hsize_t DefaultCacheRDCBytes;
    static const double DefaultCacheW0;
    static const bool DefaultInMemory;
+   static const hsize_t DefaultArrayCacheChunks;
 
 protected:
    // Nobody creates this class except through the interface. 
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <string>
+#include "hdf5DNA.h"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+using namespace std;
+using namespace hal;
+
+// characters for each 4-bit code (see HDF5DNA::unpack), and their 
+// complements.  codes 5-7 are never written for valid input
+static const char UnpackTable[16] = {
+  'a', 'c', 'g', 't', 'n', 'x', 'x', 'x',
+  'A', 'C', 'G', 'T', 'N', 'X', 'X', 'X'};
+static const char ComplementTable[16] = {
+  't', 'g', 'c', 'a', 'n', 'x', 'x', 'x',
+  'T', 'G', 'C', 'A', 'N', 'X', 'X', 'X'};
+
+static const unsigned char InvalidCode = 255U;
+
+/** 4-bit codes for each character (and for its complement), 
+ * InvalidCode for characters that are not nucleotides */
+struct PackTables
+{
+   PackTables();
+   unsigned char _codes[256];
+   unsigned char _complementCodes[256];
+};
+
+PackTables::PackTables()
+{
+  for (size_t i = 0; i < 256; ++i)
+  {
+    _codes[i] = InvalidCode;
+    _complementCodes[i] = InvalidCode;
+  }
+  // n is its own complement
+  for (unsigned char code = 0; code < 16; ++code)
+  {
+    if ((code & 7U) <= 4U)
+    {
+      _codes[(unsigned char)UnpackTable[code]] = code;
+      _complementCodes[(unsigned char)ComplementTable[code]] = code;
+    }
+  }
+}
+
+static const PackTables packTables;
+
+// out position of the kth character of the run
+static inline hal_size_t outPos(hal_size_t k, hal_size_t length, 
+                                bool reversed)
+{
+  return reversed ? length - 1 - k : k;
+}
+
+void HDF5DNA::unpack(const unsigned char* packed, hal_index_t first,
+                     hal_size_t length, bool reversed, char* out)
+{
+  const char* table = reversed ? ComplementTable : UnpackTable;
+  hal_size_t k = 0;
+  if (length > 0 && first % 2 != 0)
+  {
+    out[outPos(0, length, reversed)] = table[*packed & 15U];
+    ++packed;
+    ++k;
+  }
+
+  // from here on character first + k is in the high bits of *packed
+#ifdef __SSSE3__
+  // 16 bytes are unpacked at once: each nibble is looked up in the 
+  // table with a byte shuffle, then the high and low nibbles are 
+  // interleaved back into character order
+  const __m128i lookup = _mm_loadu_si128(
+    reinterpret_cast<const __m128i*>(table));
+  const __m128i lowMask = _mm_set1_epi8(15);
+  const __m128i reverseMask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 
+                                           8, 9, 10, 11, 12, 13, 14, 15);
+  for (; length - k >= 32; k += 32, packed += 16)
+  {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask);
+    __m128i low = _mm_and_si128(bytes, lowMask);
+    high = _mm_shuffle_epi8(lookup, high);
+    low = _mm_shuffle_epi8(lookup, low);
+    __m128i chars0 = _mm_unpacklo_epi8(high, low);
+    __m128i chars1 = _mm_unpackhi_epi8(high, low);
+    if (reversed == false)
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), chars0);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k + 16), chars1);
+    }
+    else
+    {
+      char* dest = out + length - k - 32;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                       _mm_shuffle_epi8(chars1, reverseMask));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16),
+                       _mm_shuffle_epi8(chars0, reverseMask));
+    }
+  }
+#endif
+
+  for (; length - k >= 2; k += 2, ++packed)
+  {
+    out[outPos(k, length, reversed)] = table[*packed >> 4];
+    out[outPos(k + 1, length, reversed)] = table[*packed & 15U];
+  }
+  if (k < length)
+  {
+    out[outPos(k, length, reversed)] = table[*packed >> 4];
+  }
+}
+
+void HDF5DNA::pack(const char* in, hal_index_t first, hal_size_t length,
+                   bool reversed, unsigned char* packed)
+{
+  const unsigned char* codes = reversed ? packTables._complementCodes :
+     packTables._codes;
+  for (hal_size_t k = 0; k < length; ++k)
+  {
+    char c = in[outPos(k, length, reversed)];
+    unsigned char code = codes[(unsigned char)c];
+    if (code == InvalidCode)
+    {
+      throw hal_exception(string("Trying to set invalid charachter: ") + c);
+    }
+    if ((first + k) % 2 == 0)
+    {
+      *packed = (*packed & 15U) | (code << 4);
+    }
+    else
+    {
+      *packed = (*packed & 240U) | code;
+      ++packed;
+    }
+  }
+}
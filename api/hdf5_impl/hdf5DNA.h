@@ -22,6 +22,26 @@ public:
    static char unpack(hal_index_t index, unsigned char packedChar);
    static void pack(char unpackedChar, hal_index_t index, 
                     unsigned char& packedChar);
+
+   /** Unpack a run of characters.  
+    * @param packed byte holding character first
+    * @param first index of first character
+    * @param length number of characters to unpack 
+    * @param reversed write the reverse complement of the run, ie
+    * out[0] is the complement of character first + length - 1
+    * @param out buffer of at least length characters */
+   static void unpack(const unsigned char* packed, hal_index_t first,
+                      hal_size_t length, bool reversed, char* out);
+
+   /** Pack a run of characters (inverse of the above).  Throws 
+    * a hal_exception if in contains a character that is not a nucleotide.
+    * @param in characters to pack
+    * @param first index of first character 
+    * @param length number of characters to pack
+    * @param reversed pack the reverse complement of in
+    * @param packed byte holding character first */
+   static void pack(const char* in, hal_index_t first, hal_size_t length,
+                    bool reversed, unsigned char* packed);
 };
 
 // inline members
@@ -8,6 +8,7 @@
 #define _HDF5DNAITERATOR_H
 
 #include <cassert>
+#include <algorithm>
 #include <H5Cpp.h>
 #include "halDNAIterator.h"
 #include "halCommon.h"
@@ -169,21 +170,63 @@ inline void HDF5DNAIterator::readString(std::string& outString,
   assert(length == 0 || inRange() == true);
   outString.resize(length);
 
-  for (hal_size_t i = 0; i < length; ++i)
+  // unpack the run one page of the DNA array at a time
+  hal_size_t done = 0;
+  while (done < length)
   {
-    outString[i] = getChar();
-    toRight();
+    hal_index_t first = _index;
+    hal_index_t last = _index + (hal_index_t)(length - done) - 1;
+    if (_reversed == true)
+    {
+      first = _index - (hal_index_t)(length - done) + 1;
+      last = _index;
+    }
+    assert(first >= 0 && 
+           last < (hal_index_t)_genome->_totalSequenceLength);
+    hsize_t bufStart;
+    hsize_t bufEnd;
+    const unsigned char* buf = reinterpret_cast<const unsigned char*>(
+      _genome->_dnaArray.getBuffer(_index / 2, bufStart, bufEnd));
+    first = std::max(first, (hal_index_t)bufStart * 2);
+    last = std::min(last, (hal_index_t)bufEnd * 2 + 1);
+    hal_size_t count = last - first + 1;
+    HDF5DNA::unpack(buf + (first / 2 - bufStart), first, count, _reversed,
+                    &outString[done]);
+    done += count;
+    _index += _reversed ? -(hal_index_t)count : (hal_index_t)count;
   }
 }
 
 inline void HDF5DNAIterator::writeString(const std::string& inString,
                                          hal_size_t length)
 {
-  assert(length == 0 || inRange() == true);
-  for (hal_size_t i = 0; i < length; ++i)
+  hal_size_t done = 0;
+  while (done < length)
   {
-    setChar(inString[i]);
-    toRight();
+    hal_index_t first = _index;
+    hal_index_t last = _index + (hal_index_t)(length - done) - 1;
+    if (_reversed == true)
+    {
+      first = _index - (hal_index_t)(length - done) + 1;
+      last = _index;
+    }
+    if (inRange() == false || first < 0 || 
+        last >= (hal_index_t)_genome->_totalSequenceLength ||
+        last / 2 >= (hal_index_t)_genome->_dnaArray.getSize())
+    {
+      throw hal_exception("Trying to set character out of range");
+    }
+    hsize_t bufStart;
+    hsize_t bufEnd;
+    unsigned char* buf = reinterpret_cast<unsigned char*>(
+      _genome->_dnaArray.getUpdateBuffer(_index / 2, bufStart, bufEnd));
+    first = std::max(first, (hal_index_t)bufStart * 2);
+    last = std::min(last, (hal_index_t)bufEnd * 2 + 1);
+    hal_size_t count = last - first + 1;
+    HDF5DNA::pack(inString.data() + done, first, count, _reversed,
+                  buf + (first / 2 - bufStart));
+    done += count;
+    _index += _reversed ? -(hal_index_t)count : (hal_index_t)count;
   }
 }
 
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <algorithm>
 #include "hdf5ExternalArray.h"
 
 using namespace hal;
@@ -21,13 +22,18 @@ HDF5ExternalArray::HDF5ExternalArray() :
   _bufEnd(0),
   _bufSize(0),
   _buf(NULL),
-  _dirty(false)
+  _dirty(false),
+  _pageCapacity(0),
+  _curPage(0),
+  _pageClock(0),
+  _pageHits(0),
+  _pageMisses(0)
 {}
 
 /** Destructor */
 HDF5ExternalArray::~HDF5ExternalArray()
 {
-  delete [] _buf;
+  freePages();
 }
 
 // Create a new dataset in specifed location
@@ -36,7 +42,8 @@ void HDF5ExternalArray::create(CommonFG* file,
                                const DataType& dataType,
                                hsize_t numElements,
                                const DSetCreatPropList* inCparms,
-                               hsize_t chunksInBuffer)
+                               hsize_t chunksInBuffer,
+                               hsize_t numPages)
 {
   // copy in parameters
   _file = file;
@@ -75,23 +82,28 @@ void HDF5ExternalArray::create(CommonFG* file,
     _chunkSize = 0;
   }
   
-  // create the internal data buffer
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufStart = 0;
-  _bufEnd = _bufStart + _bufSize - 1;
-  delete [] _buf;
-  _buf = new char[_bufSize * _dataSize];
+  // create the internal data buffers. the first one is considered
+  // to be already loaded since there's nothing to read yet.
+  _pageCapacity = _chunkSize > 1 ? _chunkSize : _size;  
+  initPages(numPages);
+  if (_size > 0)
+  {
+    Page& first = _pages[0];
+    first._start = 0;
+    first._end = min(_pageCapacity, _size) - 1;
+    first._loaded = true;
+    setCurrentPage(0);
+  }
 
   // create the hdf5 array
   _dataSet = _file->createDataSet(_path, _dataType, _dataSpace, cparms);
-  _chunkSpace = DataSpace(1, &_bufSize);
   assert(getSize() == numElements);
   assert(_bufSize > 0 || _size == 0);
 }
 
 // Load an existing dataset into memory
 void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
-                             hsize_t chunksInBuffer)
+                             hsize_t chunksInBuffer, hsize_t numPages)
 {
   // load up the parameters
   _file = file;
@@ -126,47 +138,147 @@ void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
     _chunkSize = 0;
   }
   
-  // create the internal data buffer
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufEnd = _bufStart + _bufSize - 1;
-  // set out of range to ensure page happens
-  _bufStart = _bufEnd + 1;
-  delete [] _buf;
-  _buf = new char[_bufSize * _dataSize];
-
-  assert(_bufSize > 0 || _size == 0);
+  // create the internal data buffers (nothing is read until the
+  // first page() call)
+  _pageCapacity = _chunkSize > 1 ? _chunkSize : _size;  
+  initPages(numPages);
 }
 
-// Write the memory buffer back to the file 
+// Write the memory buffers back to the file 
 void HDF5ExternalArray::write()
 {
-  if (_dirty == true)
+  if (_pages.empty() == true)
   {
-    _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-    _dataSet.write(_buf, _dataType, _chunkSpace, _dataSpace);
+    return;
   }
+  _pages[_curPage]._dirty = _dirty;
+  for (size_t i = 0; i < _pages.size(); ++i)
+  {
+    if (_pages[i]._loaded == true && _pages[i]._dirty == true)
+    {
+      writePage(_pages[i]);
+    }
+  }
+  _dirty = false;
 }
 
 // Page chunk containing index i into memory 
 void HDF5ExternalArray::page(hsize_t i)
 {
-  if (_dirty == true)
+  assert(_pages.empty() == false);
+  Page& current = _pages[_curPage];
+  if (current._loaded == true)
   {
-    write();
+    current._dirty = _dirty;
+    current._lastUsed = ++_pageClock;
   }
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufStart = (i / _bufSize) * _bufSize; // todo: review
-  _bufEnd = _bufStart + _bufSize - 1;  
 
-  if (_bufEnd >= _size)
+  // try the cache first
+  for (size_t p = 0; p < _pages.size(); ++p)
   {
-    _bufEnd = _size - 1;
-    _bufSize = _bufEnd - _bufStart + 1;
+    const Page& cached = _pages[p];
+    if (cached._loaded == true && i >= cached._start && i <= cached._end)
+    {
+      ++_pageHits;
+      setCurrentPage(p);
+      return;
+    }
   }
 
-  _chunkSpace = DataSpace(1, &_bufSize);
-  _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-  _dataSet.read(_buf, _dataType, _chunkSpace, _dataSpace);
-  _dirty = false;
+  // recycle an empty page if there is one, otherwise the least
+  // recently used one
+  ++_pageMisses;
+  size_t victim = 0;
+  for (size_t p = 1; p < _pages.size() && _pages[victim]._loaded == true; ++p)
+  {
+    if (_pages[p]._loaded == false || 
+        _pages[p]._lastUsed < _pages[victim]._lastUsed)
+    {
+      victim = p;
+    }
+  }
+  if (_pages[victim]._loaded == true && _pages[victim]._dirty == true)
+  {
+    writePage(_pages[victim]);
+  }
+  readPage(_pages[victim], i);
+  setCurrentPage(victim);
   assert(_bufSize > 0 || _size == 0);
 }
+
+void HDF5ExternalArray::initPages(hsize_t numPages)
+{
+  freePages();
+  // no point in more than one buffer if it holds the whole array
+  if (numPages == 0 || _pageCapacity >= _size)
+  {
+    numPages = 1;
+  }
+  _pages.resize(numPages);
+  for (size_t i = 0; i < _pages.size(); ++i)
+  {
+    Page& page = _pages[i];
+    page._start = 0;
+    page._end = 0;
+    page._buf = new char[_pageCapacity * _dataSize];
+    page._loaded = false;
+    page._dirty = false;
+    page._lastUsed = 0;
+  }
+  _curPage = 0;
+  _pageClock = 0;
+  _pageHits = 0;
+  _pageMisses = 0;
+  // set out of range to ensure page happens
+  _buf = _pages[0]._buf;
+  _bufStart = 1;
+  _bufEnd = 0;
+  _bufSize = 0;
+  _dirty = false;
+}
+
+void HDF5ExternalArray::freePages()
+{
+  for (size_t i = 0; i < _pages.size(); ++i)
+  {
+    delete [] _pages[i]._buf;
+  }
+  _pages.clear();
+  _buf = NULL;
+}
+
+void HDF5ExternalArray::setCurrentPage(hsize_t pageIdx)
+{
+  assert(pageIdx < _pages.size());
+  Page& page = _pages[pageIdx];
+  assert(page._loaded == true);
+  _curPage = pageIdx;
+  _buf = page._buf;
+  _bufStart = page._start;
+  _bufEnd = page._end;
+  _bufSize = _bufEnd - _bufStart + 1;
+  _dirty = page._dirty;
+}
+
+void HDF5ExternalArray::readPage(Page& page, hsize_t i)
+{
+  assert(i < _size);
+  page._start = (i / _pageCapacity) * _pageCapacity;
+  page._end = min(page._start + _pageCapacity, _size) - 1;
+  hsize_t pageSize = page._end - page._start + 1;
+  DataSpace pageSpace(1, &pageSize);
+  _dataSpace.selectHyperslab(H5S_SELECT_SET, &pageSize, &page._start);
+  _dataSet.read(page._buf, _dataType, pageSpace, _dataSpace);
+  page._loaded = true;
+  page._dirty = false;
+}
+
+void HDF5ExternalArray::writePage(Page& page)
+{
+  assert(page._loaded == true);
+  hsize_t pageSize = page._end - page._start + 1;
+  DataSpace pageSpace(1, &pageSize);
+  _dataSpace.selectHyperslab(H5S_SELECT_SET, &pageSize, &page._start);
+  _dataSet.write(page._buf, _dataType, pageSpace, _dataSpace);
+  page._dirty = false;
+}
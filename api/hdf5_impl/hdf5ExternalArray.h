@@ -8,6 +8,7 @@
 #define _HDF5EXTERNALARRAY_H
 
 #include <cassert>
+#include <vector>
 #include <H5Cpp.h>
 #include "halDefs.h"
 
@@ -20,6 +21,12 @@ namespace hal {
  * We can't use compiler tpying of the input objects (and instead just 
  * expose the raw void* data) because the elements' sizes are not known
  * at compile time, and we don't want to move it around once its read.
+ *
+ * Up to numPages buffers (pages) are kept in memory at once, and the 
+ * least recently used one is recycled when a new one needs to be read.
+ * This keeps access patterns that alternate between a few distant 
+ * regions of the array (ex. following paralogy cycles or jumping 
+ * between sequences) from re-reading the same chunk over and over. 
  */
 class HDF5ExternalArray
 {
@@ -41,13 +48,16 @@ public:
      * 0: load entire array into buffer
      * 1: use default chunking (from dataset)
      * N: buffersize will be N chunks. 
+     * @param numPages Number of buffers to keep in the page cache 
+     * (forced to 1 when the whole array is loaded into a single buffer)
      */
    void create(H5::CommonFG* file, 
                const H5std_string& path, 
                const H5::DataType& dataType,
                hsize_t numElements,
                const H5::DSetCreatPropList* inCparms = NULL,
-               hsize_t chunksInBuffer = 1);
+               hsize_t chunksInBuffer = 1,
+               hsize_t numPages = 1);
  
    /** Load an existing dataset into memory
      * @param file Pointer to the HDF5 file in which to create array
@@ -56,11 +66,13 @@ public:
      * 0: load entire array into buffer
      * 1: use default chunking (from dataset)
      * N: buffersize will be N chunks. 
+     * @param numPages Number of buffers to keep in the page cache 
+     * (forced to 1 when the whole array is loaded into a single buffer)
      */
    void load(H5::CommonFG* file, const H5std_string& path,
-             hsize_t chunksInBuffer = 1);
+             hsize_t chunksInBuffer = 1, hsize_t numPages = 1);
    
-   /** Write the memory buffer back to the file */
+   /** Write all modified memory buffers back to the file */
    void write();
 
    /** Access the raw data at given index
@@ -73,6 +85,17 @@ public:
     */
    char* getUpdate(hsize_t i);
 
+   /** Access the raw data of the in-memory buffer holding the given
+    * index, for reading runs of elements without paging each one.
+    * @param i index of element that must be in the buffer
+    * @param bufStart set to index of first element in buffer
+    * @param bufEnd set to index of last element in buffer 
+    * @return raw data of element bufStart */
+   const char* getBuffer(hsize_t i, hsize_t& bufStart, hsize_t& bufEnd);
+
+   /** Same as getBuffer, but for updating (see getUpdate) */
+   char* getUpdateBuffer(hsize_t i, hsize_t& bufStart, hsize_t& bufEnd);
+
    /** Access typed value within element in a raw data array 
     * @param index Index of element (struct) in the array
     * @param offset Offset of value within struct (number of bytes) */
@@ -94,12 +117,56 @@ public:
 
    /** Get the HDF5 Datatype */
    const H5::DataType& getDataType() const;
+
+   /** Number of buffers in the page cache */
+   hsize_t getNumPages() const;
+
+   /** Number of accesses outside the current buffer that were found
+    * in another buffer of the page cache */
+   hsize_t getNumPageHits() const;
+
+   /** Number of accesses outside the current buffer that required 
+    * reading a chunk from the file */
+   hsize_t getNumPageMisses() const;
    
 protected:
 
-   /** Read chunk from file */
+   /** Slot in the page cache */
+   struct Page
+   {
+      /** Index of first element in buffer */
+      hsize_t _start;
+      /** Index of last element in buffer */
+      hsize_t _end;
+      /** In-memory buffer (capacity of _pageCapacity elements) */
+      char* _buf;
+      /** Buffer contains data */
+      bool _loaded;
+      /** Buffer must be written to disk before being recycled */
+      bool _dirty;
+      /** Value of _pageClock when page was last current */
+      hsize_t _lastUsed;
+   };
+
+   /** Make the page containing index i current, reading it from the 
+    * file if it isn't already in the cache */
    void page(hsize_t i);
 
+   /** (Re)allocate the page cache */
+   void initPages(hsize_t numPages);
+
+   /** Free the page cache */
+   void freePages();
+
+   /** Make cached page current */
+   void setCurrentPage(hsize_t pageIdx);
+
+   /** Read chunk containing index i from file into page */
+   void readPage(Page& page, hsize_t i);
+
+   /** Write page back to the file */
+   void writePage(Page& page);
+
    /** Pointer to file that owns this dataset */
    H5::CommonFG* _file;
    /** Path of dataset in file */
@@ -116,19 +183,29 @@ protected:
    hsize_t _chunkSize;
    /** Size of datatype in bytes */
    hsize_t _dataSize;
-   /** Index of first element in memory buffer */
+   /** Index of first element in current memory buffer */
    hsize_t _bufStart;
-   /** Index of last element in memory buffer */
+   /** Index of last element in current memory buffer */
    hsize_t _bufEnd;
-   /** Number of elements in memory buffer */
+   /** Number of elements in current memory buffer */
    hsize_t _bufSize;
-   /** In-memory buffer */
+   /** Current in-memory buffer (belongs to _pages[_curPage]) */
    char* _buf;
-   /** Dimensional information for in-memory buffer */
-   H5::DataSpace _chunkSpace;
-   /** Flag saying we should write to disk on write
+   /** Flag saying we should write current buffer to disk on write
     * or page-out calls (set by getUpdate()) */
    bool _dirty;
+   /** Maximum number of elements in a page */
+   hsize_t _pageCapacity;
+   /** The page cache */
+   std::vector<Page> _pages;
+   /** Index of the current page in _pages */
+   hsize_t _curPage;
+   /** Counter used to timestamp pages for LRU replacement */
+   hsize_t _pageClock;
+   /** Cache hit counter */
+   hsize_t _pageHits;
+   /** Cache miss counter */
+   hsize_t _pageMisses;
 
 private:
 
@@ -164,6 +241,26 @@ inline char* HDF5ExternalArray::getUpdate(hsize_t i)
   return _buf + (i - _bufStart) * _dataSize;
 }
 
+inline const char* HDF5ExternalArray::getBuffer(hsize_t i, 
+                                                hsize_t& bufStart,
+                                                hsize_t& bufEnd)
+{
+  get(i);
+  bufStart = _bufStart;
+  bufEnd = _bufEnd;
+  return _buf;
+}
+
+inline char* HDF5ExternalArray::getUpdateBuffer(hsize_t i, 
+                                                hsize_t& bufStart,
+                                                hsize_t& bufEnd)
+{
+  getUpdate(i);
+  bufStart = _bufStart;
+  bufEnd = _bufEnd;
+  return _buf;
+}
+
 inline hsize_t HDF5ExternalArray::getSize() const
 {
   return _size;
@@ -193,5 +290,20 @@ inline const H5::DataType& HDF5ExternalArray::getDataType() const
   return _dataType;
 }
 
+inline hsize_t HDF5ExternalArray::getNumPages() const
+{
+  return _pages.size();
+}
+
+inline hsize_t HDF5ExternalArray::getNumPageHits() const
+{
+  return _pageHits;
+}
+
+inline hsize_t HDF5ExternalArray::getNumPageMisses() const
+{
+  return _pageMisses;
+}
+
 }
 #endif
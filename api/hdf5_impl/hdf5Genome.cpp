@@ -5,6 +5,7 @@
 #include <cassert>
 #include <iostream>
 #include <algorithm>
+#include <cstddef>
 #include "H5Cpp.h"
 #include "hdf5Genome.h"
 #include "hdf5DNA.h"
@@ -29,6 +30,8 @@ const string HDF5Genome::topArrayName = "TOP_ARRAY";
 const string HDF5Genome::bottomArrayName = "BOTTOM_ARRAY";
 const string HDF5Genome::sequenceIdxArrayName = "SEQIDX_ARRAY";
 const string HDF5Genome::sequenceNameArrayName = "SEQNAME_ARRAY";
+const string HDF5Genome::sequenceNameIdxArrayName = "SEQNAMEIDX_ARRAY";
+const string HDF5Genome::sequenceSiteIdxArrayName = "SEQSITEIDX_ARRAY";
 const string HDF5Genome::metaGroupName = "Meta";
 const string HDF5Genome::rupGroupName = "Rup";
 const double HDF5Genome::dnaChunkScale = 10.;
@@ -37,14 +40,20 @@ HDF5Genome::HDF5Genome(const string& name,
                        HDF5Alignment* alignment,
                        CommonFG* h5Parent,
                        const DSetCreatPropList& dcProps,
-                       bool inMemory) :
+                       bool inMemory,
+                       hsize_t numPagesInArrayCache) :
   _alignment(alignment),
   _h5Parent(h5Parent),
   _name(name),
   _numChildrenInBottomArray(0),
   _totalSequenceLength(0),
   _numChunksInArrayBuffer(inMemory ? 0 : 1),
-  _parentCache(NULL)
+  _numPagesInArrayCache(numPagesInArrayCache),
+  _parentCache(NULL),
+  _genomeId(NULL_INDEX),
+  _siteHit(NULL),
+  _siteHitStart(0),
+  _siteHitEnd(0)
 {
   _dcprops.copy(dcProps);
   assert(!name.empty());
@@ -89,6 +98,18 @@ HDF5Genome::~HDF5Genome()
 
 //GENOME INTERFACE
 
+// one SequenceSiteRecord per element, laid out as in memory
+H5::CompType HDF5Genome::siteIdxDataType()
+{
+  assert(PredType::NATIVE_HSIZE.getSize() == sizeof(uint64_t));
+  CompType dataType(sizeof(SequenceSiteRecord));
+  dataType.insertMember("start", offsetof(SequenceSiteRecord, _start),
+                        PredType::NATIVE_HSIZE);
+  dataType.insertMember("index", offsetof(SequenceSiteRecord, _index),
+                        PredType::NATIVE_HSIZE);
+  return dataType;
+}
+
 void HDF5Genome::setDimensions(
   const vector<Sequence::Info>& sequenceDimensions,
   bool storeDNAArrays)
@@ -139,6 +160,18 @@ void HDF5Genome::setDimensions(
     _group.unlink(sequenceNameArrayName);
   }
   catch (H5::Exception){}
+  try
+  {
+    DataSet d = _group.openDataSet(sequenceNameIdxArrayName);
+    _group.unlink(sequenceNameIdxArrayName);
+  }
+  catch (H5::Exception){}
+  try
+  {
+    DataSet d = _group.openDataSet(sequenceSiteIdxArrayName);
+    _group.unlink(sequenceSiteIdxArrayName);
+  }
+  catch (H5::Exception){}
 
   if (_totalSequenceLength > 0 && storeDNAArrays == true)
   {
@@ -162,17 +195,30 @@ void HDF5Genome::setDimensions(
     dnaDC.copy(_dcprops);
     dnaDC.setChunk(1, &chunk);
     _dnaArray.create(&_group, dnaArrayName, HDF5DNA::dataType(), 
-                     arrayLength, &dnaDC, _numChunksInArrayBuffer);
+                     arrayLength, &dnaDC, _numChunksInArrayBuffer,
+                     _numPagesInArrayCache);
   }
   if (totalSeq > 0)
   {
     _sequenceIdxArray.create(&_group, sequenceIdxArrayName, 
                              HDF5Sequence::idxDataType(), 
-                             totalSeq + 1, &_dcprops, _numChunksInArrayBuffer);
+                             totalSeq + 1, &_dcprops, _numChunksInArrayBuffer,
+                             _numPagesInArrayCache);
 
     _sequenceNameArray.create(&_group, sequenceNameArrayName, 
                               HDF5Sequence::nameDataType(maxName + 1), 
-                              totalSeq, &_dcprops, _numChunksInArrayBuffer);
+                              totalSeq, &_dcprops, _numChunksInArrayBuffer,
+                              _numPagesInArrayCache);
+
+    _sequenceNameIdxArray.create(&_group, sequenceNameIdxArrayName,
+                                 PredType::NATIVE_HSIZE, totalSeq, &_dcprops,
+                                 _numChunksInArrayBuffer,
+                                 _numPagesInArrayCache);
+
+    _sequenceSiteIdxArray.create(&_group, sequenceSiteIdxArrayName,
+                                 siteIdxDataType(), totalSeq + 1, &_dcprops,
+                                 _numChunksInArrayBuffer,
+                                 _numPagesInArrayCache);
 
     writeSequences(sequenceDimensions);    
   }
@@ -188,18 +234,14 @@ void HDF5Genome::setDimensions(
 void HDF5Genome::updateTopDimensions(
   const vector<Sequence::UpdateInfo>& topDimensions)
 {
-  loadSequencePosCache();
-  loadSequenceNameCache();
   vector<Sequence::UpdateInfo>::const_iterator i;
-  map<string, HDF5Sequence*>::iterator cacheIt;
   map<string, const Sequence::UpdateInfo*> inputMap;
   map<string, hal_size_t> currentTopD;
   // copy input into map, checking everything is already present
   for (i = topDimensions.begin(); i != topDimensions.end(); ++i)
   {
     const string& name = i->_name;
-    cacheIt = _sequenceNameCache.find(name);
-    if (cacheIt == _sequenceNameCache.end())
+    if (findSequenceIndex(name) == NULL_INDEX)
     {
       throw hal_exception(string("Cannot update sequence ") +
                           name + " because it is not present in "
@@ -210,16 +252,18 @@ void HDF5Genome::updateTopDimensions(
   // keep a record of the number of segments in each existing 
   // segment (these can get muddled as we add the new ones in the next
   // loop to be sure by getting them in one shot)
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
+  // Note to self: zero-length sequences are skipped.  This is fine
   // here since we will never update them, but seems like it could be 
   // dangerous if something were to change
-  map<hal_size_t, HDF5Sequence*>::iterator posCacheIt;
+  hal_size_t numSequences = _sequenceNameArray.getSize();
   map<string, const Sequence::UpdateInfo*>::iterator inputIt;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t seqIdx = 0; seqIdx < numSequences; ++seqIdx)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    HDF5Sequence* sequence = getSequenceByIndex(seqIdx);
+    if (sequence->getSequenceLength() == 0)
+    {
+      continue;
+    }
     inputIt = inputMap.find(sequence->getName());
     if (inputIt == inputMap.end())
     {
@@ -230,18 +274,18 @@ void HDF5Genome::updateTopDimensions(
   }
   // scan through existing sequences, updating as necessary
   // build summary of all new and unchanged dimensions in newDimensions
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
-  // here since we will never update them, but seems like it could be 
-  // dangerous if something were to change
+  // (again skipping zero-length sequences)
   map<string, hal_size_t>::iterator currentIt;
   vector<Sequence::UpdateInfo> newDimensions;
   Sequence::UpdateInfo newInfo;
   hal_size_t topArrayIndex = 0;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t seqIdx = 0; seqIdx < numSequences; ++seqIdx)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    HDF5Sequence* sequence = getSequenceByIndex(seqIdx);
+    if (sequence->getSequenceLength() == 0)
+    {
+      continue;
+    }
     sequence->setTopSegmentArrayIndex(topArrayIndex);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt != inputMap.end())
@@ -253,7 +297,7 @@ void HDF5Genome::updateTopDimensions(
     {
       currentIt = currentTopD.find(sequence->getName());
       assert(currentIt != currentTopD.end());
-      newInfo._name = posCacheIt->first;
+      newInfo._name = sequence->getName();
       newInfo._numSegments = currentIt->second;
       newDimensions.push_back(newInfo);
     }
@@ -266,18 +310,14 @@ void HDF5Genome::updateTopDimensions(
 void HDF5Genome::updateBottomDimensions(
   const vector<Sequence::UpdateInfo>& bottomDimensions)
 {
-  loadSequencePosCache();
-  loadSequenceNameCache();
   vector<Sequence::UpdateInfo>::const_iterator i;
-  map<string, HDF5Sequence*>::iterator cacheIt;
   map<string, const Sequence::UpdateInfo*> inputMap;
   map<string, hal_size_t> currentBottomD;
   // copy input into map, checking everything is already present
   for (i = bottomDimensions.begin(); i != bottomDimensions.end(); ++i)
   {
     const string& name = i->_name;
-    cacheIt = _sequenceNameCache.find(name);
-    if (cacheIt == _sequenceNameCache.end())
+    if (findSequenceIndex(name) == NULL_INDEX)
     {
       throw hal_exception(string("Cannot update sequence ") +
                           name + " because it is not present in "
@@ -288,16 +328,18 @@ void HDF5Genome::updateBottomDimensions(
   // keep a record of the number of segments in each existing 
   // segment (these can get muddled as we add the new ones in the next
   // loop to be sure by getting them in one shot)
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
+  // Note to self: zero-length sequences are skipped.  This is fine
   // here since we will never update them, but seems like it could be 
   // dangerous if something were to change
-  map<hal_size_t, HDF5Sequence*>::iterator posCacheIt;
+  hal_size_t numSequences = _sequenceNameArray.getSize();
   map<string, const Sequence::UpdateInfo*>::iterator inputIt;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t seqIdx = 0; seqIdx < numSequences; ++seqIdx)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    HDF5Sequence* sequence = getSequenceByIndex(seqIdx);
+    if (sequence->getSequenceLength() == 0)
+    {
+      continue;
+    }
     inputIt = inputMap.find(sequence->getName());
     if (inputIt == inputMap.end())
     {
@@ -308,18 +350,18 @@ void HDF5Genome::updateBottomDimensions(
   }
   // scan through existing sequences, updating as necessary
   // build summary of all new and unchanged dimensions in newDimensions
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
-  // here since we will never update them, but seems like it could be 
-  // dangerous if something were to change
+  // (again skipping zero-length sequences)
   map<string, hal_size_t>::iterator currentIt;
   vector<Sequence::UpdateInfo> newDimensions;
   Sequence::UpdateInfo newInfo;
   hal_size_t bottomArrayIndex = 0;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t seqIdx = 0; seqIdx < numSequences; ++seqIdx)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    HDF5Sequence* sequence = getSequenceByIndex(seqIdx);
+    if (sequence->getSequenceLength() == 0)
+    {
+      continue;
+    }
     sequence->setBottomSegmentArrayIndex(bottomArrayIndex);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt != inputMap.end())
@@ -331,7 +373,7 @@ void HDF5Genome::updateBottomDimensions(
     {
       currentIt = currentBottomD.find(sequence->getName());
       assert(currentIt != currentBottomD.end());
-      newInfo._name = posCacheIt->first;
+      newInfo._name = sequence->getName();
       newInfo._numSegments = currentIt->second;
       newDimensions.push_back(newInfo);
     }
@@ -359,7 +401,8 @@ void HDF5Genome::setGenomeTopDimensions(
   }
   catch (H5::Exception){}
   _topArray.create(&_group, topArrayName, HDF5TopSegment::dataType(), 
-                   numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer);
+                   numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer,
+                   _numPagesInArrayCache);
   _parentCache = NULL;
 }
 
@@ -394,7 +437,8 @@ void HDF5Genome::setGenomeBottomDimensions(
 
   _bottomArray.create(&_group, bottomArrayName, 
                       HDF5BottomSegment::dataType(numChildren), 
-                      numBottomSegments + 1, &botDC, _numChunksInArrayBuffer);
+                      numBottomSegments + 1, &botDC, _numChunksInArrayBuffer,
+                      _numPagesInArrayCache);
   _numChildrenInBottomArray = numChildren;
   _childCache.clear();
 }
@@ -407,61 +451,48 @@ hal_size_t HDF5Genome::getNumSequences() const
    
 Sequence* HDF5Genome::getSequence(const string& name)
 {
-  loadSequenceNameCache();
-  Sequence* sequence = NULL;
-  map<string, HDF5Sequence*>::iterator mapIt = _sequenceNameCache.find(name);
-  if (mapIt != _sequenceNameCache.end())
-  {
-    sequence = mapIt->second;
-  }
-  return sequence;
+  const HDF5Genome* constThis = this;
+  return const_cast<Sequence*>(constThis->getSequence(name));
 }
 
 const Sequence* HDF5Genome::getSequence(const string& name) const
 {
-  loadSequenceNameCache();
-  const Sequence* sequence = NULL;
-  map<string, HDF5Sequence*>::const_iterator mapIt = 
-     _sequenceNameCache.find(name);
-  if (mapIt != _sequenceNameCache.end())
-  {
-    sequence = mapIt->second;
-  }
-  return sequence;
+  hal_index_t index = findSequenceIndex(name);
+  return index == NULL_INDEX ? NULL : getSequenceByIndex(index);
 }
 
 Sequence* HDF5Genome::getSequenceBySite(hal_size_t position)
 {
-  loadSequencePosCache();
-  map<hal_size_t, HDF5Sequence*>::iterator i;
-  i = _sequencePosCache.upper_bound(position);
-  if (i != _sequencePosCache.end())
-  {
-    if (position >= (hal_size_t)i->second->getStartPosition())
-    {
-      assert(position < i->second->getStartPosition() +
-             i->second->getSequenceLength());
-      return i->second;
-    }
-  }
-  return NULL;
+  const HDF5Genome* constThis = this;
+  return const_cast<Sequence*>(constThis->getSequenceBySite(position));
 }
 
 const Sequence* HDF5Genome::getSequenceBySite(hal_size_t position) const
 {
-  loadSequencePosCache();
-  map<hal_size_t, HDF5Sequence*>::const_iterator i;
-  i = _sequencePosCache.upper_bound(position);
-  if (i != _sequencePosCache.end())
+  // consecutive lookups (ie. from iterators) usually land in the same
+  // sequence
+  if (_siteHit != NULL && position >= _siteHitStart && 
+      position < _siteHitEnd)
   {
-    if (position >= (hal_size_t)i->second->getStartPosition())
-    {
-      assert(position < i->second->getStartPosition() +
-             i->second->getSequenceLength());
-      return i->second;
-    }
+    return _siteHit;
   }
-  return NULL;
+  loadSiteIndex();
+  if (_sequenceNameArray.getSize() == 0)
+  {
+    return NULL;
+  }
+  HDF5Sequence* sequence = getSequenceByIndex(_siteIndex.find(position));
+  hal_size_t start = sequence->getStartPosition();
+  hal_size_t end = start + sequence->getSequenceLength();
+  if (position < start || position >= end)
+  {
+    // past the end of the genome
+    return NULL;
+  }
+  _siteHit = sequence;
+  _siteHitStart = start;
+  _siteHitEnd = end;
+  return _siteHit;
 }
 
 SequenceIteratorPtr HDF5Genome::getSequenceIterator(
@@ -585,6 +616,168 @@ const Alignment* HDF5Genome::getAlignment() const
   return _alignment;
 }
 
+hal_size_t HDF5Genome::getGenomeId() const
+{
+  if (_genomeId == NULL_INDEX)
+  {
+    _genomeId = _alignment->getGenomeTree()->getId(_name);
+    if (_genomeId == NULL_INDEX)
+    {
+      throw hal_exception("Genome " + _name + " not found in tree");
+    }
+  }
+  return _genomeId;
+}
+
+// the records are moved straight between the arrays and the HDF5 page
+// cache (no segment objects or iterators involved)
+void HDF5Genome::getTopSegmentRecords(hal_index_t start, hal_size_t count,
+                                      vector<TopSegmentRecord>& records) const
+{
+  if (start < 0 || start + count > getNumTopSegments())
+  {
+    throw hal_exception("Trying to read top segments out of range in " +
+                        _name);
+  }
+  records.resize(count);
+  // end of each segment is the start of the next one
+  hal_index_t startPosition = _topArray.getValue<hal_index_t>(
+    start, HDF5TopSegment::genomeIndexOffset);
+  for (hal_size_t i = 0; i < count; ++i)
+  {
+    hsize_t index = start + i;
+    TopSegmentRecord& record = records[i];
+    hal_index_t endPosition = _topArray.getValue<hal_index_t>(
+      index + 1, HDF5TopSegment::genomeIndexOffset);
+    record._startPosition = startPosition;
+    record._length = endPosition - startPosition;
+    record._bottomParseIndex = _topArray.getValue<hal_index_t>(
+      index, HDF5TopSegment::bottomIndexOffset);
+    record._nextParalogyIndex = _topArray.getValue<hal_index_t>(
+      index, HDF5TopSegment::parIndexOffset);
+    record._parentIndex = _topArray.getValue<hal_index_t>(
+      index, HDF5TopSegment::parentIndexOffset);
+    record._parentReversed = _topArray.getValue<bool>(
+      index, HDF5TopSegment::parentReversedOffset);
+    startPosition = endPosition;
+  }
+}
+
+void HDF5Genome::setTopSegmentRecords(hal_index_t start,
+                                      const vector<TopSegmentRecord>& records)
+{
+  if (start < 0 || start + records.size() > getNumTopSegments())
+  {
+    throw hal_exception("Trying to write top segments out of range in " +
+                        _name);
+  }
+  for (size_t i = 0; i < records.size(); ++i)
+  {
+    hsize_t index = start + i;
+    const TopSegmentRecord& record = records[i];
+    if (record._startPosition >= (hal_index_t)_totalSequenceLength ||
+        record._startPosition + record._length > _totalSequenceLength)
+    {
+      throw hal_exception("Trying to set top segment coordinate out of "
+                          "range");
+    }
+    _topArray.setValue(index, HDF5TopSegment::genomeIndexOffset,
+                       record._startPosition);
+    _topArray.setValue(index + 1, HDF5TopSegment::genomeIndexOffset,
+                       (hal_index_t)(record._startPosition + record._length));
+    _topArray.setValue(index, HDF5TopSegment::bottomIndexOffset,
+                       record._bottomParseIndex);
+    _topArray.setValue(index, HDF5TopSegment::parIndexOffset,
+                       record._nextParalogyIndex);
+    _topArray.setValue(index, HDF5TopSegment::parentIndexOffset,
+                       record._parentIndex);
+    _topArray.setValue(index, HDF5TopSegment::parentReversedOffset,
+                       record._parentReversed);
+  }
+}
+
+void HDF5Genome::getBottomSegmentRecords(hal_index_t start, hal_size_t count,
+                                         vector<BottomSegmentRecord>& records,
+                                         vector<ChildRecord>& children) const
+{
+  if (start < 0 || start + count > getNumBottomSegments())
+  {
+    throw hal_exception("Trying to read bottom segments out of range in " +
+                        _name);
+  }
+  hal_size_t numChildren = _numChildrenInBottomArray;
+  const size_t childSize = sizeof(hal_index_t) + sizeof(bool);
+  records.resize(count);
+  children.resize(count * numChildren);
+  hal_index_t startPosition = _bottomArray.getValue<hal_index_t>(
+    start, HDF5BottomSegment::genomeIndexOffset);
+  for (hal_size_t i = 0; i < count; ++i)
+  {
+    hsize_t index = start + i;
+    BottomSegmentRecord& record = records[i];
+    hal_index_t endPosition = _bottomArray.getValue<hal_index_t>(
+      index + 1, HDF5BottomSegment::genomeIndexOffset);
+    record._startPosition = startPosition;
+    record._length = endPosition - startPosition;
+    record._topParseIndex = _bottomArray.getValue<hal_index_t>(
+      index, HDF5BottomSegment::topIndexOffset);
+    for (hal_size_t child = 0; child < numChildren; ++child)
+    {
+      size_t offset = HDF5BottomSegment::firstChildOffset + child * childSize;
+      ChildRecord& childRecord = children[i * numChildren + child];
+      childRecord._childIndex = _bottomArray.getValue<hal_index_t>(index,
+                                                                   offset);
+      childRecord._childReversed = _bottomArray.getValue<bool>(
+        index, offset + sizeof(hal_index_t));
+    }
+    startPosition = endPosition;
+  }
+}
+
+void HDF5Genome::setBottomSegmentRecords(
+  hal_index_t start, const vector<BottomSegmentRecord>& records,
+  const vector<ChildRecord>& children)
+{
+  hal_size_t numChildren = _numChildrenInBottomArray;
+  if (start < 0 || start + records.size() > getNumBottomSegments())
+  {
+    throw hal_exception("Trying to write bottom segments out of range in " +
+                        _name);
+  }
+  if (children.size() != records.size() * numChildren)
+  {
+    throw hal_exception("Wrong number of child links given for bottom "
+                        "segments of " + _name);
+  }
+  const size_t childSize = sizeof(hal_index_t) + sizeof(bool);
+  for (size_t i = 0; i < records.size(); ++i)
+  {
+    hsize_t index = start + i;
+    const BottomSegmentRecord& record = records[i];
+    if (record._startPosition >= (hal_index_t)_totalSequenceLength ||
+        record._startPosition + record._length > _totalSequenceLength)
+    {
+      throw hal_exception("Trying to set bottom segment coordinate out of "
+                          "range");
+    }
+    _bottomArray.setValue(index, HDF5BottomSegment::genomeIndexOffset,
+                          record._startPosition);
+    _bottomArray.setValue(index + 1, HDF5BottomSegment::genomeIndexOffset,
+                          (hal_index_t)(record._startPosition +
+                                        record._length));
+    _bottomArray.setValue(index, HDF5BottomSegment::topIndexOffset,
+                          record._topParseIndex);
+    for (hal_size_t child = 0; child < numChildren; ++child)
+    {
+      size_t offset = HDF5BottomSegment::firstChildOffset + child * childSize;
+      const ChildRecord& childRecord = children[i * numChildren + child];
+      _bottomArray.setValue(index, offset, childRecord._childIndex);
+      _bottomArray.setValue(index, offset + sizeof(hal_index_t),
+                            childRecord._childReversed);
+    }
+  }
+}
+
 // SEGMENTED SEQUENCE INTERFACE
 
 const string& HDF5Genome::getName() const
@@ -791,6 +984,8 @@ void HDF5Genome::write()
   _rup->write();
   _sequenceIdxArray.write();
   _sequenceNameArray.write();
+  _sequenceNameIdxArray.write();
+  _sequenceSiteIdxArray.write();
 }
 
 void HDF5Genome::read()
@@ -799,20 +994,23 @@ void HDF5Genome::read()
   try
   {
     _group.openDataSet(dnaArrayName);
-    _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer);    
+    _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer,
+                   _numPagesInArrayCache);
   }
   catch (H5::Exception){}
 
   try
   {
     _group.openDataSet(topArrayName);
-    _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer);
+    _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer,
+                   _numPagesInArrayCache);
   }
   catch (H5::Exception){}
   try
   {
     _group.openDataSet(bottomArrayName);
-    _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer);
+    _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer,
+                      _numPagesInArrayCache);
     _numChildrenInBottomArray = 
        HDF5BottomSegment::numChildrenFromDataType(_bottomArray.getDataType());
   }
@@ -823,14 +1021,34 @@ void HDF5Genome::read()
   {
     _group.openDataSet(sequenceIdxArrayName);
     _sequenceIdxArray.load(&_group, sequenceIdxArrayName, 
-                           _numChunksInArrayBuffer);
+                           _numChunksInArrayBuffer, _numPagesInArrayCache);
   }
   catch (H5::Exception){}
   try
   {
     _group.openDataSet(sequenceNameArrayName);
     _sequenceNameArray.load(&_group, sequenceNameArrayName, 
-                            _numChunksInArrayBuffer);
+                            _numChunksInArrayBuffer, _numPagesInArrayCache);
+  }
+  catch (H5::Exception){}
+  // files written before the name index existed fall back on sorting
+  // the names in memory (see loadSequenceNameOrder())
+  try
+  {
+    _group.openDataSet(sequenceNameIdxArrayName);
+    _sequenceNameIdxArray.load(&_group, sequenceNameIdxArrayName, 
+                               _numChunksInArrayBuffer, 
+                               _numPagesInArrayCache);
+  }
+  catch (H5::Exception){}
+  // likewise, the site index is rebuilt from the sequence start
+  // positions when it isn't in the file (see loadSiteIndex())
+  try
+  {
+    _group.openDataSet(sequenceSiteIdxArrayName);
+    _sequenceSiteIdxArray.load(&_group, sequenceSiteIdxArrayName, 
+                               _numChunksInArrayBuffer, 
+                               _numPagesInArrayCache);
   }
   catch (H5::Exception){}
 
@@ -844,82 +1062,80 @@ void HDF5Genome::readSequences()
 
 void HDF5Genome::deleteSequenceCache()
 {
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
+  for (size_t i = 0; i < _sequenceCache.size(); ++i)
   {
-    map<hal_size_t, HDF5Sequence*>::iterator i;
-    for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i)
-    {
-      delete i->second;
-    }
-    vector<HDF5Sequence*>::iterator z;
-    for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z)
-    {
-      delete *z;
-    }
+    delete _sequenceCache[i];
   }
-  else if (_sequenceNameCache.size() > 0)
+  _sequenceCache.clear();
+  _sequenceNameOrder.clear();
+  _siteIndex.clear();
+  _siteHit = NULL;
+}
+
+HDF5Sequence* HDF5Genome::getSequenceByIndex(hal_size_t index) const
+{
+  hal_size_t numSequences = _sequenceNameArray.getSize();
+  assert(index < numSequences);
+  if (_sequenceCache.size() != numSequences)
   {
-    map<string, HDF5Sequence*>::iterator i;
-    for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i)
-    {
-      delete i->second;
-    }
+    assert(_sequenceCache.empty());
+    _sequenceCache.assign(numSequences, NULL);
   }
-  _sequencePosCache.clear();
-  _zeroLenPosCache.clear();
-  _sequenceNameCache.clear(); // I share my pointers with above. 
+  if (_sequenceCache[index] == NULL)
+  {
+    _sequenceCache[index] = 
+       new HDF5Sequence(const_cast<HDF5Genome*>(this),
+                        const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
+                        const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
+                        index);
+  }
+  return _sequenceCache[index];
 }
 
-void HDF5Genome::loadSequencePosCache() const
+// the index is read from the site index array if the file has one.
+// otherwise the start positions are read straight out of the sequence
+// index array (where they are stored in order), without creating any
+// sequences
+void HDF5Genome::loadSiteIndex() const
 {
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
+  if (_siteIndex.isLoaded() == true)
   {
     return;
   }
-  hal_size_t totalReadLen = 0;
   hal_size_t numSequences = _sequenceNameArray.getSize();
-  
-  if (_sequenceNameCache.size() > 0)
+  if (numSequences > 0 && 
+      _sequenceSiteIdxArray.getSize() == numSequences + 1)
   {
-    assert(_sequenceNameCache.size() == numSequences);
-    map<std::string, HDF5Sequence*>::iterator i;
-    for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i)
+    vector<SequenceSiteRecord> records(numSequences + 1);
+    for (hal_size_t i = 1; i <= numSequences; ++i)
     {
-      if (i->second->getSequenceLength() > 0)
-      {
-        _sequencePosCache.insert(pair<hal_size_t, HDF5Sequence*>(
-                                   i->second->getStartPosition() +
-                                   i->second->getSequenceLength(), i->second));
-        totalReadLen += i->second->getSequenceLength();
-      }
-      else
-      {
-        _zeroLenPosCache.push_back(i->second);
-      }
+      records[i]._start = _sequenceSiteIdxArray.getValue<hal_size_t>(
+        i, offsetof(SequenceSiteRecord, _start));
+      records[i]._index = _sequenceSiteIdxArray.getValue<hal_size_t>(
+        i, offsetof(SequenceSiteRecord, _index));
     }
+    _siteIndex.load(records);
+    return;
   }
-  else
+  vector<hal_size_t> starts(numSequences);
+  hal_size_t prevStart = 0;
+  for (hal_size_t i = 0; i < numSequences; ++i)
   {
-    for (hal_size_t i = 0; i < numSequences; ++i)
+    starts[i] = _sequenceIdxArray.getValue<hal_size_t>(
+      i, HDF5Sequence::startOffset);
+    if (starts[i] < prevStart)
     {
-      HDF5Sequence* seq = 
-         new HDF5Sequence(const_cast<HDF5Genome*>(this),
-                          const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
-                          const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
-                          i);
-      if (seq->getSequenceLength() > 0)
-      {
-        _sequencePosCache.insert(
-          pair<hal_size_t, HDF5Sequence*>(seq->getStartPosition() +
-                                          seq->getSequenceLength(), seq));
-        totalReadLen += seq->getSequenceLength();
-      }
-      else
-      {
-        _zeroLenPosCache.push_back(seq);
-      }
+      stringstream ss;
+      ss << "Sequence " << i << " of genome " << getName() << " starts at "
+         << starts[i] << " which is before the previous sequence. "
+         << "This is an internal error or the file is corrupt.";
+      throw hal_exception(ss.str());
     }
+    prevStart = starts[i];
   }
+  hal_size_t totalReadLen = numSequences > 0 ? 
+     _sequenceIdxArray.getValue<hal_size_t>(numSequences, 
+                                            HDF5Sequence::startOffset) : 0;
   if (_totalSequenceLength > 0 && totalReadLen != _totalSequenceLength)
   {
     stringstream ss;
@@ -929,46 +1145,63 @@ void HDF5Genome::loadSequencePosCache() const
        << "or the file is corrupt.";
     throw hal_exception(ss.str());
   }
+  _siteIndex.build(starts);
 }
 
-void HDF5Genome::loadSequenceNameCache() const
+namespace {
+// reads the name order from the file, or from memory if order is given
+struct HDF5NameReader
 {
-  if (_sequenceNameCache.size() > 0)
+   HDF5NameReader(HDF5ExternalArray* nameArray, 
+                  const HDF5ExternalArray* nameIdxArray,
+                  const vector<hal_size_t>* order) :
+     _nameArray(nameArray), _nameIdxArray(nameIdxArray), _order(order) {}
+   hal_size_t getIndex(hal_size_t rank) const
+   {
+     return _order != NULL ? (*_order)[rank] :
+        _nameIdxArray->getValue<hal_size_t>(rank, 0);
+   }
+   const char* getName(hal_size_t index) const
+   {
+     return _nameArray->get(index);
+   }
+   HDF5ExternalArray* _nameArray;
+   const HDF5ExternalArray* _nameIdxArray;
+   const vector<hal_size_t>* _order;
+};
+}
+
+// only the names visited by the binary search are read, and only the
+// sequence that is found gets created
+hal_index_t HDF5Genome::findSequenceIndex(const string& name) const
+{
+  hal_size_t numSequences = _sequenceNameArray.getSize();
+  const vector<hal_size_t>* order = NULL;
+  if (_sequenceNameIdxArray.getSize() != numSequences)
   {
-    return;
+    loadSequenceNameOrder();
+    order = &_sequenceNameOrder;
   }
+  HDF5NameReader reader(const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
+                        &_sequenceNameIdxArray, order);
+  return SequenceNameIndex::find(reader, numSequences, name);
+}
+
+void HDF5Genome::loadSequenceNameOrder() const
+{
   hal_size_t numSequences = _sequenceNameArray.getSize();
-  
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
+  if (_sequenceNameOrder.size() == numSequences)
   {
-    assert(_sequencePosCache.size() + _zeroLenPosCache.size() == numSequences);
-    map<hal_size_t, HDF5Sequence*>::iterator i;
-    for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i)
-    {
-      _sequenceNameCache.insert(pair<string, HDF5Sequence*>(
-                                  i->second->getName(), i->second));
-    }
-    vector<HDF5Sequence*>::iterator z;
-    for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z)
-    {
-      _sequenceNameCache.insert(pair<string, HDF5Sequence*>(
-                                  (*z)->getName(), (*z)));
-    }
+    return;
   }
-  else
+  vector<string> names(numSequences);
+  HDF5ExternalArray* nameArray = 
+     const_cast<HDF5ExternalArray*>(&_sequenceNameArray);
+  for (hal_size_t i = 0; i < numSequences; ++i)
   {
-    for (hal_size_t i = 0; i < numSequences; ++i)
-    {
-      HDF5Sequence* seq = 
-         new HDF5Sequence(const_cast<HDF5Genome*>(this),
-                          const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
-                          const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
-                          i);
-
-      _sequenceNameCache.insert(
-        pair<string, HDF5Sequence*>(seq->getName(), seq));
-    }
+    names[i] = nameArray->get(i);
   }
+  SequenceNameIndex::layout(names, _sequenceNameOrder);
 }
   
 void HDF5Genome::writeSequences(const vector<Sequence::Info>&
@@ -976,6 +1209,10 @@ void HDF5Genome::writeSequences(const vector<Sequence::Info>&
 {
   deleteSequenceCache();
   vector<Sequence::Info>::const_iterator i;
+  vector<string> names;
+  names.reserve(sequenceDimensions.size());
+  vector<hal_size_t> starts;
+  starts.reserve(sequenceDimensions.size());
   hal_size_t startPosition = 0;
   hal_size_t topArrayIndex = 0;
   hal_size_t bottomArrayIndex = 0;
@@ -987,21 +1224,31 @@ void HDF5Genome::writeSequences(const vector<Sequence::Info>&
                                          i - sequenceDimensions.begin());
     // write all the Sequence::Info into the hdf5 sequence record
     seq->set(startPosition, *i, topArrayIndex, bottomArrayIndex);
-    // Keep the object pointer in our caches
-    if (seq->getSequenceLength() > 0)
-    {
-      _sequencePosCache.insert(
-        pair<hal_size_t, HDF5Sequence*>(startPosition + i->_length, seq));
-    }
-    else
-    {
-      _zeroLenPosCache.push_back(seq);
-    }
-    _sequenceNameCache.insert(pair<string, HDF5Sequence*>(i->_name, seq));
+    // Keep the object pointer in our cache
+    _sequenceCache.push_back(seq);
+    names.push_back(i->_name);
+    starts.push_back(startPosition);
     startPosition += i->_length;
     topArrayIndex += i->_numTopSegments;
     bottomArrayIndex += i->_numBottomSegments;
-  }  
+  }
+
+  vector<hal_size_t> order;
+  SequenceNameIndex::layout(names, order);
+  for (hal_size_t rank = 0; rank < order.size(); ++rank)
+  {
+    _sequenceNameIdxArray.setValue(rank, 0, order[rank]);
+  }
+
+  vector<SequenceSiteRecord> records;
+  SequenceSiteIndex::layout(starts, records);
+  for (hal_size_t k = 0; k < records.size(); ++k)
+  {
+    _sequenceSiteIdxArray.setValue(k, offsetof(SequenceSiteRecord, _start),
+                                   (hal_size_t)records[k]._start);
+    _sequenceSiteIdxArray.setValue(k, offsetof(SequenceSiteRecord, _index),
+                                   (hal_size_t)records[k]._index);
+  }
 }
 
 void HDF5Genome::resetBranchCaches()
@@ -1009,3 +1256,8 @@ void HDF5Genome::resetBranchCaches()
   _parentCache = NULL;
   _childCache.clear();
 }
+
+void HDF5Genome::resetTreeCache()
+{
+  _genomeId = NULL_INDEX;
+}
@@ -14,6 +14,8 @@
 #include "halTopSegmentIterator.h"
 #include "halBottomSegmentIterator.h"
 #include "hdf5MetaData.h"
+#include "sequenceSiteIndex.h"
+#include "sequenceNameIndex.h"
 
 
 namespace hal {
@@ -41,7 +43,8 @@ public:
               HDF5Alignment* alignment,
               H5::CommonFG* h5Parent,
               const H5::DSetCreatPropList& dcProps,
-              bool inMemory);
+              bool inMemory,
+              hsize_t numPagesInArrayCache = 1);
 
    virtual ~HDF5Genome();
 
@@ -96,6 +99,22 @@ public:
 
    const Alignment* getAlignment() const;
 
+   hal_size_t getGenomeId() const;
+
+   void getTopSegmentRecords(hal_index_t start, hal_size_t count,
+                             std::vector<TopSegmentRecord>& records) const;
+
+   void setTopSegmentRecords(hal_index_t start,
+                             const std::vector<TopSegmentRecord>& records);
+
+   void getBottomSegmentRecords(hal_index_t start, hal_size_t count,
+                                std::vector<BottomSegmentRecord>& records,
+                                std::vector<ChildRecord>& children) const;
+
+   void setBottomSegmentRecords(
+     hal_index_t start, const std::vector<BottomSegmentRecord>& records,
+     const std::vector<ChildRecord>& children);
+
    // SEGMENTED SEQUENCE INTERFACE
 
    hal_size_t getSequenceLength() const;
@@ -173,8 +192,11 @@ protected:
    void writeSequences(const std::vector<hal::Sequence::Info>&
                        sequenceDimensions);
    void deleteSequenceCache();
-   void loadSequencePosCache() const;
-   void loadSequenceNameCache() const;
+   HDF5Sequence* getSequenceByIndex(hal_size_t index) const;
+   void loadSiteIndex() const;
+   hal_index_t findSequenceIndex(const std::string& name) const;
+   void loadSequenceNameOrder() const;
+   static H5::CompType siteIdxDataType();
    void setGenomeTopDimensions(
      const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
 
@@ -195,23 +217,37 @@ protected:
    HDF5ExternalArray _bottomArray;
    HDF5ExternalArray _sequenceIdxArray;
    HDF5ExternalArray _sequenceNameArray;
+   // sequence indexes sorted by name (see SequenceNameIndex)
+   HDF5ExternalArray _sequenceNameIdxArray;
+   // SequenceSiteIndex records in Eytzinger order (see loadSiteIndex())
+   HDF5ExternalArray _sequenceSiteIdxArray;
    H5::Group _group;
    H5::DSetCreatPropList _dcprops;
    hal_size_t _numChildrenInBottomArray;
    hal_size_t _totalSequenceLength;
    hal_size_t _numChunksInArrayBuffer;
+   hal_size_t _numPagesInArrayCache;
 
    mutable Genome* _parentCache;
+   mutable hal_index_t _genomeId;
    mutable std::vector<Genome*> _childCache;
-   mutable std::map<hal_size_t, HDF5Sequence*> _sequencePosCache;
-   mutable std::vector<HDF5Sequence*> _zeroLenPosCache;
-   mutable std::map<std::string, HDF5Sequence*> _sequenceNameCache;
+   // sequences by index, created as needed
+   mutable std::vector<HDF5Sequence*> _sequenceCache;
+   mutable SequenceSiteIndex _siteIndex;
+   // last sequence returned by getSequenceBySite and its range
+   mutable HDF5Sequence* _siteHit;
+   mutable hal_size_t _siteHitStart;
+   mutable hal_size_t _siteHitEnd;
+   // in-memory name order for files written without _sequenceNameIdxArray
+   mutable std::vector<hal_size_t> _sequenceNameOrder;
 
    static const std::string dnaArrayName;
    static const std::string topArrayName;
    static const std::string bottomArrayName;
    static const std::string sequenceIdxArrayName;
    static const std::string sequenceNameArrayName;
+   static const std::string sequenceNameIdxArrayName;
+   static const std::string sequenceSiteIdxArrayName;
    static const std::string metaGroupName;
    static const std::string rupGroupName;
 
@@ -19,6 +19,7 @@ class HDF5SequenceIterator;
 class HDF5Sequence : public Sequence
 {
    friend class HDF5SequenceIterator;
+   friend class HDF5Genome;
 
 public:
 
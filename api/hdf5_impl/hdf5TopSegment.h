@@ -21,6 +21,7 @@ class HDF5TopSegment : public TopSegment
 {
    friend class HDF5TopSegmentIterator;
    friend class HDF5BottomSegmentIterator;
+   friend class HDF5Genome;
 
 public:
 
@@ -58,7 +59,7 @@ public:
    hal_size_t getMappedSegments(
      std::set<MappedSegmentConstPtr>& outSegments,
      const Genome* tgtGenome,
-     const std::set<const Genome*>* genomesOnPath,
+     const GenomeSet* genomesOnPath,
      bool doDupes,
      hal_size_t minLength,
      const Genome *coalescenceLimit,
@@ -256,7 +257,7 @@ inline bool HDF5TopSegment::isTop() const
 inline hal_size_t HDF5TopSegment::getMappedSegments(
   std::set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const std::set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
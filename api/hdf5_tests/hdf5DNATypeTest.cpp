@@ -101,6 +101,57 @@ void hdf5DNAPackingTest(CuTest *testCase)
   }
 }
 
+// runs packed and unpacked in bulk must match the one-character
+// functions, in both directions
+void hdf5DNABulkPackingTest(CuTest *testCase)
+{
+  static const size_t len = 5000;
+  string array(len, 'N');
+  srand(time(NULL));
+  for (size_t i = 0; i < len; ++i)
+  {
+    array[i] = idxToDNA(rand());
+  }
+
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    hal_index_t first = rand() % 100;
+    hal_size_t length = rand() % (len - first);
+    bool reversed = rand() % 2 == 1;
+    unsigned char packedArray[len/2 + 1];
+    HDF5DNA::pack(array.c_str(), first, length, reversed, 
+                  packedArray + first / 2);
+    string expected = array.substr(0, length);
+    if (reversed)
+    {
+      reverseComplement(expected);
+    }
+    for (hal_size_t j = 0; j < length; ++j)
+    {
+      unsigned char c = HDF5DNA::unpack(first + j, 
+                                        packedArray[(first + j) / 2]);
+      CuAssertTrue(testCase, c == expected[j]);
+    }
+    
+    string unpacked(length, '?');
+    HDF5DNA::unpack(packedArray + first / 2, first, length, reversed,
+                    &unpacked[0]);
+    CuAssertTrue(testCase, unpacked == array.substr(0, length));
+  }
+
+  bool threw = false;
+  try
+  {
+    unsigned char c = 0;
+    HDF5DNA::pack("AC-T", 0, 4, false, &c);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(testCase, threw);
+}
+
 void hdf5DNATypeTest(CuTest *testCase)
 {
   for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx)
@@ -162,6 +213,7 @@ CuSuite* hdf5DNATypeTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, hdf5DNAPackingTest);
+  SUITE_ADD_TEST(suite, hdf5DNABulkPackingTest);
   SUITE_ADD_TEST(suite, hdf5DNATypeTest);
   return suite;
 }
@@ -159,11 +159,83 @@ void hdf5ExternalArrayTestCompression(CuTest *testCase)
   }
 }
 
+void hdf5ExternalArrayTestPageCache(CuTest *testCase)
+{
+  for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx)
+  {
+    hsize_t chunkSize = chunkSizes[chunkIdx];
+    setup();
+    try 
+    {
+      // write the array by alternating between its two halves so 
+      // that dirty pages get recycled as well as read back
+      IntType datatype(PredType::NATIVE_HSIZE);
+      H5File file(H5std_string(fileName), H5F_ACC_TRUNC);
+      HDF5ExternalArray myArray;
+      DSetCreatPropList cparms;
+      if (chunkSize > 0)
+      {
+        cparms.setDeflate(2);
+        cparms.setChunk(1, &chunkSize);
+      }
+      myArray.create(&file, datasetName, datatype, N, &cparms, 1, 3);
+      for (hsize_t i = 0; i < N / 2; ++i)
+      {
+        hsize_t j = N - 1 - i;
+        *reinterpret_cast<hsize_t*>(myArray.getUpdate(i)) = i;
+        *reinterpret_cast<hsize_t*>(myArray.getUpdate(j)) = j;
+      }
+      myArray.write();
+      file.flush(H5F_SCOPE_LOCAL);
+      file.close();
+      checkNumbers(testCase);
+
+      // ping-pong between three distant regions.  when they fall in 
+      // different chunks, every access after the first pass over the 
+      // three regions should be a cache hit
+      H5File rfile(H5std_string(fileName), H5F_ACC_RDONLY);
+      HDF5ExternalArray myrArray;
+      myrArray.load(&rfile, datasetName, 1, 3);
+      hsize_t numPages = myrArray.getNumPages();
+      CuAssertTrue(testCase, numPages == 1 || numPages == 3);
+      hsize_t positions[] = {0, N / 2, N - 1};
+      for (hsize_t i = 0; i < 1000; ++i)
+      {
+        hsize_t pos = positions[i % 3];
+        const int64_t* val = 
+           reinterpret_cast<const int64_t*>(myrArray.get(pos));
+        CuAssertTrue(testCase, *val == numbers[pos]);
+      }
+      if (numPages == 3 && chunkSize <= N / 5)
+      {
+        CuAssertTrue(testCase, myrArray.getNumPageMisses() == 3);
+        CuAssertTrue(testCase, myrArray.getNumPageHits() == 1000 - 3);
+      }
+      for (hsize_t i = 0; i < N; ++i)
+      {
+        const int64_t* val = reinterpret_cast<const int64_t*>(myrArray.get(i));
+        CuAssertTrue(testCase, *val == numbers[i]);
+      }
+    }
+    catch(Exception& exception)
+    {
+      cerr << exception.getCDetailMsg() << endl;
+      CuAssertTrue(testCase, 0);
+    }
+    catch(...)
+    {
+      CuAssertTrue(testCase, 0);
+    }
+    teardown();
+  }
+}
+
 CuSuite* hdf5ExternalArrayTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCreate);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestLoad);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCompression);
+  SUITE_ADD_TEST(suite, hdf5ExternalArrayTestPageCache);
   return suite;
 }
@@ -30,6 +30,8 @@ DefaultColumnIterator::DefaultColumnIterator(const Genome* reference,
   _noDupes(noDupes),
   _noAncestors(noAncestors),
   _reversed(reverseStrand),
+  _colMapEnabled(false),
+  _flatColumnSorted(true),
   _tree(NULL),
   _unique(unique),
   _onlyOrthologs(onlyOrthologs)
@@ -69,9 +71,16 @@ DefaultColumnIterator::DefaultColumnIterator(const Genome* reference,
   // if targets is empty we just visit everything. 
   if (targets != NULL && !targets->empty())
   {
-    _targets = *targets;
-    _targets.insert(reference);
-    getGenomesInSpanningTree(_targets, _scope);
+    const GenomeTree* tree = reference->getAlignment()->getGenomeTree();
+    _targets.resize(tree->getNumGenomes());
+    for (set<const Genome*>::const_iterator i = targets->begin();
+         i != targets->end(); ++i)
+    {
+      _targets.insert((*i)->getGenomeId());
+    }
+    _targets.insert(reference->getGenomeId());
+    _scope.resize(tree->getNumGenomes());
+    tree->getSpanningTree(_targets, _scope);
   }
   
   // note columnIndex in genome (not sequence) coordinates
@@ -161,16 +170,12 @@ void DefaultColumnIterator::toRight() const
 
 #ifndef NDEBUG
   set<pair<const Sequence*, hal_index_t> > coordSet;
-  ColumnMap::const_iterator i, iNext;
-  DNASet::const_iterator j;
-  for (i = _colMap.begin(); i != _colMap.end(); ++i)
+  for (FlatColumn::const_iterator i = _flatColumn.begin(); 
+       i != _flatColumn.end(); ++i)
   {
     // check that the same coordinate not present for the same sequence
-    for (j = i->second->begin(); j != i->second->end(); ++j)
-    {
-      pair<const Sequence*, hal_index_t> data(i->first, (*j)->getArrayIndex());
-      assert(coordSet.insert(data).second == true);
-    }
+    pair<const Sequence*, hal_index_t> data(i->_sequence, i->_position);
+    assert(coordSet.insert(data).second == true);
   }
 #endif
 }
@@ -226,9 +231,42 @@ hal_index_t DefaultColumnIterator::getReferenceSequencePosition() const
 const DefaultColumnIterator::ColumnMap* DefaultColumnIterator::getColumnMap() 
 const
 {
+  if (_colMapEnabled == false)
+  {
+    // first time the map is asked for: fill it in for the current column
+    // then keep it up to date in colMapInsert() from here on.
+    _colMapEnabled = true;
+    for (FlatColumn::const_iterator i = _flatColumn.begin(); 
+         i != _flatColumn.end(); ++i)
+    {
+      colMapInsertDNA(i->_dna);
+    }
+  }
   return &_colMap;
 }
 
+/** Stable sort so entries of the same sequence keep their order, like
+ * in the DNASets of the column map */
+struct ColumnEntryLess
+{
+   bool operator()(const ColumnIterator::ColumnEntry& e1,
+                   const ColumnIterator::ColumnEntry& e2) const
+   {
+     return ColumnIterator::SequenceLess()(e1._sequence, e2._sequence);
+   }
+};
+
+const DefaultColumnIterator::FlatColumn* 
+DefaultColumnIterator::getFlatColumn() const
+{
+  if (_flatColumnSorted == false)
+  {
+    stable_sort(_flatColumn.begin(), _flatColumn.end(), ColumnEntryLess());
+    _flatColumnSorted = true;
+  }
+  return &_flatColumn;
+}
+
 hal_index_t DefaultColumnIterator::getArrayIndex() const
 {
   assert(_stack.size() > 0);
@@ -615,19 +653,13 @@ stTree *DefaultColumnIterator::getTree() const
     return _tree;
   } else {
     // Get any base from the column to begin building the tree
-    const ColumnIterator::ColumnMap *colMap = getColumnMap();
-    ColumnIterator::ColumnMap::const_iterator colMapIt = colMap->begin();
+    const ColumnIterator::FlatColumn *flatColumn = getFlatColumn();
     const Sequence *sequence = NULL;
     hal_index_t index = NULL_INDEX;
-    while (colMapIt != colMap->end()) {
-      if (!colMapIt->second->empty()) {
-        // Found a non-empty column map entry, just take the index and
-        // sequence of the first base found
-        sequence = colMapIt->first;
-        index = colMapIt->second->at(0)->getArrayIndex();
-        break;
-      }
-      colMapIt++;
+    if (!flatColumn->empty()) {
+      // just take the index and sequence of the first base found
+      sequence = flatColumn->at(0)._sequence;
+      index = flatColumn->at(0)._position;
     }
     assert(sequence != NULL && index != NULL_INDEX);
     const Genome *genome = sequence->getGenome();
@@ -665,7 +697,7 @@ stTree *DefaultColumnIterator::getTree() const
       buildTreeR(botIt, tree);
     }
 
-    if (_onlyOrthologs || _noDupes || !_targets.empty()) {
+    if (_onlyOrthologs || _noDupes || _targets.getNumGenomes() > 0) {
       // The gene tree, at this point, always represents the full
       // induced tree found in the HAL graph. If we are showing part
       // of the full column, we should make sure to give only the
@@ -1025,18 +1057,19 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
   // insert into the column data structure to pass out to client
   if (found == false && 
       (!_noAncestors || genome->getNumChildren() == 0) &&
-      (_targets.empty() || _targets.find(genome) != _targets.end()))
+      (_targets.getNumGenomes() == 0 || 
+       _targets.contains(genome->getGenomeId())))
   {
-    ColumnMap::iterator i = _colMap.lower_bound(sequence);
-    if(i != _colMap.end() && !(_colMap.key_comp()(sequence, i->first)))
-    {
-      i->second->push_back(dnaIt);
-    }
-    else
+    ColumnEntry entry;
+    entry._sequence = sequence;
+    entry._dna = dnaIt;
+    entry._position = dnaIt->getArrayIndex();
+    entry._reversed = dnaIt->getReversed();
+    _flatColumn.push_back(entry);
+    _flatColumnSorted = false;
+    if (_colMapEnabled == true)
     {
-      DNASet* dnaSet = new DNASet();
-      dnaSet->push_back(dnaIt);
-      _colMap.insert(i, ColumnMap::value_type(sequence, dnaSet));
+      colMapInsertDNA(dnaIt);
     }
   }
 
@@ -1048,8 +1081,26 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
   return !found;
 }
 
+void DefaultColumnIterator::colMapInsertDNA(DNAIteratorConstPtr dnaIt) const
+{
+  const Sequence* sequence = dnaIt->getSequence();
+  ColumnMap::iterator i = _colMap.lower_bound(sequence);
+  if(i != _colMap.end() && !(_colMap.key_comp()(sequence, i->first)))
+  {
+    i->second->push_back(dnaIt);
+  }
+  else
+  {
+    DNASet* dnaSet = new DNASet();
+    dnaSet->push_back(dnaIt);
+    _colMap.insert(i, ColumnMap::value_type(sequence, dnaSet));
+  }
+}
+
 void DefaultColumnIterator::resetColMap() const
 {
+  _flatColumn.clear();
+  _flatColumnSorted = true;
   for (ColumnMap::iterator i = _colMap.begin(); i != _colMap.end(); ++i)
   {
     i->second->clear();
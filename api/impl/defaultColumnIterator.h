@@ -14,6 +14,7 @@
 #include "halColumnIterator.h"
 #include "halRearrangement.h"
 #include "halCommon.h"
+#include "halGenomeTree.h"
 #include "columnIteratorStack.h"
 
 namespace hal {
@@ -43,6 +44,7 @@ public:
    virtual const hal::Sequence* getReferenceSequence() const;
    virtual hal_index_t getReferenceSequencePosition() const;
    virtual const ColumnMap* getColumnMap() const;
+   virtual const FlatColumn* getFlatColumn() const;
    virtual hal_index_t getArrayIndex() const;
    virtual void defragment() const;
    virtual bool isCanonicalOnRef() const;
@@ -76,6 +78,7 @@ protected:
 
    void resetColMap() const;
    void eraseColMap() const;
+   void colMapInsertDNA(DNAIteratorConstPtr dnaIt) const;
 
    void clearTree() const;
 
@@ -85,8 +88,10 @@ protected:
    // other iterators (which provide both const and non-const access)
    // the fact that this iterator has no writable interface makes it
    // seem like a dumb excercise though. 
-   mutable std::set<const Genome*> _targets;
-   mutable std::set<const Genome*> _scope;
+   // ids (in the alignment's GenomeTree) of the targets and of the
+   // genomes on the paths between them, empty to visit everything
+   mutable GenomeSet _targets;
+   mutable GenomeSet _scope;
    mutable ColumnIteratorStack _stack;
    mutable ColumnIteratorStack _indelStack;
    mutable const Sequence* _ref;
@@ -99,6 +104,9 @@ protected:
    mutable bool _reversed;
 
    mutable ColumnMap _colMap;
+   mutable bool _colMapEnabled;
+   mutable FlatColumn _flatColumn;
+   mutable bool _flatColumnSorted;
    mutable TopSegmentIteratorConstPtr _top;
    mutable TopSegmentIteratorConstPtr _next;
    mutable VisitCache _visitCache;
@@ -114,14 +122,16 @@ protected:
 inline bool DefaultColumnIterator::parentInScope(const Genome* genome) const
 {
   assert(genome != NULL && genome->getParent() != NULL);
-  return _scope.empty() || _scope.find(genome->getParent()) != _scope.end();
+  return _scope.getNumGenomes() == 0 || 
+     _scope.contains(genome->getParent()->getGenomeId());
 }
 
 inline bool DefaultColumnIterator::childInScope(const Genome* genome,
                                                 hal_size_t child) const
 {
   assert(genome != NULL && genome->getChild(child) != NULL);
-  return _scope.empty() || _scope.find(genome->getChild(child)) != _scope.end();
+  return _scope.getNumGenomes() == 0 ||
+     _scope.contains(genome->getChild(child)->getGenomeId());
 }
 
 }
@@ -186,7 +186,7 @@ bool DefaultGappedBottomSegmentIterator::isTop() const
 hal_size_t DefaultGappedBottomSegmentIterator::getMappedSegments(
   set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
@@ -52,7 +52,7 @@ public:
    virtual hal_size_t getMappedSegments(
      std::set<MappedSegmentConstPtr>& outSegments,
      const Genome* tgtGenome,
-     const std::set<const Genome*>* genomesOnPath,
+     const GenomeSet* genomesOnPath,
      bool doDupes,
      hal_size_t minLength,
      const Genome *coalescenceLimit,
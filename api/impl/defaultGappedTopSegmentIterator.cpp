@@ -177,7 +177,7 @@ bool DefaultGappedTopSegmentIterator::isTop() const
 hal_size_t DefaultGappedTopSegmentIterator::getMappedSegments(
   set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
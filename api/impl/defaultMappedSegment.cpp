@@ -380,7 +380,7 @@ int DefaultMappedSegment::slowComp(const DefaultSegmentIteratorConstPtr& s1,
 hal_size_t DefaultMappedSegment::map(const DefaultSegmentIterator* source,
                                      set<MappedSegmentConstPtr>& results,
                                      const Genome* tgtGenome,
-                                     const set<const Genome*>* genomesOnPath,
+                                     const GenomeSet* genomesOnPath,
                                      bool doDupes,
                                      hal_size_t minLength,
                                      const Genome *coalescenceLimit,
@@ -408,45 +408,38 @@ hal_size_t DefaultMappedSegment::map(const DefaultSegmentIterator* source,
   DefaultMappedSegmentConstPtr newMappedSeg(
     new DefaultMappedSegment(startSource, startTarget)); 
   
-  list<DefaultMappedSegmentConstPtr> input;
+  vector<DefaultMappedSegmentConstPtr> input;
   input.push_back(newMappedSeg);
-  list<DefaultMappedSegmentConstPtr> output;
+  vector<DefaultMappedSegmentConstPtr> output;
 
-  set<string> namesOnPath;
   assert(genomesOnPath != NULL);
-  for (set<const Genome*>::const_iterator i = genomesOnPath->begin();
-       i != genomesOnPath->end(); ++i)
-  {
-    namesOnPath.insert((*i)->getName());
-  }
+  const GenomeSet& idsOnPath = *genomesOnPath;
 
-  // FIXME: using multiple lists is probably much slower than just
-  // reusing the results list over and over.
-  list<DefaultMappedSegmentConstPtr> upResults;
+  vector<DefaultMappedSegmentConstPtr> upResults;
   // Map all segments up to the MRCA of src and tgt.
   if (source->getGenome() != mrca)
   {
     mapRecursiveUp(input, upResults, mrca, minLength);
   } else {
-    upResults = input;
+    upResults.swap(input);
   }
 
-  list<DefaultMappedSegmentConstPtr> paralogResults;
+  vector<DefaultMappedSegmentConstPtr> paralogResults;
   // Map to all paralogs that coalesce in or below the coalescenceLimit.
   if (mrca != coalescenceLimit && doDupes) {
-    mapRecursiveParalogies(mrca, upResults, paralogResults, namesOnPath, coalescenceLimit, minLength);
+    mapRecursiveParalogies(mrca, upResults, paralogResults, idsOnPath, coalescenceLimit, minLength);
   } else {
-    paralogResults = upResults;
+    paralogResults.swap(upResults);
   }
 
   // Finally, map back down to the target genome.
   if (tgtGenome != mrca) {
-    mapRecursiveDown(paralogResults, output, tgtGenome, namesOnPath, doDupes, minLength);
+    mapRecursiveDown(paralogResults, output, tgtGenome, idsOnPath, doDupes, minLength);
   } else {
-    output = paralogResults;
+    output.swap(paralogResults);
   }
 
-  list<DefaultMappedSegmentConstPtr>::iterator outIt = output.begin();
+  vector<DefaultMappedSegmentConstPtr>::iterator outIt = output.begin();
   for (; outIt != output.end(); ++outIt)
   {
     insertAndBreakOverlaps(*outIt, results);
@@ -457,24 +450,24 @@ hal_size_t DefaultMappedSegment::map(const DefaultSegmentIterator* source,
 
 // Map all segments from the input to any segments in the same genome
 // that coalesce in or before the given "coalescence limit" genome.
-// Destructive to any data in the input list.
+// Destructive to any data in the input vector.
 hal_size_t DefaultMappedSegment::mapRecursiveParalogies(
   const Genome *srcGenome,
-  list<DefaultMappedSegmentConstPtr>& input,
-  list<DefaultMappedSegmentConstPtr>& results,
-  const set<string>& namesOnPath,
+  vector<DefaultMappedSegmentConstPtr>& input,
+  vector<DefaultMappedSegmentConstPtr>& results,
+  const GenomeSet& idsOnPath,
   const Genome* coalescenceLimit,
   hal_size_t minLength)
 {
   if (input.empty()) {
-    results = input;
+    results.swap(input);
     return 0;
   }
 
   const Genome *curGenome = (*input.begin())->getGenome();
   assert(curGenome != NULL);
   if (curGenome == coalescenceLimit) {
-    results = input;
+    results.swap(input);
     return 0;
   }
 
@@ -483,10 +476,10 @@ hal_size_t DefaultMappedSegment::mapRecursiveParalogies(
   if (nextGenome == NULL) {
     throw hal_exception("Hit root genome when attempting to map paralogies");
   }
-  list<DefaultMappedSegmentConstPtr> paralogs;
+  vector<DefaultMappedSegmentConstPtr> paralogs;
   // Map to any paralogs in the current genome.
   // FIXME: I think the original segments are included in this, which is a waste.
-  list<DefaultMappedSegmentConstPtr>::iterator i = input.begin();
+  vector<DefaultMappedSegmentConstPtr>::iterator i = input.begin();
   for (; i != input.end(); ++i)
   {
     assert((*i)->getGenome() == curGenome);
@@ -494,7 +487,7 @@ hal_size_t DefaultMappedSegment::mapRecursiveParalogies(
   }
 
   if (nextGenome != coalescenceLimit) {
-    list<DefaultMappedSegmentConstPtr> nextSegments;
+    vector<DefaultMappedSegmentConstPtr> nextSegments;
     // Map all of the original segments (not the paralogs, which is a
     // waste) up to the next genome.
     i = input.begin();
@@ -505,34 +498,34 @@ hal_size_t DefaultMappedSegment::mapRecursiveParalogies(
     }
 
     // Recurse on the mapped segments.
-    mapRecursiveParalogies(srcGenome, nextSegments, results, namesOnPath, coalescenceLimit, minLength);
+    mapRecursiveParalogies(srcGenome, nextSegments, results, idsOnPath, coalescenceLimit, minLength);
   }
 
   // Map all the paralogs we found in this genome back to the source.
-  list<DefaultMappedSegmentConstPtr> paralogsMappedToSrc;
-  mapRecursiveDown(paralogs, paralogsMappedToSrc, srcGenome, namesOnPath, false, minLength);
+  vector<DefaultMappedSegmentConstPtr> paralogsMappedToSrc;
+  mapRecursiveDown(paralogs, paralogsMappedToSrc, srcGenome, idsOnPath, false, minLength);
 
-  results.splice(results.begin(), paralogsMappedToSrc);
-  results.sort(DefaultMappedSegment::LessSource());
-  results.unique(DefaultMappedSegment::EqualTo());
+  results.insert(results.begin(), paralogsMappedToSrc.begin(),
+                 paralogsMappedToSrc.end());
+  sortUnique(results);
   return results.size();
 }
 
 // Map the input segments up until reaching the target genome. If the
 // target genome is below the source genome, fail miserably.
-// Destructive to any data in the input or results list.
+// Destructive to any data in the input or results vector.
 hal_size_t DefaultMappedSegment::mapRecursiveUp(
-  list<DefaultMappedSegmentConstPtr>& input,
-  list<DefaultMappedSegmentConstPtr>& results,
+  vector<DefaultMappedSegmentConstPtr>& input,
+  vector<DefaultMappedSegmentConstPtr>& results,
   const Genome* tgtGenome,
   hal_size_t minLength)
 {
-  list<DefaultMappedSegmentConstPtr>* inputPtr = &input;
-  list<DefaultMappedSegmentConstPtr>* outputPtr = &results;
+  vector<DefaultMappedSegmentConstPtr>* inputPtr = &input;
+  vector<DefaultMappedSegmentConstPtr>* outputPtr = &results;
 
   if (inputPtr->empty() || (*inputPtr->begin())->getGenome() == tgtGenome)
   {
-    results = *inputPtr;
+    results.swap(*inputPtr);
     return 0;
   }
 
@@ -549,7 +542,7 @@ hal_size_t DefaultMappedSegment::mapRecursiveUp(
   }
   
   // Map all segments to the parent.
-  list<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
+  vector<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
   for (; i != inputPtr->end(); ++i)
   {
     assert((*i)->getGenome() == curGenome);
@@ -566,51 +559,52 @@ hal_size_t DefaultMappedSegment::mapRecursiveUp(
 
   if (outputPtr != &results)
   {
-    results = *outputPtr;
+    results.swap(*outputPtr);
   }
 
-  results.sort(DefaultMappedSegment::LessSource());
-  results.unique(DefaultMappedSegment::EqualTo());
+  sortUnique(results);
   return results.size();
 }
 
 // Map the input segments down until reaching the target genome. If the
 // target genome is above the source genome, fail miserably.
-// Destructive to any data in the input or results list.
+// Destructive to any data in the input or results vector.
 hal_size_t DefaultMappedSegment::mapRecursiveDown(
-  list<DefaultMappedSegmentConstPtr>& input,
-  list<DefaultMappedSegmentConstPtr>& results,
+  vector<DefaultMappedSegmentConstPtr>& input,
+  vector<DefaultMappedSegmentConstPtr>& results,
   const Genome* tgtGenome,
-  const set<string>& namesOnPath,
+  const GenomeSet& idsOnPath,
   bool doDupes,
   hal_size_t minLength)
 {
-  list<DefaultMappedSegmentConstPtr>* inputPtr = &input;
-  list<DefaultMappedSegmentConstPtr>* outputPtr = &results;
+  vector<DefaultMappedSegmentConstPtr>* inputPtr = &input;
+  vector<DefaultMappedSegmentConstPtr>* outputPtr = &results;
 
   if (inputPtr->empty())
   {
-    results = *inputPtr;
+    results.swap(*inputPtr);
     return 0;
   }
 
   const Genome *curGenome = (*inputPtr->begin())->getGenome();
   assert(curGenome != NULL);
   if (curGenome == tgtGenome) {
-    results = *inputPtr;
+    results.swap(*inputPtr);
     return 0;
   }
 
   // Find the correct child to move down into.
   const Genome *nextGenome = NULL;
   hal_size_t nextChildIndex = numeric_limits<hal_size_t>::max();
-  const Alignment *alignment = curGenome->getAlignment();
-  vector<string> childNames = alignment->getChildNames(curGenome->getName());
+  const GenomeTree* tree = curGenome->getAlignment()->getGenomeTree();
+  hal_size_t curId = curGenome->getGenomeId();
+  hal_size_t tgtId = tgtGenome->getGenomeId();
+  hal_size_t numChildren = tree->getNumChildren(curId);
   for (hal_size_t child = 0; 
-       nextGenome == NULL && child < childNames.size(); ++child)
+       nextGenome == NULL && child < numChildren; ++child)
   {
-    if (childNames[child] == tgtGenome->getName() ||
-        namesOnPath.find(childNames[child]) != namesOnPath.end())
+    hal_size_t childId = tree->getChildId(curId, child);
+    if (childId == tgtId || idsOnPath.contains(childId))
     {
       const Genome* childGenome = curGenome->getChild(child);
       nextGenome = childGenome;
@@ -629,7 +623,7 @@ hal_size_t DefaultMappedSegment::mapRecursiveDown(
   assert(nextGenome->getParent() == curGenome);
 
   // Map the actual segments down.
-  list<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
+  vector<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
   for (; i != inputPtr->end(); ++i)
   {
     assert((*i)->getGenome() == curGenome);
@@ -641,7 +635,7 @@ hal_size_t DefaultMappedSegment::mapRecursiveDown(
   {
     swap(inputPtr, outputPtr);
     outputPtr->clear();
-    list<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
+    vector<DefaultMappedSegmentConstPtr>::iterator i = inputPtr->begin();
     for (; i != inputPtr->end(); ++i)
     {
       assert((*i)->getGenome() == nextGenome);
@@ -654,22 +648,21 @@ hal_size_t DefaultMappedSegment::mapRecursiveDown(
     // Continue the recursion.
     swap(inputPtr, outputPtr);
     outputPtr->clear();
-    mapRecursiveDown(*inputPtr, *outputPtr, tgtGenome, namesOnPath, doDupes, minLength);
+    mapRecursiveDown(*inputPtr, *outputPtr, tgtGenome, idsOnPath, doDupes, minLength);
   }
 
   if (outputPtr != &results)
   {
-    results = *outputPtr;
+    results.swap(*outputPtr);
   }
 
-  results.sort(DefaultMappedSegment::LessSource());
-  results.unique(DefaultMappedSegment::EqualTo());
+  sortUnique(results);
   return results.size();
 }
 
 hal_size_t DefaultMappedSegment::mapUp(
   DefaultMappedSegmentConstPtr mappedSeg, 
-  list<DefaultMappedSegmentConstPtr>& results,
+  vector<DefaultMappedSegmentConstPtr>& results,
   bool doDupes,
   hal_size_t minLength)
 {
@@ -678,11 +671,12 @@ hal_size_t DefaultMappedSegment::mapUp(
   hal_size_t added = 0;
   if (mappedSeg->isTop() == true)
   {
-    BottomSegmentIteratorConstPtr bottom = parent->getBottomSegmentIterator();
     TopSegmentIteratorConstPtr top = mappedSeg->targetAsTop();
     if (top->hasParent() == true && top->getLength() >= minLength &&
         (doDupes == true || top->isCanonicalParalog() == true))
     {
+      BottomSegmentIteratorConstPtr bottom = 
+         parent->getBottomSegmentIterator();
       bottom->toParent(top);
       mappedSeg->_target = bottom.downCast<DefaultSegmentIteratorConstPtr>();
       results.push_back(mappedSeg);
@@ -698,6 +692,8 @@ hal_size_t DefaultMappedSegment::mapUp(
     TopSegmentIteratorConstPtr top = 
        mappedSeg->getGenome()->getTopSegmentIterator();
     top->toParseUp(bottom);
+    // scratch iterator, reset from bottom for every new segment
+    BottomSegmentIteratorConstPtr bottomBack = bottom->copy();
     do
     {
       TopSegmentIteratorConstPtr topNew = top->copy();
@@ -705,7 +701,7 @@ hal_size_t DefaultMappedSegment::mapUp(
       // we map the new target back to see how the offsets have 
       // changed.  these changes are then applied to the source segment
       // as deltas
-      BottomSegmentIteratorConstPtr bottomBack = bottom->copy();
+      bottomBack->copy(bottom);
       bottomBack->toParseDown(topNew);
       hal_index_t startBack = (hal_index_t)bottomBack->getStartOffset();
       hal_index_t endBack = (hal_index_t)bottomBack->getEndOffset();
@@ -745,7 +741,7 @@ hal_size_t DefaultMappedSegment::mapUp(
 hal_size_t DefaultMappedSegment::mapDown(
   DefaultMappedSegmentConstPtr mappedSeg, 
   hal_size_t childIndex,
-  list<DefaultMappedSegmentConstPtr>& results,
+  vector<DefaultMappedSegmentConstPtr>& results,
   hal_size_t minLength)
 {
   const Genome* child = mappedSeg->getGenome()->getChild(childIndex);
@@ -775,6 +771,8 @@ hal_size_t DefaultMappedSegment::mapDown(
     BottomSegmentIteratorConstPtr bottom = 
        mappedSeg->getGenome()->getBottomSegmentIterator();
     bottom->toParseDown(top);
+    // scratch iterator, reset from top for every new segment
+    TopSegmentIteratorConstPtr topBack = top->copy();
     do
     {
       BottomSegmentIteratorConstPtr bottomNew = bottom->copy();
@@ -782,7 +780,7 @@ hal_size_t DefaultMappedSegment::mapDown(
       // we map the new target back to see how the offsets have 
       // changed.  these changes are then applied to the source segment
       // as deltas
-      TopSegmentIteratorConstPtr topBack = top->copy();
+      topBack->copy(top);
       topBack->toParseUp(bottomNew);
       hal_index_t startBack = (hal_index_t)topBack->getStartOffset();
       hal_index_t endBack = (hal_index_t)topBack->getEndOffset();
@@ -822,7 +820,7 @@ hal_size_t DefaultMappedSegment::mapDown(
 
 hal_size_t DefaultMappedSegment::mapSelf(
   DefaultMappedSegmentConstPtr mappedSeg, 
-  list<DefaultMappedSegmentConstPtr>& results,
+  vector<DefaultMappedSegmentConstPtr>& results,
   hal_size_t minLength)
 {
   hal_size_t added = 0;
@@ -866,6 +864,8 @@ hal_size_t DefaultMappedSegment::mapSelf(
     TopSegmentIteratorConstPtr top = 
        mappedSeg->getGenome()->getTopSegmentIterator();
     top->toParseUp(bottom);
+    // scratch iterator, reset from bottom for every new segment
+    BottomSegmentIteratorConstPtr bottomBack = bottom->copy();
     do
     {
       TopSegmentIteratorConstPtr topNew = top->copy();
@@ -873,7 +873,7 @@ hal_size_t DefaultMappedSegment::mapSelf(
       // we map the new target back to see how the offsets have 
       // changed.  these changes are then applied to the source segment
       // as deltas
-      BottomSegmentIteratorConstPtr bottomBack = bottom->copy();
+      bottomBack->copy(bottom);
       bottomBack->toParseDown(topNew);
       hal_index_t startBack = (hal_index_t)bottomBack->getStartOffset();
       hal_index_t endBack = (hal_index_t)bottomBack->getEndOffset();
@@ -910,6 +910,14 @@ hal_size_t DefaultMappedSegment::mapSelf(
   return added;
 }
 
+void DefaultMappedSegment::sortUnique(
+  vector<DefaultMappedSegmentConstPtr>& segs)
+{
+  stable_sort(segs.begin(), segs.end(), DefaultMappedSegment::LessSource());
+  segs.erase(unique(segs.begin(), segs.end(), DefaultMappedSegment::EqualTo()),
+             segs.end());
+}
+
 DefaultMappedSegment::OverlapCat DefaultMappedSegment::slowOverlap(
   const SlicedSegmentConstPtr& sA, 
   const SlicedSegmentConstPtr& sB)
@@ -1273,7 +1281,7 @@ bool DefaultMappedSegment::isTop() const
 hal_size_t DefaultMappedSegment::getMappedSegments(
   set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
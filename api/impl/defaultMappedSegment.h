@@ -7,8 +7,9 @@
 #ifndef _DEFAULTMAPPEDSEGMENT_H
 #define _DEFAULTMAPPEDSEGMENT_H
 
-#include <list>
+#include <vector>
 #include "halMappedSegment.h"
+#include "halGenomeTree.h"
 #include "defaultSegmentIterator.h"
 
 namespace hal {
@@ -51,7 +52,7 @@ public:
    virtual hal_size_t getMappedSegments(
      std::set<MappedSegmentConstPtr>& outSegments,
      const Genome* tgtGenome,
-     const std::set<const Genome*>* genomesOnPath,
+     const GenomeSet* genomesOnPath,
      bool doDupes,
      hal_size_t minLength,
      const Genome *coalescenceLimit,
@@ -85,7 +86,7 @@ public:
    static hal_size_t map(const DefaultSegmentIterator* source,
                          std::set<MappedSegmentConstPtr>& results,
                          const Genome* tgtGenome,
-                         const std::set<const Genome*>* genomesOnPath,
+                         const GenomeSet* genomesOnPath,
                          bool doDupes,
                          hal_size_t minLength,
                          const Genome *coalescenceLimit,
@@ -140,9 +141,9 @@ protected:
    // homology in the MRCA of the source and target genomes).
    static hal_size_t mapIncludingExtraParalogs(
      const Genome* srcGenome,
-     std::list<DefaultMappedSegmentConstPtr>& input,
-     std::list<DefaultMappedSegmentConstPtr>& results,
-     const std::set<std::string>& namesOnPath,
+     std::vector<DefaultMappedSegmentConstPtr>& input,
+     std::vector<DefaultMappedSegmentConstPtr>& results,
+     const GenomeSet& idsOnPath,
      const Genome* tgtGenome,
      const Genome* mrca,
      const Genome *coalescenceLimit,
@@ -151,56 +152,56 @@ protected:
 
    // Map all segments from the input to any segments in the same genome
    // that coalesce in or before the given "coalescence limit" genome.
-   // Destructive to any data in the input list.
+   // Destructive to any data in the input vector.
    static hal_size_t mapRecursiveParalogies(
      const Genome *srcGenome,
-     std::list<DefaultMappedSegmentConstPtr>& input,
-     std::list<DefaultMappedSegmentConstPtr>& results,
-     const std::set<std::string>& namesOnPath,
+     std::vector<DefaultMappedSegmentConstPtr>& input,
+     std::vector<DefaultMappedSegmentConstPtr>& results,
+     const GenomeSet& idsOnPath,
      const Genome* coalescenceLimit,
      hal_size_t minLength);
 
    // Map the input segments up until reaching the target genome. If the
    // target genome is below the source genome, fail miserably.
-   // Destructive to any data in the input or results list.
+   // Destructive to any data in the input or results vector.
    static hal_size_t mapRecursiveUp(
-     std::list<DefaultMappedSegmentConstPtr>& input,
-     std::list<DefaultMappedSegmentConstPtr>& results,
+     std::vector<DefaultMappedSegmentConstPtr>& input,
+     std::vector<DefaultMappedSegmentConstPtr>& results,
      const Genome* tgtGenome,
      hal_size_t minLength);
 
    // Map the input segments down until reaching the target genome. If the
    // target genome is above the source genome, fail miserably.
-   // Destructive to any data in the input or results list.
+   // Destructive to any data in the input or results vector.
    static hal_size_t mapRecursiveDown(
-     std::list<DefaultMappedSegmentConstPtr>& input,
-     std::list<DefaultMappedSegmentConstPtr>& results,
+     std::vector<DefaultMappedSegmentConstPtr>& input,
+     std::vector<DefaultMappedSegmentConstPtr>& results,
      const Genome* tgtGenome,
-     const std::set<std::string>& namesOnPath,
+     const GenomeSet& idsOnPath,
      bool doDupes,
      hal_size_t minLength);
 
    static 
    hal_size_t mapRecursive(const Genome* prevGenome,
-                           std::list<DefaultMappedSegmentConstPtr>& input,
-                           std::list<DefaultMappedSegmentConstPtr>& results,
+                           std::vector<DefaultMappedSegmentConstPtr>& input,
+                           std::vector<DefaultMappedSegmentConstPtr>& results,
                            const Genome* tgtGenome,
-                           const std::set<std::string>& namesOnPath,
+                           const GenomeSet& idsOnPath,
                            bool doDupes,
                            hal_size_t minLength);
    static 
    hal_size_t mapUp(DefaultMappedSegmentConstPtr mappedSeg, 
-                    std::list<DefaultMappedSegmentConstPtr>& results,
+                    std::vector<DefaultMappedSegmentConstPtr>& results,
                     bool doDupes,
                     hal_size_t minLength);
    static 
    hal_size_t mapDown(DefaultMappedSegmentConstPtr mappedSeg, 
                       hal_size_t childIndex,
-                      std::list<DefaultMappedSegmentConstPtr>& results,
+                      std::vector<DefaultMappedSegmentConstPtr>& results,
                       hal_size_t minLength);
    static 
    hal_size_t mapSelf(DefaultMappedSegmentConstPtr mappedSeg, 
-                      std::list<DefaultMappedSegmentConstPtr>& results,
+                      std::vector<DefaultMappedSegmentConstPtr>& results,
                     hal_size_t minLength);
    
    TopSegmentIteratorConstPtr targetAsTop() const;
@@ -209,6 +210,10 @@ protected:
    BottomSegmentIteratorConstPtr sourceAsBottom() const;
    SegmentIteratorConstPtr sourceCopy() const;
 
+   // Sort by source and remove duplicates.  Stable, so that the 
+   // order is the same as when the results were kept in std::lists.
+   static void sortUnique(std::vector<DefaultMappedSegmentConstPtr>& segs);
+
   struct LessSource {
       bool operator()(const DefaultMappedSegmentConstPtr& ms1,
                       const DefaultMappedSegmentConstPtr& ms2) const;
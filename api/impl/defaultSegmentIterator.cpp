@@ -175,7 +175,7 @@ bool DefaultSegmentIterator::isTop() const
 hal_size_t DefaultSegmentIterator::getMappedSegments(
   set<MappedSegmentConstPtr>& outSegments,
   const Genome* tgtGenome,
-  const set<const Genome*>* genomesOnPath,
+  const GenomeSet* genomesOnPath,
   bool doDupes,
   hal_size_t minLength,
   const Genome *coalescenceLimit,
@@ -199,7 +199,7 @@ hal_size_t DefaultSegmentIterator::getMappedSegments(
   // Get the path from the coalescence limit to the target (necessary
   // for choosing which children to move through to get to the
   // target).
-  set<const Genome*> pathSet;
+  GenomeSet pathSet;
   if (genomesOnPath == NULL)
   {
     set<const Genome*> inputSet;
@@ -14,6 +14,8 @@
 #include "halAlignmentInstance.h"
 #include "hdf5Alignment.h"
 #include "hdf5CLParser.h"
+#include "mmapAlignment.h"
+#include "mmapFile.h"
 
 using namespace std;
 using namespace H5;
@@ -55,11 +57,24 @@ hal::hdf5AlignmentInstanceReadOnly(const FileCreatPropList& fileCreateProps,
   return AlignmentConstPtr(al);
 }
 
+AlignmentConstPtr hal::mmapAlignmentInstanceReadOnly()
+{
+  return AlignmentConstPtr(new MMapAlignment());
+}
+
+bool hal::isMMapAlignmentFile(const std::string& path)
+{
+  return MMapFile::isMMapFile(path);
+}
+
 AlignmentPtr hal::openHalAlignment(const std::string& path,
                                 CLParserConstPtr options)
 {
-  // detect which kind of file it is here (maybe by extension?)
-  // ...
+  if (MMapFile::isMMapFile(path) == true)
+  {
+    throw hal_exception(path + " is a memory-mapped HAL file, which can "
+                        "only be opened read-only");
+  }
 
   AlignmentPtr alignment = hdf5AlignmentInstance();
   if (options.get() != NULL)
@@ -73,10 +88,15 @@ AlignmentPtr hal::openHalAlignment(const std::string& path,
 AlignmentConstPtr hal::openHalAlignmentReadOnly(const std::string& path,
                                 CLParserConstPtr options)
 {
-  // detect which kind of file it is here (maybe by extension?)
-  // ...
-
-  AlignmentConstPtr alignment = hdf5AlignmentInstanceReadOnly();
+  AlignmentConstPtr alignment;
+  if (MMapFile::isMMapFile(path) == true)
+  {
+    alignment = mmapAlignmentInstanceReadOnly();
+  }
+  else
+  {
+    alignment = hdf5AlignmentInstanceReadOnly();
+  }
   if (options.get() != NULL)
   {
     alignment->setOptionsFromParser(options);
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <zlib.h>
+#include "halBigWigWriter.h"
+
+using namespace std;
+using namespace hal;
+
+/** File layout constants, as in the UCSC bbiFile.h, bPlusTree.h and
+ * cirTree.h */
+static const uint32_t BigWigMagic = 0x888FFC26;
+static const uint16_t BigWigVersion = 4;
+static const uint32_t BPlusTreeMagic = 0x78CA8C91;
+static const uint32_t RTreeMagic = 0x2468ACE0;
+static const uint8_t BedGraphSectionType = 1;
+static const uint64_t HeaderSize = 64;
+static const uint64_t ZoomHeaderSize = 24;
+static const uint64_t TotalSummarySize = 40;
+static const uint64_t RTreeHeaderSize = 48;
+static const uint64_t RTreeLeafItemSize = 32;
+static const uint64_t RTreeNodeItemSize = 24;
+static const uint64_t TreeNodeHeaderSize = 4;
+
+/** The first zoom level summarizes this many times the average length of
+ * the intervals in the first section. Each subsequent level is
+ * ZoomIncrement times coarser. */
+static const uint64_t InitialReductionFactor = 10;
+static const uint64_t ZoomIncrement = 4;
+
+template <typename T>
+static void append(vector<char>& buffer, T value)
+{
+  const char* bytes = reinterpret_cast<const char*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static void write(ofstream& out, T value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void writeZeros(ofstream& out, uint64_t length)
+{
+  static const char zeros[64] = {0};
+  for (; length > 0; length -= min(length, (uint64_t)sizeof(zeros)))
+  {
+    out.write(zeros, min(length, (uint64_t)sizeof(zeros)));
+  }
+}
+
+static void writeBounds(ofstream& out, uint32_t startChrom,
+                        uint32_t startBase, uint32_t endChrom,
+                        uint32_t endBase)
+{
+  write(out, startChrom);
+  write(out, startBase);
+  write(out, endChrom);
+  write(out, endBase);
+}
+
+BigWigWriter::BigWigWriter(const string& path, hal_size_t itemsPerSlot,
+                           hal_size_t blockSize) :
+  _path(path),
+  _itemsPerSlot(itemsPerSlot),
+  _blockSize(blockSize),
+  _closed(false),
+  _hasItem(false),
+  _numItems(0),
+  _zoomLevelsInitialized(false),
+  _uncompressBufSize(0),
+  _totalBases(0),
+  _totalMin(0),
+  _totalMax(0),
+  _totalSum(0),
+  _totalSumSquares(0)
+{
+  if (_itemsPerSlot == 0 || _itemsPerSlot > 0xffff ||
+      _blockSize < 2 || _blockSize > 0xffff)
+  {
+    throw hal_exception("Invalid bigWig items per slot or block size");
+  }
+  _file.open(_path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!_file)
+  {
+    throw hal_exception("Error opening output file " + _path);
+  }
+  // the header, zoom headers and total summary are filled in by close()
+  writeZeros(_file, HeaderSize + MaxZoomLevels * ZoomHeaderSize +
+             TotalSummarySize);
+  // followed by the number of data sections
+  _dataOffset = _file.tellp();
+  write(_file, (uint64_t)0);
+}
+
+BigWigWriter::~BigWigWriter()
+{
+  clear();
+}
+
+void BigWigWriter::setSequence(const string& name, hal_size_t length)
+{
+  if (_closed == true)
+  {
+    throw hal_exception("BigWigWriter: file already closed");
+  }
+  if (_chromNameSet.insert(name).second == false)
+  {
+    throw hal_exception("BigWigWriter: sequence " + name +
+                        " set more than once");
+  }
+  if (length > 0xffffffff)
+  {
+    throw hal_exception("BigWigWriter: sequence " + name +
+                        " is too long for the bigWig format");
+  }
+  flushItem();
+  flushSection();
+  _chromNames.push_back(name);
+  _chromLengths.push_back((uint32_t)length);
+}
+
+void BigWigWriter::addInterval(hal_index_t start, hal_index_t end,
+                               double value)
+{
+  if (_chromNames.empty() == true || _closed == true)
+  {
+    throw hal_exception("BigWigWriter: no sequence set");
+  }
+  if (start < 0 || end <= start || end > (hal_index_t)_chromLengths.back())
+  {
+    stringstream ss;
+    ss << "BigWigWriter: interval [" << start << "," << end << ") is out "
+       << "of range for sequence " << _chromNames.back();
+    throw hal_exception(ss.str());
+  }
+  float floatValue = (float)value;
+  if (_hasItem == true)
+  {
+    if (start < (hal_index_t)_item._end)
+    {
+      stringstream ss;
+      ss << "BigWigWriter: interval [" << start << "," << end << ") of "
+         << "sequence " << _chromNames.back() << " is not sorted";
+      throw hal_exception(ss.str());
+    }
+    if (start == (hal_index_t)_item._end && floatValue == _item._value)
+    {
+      _item._end = (uint32_t)end;
+      return;
+    }
+    flushItem();
+  }
+  _item._start = (uint32_t)start;
+  _item._end = (uint32_t)end;
+  _item._value = floatValue;
+  _hasItem = true;
+}
+
+void BigWigWriter::close()
+{
+  if (_closed == true)
+  {
+    return;
+  }
+  _closed = true;
+  flushItem();
+  flushSection();
+  if (_zoomLevelsInitialized == false)
+  {
+    initZoomLevels();
+  }
+  for (size_t i = 0; i < _zoomLevels.size(); ++i)
+  {
+    if (_zoomLevels[i]._hasCurrent == true)
+    {
+      flushSummary(_zoomLevels[i]);
+    }
+    flushZoomBlock(_zoomLevels[i]);
+  }
+
+  // full resolution data
+  uint64_t indexOffset = _file.tellp();
+  _file.seekp(_dataOffset);
+  write(_file, (uint64_t)_sections.size());
+  _file.seekp(indexOffset);
+  writeRTree(_sections, indexOffset);
+
+  // a zoom level is only kept if it is at least twice smaller than the
+  // previous one.  (with sparse data the first levels can have about one
+  // summary per item, and the coarser ones may still be worth keeping)
+  vector<uint32_t> zoomReductions;
+  vector<uint64_t> zoomDataOffsets;
+  vector<uint64_t> zoomIndexOffsets;
+  uint64_t previousCount = _numItems;
+  vector<char> buffer(1 << 16);
+  for (size_t i = 0; i < _zoomLevels.size(); ++i)
+  {
+    ZoomLevel& level = _zoomLevels[i];
+    if (level._numSummaries == 0 || level._numSummaries * 2 > previousCount)
+    {
+      continue;
+    }
+    previousCount = level._numSummaries;
+    uint64_t dataOffset = _file.tellp();
+    write(_file, (uint32_t)level._numSummaries);
+    rewind(level._file);
+    for (uint64_t copied = 0; copied < level._fileSize; )
+    {
+      size_t length = min((uint64_t)buffer.size(), level._fileSize - copied);
+      if (fread(&buffer[0], 1, length, level._file) != length)
+      {
+        throw hal_exception("BigWigWriter: error reading temporary file");
+      }
+      _file.write(&buffer[0], length);
+      copied += length;
+    }
+    for (size_t j = 0; j < level._blocks.size(); ++j)
+    {
+      level._blocks[j]._offset += dataOffset + sizeof(uint32_t);
+    }
+    uint64_t zoomIndexOffset = _file.tellp();
+    writeRTree(level._blocks, zoomIndexOffset);
+    zoomReductions.push_back(level._reduction);
+    zoomDataOffsets.push_back(dataOffset);
+    zoomIndexOffsets.push_back(zoomIndexOffset);
+  }
+
+  uint64_t chromTreeOffset = _file.tellp();
+  writeChromTree();
+
+  _file.seekp(0);
+  write(_file, BigWigMagic);
+  write(_file, BigWigVersion);
+  write(_file, (uint16_t)zoomDataOffsets.size());
+  write(_file, chromTreeOffset);
+  write(_file, _dataOffset);
+  write(_file, indexOffset);
+  write(_file, (uint16_t)0); // field count
+  write(_file, (uint16_t)0); // defined field count
+  write(_file, (uint64_t)0); // autoSql offset
+  write(_file, HeaderSize + MaxZoomLevels * ZoomHeaderSize);
+  write(_file, (uint32_t)_uncompressBufSize);
+  write(_file, (uint64_t)0); // extension offset
+  for (size_t i = 0; i < zoomDataOffsets.size(); ++i)
+  {
+    write(_file, zoomReductions[i]);
+    write(_file, (uint32_t)0);
+    write(_file, zoomDataOffsets[i]);
+    write(_file, zoomIndexOffsets[i]);
+  }
+  _file.seekp(HeaderSize + MaxZoomLevels * ZoomHeaderSize);
+  write(_file, _totalBases);
+  write(_file, _totalMin);
+  write(_file, _totalMax);
+  write(_file, _totalSum);
+  write(_file, _totalSumSquares);
+
+  _file.close();
+  clear();
+  if (!_file)
+  {
+    throw hal_exception("Error writing " + _path);
+  }
+}
+
+void BigWigWriter::flushItem()
+{
+  if (_hasItem == false)
+  {
+    return;
+  }
+  _hasItem = false;
+  _section.push_back(_item);
+  ++_numItems;
+  double bases = _item._end - _item._start;
+  if (_totalBases == 0)
+  {
+    _totalMin = _item._value;
+    _totalMax = _item._value;
+  }
+  _totalBases += _item._end - _item._start;
+  _totalMin = min(_totalMin, (double)_item._value);
+  _totalMax = max(_totalMax, (double)_item._value);
+  _totalSum += _item._value * bases;
+  _totalSumSquares += _item._value * _item._value * bases;
+  if (_section.size() == _itemsPerSlot)
+  {
+    flushSection();
+  }
+}
+
+void BigWigWriter::flushSection()
+{
+  if (_section.empty() == true)
+  {
+    return;
+  }
+  uint32_t chrom = (uint32_t)_chromNames.size() - 1;
+  vector<char> buffer;
+  buffer.reserve(24 + _section.size() * 12);
+  append(buffer, chrom);
+  append(buffer, _section.front()._start);
+  append(buffer, _section.back()._end);
+  append(buffer, (uint32_t)0); // item step
+  append(buffer, (uint32_t)0); // item span
+  append(buffer, BedGraphSectionType);
+  append(buffer, (uint8_t)0);
+  append(buffer, (uint16_t)_section.size());
+  for (size_t i = 0; i < _section.size(); ++i)
+  {
+    append(buffer, _section[i]._start);
+    append(buffer, _section[i]._end);
+    append(buffer, _section[i]._value);
+  }
+  compress(buffer);
+
+  Block block;
+  block._startChrom = chrom;
+  block._startBase = _section.front()._start;
+  block._endChrom = chrom;
+  block._endBase = _section.back()._end;
+  block._offset = _file.tellp();
+  block._size = _compressBuffer.size();
+  _file.write(&_compressBuffer[0], _compressBuffer.size());
+  _sections.push_back(block);
+
+  if (_zoomLevelsInitialized == false)
+  {
+    initZoomLevels();
+  }
+  for (size_t i = 0; i < _section.size(); ++i)
+  {
+    addToZoomLevels(_section[i]);
+  }
+  _section.clear();
+}
+
+void BigWigWriter::initZoomLevels()
+{
+  uint64_t bases = 0;
+  for (size_t i = 0; i < _section.size(); ++i)
+  {
+    bases += _section[i]._end - _section[i]._start;
+  }
+  uint64_t averageLength = 1;
+  if (_section.empty() == false)
+  {
+    averageLength = max((uint64_t)1, bases / _section.size());
+  }
+  uint64_t reduction = averageLength * InitialReductionFactor;
+  for (size_t i = 0; i < MaxZoomLevels && reduction <= 0x7fffffff; ++i)
+  {
+    _zoomLevels.push_back(ZoomLevel());
+    ZoomLevel& level = _zoomLevels.back();
+    level._reduction = (uint32_t)reduction;
+    level._file = tmpfile();
+    level._fileSize = 0;
+    level._numSummaries = 0;
+    level._hasCurrent = false;
+    if (level._file == NULL)
+    {
+      throw hal_exception("BigWigWriter: error creating temporary file");
+    }
+    reduction *= ZoomIncrement;
+  }
+  _zoomLevelsInitialized = true;
+}
+
+void BigWigWriter::addToZoomLevels(const Item& item)
+{
+  uint32_t chrom = (uint32_t)_chromNames.size() - 1;
+  uint64_t chromLength = _chromLengths.back();
+  double value = item._value;
+  for (size_t i = 0; i < _zoomLevels.size(); ++i)
+  {
+    ZoomLevel& level = _zoomLevels[i];
+    Summary& summary = level._current;
+    for (uint32_t start = item._start; start < item._end; )
+    {
+      if (level._hasCurrent == true &&
+          (summary._chrom != chrom || start >= summary._end))
+      {
+        flushSummary(level);
+      }
+      if (level._hasCurrent == false)
+      {
+        summary._chrom = chrom;
+        summary._start = start;
+        summary._end = (uint32_t)min((uint64_t)start + level._reduction,
+                                     chromLength);
+        summary._validCount = 0;
+        summary._min = value;
+        summary._max = value;
+        summary._sum = 0;
+        summary._sumSquares = 0;
+        level._hasCurrent = true;
+      }
+      uint32_t end = min(item._end, summary._end);
+      double bases = end - start;
+      summary._validCount += end - start;
+      summary._min = min(summary._min, value);
+      summary._max = max(summary._max, value);
+      summary._sum += value * bases;
+      summary._sumSquares += value * value * bases;
+      start = end;
+    }
+  }
+}
+
+void BigWigWriter::flushSummary(ZoomLevel& level)
+{
+  assert(level._hasCurrent == true);
+  level._pending.push_back(level._current);
+  level._hasCurrent = false;
+  ++level._numSummaries;
+  if (level._pending.size() == _itemsPerSlot)
+  {
+    flushZoomBlock(level);
+  }
+}
+
+void BigWigWriter::flushZoomBlock(ZoomLevel& level)
+{
+  if (level._pending.empty() == true)
+  {
+    return;
+  }
+  vector<char> buffer;
+  buffer.reserve(level._pending.size() * 32);
+  for (size_t i = 0; i < level._pending.size(); ++i)
+  {
+    const Summary& summary = level._pending[i];
+    append(buffer, summary._chrom);
+    append(buffer, summary._start);
+    append(buffer, summary._end);
+    append(buffer, summary._validCount);
+    append(buffer, (float)summary._min);
+    append(buffer, (float)summary._max);
+    append(buffer, (float)summary._sum);
+    append(buffer, (float)summary._sumSquares);
+  }
+  compress(buffer);
+  if (fwrite(&_compressBuffer[0], 1, _compressBuffer.size(), level._file) !=
+      _compressBuffer.size())
+  {
+    throw hal_exception("BigWigWriter: error writing temporary file");
+  }
+
+  // block offsets are relative to the temporary file until close()
+  Block block;
+  block._startChrom = level._pending.front()._chrom;
+  block._startBase = level._pending.front()._start;
+  block._endChrom = level._pending.back()._chrom;
+  block._endBase = level._pending.back()._end;
+  block._offset = level._fileSize;
+  block._size = _compressBuffer.size();
+  level._blocks.push_back(block);
+  level._fileSize += block._size;
+  level._pending.clear();
+}
+
+void BigWigWriter::compress(const vector<char>& buffer)
+{
+  uLongf compressedSize = compressBound(buffer.size());
+  _compressBuffer.resize(compressedSize);
+  if (compress2(reinterpret_cast<Bytef*>(&_compressBuffer[0]),
+                &compressedSize,
+                reinterpret_cast<const Bytef*>(&buffer[0]), buffer.size(),
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+  {
+    throw hal_exception("BigWigWriter: zlib compression error");
+  }
+  _compressBuffer.resize(compressedSize);
+  _uncompressBufSize = max(_uncompressBufSize, (uint64_t)buffer.size());
+}
+
+/** Write a UCSC cirTree indexing the blocks (which are sorted by
+ * chromosome and position).  Each leaf node points to up to _blockSize
+ * blocks and each internal node to up to _blockSize nodes.  The root is
+ * written first and the leaves last */
+void BigWigWriter::writeRTree(const vector<Block>& blocks,
+                              uint64_t endOffset)
+{
+  uint64_t indexOffset = _file.tellp();
+  write(_file, RTreeMagic);
+  write(_file, (uint32_t)_blockSize);
+  write(_file, (uint64_t)blocks.size());
+  if (blocks.empty() == true)
+  {
+    writeBounds(_file, 0, 0, 0, 0);
+  }
+  else
+  {
+    writeBounds(_file, blocks.front()._startChrom, blocks.front()._startBase,
+                blocks.back()._endChrom, blocks.back()._endBase);
+  }
+  write(_file, endOffset);
+  write(_file, (uint32_t)_itemsPerSlot);
+  write(_file, (uint32_t)0);
+  if (blocks.empty() == true)
+  {
+    write(_file, (uint8_t)1);
+    write(_file, (uint8_t)0);
+    write(_file, (uint16_t)0);
+    return;
+  }
+
+  // levels[0] are the leaves.  node i of a level covers children
+  // [i * _blockSize, (i + 1) * _blockSize) of the level below it
+  vector<vector<Block> > levels;
+  const vector<Block>* children = &blocks;
+  do
+  {
+    vector<Block> level;
+    for (size_t i = 0; i < children->size(); i += _blockSize)
+    {
+      size_t last = min(i + _blockSize, children->size()) - 1;
+      Block node = children->at(i);
+      node._endChrom = children->at(last)._endChrom;
+      node._endBase = children->at(last)._endBase;
+      level.push_back(node);
+    }
+    levels.push_back(level);
+    children = &levels.back();
+  } while (children->size() > 1);
+
+  uint64_t offset = indexOffset + RTreeHeaderSize;
+  for (size_t l = levels.size(); l > 0; --l)
+  {
+    size_t numChildren = l == 1 ? blocks.size() : levels[l - 2].size();
+    uint64_t itemSize = l == 1 ? RTreeLeafItemSize : RTreeNodeItemSize;
+    for (size_t i = 0; i < levels[l - 1].size(); ++i)
+    {
+      levels[l - 1][i]._offset = offset;
+      offset += TreeNodeHeaderSize + itemSize *
+         (min((i + 1) * _blockSize, numChildren) - i * _blockSize);
+    }
+  }
+
+  for (size_t l = levels.size(); l > 0; --l)
+  {
+    const vector<Block>& level = levels[l - 1];
+    children = l == 1 ? &blocks : &levels[l - 2];
+    for (size_t i = 0; i < level.size(); ++i)
+    {
+      assert((uint64_t)_file.tellp() == level[i]._offset);
+      size_t first = i * _blockSize;
+      size_t last = min(first + _blockSize, children->size());
+      write(_file, (uint8_t)(l == 1 ? 1 : 0));
+      write(_file, (uint8_t)0);
+      write(_file, (uint16_t)(last - first));
+      for (size_t j = first; j < last; ++j)
+      {
+        const Block& child = children->at(j);
+        writeBounds(_file, child._startChrom, child._startBase,
+                    child._endChrom, child._endBase);
+        write(_file, child._offset);
+        if (l == 1)
+        {
+          write(_file, child._size);
+        }
+      }
+    }
+  }
+}
+
+/** Write the UCSC B+ tree that maps sequence names to their ids and
+ * lengths.  Same layout as bptFileBulkIndexToOpenFile(): internal levels
+ * from the root down, then the leaves, all nodes padded to _blockSize
+ * slots */
+void BigWigWriter::writeChromTree()
+{
+  vector<pair<string, uint32_t> > chroms;
+  size_t keySize = 1;
+  for (size_t i = 0; i < _chromNames.size(); ++i)
+  {
+    chroms.push_back(pair<string, uint32_t>(_chromNames[i], i));
+    keySize = max(keySize, _chromNames[i].length());
+  }
+  sort(chroms.begin(), chroms.end());
+  uint64_t itemCount = chroms.size();
+  uint64_t blockSize = max((uint64_t)1, min((uint64_t)_blockSize, itemCount));
+  uint64_t valSize = 2 * sizeof(uint32_t);
+
+  write(_file, BPlusTreeMagic);
+  write(_file, (uint32_t)blockSize);
+  write(_file, (uint32_t)keySize);
+  write(_file, (uint32_t)valSize);
+  write(_file, itemCount);
+  write(_file, (uint64_t)0);
+
+  size_t levels = 1;
+  for (uint64_t count = itemCount; count > blockSize; ++levels)
+  {
+    count = (count + blockSize - 1) / blockSize;
+  }
+  vector<char> key(keySize);
+  uint64_t nodeBytes = TreeNodeHeaderSize + blockSize * (keySize + 8);
+  uint64_t leafBytes = TreeNodeHeaderSize + blockSize * (keySize + valSize);
+
+  for (size_t level = levels - 1; level > 0; --level)
+  {
+    uint64_t slotSize = 1;
+    for (size_t i = 0; i < level; ++i)
+    {
+      slotSize *= blockSize;
+    }
+    uint64_t nodeSize = slotSize * blockSize;
+    uint64_t nodeCount = (itemCount + nodeSize - 1) / nodeSize;
+    uint64_t nextChild = (uint64_t)_file.tellp() + nodeCount * nodeBytes;
+    for (uint64_t i = 0; i < itemCount; i += nodeSize)
+    {
+      uint64_t count = min(blockSize,
+                           (itemCount - i + slotSize - 1) / slotSize);
+      write(_file, (uint8_t)0);
+      write(_file, (uint8_t)0);
+      write(_file, (uint16_t)count);
+      for (uint64_t j = 0; j < count; ++j)
+      {
+        const string& name = chroms[i + j * slotSize].first;
+        fill(key.begin(), key.end(), 0);
+        copy(name.begin(), name.end(), key.begin());
+        _file.write(&key[0], keySize);
+        write(_file, nextChild);
+        nextChild += level == 1 ? leafBytes : nodeBytes;
+      }
+      writeZeros(_file, (blockSize - count) * (keySize + 8));
+    }
+  }
+
+  uint64_t i = 0;
+  do
+  {
+    uint64_t count = min(blockSize, itemCount - i);
+    write(_file, (uint8_t)1);
+    write(_file, (uint8_t)0);
+    write(_file, (uint16_t)count);
+    for (uint64_t j = i; j < i + count; ++j)
+    {
+      fill(key.begin(), key.end(), 0);
+      copy(chroms[j].first.begin(), chroms[j].first.end(), key.begin());
+      _file.write(&key[0], keySize);
+      write(_file, chroms[j].second);
+      write(_file, _chromLengths[chroms[j].second]);
+    }
+    writeZeros(_file, (blockSize - count) * (keySize + valSize));
+    i += count;
+  } while (i < itemCount);
+}
+
+void BigWigWriter::clear()
+{
+  for (size_t i = 0; i < _zoomLevels.size(); ++i)
+  {
+    if (_zoomLevels[i]._file != NULL)
+    {
+      fclose(_zoomLevels[i]._file);
+    }
+  }
+  _zoomLevels.clear();
+}
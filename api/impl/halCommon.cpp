@@ -5,6 +5,9 @@
  */
 #include <sstream>
 #include <map>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
 #include "halDefs.h"
 #include "hal.h"
 
@@ -38,7 +41,15 @@ void hal::reverseComplement(std::string& s)
 {
   if (!s.empty())
   {
-    size_t j = s.length() - 1;
+    reverseComplement(&s[0], s.length());
+  }
+}
+
+void hal::reverseComplement(char* s, size_t length)
+{
+  if (length > 0)
+  {
+    size_t j = length - 1;
     size_t i = 0;
     char buf;
     do
@@ -47,7 +58,7 @@ void hal::reverseComplement(std::string& s)
       {
         --j;
       }
-      while (i < s.length() - 1 && s[i] == '-')
+      while (i < length - 1 && s[i] == '-')
       {
         ++i;
       }
@@ -71,6 +82,72 @@ void hal::reverseComplement(std::string& s)
   }
 }
 
+// The case bit of each of 8 characters packed in a word
+static const uint64_t caseBits = 0x2020202020202020ULL;
+// Number of bases read at a time from a sequence
+static const hal_size_t maskBlockLength = 1 << 20;
+
+static inline uint64_t loadWord(const char* s)
+{
+  uint64_t word;
+  memcpy(&word, s, sizeof(word));
+  return word;
+}
+
+void hal::getMaskedRuns(const char* dna, size_t length, hal_index_t offset,
+                        PositionRuns& runs)
+{
+  size_t i = 0;
+  while (i < length)
+  {
+    // skip unmasked bases, a whole word at a time while there are 8
+    // in a row
+    while (i + 8 <= length && (loadWord(dna + i) & caseBits) == 0)
+    {
+      i += 8;
+    }
+    while (i < length && isMasked(dna[i]) == false)
+    {
+      ++i;
+    }
+    if (i == length)
+    {
+      break;
+    }
+    size_t first = i;
+    while (i + 8 <= length && (loadWord(dna + i) & caseBits) == caseBits)
+    {
+      i += 8;
+    }
+    while (i < length && isMasked(dna[i]) == true)
+    {
+      ++i;
+    }
+    hal_index_t runFirst = offset + (hal_index_t)first;
+    hal_index_t runLast = offset + (hal_index_t)i - 1;
+    if (runs.empty() == false && runs.back().second + 1 == runFirst)
+    {
+      runs.back().second = runLast;
+    }
+    else
+    {
+      runs.push_back(pair<hal_index_t, hal_index_t>(runFirst, runLast));
+    }
+  }
+}
+
+void hal::getMaskedRuns(const SegmentedSequence* sequence, hal_index_t start,
+                        hal_size_t length, PositionRuns& runs)
+{
+  string buffer;
+  for (hal_size_t done = 0; done < length; done += maskBlockLength)
+  {
+    hal_size_t blockLength = min(maskBlockLength, length - done);
+    sequence->getSubString(buffer, start + done, blockLength);
+    getMaskedRuns(buffer.data(), blockLength, start + done, runs);
+  }
+}
+
 void hal::reverseGaps(string& s)
 {
   bool hasGap = false; // just to skip unnecessary work
@@ -98,111 +175,68 @@ void hal::reverseGaps(string& s)
   }
 }
 
-// we now work with names instead of Genome*s to avoid expensive openGenome
-// function
-static size_t lcaRecursive(const Alignment* alignment,
-                           const string& genome,
-                           const set<string>& inputSet,
-                           map<string, size_t>& table)
+// convert a set of genomes to a bitset of their GenomeTree ids
+static const GenomeTree* toGenomeSet(const set<const Genome*>& inputSet,
+                                     GenomeSet& genomeSet)
 {
-  size_t score = 0;
-  if (inputSet.find(genome) != inputSet.end())
-  {
-    score = 1;
-  }
-  vector<string> childs = alignment->getChildNames(genome);
-  for (hal_size_t i = 0; i < childs.size(); ++i)
+  const Alignment* alignment = (*inputSet.begin())->getAlignment();
+  const GenomeTree* tree = alignment->getGenomeTree();
+  genomeSet.resize(tree->getNumGenomes());
+  for (set<const Genome*>::const_iterator i = inputSet.begin(); 
+       i != inputSet.end(); ++i)
   {
-    score += lcaRecursive(alignment, childs[i], inputSet, table);
+    genomeSet.insert((*i)->getGenomeId());
   }
-  table.insert(pair<string, size_t>(genome, score));
-  return score;
+  return tree;
 }
 
 const Genome* hal::getLowestCommonAncestor(const set<const Genome*>& inputSet)
 {
   if (inputSet.empty())
      return NULL;
-  
-  const Alignment* alignment = (*inputSet.begin())->getAlignment();
-  set<string> inputNames;
-  for (set<const Genome*>::iterator i = inputSet.begin(); i != inputSet.end();
-       ++i)
-  {
-    inputNames.insert((*i)->getName());
-  }
-
-  // dumb algorithm but it's friday and i'm too tired to think
-  string root = alignment->getRootName();
-  map<string, size_t> table;
-  lcaRecursive(alignment, root, inputNames, table);
-  string lca = root;
-  bool found = false;
-  while (!found)
-  {
-    found = true;
-    hal_size_t score = table.find(lca)->second;
-    vector<string> childs = alignment->getChildNames(lca);
 
-    for (hal_size_t i = 0; found && i < childs.size(); ++i)
-    {
-      if (table.find(childs[i])->second == score)
-      {
-        lca = childs[i];
-        found = false;
-      }
-    }
-  }
-  return alignment->openGenome(lca);
+  GenomeSet genomeSet;
+  const GenomeTree* tree = toGenomeSet(inputSet, genomeSet);
+  hal_index_t lca = tree->getLowestCommonAncestor(genomeSet);
+  assert(lca != NULL_INDEX);
+  return (*inputSet.begin())->getAlignment()->openGenome(tree->getName(lca));
 }
 
-// we now work with names instead of Genome*s to avoid expensive openGenome
-// function
-static bool spanningRecursive(const Alignment* alignment,
-                              const string& genome, 
-                              set<const Genome*>& outputSet, 
-                              set<string>& outputNames,
-                              bool below = false)
+void hal::getGenomesInSpanningTree(const set<const Genome*>& inputSet,
+                              set<const Genome*>& outputSet)
 {
-  bool above = false;
-  if (outputNames.find(genome) != outputNames.end())
-  {
-    below = true;
-    above = true;
-  }
-  vector<string> childs = alignment->getChildNames(genome);
-  for (hal_size_t i = 0; i < childs.size(); ++i)
-  {
-    bool childAbove = spanningRecursive(alignment, childs[i], outputSet, 
-                                        outputNames, below);
-    above = above || childAbove;
-  }
+  if (inputSet.empty())
+     return;
 
-  if (above && below)
+  GenomeSet genomeSet;
+  const GenomeTree* tree = toGenomeSet(inputSet, genomeSet);
+  GenomeSet spanningSet(tree->getNumGenomes());
+  tree->getSpanningTree(genomeSet, spanningSet);
+
+  // only open the genomes that aren't already in the input
+  const Alignment* alignment = (*inputSet.begin())->getAlignment();
+  outputSet = inputSet;
+  for (hal_index_t id = spanningSet.next(NULL_INDEX); id != NULL_INDEX;
+       id = spanningSet.next(id))
   {
-    outputSet.insert(alignment->openGenome(genome));
-    outputNames.insert(genome);
+    if (!genomeSet.contains(id))
+    {
+      outputSet.insert(alignment->openGenome(tree->getName(id)));
+    }
   }
-  return above;  
 }
 
 void hal::getGenomesInSpanningTree(const set<const Genome*>& inputSet,
-                              set<const Genome*>& outputSet)
+                                   GenomeSet& outputSet)
 {
-  const Genome* lca = getLowestCommonAncestor(inputSet);
-  if (lca== NULL)
+  if (inputSet.empty())
      return;
-  outputSet = inputSet;
-  outputSet.insert(lca);
-  set<string> outputNames;
-  for (set<const Genome*>::iterator i = outputSet.begin(); i != outputSet.end();
-       ++i)
-  {
-    outputNames.insert((*i)->getName());
-  }
-  spanningRecursive(lca->getAlignment(), lca->getName(), outputSet, outputNames);
-}
 
+  GenomeSet genomeSet;
+  const GenomeTree* tree = toGenomeSet(inputSet, genomeSet);
+  outputSet.resize(tree->getNumGenomes());
+  tree->getSpanningTree(genomeSet, outputSet);
+}
 
 void hal::getGenomesInSubTree(const Genome* root, 
                               set<const Genome*>& outputSet)
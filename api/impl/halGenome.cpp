@@ -1,6 +1,7 @@
 #include <sstream>
 #include <assert.h>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include "halGenome.h"
 #include "halAlignment.h"
@@ -13,6 +14,12 @@
 using namespace std;
 
 namespace hal {
+
+// Number of bases moved at a time by copySequence
+static const hal_size_t copyBlockLength = 1 << 22;
+
+const hal_size_t Genome::copyBlockSegments = 1 << 16;
+
 void Genome::copy(Genome *dest) const
 {
   copyDimensions(dest);
@@ -87,13 +94,31 @@ void Genome::copyBottomDimensions(Genome *dest) const
   dest->updateBottomDimensions(dimensions);
 }
 
-void Genome::copyTopSegments(Genome *dest) const
+// Get the first bottom segment of each sequence of inGenome that has any
+// (in increasing order), along with the sequence of the same name in
+// outGenome (or NULL if there is none)
+static void getBottomSegmentRuns(const Genome* inGenome,
+                                 const Genome* outGenome,
+                                 vector<hal_index_t>& runStarts,
+                                 vector<const Sequence*>& inSequences,
+                                 vector<const Sequence*>& outSequences)
 {
-  const Genome *inParent = getParent();
-  const Genome *outParent = dest->getParent();
+  SequenceIteratorConstPtr seqIt = inGenome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = inGenome->getSequenceEndIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext())
+  {
+    const Sequence* inSequence = seqIt->getSequence();
+    if (inSequence->getNumBottomSegments() > 0)
+    {
+      runStarts.push_back(inSequence->getBottomSegmentArrayIndex());
+      inSequences.push_back(inSequence);
+      outSequences.push_back(outGenome->getSequence(inSequence->getName()));
+    }
+  }
+}
 
-  TopSegmentIteratorConstPtr inTop = getTopSegmentIterator();
-  TopSegmentIteratorPtr outTop = dest->getTopSegmentIterator();
+void Genome::copyTopSegments(Genome *dest) const
+{
   hal_size_t n = dest->getNumTopSegments();
   assert(n == 0 || n == getNumTopSegments());
 
@@ -102,41 +127,46 @@ void Genome::copyTopSegments(Genome *dest) const
     return;
   }
 
-  BottomSegmentIteratorConstPtr inParentBottomSegIt = inParent->getBottomSegmentIterator();
-  BottomSegmentIteratorConstPtr outParentBottomSegIt = outParent->getBottomSegmentIterator();
-
-  for (; (hal_size_t)inTop->getArrayIndex() < n; inTop->toRight(),
-         outTop->toRight())
+  // The parent's sequences can be ordered differently in the two
+  // alignments, so parent indices are moved from the parent sequence in
+  // this alignment to the one with the same name in the destination
+  vector<hal_index_t> runStarts;
+  vector<const Sequence*> inParentSequences;
+  vector<const Sequence*> outParentSequences;
+  getBottomSegmentRuns(getParent(), dest->getParent(), runStarts,
+                       inParentSequences, outParentSequences);
+
+  vector<TopSegmentRecord> records;
+  for (hal_size_t start = 0; start < n; start += copyBlockSegments)
   {
-    hal_index_t genomePos = inTop->getStartPosition();
-    assert(genomePos != NULL_INDEX);
-    string inSeqName = getSequenceBySite(genomePos)->getName();
-    string outSeqName = dest->getSequenceBySite(genomePos)->getName();
-    // if (inSeqName != outSeqName) {
-    //   stringstream ss;
-    //   ss << "When copying top segments from " << getName() << " to " << dest->getName() << ": sequence " << inSeqName << " != " << outSeqName << " at site " << genomePos;
-    //   throw hal_exception(ss.str());
-    // }
-
-    outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
-    outTop->setParentIndex(inTop->getParentIndex());
-    outTop->setParentReversed(inTop->getParentReversed());
-    outTop->setBottomParseIndex(inTop->getBottomParseIndex());
-    outTop->setNextParalogyIndex(inTop->getNextParalogyIndex());
-
-    // Check that the sequences from the bottom segments we point to are the same. If not, correct the indices so that they are.
-    if (inTop->getParentIndex() != NULL_INDEX) {
-      inParentBottomSegIt->toParent(inTop);
-
-      const Sequence *inParentSequence = inParentBottomSegIt->getSequence();
-
-      const Sequence *outParentSequence = outParent->getSequence(inParentSequence->getName());
-
-      hal_index_t inParentSegmentOffset = inTop->getParentIndex() - inParentSequence->getBottomSegmentArrayIndex();
-      hal_index_t outParentSegmentIndex = inParentSegmentOffset + outParentSequence->getBottomSegmentArrayIndex();
-
-      outTop->setParentIndex(outParentSegmentIndex);
+    hal_size_t count = min(copyBlockSegments, n - start);
+    getTopSegmentRecords(start, count, records);
+    for (size_t i = 0; i < count; ++i)
+    {
+      hal_index_t parentIndex = records[i]._parentIndex;
+      if (parentIndex == NULL_INDEX)
+      {
+        continue;
+      }
+      size_t run = upper_bound(runStarts.begin(), runStarts.end(),
+                               parentIndex) - runStarts.begin();
+      assert(run > 0);
+      const Sequence* inParentSequence = inParentSequences[run - 1];
+      const Sequence* outParentSequence = outParentSequences[run - 1];
+      if (outParentSequence == NULL)
+      {
+        stringstream ss;
+        ss << "When copying top segments from " << getName() << " to "
+           << dest->getName() << ": parent sequence "
+           << inParentSequence->getName() << " not found in "
+           << dest->getParent()->getName();
+        throw hal_exception(ss.str());
+      }
+      records[i]._parentIndex = 
+         parentIndex - inParentSequence->getBottomSegmentArrayIndex() +
+         outParentSequence->getBottomSegmentArrayIndex();
     }
+    dest->setTopSegmentRecords(start, records);
   }
 }
 
@@ -147,53 +177,47 @@ void Genome::copyBottomSegments(Genome *dest) const
   hal_size_t outNc = dest->getNumChildren();
   // The child indices aren't consistent across files--make sure each bottom
   // segment points to the correct children
-  vector<string> inChildNames;
-  vector<string> outChildNames;
-  for (hal_size_t inChild = 0; inChild < inNc; ++inChild)
-  {
-    inChildNames.push_back(getChild(inChild)->getName());
-  }
-  for (hal_size_t outChild = 0; outChild < outNc; ++outChild)
-  {
-    outChildNames.push_back(dest->getChild(outChild)->getName());
-  }
-  map<hal_size_t, hal_size_t> inChildToOutChild;
+  vector<hal_size_t> inChildToOutChild(inNc, outNc);
+  hal_size_t numMapped = 0;
   for (hal_size_t inChild = 0; inChild < inNc; inChild++)
   {
-    hal_size_t outChild;
-    for (outChild = 0; outChild < outNc; outChild++)
+    const string& inChildName = getChild(inChild)->getName();
+    for (hal_size_t outChild = 0; outChild < outNc; outChild++)
     {
-      if (inChildNames[inChild] == outChildNames[outChild])
+      if (inChildName == dest->getChild(outChild)->getName())
       {
         inChildToOutChild[inChild] = outChild;
+        ++numMapped;
         break;
       }
     }
-    if (outChild == outNc)
-    {
-      inChildToOutChild[inChild] = outNc;
-    }
   }
+  // links to children of the destination that aren't in this alignment
+  // are left as they are
+  bool keepOutChildren = numMapped < outNc;
 
   // Go through each sequence in this genome, find the matching
   // sequence in the dest genome, then copy over the segments for each
   // sequence.
-  SequenceIteratorConstPtr seqIt = getSequenceIterator();
-  SequenceIteratorConstPtr seqEndIt = getSequenceEndIterator();
-
-  for (; seqIt != seqEndIt; seqIt->toNext())
+  vector<hal_index_t> runStarts;
+  vector<const Sequence*> inSequences;
+  vector<const Sequence*> outSequences;
+  getBottomSegmentRuns(this, dest, runStarts, inSequences, outSequences);
+
+  vector<BottomSegmentRecord> records;
+  vector<BottomSegmentRecord> outRecords;
+  vector<ChildRecord> inChildren;
+  vector<ChildRecord> outChildren;
+  for (size_t run = 0; run < runStarts.size(); ++run)
   {
-    const Sequence *inSeq = seqIt->getSequence();
-    const Sequence *outSeq = dest->getSequence(inSeq->getName());
-    BottomSegmentIteratorPtr inBot = inSeq->getBottomSegmentIterator();
-    BottomSegmentIteratorPtr outBot = outSeq->getBottomSegmentIterator();
-
-    cout << "DEBUG: inSeq name: " << inSeq->getName() << ", outSeq name: " << outSeq->getName() << endl;
-
-    if (inSeq->getName() != outSeq->getName()) {
-      // This check is important enough that it can't be an assert.
+    const Sequence *inSeq = inSequences[run];
+    const Sequence *outSeq = outSequences[run];
+    if (outSeq == NULL)
+    {
       stringstream ss;
-      ss << "When copying bottom segments: segment #" << inBot->getArrayIndex() << " of source genome is from sequence " << inBot->getSequence()->getName() << ", but segment #" << outBot->getArrayIndex() << " is from sequence " << outBot->getSequence()->getName();
+      ss << "When copying bottom segments: sequence " << inSeq->getName()
+         << " of genome " << getName() << " not found in genome " 
+         << dest->getName();
       throw hal_exception(ss.str());
     }
 
@@ -203,30 +227,47 @@ void Genome::copyBottomSegments(Genome *dest) const
       throw hal_exception(ss.str());      
     }
 
-    hal_index_t inSegmentEnd = inSeq->getBottomSegmentArrayIndex() + inSeq->getNumBottomSegments();
-    cout << "DEBUG: inSegmentStart: " << inSeq->getBottomSegmentArrayIndex() << " inSegmentEnd: " << inSegmentEnd << " num bottom segments: " << inSeq->getNumBottomSegments() << endl;
-    for (; inBot->getArrayIndex() < inSegmentEnd; inBot->toRight(),
-           outBot->toRight())
+    hal_index_t shift = 
+       outSeq->getStartPosition() - inSeq->getStartPosition();
+    hal_index_t outSeqEnd = 
+       outSeq->getStartPosition() + (hal_index_t)outSeq->getSequenceLength();
+    hal_index_t inStart = inSeq->getBottomSegmentArrayIndex();
+    hal_index_t outStart = outSeq->getBottomSegmentArrayIndex();
+    hal_size_t n = inSeq->getNumBottomSegments();
+    for (hal_size_t done = 0; done < n; done += copyBlockSegments)
     {
-      hal_index_t outStartPosition = inBot->getStartPosition() - inSeq->getStartPosition() + outSeq->getStartPosition();
-
-      cout << "Decided on outStartPosition " << outStartPosition << " for seg index " << outBot->getArrayIndex() << " (src index " << inBot->getArrayIndex() << ")" << endl;
-
-      if (dest->getSequenceBySite(outStartPosition) != outSeq) {
-        stringstream ss;
-        ss << "When copying bottom segments from " << getName() << " to " << dest->getName() << ": expected destination sequence " << outSeq->getName() << " for segment # " << inBot->getArrayIndex() << " but got " << dest->getSequenceBySite(outStartPosition)->getName();
-        throw hal_exception(ss.str());
+      hal_size_t count = min(copyBlockSegments, n - done);
+      getBottomSegmentRecords(inStart + done, count, records, inChildren);
+      if (keepOutChildren == true)
+      {
+        dest->getBottomSegmentRecords(outStart + done, count, outRecords,
+                                      outChildren);
+      }
+      else
+      {
+        outChildren.resize(count * outNc);
       }
-      outBot->setCoordinates(outStartPosition, inBot->getLength());
-      for(hal_size_t inChild = 0; inChild < inNc; inChild++) {
-        hal_size_t outChild = inChildToOutChild[inChild];
-        if (outChild != outNc) {
-          outBot->setChildIndex(outChild, inBot->getChildIndex(inChild));
-          cout << "genome " << getName() << ": Set child index " << inChild << " to " << inBot->getChildIndex(inChild) << endl;
-          outBot->setChildReversed(outChild, inBot->getChildReversed(inChild));
+      for (size_t i = 0; i < count; ++i)
+      {
+        hal_index_t outStartPosition = records[i]._startPosition + shift;
+        if (outStartPosition < outSeq->getStartPosition() ||
+            outStartPosition >= outSeqEnd)
+        {
+          stringstream ss;
+          ss << "When copying bottom segments from " << getName() << " to " << dest->getName() << ": expected destination sequence " << outSeq->getName() << " for segment # " << inStart + done + i << " but its start " << outStartPosition << " is outside of it";
+          throw hal_exception(ss.str());
+        }
+        records[i]._startPosition = outStartPosition;
+        for (hal_size_t inChild = 0; inChild < inNc; inChild++)
+        {
+          hal_size_t outChild = inChildToOutChild[inChild];
+          if (outChild != outNc)
+          {
+            outChildren[i * outNc + outChild] = inChildren[i * inNc + inChild];
+          }
         }
       }
-      outBot->setTopParseIndex(inBot->getTopParseIndex());
+      dest->setBottomSegmentRecords(outStart + done, records, outChildren);
     }
   }
 }
@@ -234,14 +275,14 @@ void Genome::copyBottomSegments(Genome *dest) const
 
 void Genome::copySequence(Genome *dest) const
 {
-  DNAIteratorConstPtr inDna = getDNAIterator();
-  DNAIteratorPtr outDna = dest->getDNAIterator();
   hal_size_t n = getSequenceLength();
   assert(n == dest->getSequenceLength());
-  for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), 
-         outDna->toRight())
+  string buffer;
+  for (hal_size_t start = 0; start < n; start += copyBlockLength)
   {
-    outDna->setChar(inDna->getChar());
+    hal_size_t length = min(copyBlockLength, n - start);
+    getSubString(buffer, start, length);
+    dest->setSubString(buffer, start, length);
   }
 }
 
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include "hal.h"
+#include "halGenomeTree.h"
+
+using namespace std;
+using namespace hal;
+
+// index of the lowest set bit of a non-zero word
+static inline hal_size_t lowestBit(hal_size_t word)
+{
+  assert(word != 0);
+  return __builtin_ctzll(word);
+}
+
+// index of the highest set bit of a non-zero word
+static inline hal_size_t highestBit(hal_size_t word)
+{
+  assert(word != 0);
+  return 63 - __builtin_clzll(word);
+}
+
+GenomeSet::GenomeSet(hal_size_t numGenomes)
+{
+  resize(numGenomes);
+}
+
+void GenomeSet::resize(hal_size_t numGenomes)
+{
+  _numGenomes = numGenomes;
+  _bits.assign((numGenomes + 63) / 64, 0);
+}
+
+void GenomeSet::clear()
+{
+  _bits.assign(_bits.size(), 0);
+}
+
+bool GenomeSet::empty() const
+{
+  for (size_t i = 0; i < _bits.size(); ++i)
+  {
+    if (_bits[i] != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+hal_size_t GenomeSet::size() const
+{
+  hal_size_t count = 0;
+  for (size_t i = 0; i < _bits.size(); ++i)
+  {
+    count += __builtin_popcountll(_bits[i]);
+  }
+  return count;
+}
+
+hal_index_t GenomeSet::next(hal_index_t id) const
+{
+  hal_size_t start = (hal_size_t)(id + 1);
+  if (start >= _numGenomes)
+  {
+    return NULL_INDEX;
+  }
+  size_t word = start >> 6;
+  hal_size_t bits = _bits[word] & (~(hal_size_t)0 << (start & 63));
+  while (bits == 0)
+  {
+    if (++word == _bits.size())
+    {
+      return NULL_INDEX;
+    }
+    bits = _bits[word];
+  }
+  return (hal_index_t)(word * 64 + lowestBit(bits));
+}
+
+hal_index_t GenomeSet::last() const
+{
+  for (size_t word = _bits.size(); word > 0; --word)
+  {
+    if (_bits[word - 1] != 0)
+    {
+      return (hal_index_t)((word - 1) * 64 + highestBit(_bits[word - 1]));
+    }
+  }
+  return NULL_INDEX;
+}
+
+void GenomeSet::insertAll(const GenomeSet& other)
+{
+  assert(other._numGenomes == _numGenomes);
+  for (size_t i = 0; i < _bits.size(); ++i)
+  {
+    _bits[i] |= other._bits[i];
+  }
+}
+
+bool GenomeSet::operator==(const GenomeSet& other) const
+{
+  return _numGenomes == other._numGenomes && _bits == other._bits;
+}
+
+GenomeTree::GenomeTree(const Alignment* alignment)
+{
+  if (alignment->getNumGenomes() == 0)
+  {
+    return;
+  }
+
+  // number the genomes in preorder, so that each subtree is a contiguous
+  // range of ids.  children are pushed in reverse to be visited in order
+  vector<pair<string, hal_index_t> > stack;
+  stack.push_back(pair<string, hal_index_t>(alignment->getRootName(),
+                                            NULL_INDEX));
+  while (!stack.empty())
+  {
+    string name = stack.back().first;
+    hal_index_t parent = stack.back().second;
+    stack.pop_back();
+    hal_size_t id = _names.size();
+    if (_ids.insert(pair<string, hal_size_t>(name, id)).second == false)
+    {
+      throw hal_exception("Genome " + name + " appears twice in the tree");
+    }
+    _names.push_back(name);
+    _parents.push_back(parent);
+    _children.push_back(vector<hal_size_t>());
+    _depths.push_back(parent == NULL_INDEX ? 0 : _depths[parent] + 1);
+    if (parent != NULL_INDEX)
+    {
+      _children[parent].push_back(id);
+    }
+    vector<string> childNames = alignment->getChildNames(name);
+    for (size_t i = childNames.size(); i > 0; --i)
+    {
+      stack.push_back(pair<string, hal_index_t>(childNames[i - 1], id));
+    }
+  }
+
+  // a subtree ends where the next genome that isn't below it starts,
+  // so fill in the ends from the bottom up
+  _subTreeEnd.resize(_names.size());
+  for (size_t id = _names.size(); id > 0; --id)
+  {
+    const vector<hal_size_t>& children = _children[id - 1];
+    _subTreeEnd[id - 1] = children.empty() ? id : _subTreeEnd[children.back()];
+  }
+
+  buildLCATable();
+}
+
+void GenomeTree::buildLCATable()
+{
+  // Euler tour: each genome is listed when first visited and again after
+  // each of its children.  ids are in preorder so ancestors have smaller
+  // ids, and the smallest id between two visits is their LCA
+  hal_size_t numGenomes = _names.size();
+  _euler.clear();
+  _euler.reserve(2 * numGenomes - 1);
+  _eulerPos.assign(numGenomes, 0);
+  vector<pair<hal_size_t, hal_size_t> > stack;
+  stack.push_back(pair<hal_size_t, hal_size_t>(0, 0));
+  _eulerPos[0] = 0;
+  _euler.push_back(0);
+  while (!stack.empty())
+  {
+    hal_size_t id = stack.back().first;
+    hal_size_t& nextChild = stack.back().second;
+    if (nextChild < _children[id].size())
+    {
+      hal_size_t child = _children[id][nextChild++];
+      _eulerPos[child] = _euler.size();
+      _euler.push_back(child);
+      stack.push_back(pair<hal_size_t, hal_size_t>(child, 0));
+    }
+    else
+    {
+      stack.pop_back();
+      if (!stack.empty())
+      {
+        _euler.push_back(stack.back().first);
+      }
+    }
+  }
+
+  hal_size_t n = _euler.size();
+  _log2.assign(n + 1, 0);
+  for (hal_size_t i = 2; i <= n; ++i)
+  {
+    _log2[i] = _log2[i / 2] + 1;
+  }
+  _sparse.assign(_log2[n] + 1, vector<hal_size_t>());
+  _sparse[0] = _euler;
+  for (hal_size_t k = 1; k < _sparse.size(); ++k)
+  {
+    hal_size_t width = (hal_size_t)1 << k;
+    _sparse[k].resize(n - width + 1);
+    for (hal_size_t i = 0; i + width <= n; ++i)
+    {
+      _sparse[k][i] = min(_sparse[k - 1][i], _sparse[k - 1][i + width / 2]);
+    }
+  }
+}
+
+hal_index_t GenomeTree::getId(const string& name) const
+{
+  map<string, hal_size_t>::const_iterator i = _ids.find(name);
+  return i == _ids.end() ? NULL_INDEX : (hal_index_t)i->second;
+}
+
+const string& GenomeTree::getName(hal_size_t id) const
+{
+  assert(id < _names.size());
+  return _names[id];
+}
+
+hal_index_t GenomeTree::getParentId(hal_size_t id) const
+{
+  assert(id < _names.size());
+  return _parents[id];
+}
+
+hal_size_t GenomeTree::getNumChildren(hal_size_t id) const
+{
+  assert(id < _names.size());
+  return _children[id].size();
+}
+
+hal_size_t GenomeTree::getChildId(hal_size_t id, hal_size_t childIdx) const
+{
+  assert(id < _names.size() && childIdx < _children[id].size());
+  return _children[id][childIdx];
+}
+
+bool GenomeTree::isLeaf(hal_size_t id) const
+{
+  assert(id < _names.size());
+  return _children[id].empty();
+}
+
+hal_size_t GenomeTree::getDepth(hal_size_t id) const
+{
+  assert(id < _names.size());
+  return _depths[id];
+}
+
+bool GenomeTree::isOnPath(hal_size_t id, hal_size_t a, hal_size_t b) const
+{
+  return isAncestor(getLowestCommonAncestor(a, b), id) &&
+     (isAncestor(id, a) || isAncestor(id, b));
+}
+
+hal_index_t GenomeTree::getLowestCommonAncestor(const GenomeSet& genomes) const
+{
+  assert(genomes.getNumGenomes() == _names.size());
+  hal_index_t first = genomes.next(NULL_INDEX);
+  if (first == NULL_INDEX)
+  {
+    return NULL_INDEX;
+  }
+  return getLowestCommonAncestor(first, genomes.last());
+}
+
+void GenomeTree::getSpanningTree(const GenomeSet& genomes,
+                                 GenomeSet& outSet) const
+{
+  assert(outSet.getNumGenomes() == _names.size());
+  hal_index_t lca = getLowestCommonAncestor(genomes);
+  if (lca == NULL_INDEX)
+  {
+    return;
+  }
+  outSet.insert(lca);
+  for (hal_index_t id = genomes.next(NULL_INDEX); id != NULL_INDEX;
+       id = genomes.next(id))
+  {
+    // climb until we hit a path that has already been added
+    for (hal_index_t cur = id; !outSet.contains(cur); cur = _parents[cur])
+    {
+      outSet.insert(cur);
+    }
+  }
+}
+
+void GenomeTree::getSubTree(hal_size_t id, GenomeSet& outSet) const
+{
+  assert(outSet.getNumGenomes() == _names.size());
+  for (hal_size_t i = id; i < _subTreeEnd[id]; ++i)
+  {
+    outSet.insert(i);
+  }
+}
@@ -10,8 +10,119 @@
 using namespace std;
 using namespace hal;
 
+// positions are split into blocks of 1 << blockShift bits
+static const hal_index_t blockShift = 12;
+static const hal_size_t blockWords = ((hal_size_t)1 << blockShift) / 64;
+const hal_size_t PositionCache::blockSize = (hal_size_t)1 << blockShift;
+
+PositionCache::Type PositionCache::_defaultType = PositionCache::IntervalType;
+
+PositionCache::Block::Block() : _count(0), _bits(blockWords, 0)
+{
+}
+
+PositionCache::PositionCache() :
+  _type(_defaultType),
+  _setValid(true),
+  _size(0),
+  _prev(_set.begin()),
+  _lastBlockIdx(0),
+  _lastBlock(NULL)
+{
+}
+
+PositionCache::PositionCache(Type type) :
+  _type(type),
+  _setValid(true),
+  _size(0),
+  _prev(_set.begin()),
+  _lastBlockIdx(0),
+  _lastBlock(NULL)
+{
+}
+
+PositionCache::PositionCache(const PositionCache &positionCache) :
+  _type(positionCache._type),
+  _set(positionCache._set),
+  _setValid(positionCache._setValid),
+  _size(positionCache._size),
+  _prev(_set.begin()),
+  _blocks(positionCache._blocks),
+  _lastBlockIdx(0),
+  _lastBlock(NULL)
+{
+}
+
+// _prev and _lastBlock point into the containers of positionCache, so
+// they are reset rather than copied
+PositionCache& PositionCache::operator=(const PositionCache &positionCache)
+{
+  if (this != &positionCache)
+  {
+    _type = positionCache._type;
+    _set = positionCache._set;
+    _setValid = positionCache._setValid;
+    _size = positionCache._size;
+    _prev = _set.begin();
+    _blocks = positionCache._blocks;
+    _lastBlockIdx = 0;
+    _lastBlock = NULL;
+  }
+  return *this;
+}
+
+void PositionCache::setDefaultType(Type type)
+{
+  _defaultType = type;
+}
+
+PositionCache::Type PositionCache::getDefaultType()
+{
+  return _defaultType;
+}
+
+PositionCache::Type PositionCache::getTypeFromName(const string& name)
+{
+  if (name == "bitmap")
+  {
+    return BitmapType;
+  }
+  else if (name == "interval")
+  {
+    return IntervalType;
+  }
+  throw hal_exception("Unknown position cache type " + name + 
+                      ": expected bitmap or interval");
+}
 
 bool PositionCache::insert(hal_index_t pos)
+{
+  if (_type == BitmapType)
+  {
+    return insertBitmap(pos);
+  }
+  return insertInterval(pos);
+}
+
+bool PositionCache::find(hal_index_t pos) const
+{
+  if (_type == BitmapType)
+  {
+    return findBitmap(pos);
+  }
+  return findInterval(pos);
+}
+
+const PositionCache::IntervalSet* PositionCache::getIntervalSet() const
+{
+  if (_setValid == false)
+  {
+    updateIntervalSet();
+  }
+  return &_set;
+}
+
+bool PositionCache::insertInterval(hal_index_t pos)
 {
   IntervalSet::iterator i;
   if (_prev != _set.end() && _prev->first == pos - 1)
@@ -79,11 +190,11 @@ bool PositionCache::insert(hal_index_t pos)
   }
 
   ++_size;
-  assert(find(pos) == true);
+  assert(findInterval(pos) == true);
   return true;
 }
 
-bool PositionCache::find(hal_index_t pos) const
+bool PositionCache::findInterval(hal_index_t pos) const
 {
   IntervalSet::const_iterator i = _set.lower_bound(pos);
   if (i != _set.end() && i->second <= pos)
@@ -96,20 +207,176 @@ bool PositionCache::find(hal_index_t pos) const
 void PositionCache::clear()
 {
   _set.clear();
+  _setValid = true;
   _size = 0;
   _prev = _set.begin();
+  _blocks.clear();
+  _lastBlock = NULL;
+}
+
+// the block containing a position is usually the same as for the
+// previous call, so it is kept aside to skip the map lookup
+PositionCache::Block* PositionCache::getBlock(hal_index_t blockIdx) const
+{
+  if (_lastBlock != NULL && _lastBlockIdx == blockIdx)
+  {
+    return _lastBlock;
+  }
+  BlockMap::const_iterator i = _blocks.find(blockIdx);
+  if (i == _blocks.end())
+  {
+    return NULL;
+  }
+  _lastBlockIdx = blockIdx;
+  _lastBlock = const_cast<Block*>(&i->second);
+  return _lastBlock;
+}
+
+bool PositionCache::insertBitmap(hal_index_t pos)
+{
+  hal_index_t blockIdx = pos >> blockShift;
+  Block* block = getBlock(blockIdx);
+  if (block == NULL)
+  {
+    BlockMap::iterator i = _blocks.insert(
+      BlockMap::value_type(blockIdx, Block())).first;
+    _lastBlockIdx = blockIdx;
+    _lastBlock = &i->second;
+    block = _lastBlock;
+  }
+  if (block->_count == blockSize)
+  {
+    return false;
+  }
+  hal_size_t offset = (hal_size_t)pos & (blockSize - 1);
+  unsigned long long& word = block->_bits[offset / 64];
+  unsigned long long bit = 1ULL << (offset % 64);
+  if ((word & bit) != 0)
+  {
+    return false;
+  }
+  word |= bit;
+  if (++block->_count == blockSize)
+  {
+    vector<unsigned long long>().swap(block->_bits);
+  }
+  ++_size;
+  _setValid = false;
+  return true;
+}
+
+bool PositionCache::findBitmap(hal_index_t pos) const
+{
+  const Block* block = getBlock(pos >> blockShift);
+  if (block == NULL)
+  {
+    return false;
+  }
+  if (block->_count == blockSize)
+  {
+    return true;
+  }
+  hal_size_t offset = (hal_size_t)pos & (blockSize - 1);
+  return (block->_bits[offset / 64] & (1ULL << (offset % 64))) != 0;
+}
+
+// rebuild the intervals from the bitmap, merging runs across blocks
+void PositionCache::updateIntervalSet() const
+{
+  _set.clear();
+  hal_index_t first = 0;
+  hal_index_t last = -1;
+  bool inRun = false;
+  for (BlockMap::const_iterator i = _blocks.begin(); i != _blocks.end(); ++i)
+  {
+    hal_index_t blockStart = i->first << blockShift;
+    const Block& block = i->second;
+    for (hal_size_t w = 0; w < blockWords; ++w)
+    {
+      unsigned long long word = block._count == blockSize ? ~0ULL : 
+         block._bits[w];
+      hal_index_t wordStart = blockStart + (hal_index_t)(w * 64);
+      hal_index_t bitIdx = 0;
+      while (word != 0)
+      {
+        // skip the zeros then take the ones
+        hal_index_t zeros = __builtin_ctzll(word);
+        word >>= zeros;
+        bitIdx += zeros;
+        hal_index_t ones = word == ~0ULL ? 64 : __builtin_ctzll(~word);
+        word = ones == 64 ? 0 : word >> ones;
+        hal_index_t runFirst = wordStart + bitIdx;
+        bitIdx += ones;
+        if (inRun == true && runFirst == last + 1)
+        {
+          last = wordStart + bitIdx - 1;
+        }
+        else
+        {
+          if (inRun == true)
+          {
+            _set.insert(_set.end(), IntervalSet::value_type(last, first));
+          }
+          first = runFirst;
+          last = wordStart + bitIdx - 1;
+          inRun = true;
+        }
+      }
+    }
+  }
+  if (inRun == true)
+  {
+    _set.insert(_set.end(), IntervalSet::value_type(last, first));
+  }
+  _setValid = true;
 }
 
 // for debugging
 bool PositionCache::check() const
 {
   hal_size_t size = 0;
-  for (IntervalSet::const_iterator i = _set.begin(); i != _set.end(); ++i)
+  if (_type == BitmapType)
+  {
+    for (BlockMap::const_iterator i = _blocks.begin(); i != _blocks.end(); 
+         ++i)
+    {
+      const Block& block = i->second;
+      if (block._count == blockSize)
+      {
+        if (block._bits.empty() == false)
+        {
+          return false;
+        }
+      }
+      else
+      {
+        hal_size_t count = 0;
+        for (hal_size_t w = 0; w < block._bits.size(); ++w)
+        {
+          count += __builtin_popcountll(block._bits[w]);
+        }
+        if (block._bits.size() != blockWords || count != block._count || 
+            count == 0)
+        {
+          return false;
+        }
+      }
+      size += block._count;
+    }
+    if (size != _size)
+    {
+      return false;
+    }
+    size = 0;
+  }
+  const IntervalSet& intervalSet = *getIntervalSet();
+  for (IntervalSet::const_iterator i = intervalSet.begin(); 
+       i != intervalSet.end(); ++i)
   {
     size += (i->first + 1) - i->second;
     IntervalSet::const_iterator j = i;
     ++j;
-    if (j != _set.end())
+    if (j != intervalSet.end())
     { 
       // test overlap
       if (j->second <= i->first || i->second >= j->first)
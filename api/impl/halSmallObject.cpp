@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <new>
+#include <pthread.h>
+#include "halSmallObject.h"
+
+using namespace hal;
+
+/** sizes are rounded up to a multiple of this (also the alignment) */
+static const size_t SmallObjectGranularity = 16;
+/** larger blocks are passed on to the heap */
+static const size_t SmallObjectMaxSize = 512;
+static const size_t SmallObjectNumClasses =
+   SmallObjectMaxSize / SmallObjectGranularity;
+/** number of blocks fetched from the heap, or moved between a thread and
+ * the shared pool, at once */
+static const size_t SmallObjectSlabBlocks = 64;
+/** a thread keeps at most this many free blocks of a size class.  the
+ * rest go to the shared pool, so blocks freed by a thread that didn't
+ * allocate them don't pile up there */
+static const size_t SmallObjectMaxThreadBlocks = 4 * SmallObjectSlabBlocks;
+
+struct SmallObjectNode
+{
+   SmallObjectNode* _next;
+};
+
+struct SmallObjectList
+{
+   SmallObjectNode* _head;
+   size_t _length;
+};
+
+/** one set of lists per thread, so no locking is needed until a list
+ * runs dry or gets too long */
+static __thread SmallObjectList* smallObjectThreadLists = NULL;
+
+/** blocks given back by the threads, shared by all of them */
+static SmallObjectList smallObjectPool[SmallObjectNumClasses];
+static pthread_mutex_t smallObjectPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t smallObjectKey;
+static pthread_once_t smallObjectKeyOnce = PTHREAD_ONCE_INIT;
+
+/** move up to count blocks from the front of one list to another */
+static void moveSmallObjects(SmallObjectList& from, SmallObjectList& to,
+                             size_t count)
+{
+  for (size_t i = 0; i < count && from._head != NULL; ++i)
+  {
+    SmallObjectNode* node = from._head;
+    from._head = node->_next;
+    --from._length;
+    node->_next = to._head;
+    to._head = node;
+    ++to._length;
+  }
+}
+
+/** thread exit hook: hand all the thread's blocks to the shared pool */
+static void releaseSmallObjectLists(void* arg)
+{
+  SmallObjectList* lists = static_cast<SmallObjectList*>(arg);
+  pthread_mutex_lock(&smallObjectPoolMutex);
+  for (size_t i = 0; i < SmallObjectNumClasses; ++i)
+  {
+    moveSmallObjects(lists[i], smallObjectPool[i], lists[i]._length);
+  }
+  pthread_mutex_unlock(&smallObjectPoolMutex);
+  ::operator delete(lists);
+  // later destructors may still free blocks, which get a new set of lists
+  smallObjectThreadLists = NULL;
+}
+
+static void createSmallObjectKey()
+{
+  pthread_key_create(&smallObjectKey, releaseSmallObjectLists);
+}
+
+static SmallObjectList* getSmallObjectLists()
+{
+  if (smallObjectThreadLists == NULL)
+  {
+    pthread_once(&smallObjectKeyOnce, createSmallObjectKey);
+    smallObjectThreadLists = static_cast<SmallObjectList*>(
+      ::operator new(SmallObjectNumClasses * sizeof(SmallObjectList)));
+    for (size_t i = 0; i < SmallObjectNumClasses; ++i)
+    {
+      smallObjectThreadLists[i]._head = NULL;
+      smallObjectThreadLists[i]._length = 0;
+    }
+    pthread_setspecific(smallObjectKey, smallObjectThreadLists);
+  }
+  return smallObjectThreadLists;
+}
+
+static void refillSmallObjectList(SmallObjectList& list, size_t sizeClass)
+{
+  pthread_mutex_lock(&smallObjectPoolMutex);
+  moveSmallObjects(smallObjectPool[sizeClass], list, SmallObjectSlabBlocks);
+  pthread_mutex_unlock(&smallObjectPoolMutex);
+  if (list._head != NULL)
+  {
+    return;
+  }
+
+  size_t blockSize = (sizeClass + 1) * SmallObjectGranularity;
+  char* slab = static_cast<char*>(
+    ::operator new(blockSize * SmallObjectSlabBlocks));
+  for (size_t i = 0; i < SmallObjectSlabBlocks; ++i)
+  {
+    SmallObjectNode* node =
+       reinterpret_cast<SmallObjectNode*>(slab + i * blockSize);
+    node->_next = list._head;
+    list._head = node;
+  }
+  list._length = SmallObjectSlabBlocks;
+}
+
+void* hal::smallObjectAllocate(size_t size)
+{
+  if (size > SmallObjectMaxSize)
+  {
+    return ::operator new(size);
+  }
+  size_t sizeClass = size == 0 ? 0 : (size - 1) / SmallObjectGranularity;
+  SmallObjectList& list = getSmallObjectLists()[sizeClass];
+  if (list._head == NULL)
+  {
+    refillSmallObjectList(list, sizeClass);
+  }
+  SmallObjectNode* node = list._head;
+  list._head = node->_next;
+  --list._length;
+  return node;
+}
+
+void hal::smallObjectFree(void* p, size_t size)
+{
+  if (p == NULL)
+  {
+    return;
+  }
+  if (size > SmallObjectMaxSize)
+  {
+    ::operator delete(p);
+    return;
+  }
+  size_t sizeClass = size == 0 ? 0 : (size - 1) / SmallObjectGranularity;
+  SmallObjectList& list = getSmallObjectLists()[sizeClass];
+  SmallObjectNode* node = static_cast<SmallObjectNode*>(p);
+  node->_next = list._head;
+  list._head = node;
+  ++list._length;
+  if (list._length > SmallObjectMaxThreadBlocks)
+  {
+    pthread_mutex_lock(&smallObjectPoolMutex);
+    moveSmallObjects(list, smallObjectPool[sizeClass], SmallObjectSlabBlocks);
+    pthread_mutex_unlock(&smallObjectPoolMutex);
+  }
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <algorithm>
+#include "sequenceNameIndex.h"
+
+using namespace std;
+using namespace hal;
+
+namespace {
+// std::string compares characters as unsigned, like the strcmp used by
+// find(), so both agree on the order
+struct NameLess
+{
+   NameLess(const vector<string>& names) : _names(names) {}
+   bool operator()(hal_size_t a, hal_size_t b) const
+   {
+     int cmp = _names[a].compare(_names[b]);
+     return cmp < 0 || (cmp == 0 && a < b);
+   }
+   const vector<string>& _names;
+};
+}
+
+void SequenceNameIndex::layout(const vector<string>& names,
+                               vector<hal_size_t>& order)
+{
+  order.resize(names.size());
+  for (hal_size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), NameLess(names));
+}
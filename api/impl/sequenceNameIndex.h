@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _SEQUENCENAMEINDEX_H
+#define _SEQUENCENAMEINDEX_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "halDefs.h"
+
+namespace hal {
+
+/** Find a sequence by name without creating every sequence of a genome
+ * (or even reading all of its names).  The index is just the sequence
+ * indexes sorted by name, which is stored next to the names in the file
+ * and searched in place with about log2(numSequences) name reads.
+ * Duplicate names are ordered by index, so the first sequence with a
+ * given name is the one that is found. */
+class SequenceNameIndex
+{
+public:
+
+   /** Sort the indexes of the given sequence names by name */
+   static void layout(const std::vector<std::string>& names,
+                      std::vector<hal_size_t>& order);
+
+   /** Binary search of an order made by layout().  Reader must provide
+    *  hal_size_t getIndex(hal_size_t rank) const  (order[rank])
+    *  const char* getName(hal_size_t index) const  (names[index])
+    * Returns the index of the sequence or NULL_INDEX if not found */
+   template <class Reader>
+   static hal_index_t find(const Reader& reader, hal_size_t numSequences,
+                           const std::string& name);
+};
+
+template <class Reader>
+inline hal_index_t SequenceNameIndex::find(const Reader& reader,
+                                           hal_size_t numSequences,
+                                           const std::string& name)
+{
+  // lower bound of name in the sorted order
+  hal_size_t lo = 0;
+  hal_size_t hi = numSequences;
+  while (lo < hi)
+  {
+    hal_size_t mid = lo + (hi - lo) / 2;
+    if (strcmp(reader.getName(reader.getIndex(mid)), name.c_str()) < 0)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  if (lo < numSequences)
+  {
+    hal_size_t index = reader.getIndex(lo);
+    if (name == reader.getName(index))
+    {
+      return (hal_index_t)index;
+    }
+  }
+  return NULL_INDEX;
+}
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "sequenceSiteIndex.h"
+
+using namespace std;
+using namespace hal;
+
+// an in-order walk of the implicit tree (children of k are 2k and 2k+1)
+// visits the nodes in sorted order
+static hal_size_t layoutRecursive(const vector<hal_size_t>& starts,
+                                  vector<SequenceSiteRecord>& records,
+                                  hal_size_t i, hal_size_t k)
+{
+  if (k <= starts.size())
+  {
+    i = layoutRecursive(starts, records, i, 2 * k);
+    records[k]._start = starts[i];
+    records[k]._index = i;
+    ++i;
+    i = layoutRecursive(starts, records, i, 2 * k + 1);
+  }
+  return i;
+}
+
+void SequenceSiteIndex::layout(const vector<hal_size_t>& starts,
+                               vector<SequenceSiteRecord>& records)
+{
+  SequenceSiteRecord empty = {0, 0};
+  records.assign(starts.size() + 1, empty);
+  hal_size_t count = layoutRecursive(starts, records, 0, 1);
+  assert(count == starts.size());
+  (void)count;
+}
+
+void SequenceSiteIndex::build(const vector<hal_size_t>& starts)
+{
+  layout(starts, _storage);
+  _records = &_storage[0];
+  _numSequences = starts.size();
+  _loaded = true;
+}
+
+void SequenceSiteIndex::load(vector<SequenceSiteRecord>& records)
+{
+  assert(records.size() > 1);
+  _storage.swap(records);
+  records.clear();
+  _records = &_storage[0];
+  _numSequences = _storage.size() - 1;
+  _loaded = true;
+}
+
+void SequenceSiteIndex::attach(const SequenceSiteRecord* records,
+                               hal_size_t numSequences)
+{
+  _storage.clear();
+  _records = records;
+  _numSequences = numSequences;
+  _loaded = true;
+}
+
+void SequenceSiteIndex::clear()
+{
+  _storage.clear();
+  _records = NULL;
+  _numSequences = 0;
+  _loaded = false;
+}
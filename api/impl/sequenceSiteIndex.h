@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _SEQUENCESITEINDEX_H
+#define _SEQUENCESITEINDEX_H
+
+#include <cassert>
+#include <vector>
+#include <stdint.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/** Node of a SequenceSiteIndex: the start of a sequence in genome
+ * coordinates and the index of the sequence in the genome.  This is also
+ * the on-disk record of the index in mmap files. */
+struct SequenceSiteRecord
+{
+   uint64_t _start;
+   uint64_t _index;
+};
+
+/** Find the sequence that contains a genome position.  The sequence start
+ * positions are kept in a flat array in Eytzinger (breadth-first) order,
+ * so that a search walks down an implicit binary tree whose top levels
+ * share a few cache lines, instead of chasing the pointers of a
+ * std::map.  The array is either built in memory or read in place from
+ * a file (see layout()). */
+class SequenceSiteIndex
+{
+public:
+
+   SequenceSiteIndex() : _records(NULL), _numSequences(0), _loaded(false) {}
+
+   /** Lay out the start positions of the sequences (in genome order,
+    * so non-decreasing) in Eytzinger order.  records gets 
+    * starts.size() + 1 elements, the first of which is unused */
+   static void layout(const std::vector<hal_size_t>& starts,
+                      std::vector<SequenceSiteRecord>& records);
+
+   /** Build the index from the start positions of the sequences */
+   void build(const std::vector<hal_size_t>& starts);
+
+   /** Use records written by layout() that were read from a file.
+    * They are swapped into the index, leaving records empty */
+   void load(std::vector<SequenceSiteRecord>& records);
+
+   /** Use records written by layout() that are stored elsewhere (ie in
+    * a mapped file).  They must outlive the index */
+   void attach(const SequenceSiteRecord* records, hal_size_t numSequences);
+
+   void clear();
+
+   bool isLoaded() const { return _loaded; }
+
+   /** Get the index of the last sequence that starts at or before 
+    * position.  Zero-length sequences come before any sequence that
+    * shares their start, so this is the sequence containing position
+    * as long as position is less than the length of the genome. */
+   hal_size_t find(hal_size_t position) const;
+
+protected:
+
+   std::vector<SequenceSiteRecord> _storage;
+   const SequenceSiteRecord* _records;
+   hal_size_t _numSequences;
+   bool _loaded;
+};
+
+inline hal_size_t SequenceSiteIndex::find(hal_size_t position) const
+{
+  assert(_loaded && _numSequences > 0);
+  // descend to a leaf, going right whenever the node is <= position
+  hal_size_t k = 1;
+  while (k <= _numSequences)
+  {
+    k = 2 * k + (_records[k]._start <= position);
+  }
+  // strip the trailing right turns and the last left turn to get back
+  // to the first node greater than position (0 if there is none)
+  k >>= __builtin_ffsll(~k);
+  hal_size_t upper = k == 0 ? _numSequences : _records[k]._index;
+  assert(upper > 0);
+  return upper - 1;
+}
+
+}
+
+#endif
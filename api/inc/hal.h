@@ -60,7 +60,9 @@
 
 #include "halDefs.h"
 #include "halCommon.h"
+#include "halMutex.h"
 #include "halPositionCache.h"
+#include "halGenomeTree.h"
 #include "halAlignmentInstance.h"
 #include "halCLParserInstance.h"
 #include "halAlignment.h"
@@ -85,5 +87,6 @@
 #include "halGappedTopSegmentIterator.h"
 #include "halGappedBottomSegmentIterator.h"
 #include "halRearrangement.h"
+#include "halBigWigWriter.h"
 
 #endif
@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include "halDefs.h"
+#include "halGenomeTree.h"
 
 namespace hal {
 
@@ -124,6 +125,12 @@ public:
     * in the alignment */
    virtual hal_size_t getNumGenomes() const = 0;
 
+   /** Get the phylogeny with genomes numbered densely (see GenomeTree)
+    * for O(1) ancestor and LCA queries.  The pointer is owned by the 
+    * alignment and becomes invalid if the tree is modified or the
+    * alignment closed */
+   virtual const GenomeTree* getGenomeTree() const = 0;
+
    /** Get Alignment's metadata */
    virtual MetaData* getMetaData() = 0;
 
@@ -136,6 +143,16 @@ public:
    /** Get version used to create the file */
    virtual std::string getVersion() const = 0;
 
+   /** Check if the read-only (const) interface of this alignment can be
+    * used by several threads at once without any external locking.  When
+    * true, threads may simultaneously open genomes and create and use
+    * their own iterators (segment, DNA, column, mapped segments etc.)
+    * on the same alignment.  Individual iterators must still not be
+    * shared between threads, and genomes must not be closed (nor the
+    * alignment modified) while other threads are reading.  When false,
+    * all access must be serialized by the caller. */
+   virtual bool supportsConcurrentReads() const = 0;
+
 protected:
    friend class counted_ptr<Alignment>;
    friend class counted_ptr<const Alignment>;
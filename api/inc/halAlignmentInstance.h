@@ -56,9 +56,28 @@ hdf5AlignmentInstanceReadOnly(const H5::FileCreatPropList& fileCreateProps,
                               const H5::DSetCreatPropList& datasetCreateProps,
                               bool inMemory = false);
 
+/** Get read-only instance of a memory-mapped Alignment.  These files
+ * can only be created by converting an existing alignment with
+ * writeMMapAlignment (or hal2mmap) */
+AlignmentConstPtr mmapAlignmentInstanceReadOnly();
+
+/** Write an alignment to a flat file that is opened read-only by
+ * memory-mapping it (see mmapAlignmentInstanceReadOnly) instead of
+ * going through HDF5.  The OS page cache is then shared by every
+ * process reading the file.
+ * @param alignment Alignment to convert
+ * @param path Path of output file */
+void writeMMapAlignment(AlignmentConstPtr alignment, const std::string& path);
+
+/** Check if a file was written by writeMMapAlignment without opening
+ * it as an alignment.  Such files support concurrent readers (see
+ * Alignment::supportsConcurrentReads) 
+ * @param path Path of file to check */
+bool isMMapAlignmentFile(const std::string& path);
+
 /** Get an alignment instance from a file by automatically detecting which 
  * implementation to use.  (will currently (and probably forever more) 
- * just return an HDF5 instance since that's all that exists) 
+ * just return an HDF5 instance since memory-mapped files are read-only) 
  * @param path Path of file to open 
  * @param options Command line options information */
 AlignmentPtr openHalAlignment(const std::string& path,
@@ -66,8 +85,9 @@ AlignmentPtr openHalAlignment(const std::string& path,
 
 /** Get a read-only alignment instance from a file by 
  * automatically detecting which 
- * implementation to use.  (will currently (and probably forever more) 
- * just return an HDF5 instance since that's all that exists) 
+ * implementation to use.  Files written by writeMMapAlignment are
+ * recognized by their signature and memory-mapped, everything else
+ * is opened as HDF5
  * @param path Path of file to open 
  * @param options Command line options information */
 AlignmentConstPtr openHalAlignmentReadOnly(const std::string& path,
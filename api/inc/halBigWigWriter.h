@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBIGWIGWRITER_H
+#define _HALBIGWIGWRITER_H
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Write a bigWig file (the indexed binary wiggle format used by the UCSC
+ * Genome Browser) directly, as the values are computed, instead of
+ * writing a text wiggle and converting it with wigToBigWig.
+ *
+ * Sequences must be given one after the other with setSequence(), and
+ * the intervals of each sequence in increasing, non-overlapping order.
+ * Data sections are compressed and written as soon as they are full.
+ * Zoom level summaries are accumulated in temporary files, and the
+ * indexes, zoom levels and chromosome tree are written by close().
+ */
+class BigWigWriter
+{
+public:
+
+   static const hal_size_t DefaultItemsPerSlot = 1024;
+   static const hal_size_t DefaultBlockSize = 256;
+   static const hal_size_t MaxZoomLevels = 10;
+
+   BigWigWriter(const std::string& path,
+                hal_size_t itemsPerSlot = DefaultItemsPerSlot,
+                hal_size_t blockSize = DefaultBlockSize);
+
+   /** The file is incomplete (it has no header) unless close() was
+    * called */
+   ~BigWigWriter();
+
+   /** Start writing the values of a new sequence.  Each sequence can
+    * only be set once */
+   void setSequence(const std::string& name, hal_size_t length);
+
+   /** Set the values of the sequence-relative positions [start, end) of
+    * the current sequence.  Adjacent intervals with the same value are
+    * stored as one */
+   void addInterval(hal_index_t start, hal_index_t end, double value);
+
+   /** Write the indexes and the header.  Nothing can be added after */
+   void close();
+
+protected:
+
+   struct Item
+   {
+      uint32_t _start;
+      uint32_t _end;
+      float _value;
+   };
+
+   /** Range covered by a compressed block and where to find it */
+   struct Block
+   {
+      uint32_t _startChrom;
+      uint32_t _startBase;
+      uint32_t _endChrom;
+      uint32_t _endBase;
+      uint64_t _offset;
+      uint64_t _size;
+   };
+
+   struct Summary
+   {
+      uint32_t _chrom;
+      uint32_t _start;
+      uint32_t _end;
+      uint32_t _validCount;
+      double _min;
+      double _max;
+      double _sum;
+      double _sumSquares;
+   };
+
+   struct ZoomLevel
+   {
+      uint32_t _reduction;
+      FILE* _file;
+      uint64_t _fileSize;
+      uint64_t _numSummaries;
+      std::vector<Summary> _pending;
+      Summary _current;
+      bool _hasCurrent;
+      std::vector<Block> _blocks;
+   };
+
+   void flushItem();
+   void flushSection();
+   void initZoomLevels();
+   void addToZoomLevels(const Item& item);
+   void flushSummary(ZoomLevel& level);
+   void flushZoomBlock(ZoomLevel& level);
+   void compress(const std::vector<char>& buffer);
+   void writeRTree(const std::vector<Block>& blocks, uint64_t endOffset);
+   void writeChromTree();
+   void clear();
+
+protected:
+
+   std::string _path;
+   std::ofstream _file;
+   hal_size_t _itemsPerSlot;
+   hal_size_t _blockSize;
+   bool _closed;
+
+   std::vector<std::string> _chromNames;
+   std::vector<uint32_t> _chromLengths;
+   std::set<std::string> _chromNameSet;
+
+   bool _hasItem;
+   Item _item;
+   std::vector<Item> _section;
+   std::vector<Block> _sections;
+   uint64_t _numItems;
+
+   std::vector<ZoomLevel> _zoomLevels;
+   bool _zoomLevelsInitialized;
+
+   uint64_t _dataOffset;
+   uint64_t _uncompressBufSize;
+   std::vector<char> _compressBuffer;
+
+   uint64_t _totalBases;
+   double _totalMin;
+   double _totalMax;
+   double _totalSum;
+   double _totalSumSquares;
+
+private:
+   BigWigWriter(const BigWigWriter&);
+   BigWigWriter& operator=(const BigWigWriter&);
+};
+
+}
+#endif
@@ -10,6 +10,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 #include "sonLib.h"
 #include "hal.h"
 #include "halDefs.h"
@@ -30,20 +31,36 @@ class ColumnIterator
 public:
 
    /// @cond TEST
-   // we can compare genomes by pointers (because they are persistent
-   // and unique, though it's still hacky) but we can't do the same 
-   // for anything else, including sequences.  
+   // genomes are ordered by their GenomeTree ids rather than by their
+   // pointers, so that the order (of the rows of a MAF block, for
+   // example) doesn't depend on which alignment instance or thread
+   // created the genome objects
    struct SequenceLess { bool operator()(const hal::Sequence* s1,
                                          const hal::Sequence* s2) const {
-     return s1->getGenome() < s2->getGenome() || (
-       s1->getGenome() == s2->getGenome() && 
-       s1->getArrayIndex() < s2->getArrayIndex()); }
+     const hal::Genome* g1 = s1->getGenome();
+     const hal::Genome* g2 = s2->getGenome();
+     if (g1 != g2) {
+       return g1->getGenomeId() < g2->getGenomeId(); }
+     return s1->getArrayIndex() < s2->getArrayIndex(); }
    };
    /// @endcond
 
    typedef std::vector<hal::DNAIteratorConstPtr> DNASet;
    typedef std::map<const hal::Sequence*, DNASet*, SequenceLess> ColumnMap;
 
+   /** One base in a column.  _dna is the same iterator that would be
+    * stored in the column map, so it moves along with the column iterator.
+    * _position (forward genome coordinate) and _reversed are copied from
+    * it for convenience. */
+   struct ColumnEntry
+   {
+      const hal::Sequence* _sequence;
+      hal::DNAIteratorConstPtr _dna;
+      hal_index_t _position;
+      bool _reversed;
+   };
+   typedef std::vector<ColumnEntry> FlatColumn;
+
    /** Move column iterator one column to the right along reference
     * genoem sequence */
    virtual void toRight() const = 0;
@@ -78,9 +95,17 @@ public:
     * Must go back and review but it is concerning. */
    virtual hal_index_t getReferenceSequencePosition() const = 0;
 
-   /** Get a pointer to the column map */
+   /** Get a pointer to the column map.  The map is only maintained once
+    * this has been called for the first time, so clients that just use
+    * getFlatColumn() never pay for it. */
    virtual const ColumnMap* getColumnMap() const = 0;
 
+   /** Get the current column as a flat array, with the entries ordered
+    * by sequence exactly as in the column map (and in the same order
+    * as each sequence's DNASet).  The array is reused as the iterator
+    * moves, so no memory is allocated per column. */
+   virtual const FlatColumn* getFlatColumn() const = 0;
+
    /** Get the index of the column in the reference genome's array */
    virtual hal_index_t getArrayIndex() const = 0;
 
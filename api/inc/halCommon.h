@@ -18,6 +18,9 @@
 
 namespace hal {
 
+class SegmentedSequence;
+class GenomeSet;
+
 inline bool compatibleWithVersion(const std::string& version)
 {
   double myVersion, inVersion;
@@ -56,6 +59,7 @@ inline char reverseComplement(char c)
 
 /** Get the reversed complement of a string (in place) */
 void reverseComplement(std::string& s);
+void reverseComplement(char* s, size_t length);
 
 /** Reverse the gaps in the string (gap i -> len-1-i) which 
  * is not done above (does not reverse dna) */
@@ -121,6 +125,29 @@ inline bool isMasked(char c)
   return c == std::tolower(c);
 }
 
+/** Runs of positions, as (first, last) pairs */
+typedef std::vector<std::pair<hal_index_t, hal_index_t> > PositionRuns;
+
+/** Find the runs of soft-masked (lower case) bases in a DNA string,
+ * testing eight bases at a time.
+ * @param dna DNA string to scan
+ * @param length Length of dna
+ * @param offset Position of the first base of dna
+ * @param runs Runs found are appended to this.  A run beginning just
+ * after the last run already there is merged into it, so a long string
+ * can be scanned in pieces */
+void getMaskedRuns(const char* dna, size_t length, hal_index_t offset,
+                   PositionRuns& runs);
+
+/** Find the runs of soft-masked bases in a range of a genome or sequence
+ * (in its coordinates), reading its DNA a block at a time. 
+ * @param sequence Genome or sequence to scan
+ * @param start First position of range
+ * @param length Length of range
+ * @param runs Runs found are appended to this (see above) */
+void getMaskedRuns(const SegmentedSequence* sequence, hal_index_t start,
+                   hal_size_t length, PositionRuns& runs);
+
 /** test if 3rd codon position is 4-fold degenerate given first 2 positions */
 inline bool isFourfoldDegenerate(char c1, char c2)
 {
@@ -159,6 +186,12 @@ const Genome* getLowestCommonAncestor(const std::set<const Genome*>& inputSet);
 void getGenomesInSpanningTree(const std::set<const Genome*>& inputSet,
                               std::set<const Genome*>& outputSet);
 
+/* Same as above, but as the ids of the genomes in the alignment's
+ * GenomeTree (outputSet is resized to hold all of them).  This is what
+ * Segment::getMappedSegments() expects as the path */
+void getGenomesInSpanningTree(const std::set<const Genome*>& inputSet,
+                              GenomeSet& outputSet);
+
 /* Given a node (root), return it and all genomes (including internal nodes)
  * below it in the tree */
 void getGenomesInSubTree(const Genome* root, 
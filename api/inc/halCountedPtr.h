@@ -7,6 +7,8 @@
 #ifndef COUNTED_PTR_H
 #define COUNTED_PTR_H
 
+#include "halSmallObject.h"
+
 namespace hal {
 
 // trick to remove const from type (ie template typename).
@@ -29,6 +31,14 @@ struct hal_remove_const<const T> {
  * supported automatically.  Dynamic casting (base to derived) 
  * is achieved with the downCast method().
  *
+ * The reference count is updated atomically so that copies of the same
+ * pointer (ie an AlignmentConstPtr) can be made and released from
+ * different threads.  The pointed-to object itself is not protected.
+ *
+ * Counters come from the small object free lists (halSmallObject.h)
+ * rather than malloc, as do the iterators and segments derived from 
+ * SmallObject, so creating a new iterator pointer does not normally
+ * touch the heap at all.
  */
 template <class T> 
 class counted_ptr
@@ -93,7 +103,12 @@ private:
 template <class T> 
 inline counted_ptr<T>::counted_ptr(T* p) : _ptr(const_cast<Tnc*>(p)) 
 {
-  _counter = p ? new unsigned(1) : NULL;
+  _counter = NULL;
+  if (p)
+  {
+    _counter = static_cast<unsigned*>(smallObjectAllocate(sizeof(unsigned)));
+    *_counter = 1;
+  }
 }
 
 template <class T> 
@@ -179,7 +194,7 @@ inline void counted_ptr<T>::acquire(const counted_ptr<U>& c)
   {
     _ptr = const_cast<Tnc*>(static_cast<T*>(c._ptr));
     _counter = c._counter;
-    ++(*_counter);
+    __sync_add_and_fetch(_counter, 1);
   }
   else 
   {
@@ -198,7 +213,7 @@ inline void counted_ptr<T>::dynamicAcquire(const counted_ptr<U>& c)
   {
     _ptr = temp;
     _counter = c._counter;
-    ++(*_counter);
+    __sync_add_and_fetch(_counter, 1);
   }
   else 
   {
@@ -212,10 +227,10 @@ inline void counted_ptr<T>::release()
 {
   if (_counter) 
   {
-    if (--(*_counter) == 0) 
+    if (__sync_sub_and_fetch(_counter, 1) == 0) 
     {
       delete _ptr;
-      delete _counter;
+      smallObjectFree(_counter, sizeof(unsigned));
     }
     _ptr = 0;
     _counter = 0;
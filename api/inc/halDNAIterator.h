@@ -8,13 +8,14 @@
 #define _HALDNAITERATOR_H
 
 #include "halDefs.h"
+#include "halSmallObject.h"
 
 namespace hal {
 
 /** 
  * Interface for general dna iterator
  */
-class DNAIterator
+class DNAIterator : public SmallObject
 {
 public:
 
@@ -24,6 +24,35 @@ namespace hal {
 class Genome : public SegmentedSequence
 {
 public:   
+   /** Plain copy of the contents of one top segment, used to read and
+    * write runs of the top segment array in bulk */
+   struct TopSegmentRecord
+   {
+      hal_index_t _startPosition;
+      hal_size_t _length;
+      hal_index_t _parentIndex;
+      bool _parentReversed;
+      hal_index_t _bottomParseIndex;
+      hal_index_t _nextParalogyIndex;
+   };
+
+   /** Plain copy of the contents of one bottom segment (less its
+    * children, see ChildRecord), used to read and write runs of the bottom
+    * segment array in bulk */
+   struct BottomSegmentRecord
+   {
+      hal_index_t _startPosition;
+      hal_size_t _length;
+      hal_index_t _topParseIndex;
+   };
+
+   /** Link from a bottom segment to one of its children */
+   struct ChildRecord
+   {
+      hal_index_t _childIndex;
+      bool _childReversed;
+   };
+
    /** Get the name of the genome */
    virtual const std::string& getName() const = 0;
 
@@ -123,6 +152,44 @@ public:
     * AlignmentConstPtr object since its memory is already spoken for */
    virtual const Alignment* getAlignment() const = 0;
 
+   /** Get the id of the genome in the alignment's GenomeTree 
+    * (ie alignment->getGenomeTree()->getId(getName()), but cached) */
+   virtual hal_size_t getGenomeId() const = 0;
+
+   /** Read a run of the top segment array
+    * @param start Array index of the first segment
+    * @param count Number of segments to read
+    * @param records Set to the count segments */
+   virtual void getTopSegmentRecords(
+     hal_index_t start, hal_size_t count,
+     std::vector<TopSegmentRecord>& records) const = 0;
+
+   /** Overwrite a run of the top segment array
+    * @param start Array index of the first segment
+    * @param records New contents of records.size() segments */
+   virtual void setTopSegmentRecords(
+     hal_index_t start, const std::vector<TopSegmentRecord>& records) = 0;
+
+   /** Read a run of the bottom segment array
+    * @param start Array index of the first segment
+    * @param count Number of segments to read
+    * @param records Set to the count segments
+    * @param children Set to the getNumChildren() child links of each
+    * segment in turn (count * getNumChildren() in all) */
+   virtual void getBottomSegmentRecords(
+     hal_index_t start, hal_size_t count,
+     std::vector<BottomSegmentRecord>& records,
+     std::vector<ChildRecord>& children) const = 0;
+
+   /** Overwrite a run of the bottom segment array
+    * @param start Array index of the first segment
+    * @param records New contents of records.size() segments
+    * @param children Child links of each segment in turn
+    * (records.size() * getNumChildren() in all) */
+   virtual void setBottomSegmentRecords(
+     hal_index_t start, const std::vector<BottomSegmentRecord>& records,
+     const std::vector<ChildRecord>& children) = 0;
+
    /** Copy all information from this genome to another. The genomes
     * must be in different alignments. The genome must not have
     * uninitialized data.
@@ -172,6 +239,10 @@ public:
    /** Recompute parse info for this genome. */
    void fixParseInfo();
 
+   /** Number of segments read and written at a time (through the
+    * segment record methods) by the copy methods */
+   static const hal_size_t copyBlockSegments;
+
 protected:
 
    /** Destructor */
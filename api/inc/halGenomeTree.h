@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALGENOMETREE_H
+#define _HALGENOMETREE_H
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+#include "halDefs.h"
+
+namespace hal {
+
+class Alignment;
+
+/** Set of genomes stored as a bitset over the dense ids of a GenomeTree.
+ * Insertion and membership tests are O(1) and never touch genome names.
+ * Iterate over the members with
+ * for (hal_index_t i = set.next(NULL_INDEX); i != NULL_INDEX; i = set.next(i))
+ */
+class GenomeSet
+{
+public:
+   GenomeSet(hal_size_t numGenomes = 0);
+
+   /** Clear the set and make room for ids in [0, numGenomes) */
+   void resize(hal_size_t numGenomes);
+   void clear();
+   void insert(hal_size_t id);
+   void erase(hal_size_t id);
+   bool contains(hal_size_t id) const;
+   bool empty() const;
+   hal_size_t size() const;
+   hal_size_t getNumGenomes() const { return _numGenomes; }
+
+   /** Smallest member greater than id (pass NULL_INDEX for the first
+    * member), or NULL_INDEX if there is none */
+   hal_index_t next(hal_index_t id) const;
+
+   /** Largest member, or NULL_INDEX for an empty set */
+   hal_index_t last() const;
+
+   /** Add all members of other (which must have the same size) */
+   void insertAll(const GenomeSet& other);
+
+   bool operator==(const GenomeSet& other) const;
+   bool operator!=(const GenomeSet& other) const { return !(*this == other); }
+
+protected:
+
+   std::vector<hal_size_t> _bits;
+   hal_size_t _numGenomes;
+};
+
+/** Phylogeny of an alignment with the genomes numbered 0..n-1 in preorder
+ * (root is 0, children in getChildNames() order).  Since every subtree is
+ * then a contiguous range of ids, ancestor tests are O(1), and the lowest
+ * common ancestor of two genomes is the smallest id in the corresponding
+ * interval of an Euler tour, which a sparse table answers in O(1).
+ * The tree is a snapshot: it must be rebuilt if the phylogeny changes
+ * (Alignment::getGenomeTree() takes care of this). */
+class GenomeTree
+{
+public:
+   GenomeTree(const Alignment* alignment);
+
+   hal_size_t getNumGenomes() const { return _names.size(); }
+
+   /** Id of a genome name, or NULL_INDEX if it is not in the tree */
+   hal_index_t getId(const std::string& name) const;
+   const std::string& getName(hal_size_t id) const;
+
+   /** Parent id, or NULL_INDEX for the root */
+   hal_index_t getParentId(hal_size_t id) const;
+   hal_size_t getNumChildren(hal_size_t id) const;
+   hal_size_t getChildId(hal_size_t id, hal_size_t childIdx) const;
+   bool isLeaf(hal_size_t id) const;
+
+   /** Number of branches between the genome and the root */
+   hal_size_t getDepth(hal_size_t id) const;
+
+   /** Check if ancestor is id or lies above it in the tree */
+   bool isAncestor(hal_size_t ancestor, hal_size_t id) const;
+
+   /** Check if id lies on the path between genomes a and b */
+   bool isOnPath(hal_size_t id, hal_size_t a, hal_size_t b) const;
+
+   hal_size_t getLowestCommonAncestor(hal_size_t a, hal_size_t b) const;
+
+   /** Lowest common ancestor of all genomes in the set (that of the
+    * smallest and largest ids), or NULL_INDEX for an empty set */
+   hal_index_t getLowestCommonAncestor(const GenomeSet& genomes) const;
+
+   /** Add all genomes on the paths between the inputs and their lowest
+    * common ancestor (inputs and ancestor included) to outSet */
+   void getSpanningTree(const GenomeSet& genomes, GenomeSet& outSet) const;
+
+   /** Add the genome and all genomes below it to outSet */
+   void getSubTree(hal_size_t id, GenomeSet& outSet) const;
+
+protected:
+
+   void buildLCATable();
+
+protected:
+
+   std::vector<std::string> _names;
+   std::map<std::string, hal_size_t> _ids;
+   std::vector<hal_index_t> _parents;
+   std::vector<std::vector<hal_size_t> > _children;
+   std::vector<hal_size_t> _depths;
+   // one past the last id in each subtree
+   std::vector<hal_size_t> _subTreeEnd;
+   // Euler tour of the tree, and first position of each genome in it
+   std::vector<hal_size_t> _euler;
+   std::vector<hal_size_t> _eulerPos;
+   // _sparse[k][i] is the smallest id in _euler[i, i + 2^k)
+   std::vector<std::vector<hal_size_t> > _sparse;
+   std::vector<unsigned char> _log2;
+};
+
+inline bool GenomeSet::contains(hal_size_t id) const
+{
+  return id < _numGenomes && (_bits[id >> 6] >> (id & 63)) & 1;
+}
+
+inline void GenomeSet::insert(hal_size_t id)
+{
+  assert(id < _numGenomes);
+  _bits[id >> 6] |= (hal_size_t)1 << (id & 63);
+}
+
+inline void GenomeSet::erase(hal_size_t id)
+{
+  assert(id < _numGenomes);
+  _bits[id >> 6] &= ~((hal_size_t)1 << (id & 63));
+}
+
+inline bool GenomeTree::isAncestor(hal_size_t ancestor, hal_size_t id) const
+{
+  assert(ancestor < _names.size() && id < _names.size());
+  return ancestor <= id && id < _subTreeEnd[ancestor];
+}
+
+inline hal_size_t GenomeTree::getLowestCommonAncestor(hal_size_t a,
+                                                      hal_size_t b) const
+{
+  assert(a < _names.size() && b < _names.size());
+  hal_size_t i = _eulerPos[a];
+  hal_size_t j = _eulerPos[b];
+  if (i > j)
+  {
+    std::swap(i, j);
+  }
+  unsigned char k = _log2[j - i + 1];
+  return std::min(_sparse[k][i], _sparse[k][j + 1 - ((hal_size_t)1 << k)]);
+}
+
+}
+
+#endif
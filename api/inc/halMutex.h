@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMUTEX_H
+#define _HALMUTEX_H
+
+#include <pthread.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Minimal wrapper around a pthread mutex.  Used to protect the lazily
+ * filled caches of backends that support concurrent readers (see
+ * Alignment::supportsConcurrentReads()).
+ */
+class Mutex
+{
+public:
+   Mutex();
+   ~Mutex();
+   void lock();
+   void unlock();
+
+private:
+   Mutex(const Mutex&);
+   Mutex& operator=(const Mutex&);
+
+   pthread_mutex_t _mutex;
+};
+
+/** Holds a Mutex for the lifetime of the object */
+class ScopedLock
+{
+public:
+   ScopedLock(Mutex& mutex);
+   ~ScopedLock();
+
+private:
+   ScopedLock(const ScopedLock&);
+   ScopedLock& operator=(const ScopedLock&);
+
+   Mutex& _mutex;
+};
+
+inline Mutex::Mutex()
+{
+  if (pthread_mutex_init(&_mutex, NULL) != 0)
+  {
+    throw hal_exception("Error initializing mutex");
+  }
+}
+
+inline Mutex::~Mutex()
+{
+  pthread_mutex_destroy(&_mutex);
+}
+
+inline void Mutex::lock()
+{
+  pthread_mutex_lock(&_mutex);
+}
+
+inline void Mutex::unlock()
+{
+  pthread_mutex_unlock(&_mutex);
+}
+
+inline ScopedLock::ScopedLock(Mutex& mutex) : _mutex(mutex)
+{
+  _mutex.lock();
+}
+
+inline ScopedLock::~ScopedLock()
+{
+  _mutex.unlock();
+}
+
+}
+
+#endif
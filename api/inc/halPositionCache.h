@@ -18,29 +18,95 @@ namespace hal {
 /** keep track of bases by storing 2d intervals 
  * For example, if we want to flag positions in a genome
  * that we have visited, this structure will be fairly 
- * efficient provided positions are clustered into intervals */
+ * efficient provided positions are clustered into intervals.
+ *
+ * There are two ways of storing the positions, chosen when the cache
+ * is created (see setDefaultType()).  They behave the same and only
+ * differ in speed and memory.
+ *
+ * The const methods update mutable caches (the last block found and
+ * the interval set of a BitmapType cache), so a cache can't be read
+ * by several threads at once, even through a const reference */
 class PositionCache
 {
 public:
-   PositionCache() : _size(0), _prev(_set.begin()) {}
-   PositionCache(const PositionCache &positionCache) : _set(*positionCache.getIntervalSet()), _size(positionCache.size()), _prev(_set.begin()) {}
-  // sorted by last index, so each interval is (last, first)
+   /** How the positions are stored */
+   enum Type
+   {
+      /** Map of intervals.  Smallest when the positions make up a few
+       * long runs, but every new position costs a map lookup */
+      IntervalType,
+      /** Blocks of blockSize bits (found through a map, skipped when
+       * the position is in the same block as the last one).  Full blocks
+       * are stored as a count alone.  Much faster when positions are
+       * added in order, as by the column iterator */
+      BitmapType
+   };
+
+   // sorted by last index, so each interval is (last, first)
    typedef std::map<hal_index_t, hal_index_t> IntervalSet;
- 
+
+   PositionCache();
+   PositionCache(Type type);
+   PositionCache(const PositionCache &positionCache);
+   PositionCache& operator=(const PositionCache &positionCache);
+
    bool insert(hal_index_t pos);
+   /** Check if a position is in the cache.  For BitmapType caches
+    * this remembers the block it looked in */
    bool find(hal_index_t pos) const;
    void clear();
    bool check() const;
    hal_size_t size() const { return _size; }
-   hal_size_t numIntervals() const { return _set.size(); }
+   hal_size_t numIntervals() const { return getIntervalSet()->size(); }
+   Type getType() const { return _type; }
+
+   /** Get the positions as intervals.  For BitmapType caches they are
+    * computed on demand, and the set stays valid until the next
+    * change */
+   const IntervalSet* getIntervalSet() const;
 
-   const IntervalSet* getIntervalSet() const { return &_set; }
+   /** Set the type of the caches created from now on (the default type
+    * is IntervalType) */
+   static void setDefaultType(Type type);
+   static Type getDefaultType();
+   /** Get a type from its name ("bitmap" or "interval") */
+   static Type getTypeFromName(const std::string& name);
+
+   static const hal_size_t blockSize;
+
+protected:
+
+   /** Block of the bitmap */
+   struct Block
+   {
+      Block();
+      hal_size_t _count;
+      /** Empty once the block is full */
+      std::vector<unsigned long long> _bits;
+   };
+   typedef std::map<hal_index_t, Block> BlockMap;
+
+   bool insertInterval(hal_index_t pos);
+   bool findInterval(hal_index_t pos) const;
+   bool insertBitmap(hal_index_t pos);
+   bool findBitmap(hal_index_t pos) const;
+   Block* getBlock(hal_index_t blockIdx) const;
+   void updateIntervalSet() const;
 
 protected:
 
-   IntervalSet _set;
+   Type _type;
+   // for BitmapType, filled by getIntervalSet()
+   mutable IntervalSet _set;
+   mutable bool _setValid;
    hal_size_t _size;
    IntervalSet::iterator _prev;
+   BlockMap _blocks;
+   mutable hal_index_t _lastBlockIdx;
+   mutable Block* _lastBlock;
+
+   static Type _defaultType;
 };
 
 }
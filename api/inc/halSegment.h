@@ -11,14 +11,17 @@
 #include <vector>
 #include <set>
 #include "halDefs.h"
+#include "halSmallObject.h"
 
 namespace hal {
 
+class GenomeSet;
+
 /** 
  * Interface for a segment of DNA. Note that segments should
  * not be written to outside of creating new genomes.
  */
-class Segment
+class Segment : public SmallObject
 {
 public:
 
@@ -114,12 +117,12 @@ public:
     * *target* genome.
     * @param tgtGenome  Target genome to map to.  Can be the same as current.
     * @param genomesOnPath Intermediate genomes that must be visited
-    * on the way down from coalescenceLimit to tgt.  If this is
-    * specified as NULL, then the path will be computed automatically
-    * (using hal::getGenomesInSpanningTree(coalescenceLimit, tgtGenome)).
-    * Specifying this can avoid recomputing the path over and over again
-    * when, say, calling getMappedSegments repeatedly for the same 
-    * source and target. 
+    * on the way down from coalescenceLimit to tgt, as GenomeTree ids.
+    * If this is specified as NULL, then the path will be computed
+    * automatically (using hal::getGenomesInSpanningTree(coalescenceLimit,
+    * tgtGenome)).  Specifying this can avoid recomputing the path over
+    * and over again when, say, calling getMappedSegments repeatedly for
+    * the same source and target. 
     * @param doDupes  Specify whether paralogy edges are followed 
     * @param minLength Minimum length of segments to consider.  It is 
     * potentially much faster to filter using this parameter than
@@ -133,7 +136,7 @@ public:
    virtual hal_size_t getMappedSegments(
      std::set<MappedSegmentConstPtr>& outSegments,
      const Genome* tgtGenome,
-     const std::set<const Genome*>* genomesOnPath = NULL,
+     const GenomeSet* genomesOnPath = NULL,
      bool doDupes = true,
      hal_size_t minLength = 0,
      const Genome *coalescenceLimit = NULL,
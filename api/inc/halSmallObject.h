@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALSMALLOBJECT_H
+#define _HALSMALLOBJECT_H
+
+#include <cstddef>
+
+namespace hal {
+
+/** Allocate a small block from the calling thread's free list for
+ * its size class.  When the list is empty it is refilled from the pool
+ * shared by all threads, and failing that from the global heap (in slabs
+ * of many blocks).  Blocks larger than the largest size class come 
+ * straight from the heap. */
+void* smallObjectAllocate(size_t size);
+
+/** Return a block obtained from smallObjectAllocate() (with the same
+ * size) to the calling thread's free list.  It need not be the thread
+ * that allocated it.  Lists that get too long, and those of threads that
+ * exit, are handed to the shared pool.  Slab memory is kept for reuse 
+ * and never given back to the system. */
+void smallObjectFree(void* p, size_t size);
+
+/**
+ * Base class for the short-lived objects (iterators, segments) that
+ * the API creates and hands out by counted_ptr thousands of times per
+ * mapped base.  Routes their allocation through the small object free
+ * lists instead of malloc. Subclasses must have a virtual destructor
+ * so that delete passes the size of the most derived type.
+ */
+class SmallObject
+{
+public:
+   static void* operator new(size_t size);
+   static void operator delete(void* p, size_t size);
+};
+
+inline void* SmallObject::operator new(size_t size)
+{
+  return smallObjectAllocate(size);
+}
+
+inline void SmallObject::operator delete(void* p, size_t size)
+{
+  smallObjectFree(p, size);
+}
+
+}
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <iostream>
+#include <cstdlib>
+#include <deque>
+#include <sstream>
+#include "halCommon.h"
+#include "mmapAlignment.h"
+#include "mmapGenome.h"
+extern "C" {
+#include "sonLibTree.h"
+}
+
+using namespace hal;
+using namespace std;
+
+MMapAlignment::MMapAlignment() :
+  _metaData(NULL),
+  _tree(NULL),
+  _genomeTree(NULL)
+{
+
+}
+
+MMapAlignment::~MMapAlignment()
+{
+  close();
+}
+
+void MMapAlignment::createNew(const string& alignmentPath)
+{
+  throw hal_exception("Cannot create mmap HAL file " + alignmentPath +
+                      ".  Use hal2mmap to convert an existing alignment");
+}
+
+void MMapAlignment::open(const string& alignmentPath, bool readOnly)
+{
+  if (readOnly == false)
+  {
+    throw hal_exception("mmap HAL file " + alignmentPath +
+                        " can only be opened read-only");
+  }
+  close();
+  _file.open(alignmentPath);
+  if (!compatibleWithVersion(getVersion()))
+  {
+    stringstream ss;
+    ss << "HAL API v" << HAL_VERSION << " incompatible with format v"
+       << getVersion() << " HAL file.";
+    close();
+    throw hal_exception(ss.str());
+  }
+  const MMapFileHeader* header = _file.getHeader();
+  const MMapGenomeHeader* genomeHeaders =
+     _file.toPointer<MMapGenomeHeader>(header->_genomeTableOffset,
+                                       header->_numGenomes);
+  for (uint64_t i = 0; i < header->_numGenomes; ++i)
+  {
+    string name = _file.getString(genomeHeaders[i]._nameOffset);
+    _genomeHeaders.insert(pair<string, const MMapGenomeHeader*>(
+                            name, genomeHeaders + i));
+  }
+  _metaData = new MMapMetaData(&_file, header->_metaOffset);
+  loadTree();
+}
+
+void MMapAlignment::open(const string& alignmentPath) const
+{
+  const_cast<MMapAlignment*>(this)->open(alignmentPath, true);
+}
+
+void MMapAlignment::close()
+{
+  if (_tree != NULL)
+  {
+    stTree_destruct(_tree);
+    _tree = NULL;
+  }
+  _nodeMap.clear();
+  delete _genomeTree;
+  _genomeTree = NULL;
+  delete _metaData;
+  _metaData = NULL;
+  map<string, MMapGenome*>::iterator mapIt;
+  for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt)
+  {
+    delete mapIt->second;
+  }
+  _openGenomes.clear();
+  _genomeHeaders.clear();
+  _file.close();
+}
+
+// nothing is ever written, so same as above
+void MMapAlignment::close() const
+{
+  const_cast<MMapAlignment*>(this)->close();
+}
+
+void MMapAlignment::setOptionsFromParser(CLParserConstPtr parser) const
+{
+  // none of the (HDF5) options apply to memory-mapped files
+}
+
+Genome* MMapAlignment::addLeafGenome(const string& name,
+                                     const string& parentName,
+                                     double branchLength)
+{
+  throw hal_exception("Cannot add genome to read-only mmap HAL file");
+}
+
+Genome* MMapAlignment::addRootGenome(const string& name,
+                                     double branchLength)
+{
+  throw hal_exception("Cannot add genome to read-only mmap HAL file");
+}
+
+void MMapAlignment::removeGenome(const string& name)
+{
+  throw hal_exception("Cannot remove genome from read-only mmap HAL file");
+}
+
+Genome* MMapAlignment::insertGenome(const string& name,
+                                    const string& parentName,
+                                    const string& childName,
+                                    double upperBranchLength)
+{
+  throw hal_exception("Cannot insert genome into read-only mmap HAL file");
+}
+
+const Genome* MMapAlignment::openGenome(const string& name) const
+{
+  ScopedLock lock(_openGenomesMutex);
+  map<string, MMapGenome*>::iterator mapit = _openGenomes.find(name);
+  if (mapit != _openGenomes.end())
+  {
+    return mapit->second;
+  }
+  MMapGenome* genome = NULL;
+  map<string, const MMapGenomeHeader*>::const_iterator headerIt =
+     _genomeHeaders.find(name);
+  if (headerIt != _genomeHeaders.end())
+  {
+    genome = new MMapGenome(name, const_cast<MMapAlignment*>(this),
+                            &_file, headerIt->second);
+    _openGenomes.insert(pair<string, MMapGenome*>(name, genome));
+  }
+  return genome;
+}
+
+Genome* MMapAlignment::openGenome(const string& name)
+{
+  const MMapAlignment* constThis = this;
+  return const_cast<Genome*>(constThis->openGenome(name));
+}
+
+void MMapAlignment::closeGenome(const Genome* genome) const
+{
+  string name = genome->getName();
+  ScopedLock lock(_openGenomesMutex);
+  map<string, MMapGenome*>::iterator mapIt = _openGenomes.find(name);
+  if (mapIt == _openGenomes.end())
+  {
+    throw hal_exception("Attempt to close non-open genome.  "
+                        "Should not even be possible");
+  }
+  delete mapIt->second;
+  _openGenomes.erase(mapIt);
+
+  // reset the parent/child genome caches (which store genome pointers to
+  // the genome we're closing
+  if (name != getRootName())
+  {
+    mapIt = _openGenomes.find(getParentName(name));
+    if (mapIt != _openGenomes.end())
+    {
+      mapIt->second->resetBranchCaches();
+    }
+  }
+  vector<string> childNames = getChildNames(name);
+  for (size_t i = 0; i < childNames.size(); ++i)
+  {
+    mapIt = _openGenomes.find(childNames[i]);
+    if (mapIt != _openGenomes.end())
+    {
+      mapIt->second->resetBranchCaches();
+    }
+  }
+}
+
+string MMapAlignment::getRootName() const
+{
+  if (_tree == NULL)
+  {
+    throw hal_exception("Can't get root name of empty tree");
+  }
+  return stTree_getLabel(_tree);
+}
+
+string MMapAlignment::getParentName(const string& name) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(name);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node not found: ") + name);
+  }
+  stTree* node = findIt->second;
+  stTree* parent = stTree_getParent(node);
+  if (parent == NULL)
+  {
+    return "";
+  }
+  return stTree_getLabel(parent);
+}
+
+void MMapAlignment::updateBranchLength(const string& parentName,
+                                       const string& childName,
+                                       double length)
+{
+  throw hal_exception("Cannot update branch length in read-only mmap "
+                      "HAL file");
+}
+
+double MMapAlignment::getBranchLength(const string& parentName,
+                                      const string& childName) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(childName);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node ") + childName + " not found");
+  }
+  stTree* node = findIt->second;
+  stTree* parent = stTree_getParent(node);
+  if (parent == NULL || parentName != stTree_getLabel(parent))
+  {
+    throw hal_exception(string("edge ") + parentName + "--" + childName +
+                        " not found");
+  }
+  return stTree_getBranchLength(node);
+}
+
+vector<string> MMapAlignment::getChildNames(const string& name) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(name);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node ") + name + " not found");
+  }
+  stTree* node = findIt->second;
+  int32_t numChildren = stTree_getChildNumber(node);
+  vector<string> childNames(numChildren);
+  for (int32_t i = 0; i < numChildren; ++i)
+  {
+    childNames[i] = stTree_getLabel(stTree_getChild(node, i));
+  }
+  return childNames;
+}
+
+vector<string> MMapAlignment::getLeafNamesBelow(const string& name) const
+{
+  vector<string> leaves;
+  vector<string> children;
+  deque<string> bfQueue;
+  bfQueue.push_front(name);
+  while (bfQueue.empty() == false)
+  {
+    string& current = bfQueue.back();
+    children = getChildNames(current);
+    if (children.empty() == true && current != name)
+    {
+      leaves.push_back(current);
+    }
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+      bfQueue.push_front(children[i]);
+    }
+    bfQueue.pop_back();
+  }
+  return leaves;
+}
+
+hal_size_t MMapAlignment::getNumGenomes() const
+{
+  if (_tree == NULL)
+  {
+    assert(_nodeMap.empty() == true);
+    return 0;
+  }
+  else
+  {
+    return _nodeMap.size();
+  }
+}
+
+const GenomeTree* MMapAlignment::getGenomeTree() const
+{
+  return _genomeTree;
+}
+
+MetaData* MMapAlignment::getMetaData()
+{
+  return _metaData;
+}
+
+const MetaData* MMapAlignment::getMetaData() const
+{
+  return _metaData;
+}
+
+string MMapAlignment::getNewickTree() const
+{
+  if (_tree == NULL)
+  {
+    return "";
+  }
+  else
+  {
+    char* treeString = stTree_getNewickTreeString(_tree);
+    string returnString(treeString);
+    free(treeString);
+    return returnString;
+  }
+}
+
+string MMapAlignment::getVersion() const
+{
+  return _file.getString(_file.getHeader()->_versionOffset);
+}
+
+bool MMapAlignment::supportsConcurrentReads() const
+{
+  return true;
+}
+
+static void addNodeToMap(stTree* node, map<string, stTree*>& nodeMap)
+{
+  const char* label = stTree_getLabel(node);
+  assert(label != NULL);
+  string name(label);
+  assert(nodeMap.find(name) == nodeMap.end());
+  nodeMap.insert(pair<string, stTree*>(name, node));
+  int32_t numChildren = stTree_getChildNumber(node);
+  for (int32_t i = 0; i < numChildren; ++i)
+  {
+    addNodeToMap(stTree_getChild(node, i), nodeMap);
+  }
+}
+
+void MMapAlignment::loadTree()
+{
+  _nodeMap.clear();
+  string treeString = _file.getString(_file.getHeader()->_treeOffset);
+  if (_tree != NULL)
+  {
+    stTree_destruct(_tree);
+  }
+  if (treeString.empty() == true)
+  {
+    _tree = NULL;
+  }
+  else
+  {
+    _tree = stTree_parseNewickString(const_cast<char*>(treeString.c_str()));
+    addNodeToMap(_tree, _nodeMap);
+  }
+  delete _genomeTree;
+  _genomeTree = new GenomeTree(this);
+}
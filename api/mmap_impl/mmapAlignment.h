@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPALIGNMENT_H
+#define _MMAPALIGNMENT_H
+
+#include <map>
+#include "halAlignment.h"
+#include "halAlignmentInstance.h"
+#include "halMutex.h"
+#include "mmapFile.h"
+#include "mmapMetaData.h"
+
+typedef struct _stTree stTree;
+
+namespace hal {
+
+class MMapGenome;
+/**
+ * Read-only memory-mapped implementation of hal::Alignment.  Files
+ * are produced from existing alignments with writeMMapAlignment()
+ * (see hal2mmap).  Every method that would modify the alignment
+ * throws a hal_exception.
+ *
+ * Since the mapped file is never modified, the const interface is safe
+ * to use from several threads at once: the only shared state (the map
+ * of open genomes and each genome's parent/child pointers) is either
+ * locked or published atomically, and the GenomeTree is built when the
+ * file is opened.
+ */
+class MMapAlignment : public Alignment
+{
+public:
+
+   ~MMapAlignment();
+
+   void createNew(const std::string& alignmentPath);
+   void open(const std::string& alignmentPath,
+             bool readOnly);
+   void open(const std::string& alignmentPath) const;
+   void close();
+   void close() const;
+   void setOptionsFromParser(CLParserConstPtr parser) const;
+
+   Genome* addLeafGenome(const std::string& name,
+                           const std::string& parentName,
+                           double branchLength);
+
+   Genome* addRootGenome(const std::string& name,
+                           double branchLength);
+
+   void removeGenome(const std::string& name);
+
+   Genome* insertGenome(const std::string& name,
+                        const std::string& parentName,
+                        const std::string& childName,
+                        double upperBranchLength);
+
+   const Genome* openGenome(const std::string& name) const;
+
+   Genome* openGenome(const std::string& name);
+
+   void closeGenome(const Genome* genome) const;
+
+   std::string getRootName() const;
+
+   std::string getParentName(const std::string& name) const;
+
+   void updateBranchLength(const std::string& parentName,
+                           const std::string& childName,
+                           double length);
+
+   double getBranchLength(const std::string& parentName,
+                          const std::string& childName) const;
+
+   std::vector<std::string>
+   getChildNames(const std::string& name) const;
+
+   std::vector<std::string>
+   getLeafNamesBelow(const std::string& name) const;
+
+   hal_size_t getNumGenomes() const;
+
+   const GenomeTree* getGenomeTree() const;
+
+   MetaData* getMetaData();
+
+   const MetaData* getMetaData() const;
+
+   std::string getNewickTree() const;
+
+   std::string getVersion() const;
+
+   bool supportsConcurrentReads() const;
+
+protected:
+   // Nobody creates this class except through the interface.
+   friend AlignmentConstPtr mmapAlignmentInstanceReadOnly();
+
+   MMapAlignment();
+
+   void loadTree();
+
+protected:
+
+   MMapFile _file;
+   MMapMetaData* _metaData;
+   stTree* _tree;
+   mutable std::map<std::string, stTree*> _nodeMap;
+   GenomeTree* _genomeTree;
+   std::map<std::string, const MMapGenomeHeader*> _genomeHeaders;
+   mutable std::map<std::string, MMapGenome*> _openGenomes;
+   mutable Mutex _openGenomesMutex;
+};
+
+}
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <sstream>
+#include <iostream>
+#include "mmapBottomSegment.h"
+#include "mmapTopSegment.h"
+#include "mmapDNAIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapBottomSegment::MMapBottomSegment(MMapGenome* genome,
+                                     hal_index_t index) :
+  _index(index),
+  _genome(genome)
+{
+
+}
+
+MMapBottomSegment::~MMapBottomSegment()
+{
+  
+}
+
+void MMapBottomSegment::setChildIndex(hal_size_t i, hal_index_t childIndex)
+{
+  throw hal_exception("Cannot set bottom segment child in read-only "
+                      "mmap HAL file");
+}
+
+void MMapBottomSegment::setChildReversed(hal_size_t i, bool isReversed)
+{
+  throw hal_exception("Cannot set bottom segment child in read-only "
+                      "mmap HAL file");
+}
+
+void MMapBottomSegment::setTopParseIndex(hal_index_t parseIndex)
+{
+  throw hal_exception("Cannot set bottom segment parse index in read-only "
+                      "mmap HAL file");
+}
+
+hal_offset_t MMapBottomSegment::getTopParseOffset() const
+{
+  assert(_index >= 0);
+  hal_offset_t offset = 0;
+  hal_index_t topIndex = getTopParseIndex();
+  if (topIndex != NULL_INDEX)
+  {
+    MMapTopSegment ts(_genome, topIndex);
+    assert(ts.getStartPosition() <= getStartPosition());
+    assert((hal_index_t)(ts.getStartPosition() + ts.getLength()) 
+           >= getStartPosition());
+    offset = getStartPosition() - ts.getStartPosition();
+  }
+  return offset;
+}
+
+void MMapBottomSegment::setCoordinates(hal_index_t startPos, hal_size_t length)
+{
+  throw hal_exception("Cannot set bottom segment coordinates in read-only "
+                      "mmap HAL file");
+}
+
+void MMapBottomSegment::getString(string& outString) const
+{
+  MMapDNAIterator di(_genome, getStartPosition());
+  di.readString(outString, getLength()); 
+}
+
+bool MMapBottomSegment::isMissingData(double nThreshold) const
+{
+  if (nThreshold >= 1.0)
+  {
+    return false;
+  }  
+  MMapDNAIterator di(_genome, getStartPosition());
+  size_t length = getLength();
+  size_t maxNs = nThreshold * (double)length;
+  size_t Ns = 0;
+  char c;
+  for (size_t i = 0; i < length; ++i, di.toRight())
+  {
+    c = di.getChar();
+    if (c == 'N' || c == 'n')
+    {
+      ++Ns;
+    }
+    if (Ns > maxNs)
+    {
+      return true;
+    }
+    if ((length - i) < (maxNs - Ns))
+    {
+      break;
+    }
+  }
+  return false;
+}
+
+void MMapBottomSegment::print(std::ostream& os) const
+{
+  os << "MMap Bottom Segment";
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPDNAITERATOR_H
+#define _MMAPDNAITERATOR_H
+
+#include <cassert>
+#include "halDNAIterator.h"
+#include "halCommon.h"
+#include "hdf5DNA.h"
+#include "mmapGenome.h"
+
+namespace hal {
+
+/** 
+ * DNA iterator reading bases in place from the mapped file.  The 
+ * packing is the same as in HDF5 files so HDF5DNA does the decoding.
+ */
+class MMapDNAIterator : public DNAIterator
+{
+public:
+   
+   MMapDNAIterator(MMapGenome* genome, hal_index_t index);
+   ~MMapDNAIterator();
+   
+   char getChar() const;
+   void setChar(char c);
+   void toLeft() const;
+   void toRight() const;
+   void jumpTo(hal_size_t index) const;
+   void toReverse() const;
+   bool getReversed() const;
+   void setReversed(bool reversed) const;
+   const Genome* getGenome() const;
+   Genome* getGenome();
+   const Sequence* getSequence() const;
+   Sequence* getSequence();
+   hal_index_t getArrayIndex() const;
+
+   bool equals(DNAIteratorConstPtr& other) const;
+   bool leftOf(DNAIteratorConstPtr& other) const;
+
+   void readString(std::string& outString, hal_size_t length) const;
+
+   void writeString(const std::string& inString, hal_size_t length);
+
+   inline bool inRange() const;
+   
+
+protected:
+   mutable hal_index_t _index;
+   mutable MMapGenome* _genome;
+   mutable bool _reversed;
+};
+
+inline bool MMapDNAIterator::inRange() const
+{
+  return _index >= 0 && 
+     _index < (hal_index_t)_genome->_totalSequenceLength &&
+     _index / 2 < (hal_index_t)_genome->_dnaLength;
+}
+
+inline char MMapDNAIterator::getChar() const
+{
+  assert(inRange() == true);
+  char c = HDF5DNA::unpack(_index, _genome->_dna[_index / 2]);
+  if (_reversed)
+  {
+    c = reverseComplement(c);
+  }
+  return c;
+}
+
+inline void MMapDNAIterator::setChar(char c)
+{
+  throw hal_exception("Cannot set DNA in read-only mmap HAL file");
+}
+
+inline void MMapDNAIterator::toLeft() const
+{
+  _reversed ? ++_index : --_index;
+}
+
+inline void MMapDNAIterator::toRight() const
+{
+  _reversed ? --_index : ++_index;
+}
+
+inline void MMapDNAIterator::jumpTo(hal_size_t index) const
+{
+  _index = static_cast<hal_index_t>(index);
+}
+
+inline void MMapDNAIterator::toReverse() const
+{
+  _reversed = !_reversed;
+}
+
+inline bool MMapDNAIterator::getReversed() const
+{
+  return _reversed;
+}
+
+inline void MMapDNAIterator::setReversed(bool reversed) const
+{
+  _reversed = reversed;
+}
+
+inline const Genome* MMapDNAIterator::getGenome() const
+{
+  return _genome;
+}
+
+inline Genome* MMapDNAIterator::getGenome()
+{
+  return _genome;
+}
+
+inline const Sequence* MMapDNAIterator::getSequence() const
+{
+  return _genome->getSequenceBySite(_index);
+}
+
+inline Sequence* MMapDNAIterator::getSequence()
+{
+  return _genome->getSequenceBySite(_index);
+}
+
+inline hal_index_t MMapDNAIterator::getArrayIndex() const
+{
+  return _index;
+}
+
+inline bool MMapDNAIterator::equals(DNAIteratorConstPtr& other) const
+{
+  const MMapDNAIterator* mmapOther = reinterpret_cast<
+     const MMapDNAIterator*>(other.get());
+  assert(_genome == mmapOther->_genome);
+  return _index == mmapOther->_index;
+}
+
+inline bool MMapDNAIterator::leftOf(DNAIteratorConstPtr& other) const
+{
+  const MMapDNAIterator* mmapOther = reinterpret_cast<
+     const MMapDNAIterator*>(other.get());
+  assert(_genome == mmapOther->_genome);
+  return _index < mmapOther->_index;
+}
+
+inline void MMapDNAIterator::readString(std::string& outString,
+                                        hal_size_t length) const
+{
+  assert(length == 0 || inRange() == true);
+  outString.resize(length);
+  if (length == 0)
+  {
+    return;
+  }
+  hal_index_t first = _reversed ? _index - (hal_index_t)length + 1 : _index;
+  assert(first >= 0 && (first + length - 1) / 2 < _genome->_dnaLength);
+  HDF5DNA::unpack(_genome->_dna + first / 2, first, length, _reversed,
+                  &outString[0]);
+  _index += _reversed ? -(hal_index_t)length : (hal_index_t)length;
+}
+
+inline void MMapDNAIterator::writeString(const std::string& inString,
+                                         hal_size_t length)
+{
+  throw hal_exception("Cannot set DNA in read-only mmap HAL file");
+}
+
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "halCommon.h"
+#include "mmapFile.h"
+
+using namespace std;
+using namespace hal;
+
+const char MMapFile::Magic[8] = {'H', 'A', 'L', 'M', 'M', 'A', 'P', '\0'};
+const uint64_t MMapFile::ByteOrderMark = 0x0102030405060708ULL;
+const uint64_t MMapFile::FormatVersion = 3;
+
+MMapFile::MMapFile() :
+  _base(NULL),
+  _size(0)
+{
+
+}
+
+MMapFile::~MMapFile()
+{
+  close();
+}
+
+void MMapFile::open(const string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw hal_exception("Unable to open " + path + ": " + strerror(errno));
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0)
+  {
+    ::close(fd);
+    throw hal_exception("Unable to stat " + path + ": " + strerror(errno));
+  }
+  if ((size_t)fileStat.st_size < sizeof(MMapFileHeader))
+  {
+    ::close(fd);
+    throw hal_exception(path + " is too small to be a mmap HAL file");
+  }
+  void* base = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (base == MAP_FAILED)
+  {
+    throw hal_exception("Unable to mmap " + path + ": " + strerror(errno));
+  }
+  _base = static_cast<const char*>(base);
+  _size = fileStat.st_size;
+  _path = path;
+
+  const MMapFileHeader* header = getHeader();
+  if (memcmp(header->_magic, Magic, sizeof(Magic)) != 0)
+  {
+    close();
+    throw hal_exception(path + " is not a mmap HAL file");
+  }
+  if (header->_byteOrderMark != ByteOrderMark)
+  {
+    close();
+    throw hal_exception(path + " was written on a machine with a "
+                        "different byte order");
+  }
+  if (header->_formatVersion != FormatVersion || header->_fileSize != _size)
+  {
+    stringstream ss;
+    ss << path << " has mmap format v" << header->_formatVersion
+       << " and size " << header->_fileSize << " but expected v"
+       << FormatVersion << " and size " << _size;
+    close();
+    throw hal_exception(ss.str());
+  }
+}
+
+void MMapFile::close()
+{
+  if (_base != NULL)
+  {
+    munmap(const_cast<char*>(_base), _size);
+    _base = NULL;
+    _size = 0;
+  }
+}
+
+const char* MMapFile::getString(uint64_t offset) const
+{
+  checkRange(offset, 1);
+  const char* str = _base + offset;
+  if (memchr(str, '\0', _size - offset) == NULL)
+  {
+    throw hal_exception("Unterminated string in mmap HAL file " + _path);
+  }
+  return str;
+}
+
+bool MMapFile::isMMapFile(const string& path)
+{
+  char buffer[sizeof(Magic)];
+  ifstream inFile(path.c_str(), ios::in | ios::binary);
+  if (!inFile || !inFile.read(buffer, sizeof(buffer)))
+  {
+    return false;
+  }
+  return memcmp(buffer, Magic, sizeof(Magic)) == 0;
+}
+
+void MMapFile::checkRange(uint64_t offset, uint64_t size) const
+{
+  assert(_base != NULL);
+  if (offset > _size || size > _size - offset)
+  {
+    stringstream ss;
+    ss << "Offset " << offset << " (+" << size << ") out of range in mmap "
+       << "HAL file " << _path << " of size " << _size;
+    throw hal_exception(ss.str());
+  }
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPFILE_H
+#define _MMAPFILE_H
+
+#include <string>
+#include <stdint.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * On-disk layout of a memory-mapped HAL file.  Everything is stored
+ * in native byte order as fixed-width records aligned to 8 bytes so
+ * the arrays can be read in place through pointer arithmetic.  All
+ * offsets are absolute byte positions in the file.  Strings are
+ * null-terminated.
+ *
+ *  MMapFileHeader
+ *  MMapGenomeHeader x numGenomes
+ *  followed by the arrays and strings that the headers point to:
+ *    MMapSequenceRecord x (numSequences + 1)
+ *    SequenceSiteRecord x (numSequences + 1): the sequence starts in
+ *      Eytzinger order for getSequenceBySite (see sequenceSiteIndex.h)
+ *    uint64_t x numSequences: the sequence indexes sorted by name for
+ *      getSequence (see sequenceNameIndex.h)
+ *    MMapTopSegmentRecord x (numTopSegments + 1)
+ *    (MMapBottomSegmentRecord + MMapBottomChildRecord x numChildren) x
+ *      (numBottomSegments + 1)
+ *    packed DNA (two bases per byte, same encoding as HDF5DNA)
+ *    metadata (uint64_t count followed by MMapMetaDataRecord x count)
+ *    strings (names, tree, version and metadata keys and values)
+ *
+ * As in the HDF5 arrays, each record array has an extra sentinel record
+ * at the end whose start coordinate (and segment indexes for sequences)
+ * are used to compute lengths.
+ */
+struct MMapFileHeader
+{
+   char _magic[8];
+   uint64_t _byteOrderMark;
+   uint64_t _formatVersion;
+   uint64_t _fileSize;
+   uint64_t _numGenomes;
+   uint64_t _genomeTableOffset;
+   uint64_t _treeOffset;
+   uint64_t _versionOffset;
+   uint64_t _metaOffset;
+};
+
+struct MMapGenomeHeader
+{
+   uint64_t _nameOffset;
+   uint64_t _metaOffset;
+   uint64_t _sequenceLength;
+   uint64_t _numSequences;
+   uint64_t _numTopSegments;
+   uint64_t _numBottomSegments;
+   uint64_t _numChildren;
+   uint64_t _sequenceOffset;
+   uint64_t _topOffset;
+   uint64_t _bottomOffset;
+   uint64_t _dnaOffset;
+   uint64_t _dnaLength;
+   uint64_t _siteIndexOffset;
+   uint64_t _nameIndexOffset;
+};
+
+struct MMapSequenceRecord
+{
+   uint64_t _start;
+   uint64_t _topSegmentArrayIndex;
+   uint64_t _bottomSegmentArrayIndex;
+   uint64_t _nameOffset;
+};
+
+struct MMapTopSegmentRecord
+{
+   int64_t _start;
+   int64_t _bottomParseIndex;
+   int64_t _nextParalogyIndex;
+   int64_t _parentIndex;
+   int64_t _parentReversed;
+};
+
+struct MMapBottomSegmentRecord
+{
+   int64_t _start;
+   int64_t _topParseIndex;
+};
+
+struct MMapBottomChildRecord
+{
+   int64_t _childIndex;
+   int64_t _childReversed;
+};
+
+struct MMapMetaDataRecord
+{
+   uint64_t _keyOffset;
+   uint64_t _valueOffset;
+};
+
+/**
+ * Read-only memory mapping of an entire MMap HAL file.  The mapping
+ * is shared, so the OS page cache backs every process that opens the
+ * same file.
+ */
+class MMapFile
+{
+public:
+
+   MMapFile();
+   ~MMapFile();
+
+   /** Map a file into memory, checking its signature and version.
+    * @param path Path of the file to map */
+   void open(const std::string& path);
+
+   /** Unmap the file (if open) */
+   void close();
+
+   /** Check if a file is mapped */
+   bool isOpen() const;
+
+   /** Get the file header (file must be open) */
+   const MMapFileHeader* getHeader() const;
+
+   /** Get a pointer to an offset in the file, checking that count
+    * objects of type T fit in the mapping */
+   template <typename T>
+   const T* toPointer(uint64_t offset, uint64_t count = 1) const;
+
+   /** Get a null-terminated string stored at an offset in the file */
+   const char* getString(uint64_t offset) const;
+
+   /** Check if the file at the given path begins with the MMap
+    * signature.  Returns false for missing or unreadable files */
+   static bool isMMapFile(const std::string& path);
+
+   static const char Magic[8];
+   static const uint64_t ByteOrderMark;
+   static const uint64_t FormatVersion;
+
+protected:
+
+   void checkRange(uint64_t offset, uint64_t size) const;
+
+   const char* _base;
+   size_t _size;
+   std::string _path;
+};
+
+inline bool MMapFile::isOpen() const
+{
+  return _base != NULL;
+}
+
+inline const MMapFileHeader* MMapFile::getHeader() const
+{
+  return reinterpret_cast<const MMapFileHeader*>(_base);
+}
+
+template <typename T>
+inline const T* MMapFile::toPointer(uint64_t offset, uint64_t count) const
+{
+  checkRange(offset, count * sizeof(T));
+  return reinterpret_cast<const T*>(_base + offset);
+}
+
+}
+#endif
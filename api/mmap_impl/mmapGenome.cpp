@@ -0,0 +1,536 @@
+/* Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include "mmapGenome.h"
+#include "mmapAlignment.h"
+#include "mmapTopSegment.h"
+#include "mmapBottomSegment.h"
+#include "mmapSequence.h"
+#include "mmapSequenceIterator.h"
+#include "mmapDNAIterator.h"
+#include "defaultTopSegmentIterator.h"
+#include "defaultBottomSegmentIterator.h"
+#include "defaultColumnIterator.h"
+#include "defaultRearrangement.h"
+#include "defaultGappedTopSegmentIterator.h"
+#include "defaultGappedBottomSegmentIterator.h"
+
+using namespace hal;
+using namespace std;
+
+MMapGenome::MMapGenome(const string& name,
+                       MMapAlignment* alignment,
+                       const MMapFile* file,
+                       const MMapGenomeHeader* header) :
+  _alignment(alignment),
+  _file(file),
+  _name(name),
+  _genomeId(alignment->getGenomeTree()->getId(name)),
+  _totalSequenceLength(header->_sequenceLength),
+  _numSequences(header->_numSequences),
+  _numTopSegments(header->_numTopSegments),
+  _numBottomSegments(header->_numBottomSegments),
+  _numChildren(header->_numChildren),
+  _bottomRecordSize(sizeof(MMapBottomSegmentRecord) +
+                    header->_numChildren * sizeof(MMapBottomChildRecord)),
+  _dnaLength(header->_dnaLength),
+  _parentCache(NULL),
+  _childCache(header->_numChildren, NULL),
+  _sequenceCache(header->_numSequences, NULL),
+  _siteHint(0)
+{
+  assert(!name.empty());
+  assert(alignment != NULL && file != NULL);
+
+  // toPointer checks that every array lies inside the file so that
+  // the accessors can do unchecked pointer arithmetic from here on
+  _sequenceRecords = _file->toPointer<MMapSequenceRecord>(
+    header->_sequenceOffset, _numSequences + 1);
+  _siteIndex.attach(_file->toPointer<SequenceSiteRecord>(
+                      header->_siteIndexOffset, _numSequences + 1),
+                    _numSequences);
+  _nameIndex = _file->toPointer<hal_size_t>(header->_nameIndexOffset,
+                                            _numSequences);
+  _topRecords = _file->toPointer<MMapTopSegmentRecord>(
+    header->_topOffset, _numTopSegments + 1);
+  _bottomRecords = _file->toPointer<char>(
+    header->_bottomOffset, (_numBottomSegments + 1) * _bottomRecordSize);
+  _dna = _file->toPointer<unsigned char>(header->_dnaOffset, _dnaLength);
+  _metaData = new MMapMetaData(_file, header->_metaOffset);
+}
+
+MMapGenome::~MMapGenome()
+{
+  delete _metaData;
+  for (size_t i = 0; i < _sequenceCache.size(); ++i)
+  {
+    delete _sequenceCache[i];
+  }
+}
+
+void MMapGenome::setDimensions(
+  const vector<Sequence::Info>& sequenceDimensions,
+  bool storeDNAArrays)
+{
+  throw hal_exception("Cannot set dimensions of genome " + _name +
+                      " in read-only mmap HAL file");
+}
+
+void MMapGenome::updateTopDimensions(
+  const vector<Sequence::UpdateInfo>& topDimensions)
+{
+  throw hal_exception("Cannot set dimensions of genome " + _name +
+                      " in read-only mmap HAL file");
+}
+
+void MMapGenome::updateBottomDimensions(
+  const vector<Sequence::UpdateInfo>& bottomDimensions)
+{
+  throw hal_exception("Cannot set dimensions of genome " + _name +
+                      " in read-only mmap HAL file");
+}
+
+hal_size_t MMapGenome::getNumSequences() const
+{
+  return _numSequences;
+}
+
+namespace {
+// reads the names straight out of the mapped file
+struct MMapNameReader
+{
+   MMapNameReader(const MMapFile* file, const MMapSequenceRecord* records,
+                  const hal_size_t* nameIndex) :
+     _file(file), _records(records), _nameIndex(nameIndex) {}
+   hal_size_t getIndex(hal_size_t rank) const
+   {
+     return _nameIndex[rank];
+   }
+   const char* getName(hal_size_t index) const
+   {
+     return _file->getString(_records[index]._nameOffset);
+   }
+   const MMapFile* _file;
+   const MMapSequenceRecord* _records;
+   const hal_size_t* _nameIndex;
+};
+}
+
+Sequence* MMapGenome::getSequence(const string& name)
+{
+  const MMapGenome* constThis = this;
+  return const_cast<Sequence*>(constThis->getSequence(name));
+}
+
+const Sequence* MMapGenome::getSequence(const string& name) const
+{
+  MMapNameReader reader(_file, _sequenceRecords, _nameIndex);
+  hal_index_t index = SequenceNameIndex::find(reader, _numSequences, name);
+  return index == NULL_INDEX ? NULL : getSequenceByIndex(index);
+}
+
+Sequence* MMapGenome::getSequenceBySite(hal_size_t position)
+{
+  const MMapGenome* constThis = this;
+  return const_cast<Sequence*>(constThis->getSequenceBySite(position));
+}
+
+const Sequence* MMapGenome::getSequenceBySite(hal_size_t position) const
+{
+  if (position >= _totalSequenceLength || _numSequences == 0)
+  {
+    return NULL;
+  }
+  // consecutive lookups (ie. from iterators) usually land in the same
+  // sequence.  a zero-length hint never matches
+  hal_size_t hint = __atomic_load_n(&_siteHint, __ATOMIC_RELAXED);
+  const MMapSequenceRecord* record = _sequenceRecords + hint;
+  if (position < record->_start || position >= (record + 1)->_start)
+  {
+    hint = _siteIndex.find(position);
+    __atomic_store_n(&_siteHint, hint, __ATOMIC_RELAXED);
+  }
+  assert(position >= _sequenceRecords[hint]._start &&
+         position < _sequenceRecords[hint + 1]._start);
+  return getSequenceByIndex(hint);
+}
+
+SequenceIteratorPtr MMapGenome::getSequenceIterator(
+  hal_index_t position)
+{
+  assert(position <= (hal_index_t)_numSequences);
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(this, position);
+  return SequenceIteratorPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapGenome::getSequenceIterator(
+  hal_index_t position) const
+{
+  assert(position <= (hal_index_t)_numSequences);
+  // genome effectively gets re-consted when returned in the
+  // const iterator.  just save doubling up code.
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(
+    const_cast<MMapGenome*>(this), position);
+  return SequenceIteratorConstPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapGenome::getSequenceEndIterator() const
+{
+  return getSequenceIterator(getNumSequences());
+}
+
+MetaData* MMapGenome::getMetaData()
+{
+  return _metaData;
+}
+
+const MetaData* MMapGenome::getMetaData() const
+{
+  return _metaData;
+}
+
+// openGenome() always returns the same pointer for a given name, so
+// threads racing to fill the branch caches all store the same value.
+Genome* MMapGenome::getParent()
+{
+  Genome* parent = _parentCache;
+  if (parent == NULL)
+  {
+    string parName = _alignment->getParentName(_name);
+    if (parName.empty() == false)
+    {
+      parent = _alignment->openGenome(parName);
+      __sync_bool_compare_and_swap(&_parentCache, (Genome*)NULL, parent);
+    }
+  }
+  return parent;
+}
+
+const Genome* MMapGenome::getParent() const
+{
+  return const_cast<MMapGenome*>(this)->getParent();
+}
+
+Genome* MMapGenome::getChild(hal_size_t childIdx)
+{
+  assert(childIdx < _numChildren);
+  Genome* child = _childCache[childIdx];
+  if (child == NULL)
+  {
+    vector<string> childNames = _alignment->getChildNames(_name);
+    assert(childNames.size() > childIdx);
+    child = _alignment->openGenome(childNames.at(childIdx));
+    __sync_bool_compare_and_swap(&_childCache[childIdx], (Genome*)NULL,
+                                 child);
+  }
+  return child;
+}
+
+const Genome* MMapGenome::getChild(hal_size_t childIdx) const
+{
+  return const_cast<MMapGenome*>(this)->getChild(childIdx);
+}
+
+hal_size_t MMapGenome::getNumChildren() const
+{
+  return _numChildren;
+}
+
+hal_index_t MMapGenome::getChildIndex(const Genome* child) const
+{
+  string childName = child->getName();
+  vector<string> childNames = _alignment->getChildNames(_name);
+  for (hal_size_t i = 0; i < childNames.size(); ++i)
+  {
+    if (childNames[i] == childName)
+    {
+      return i;
+    }
+  }
+  return NULL_INDEX;
+}
+
+bool MMapGenome::containsDNAArray() const
+{
+  return _dnaLength > 0;
+}
+
+const Alignment* MMapGenome::getAlignment() const
+{
+  return _alignment;
+}
+
+hal_size_t MMapGenome::getGenomeId() const
+{
+  return _genomeId;
+}
+
+void MMapGenome::getTopSegmentRecords(hal_index_t start, hal_size_t count,
+                                      vector<TopSegmentRecord>& records) const
+{
+  if (start < 0 || start + count > _numTopSegments)
+  {
+    throw hal_exception("Trying to read top segments out of range in " +
+                        _name);
+  }
+  records.resize(count);
+  for (hal_size_t i = 0; i < count; ++i)
+  {
+    const MMapTopSegmentRecord* mapRecord = getTopRecord(start + i);
+    TopSegmentRecord& record = records[i];
+    record._startPosition = mapRecord->_start;
+    record._length = (mapRecord + 1)->_start - mapRecord->_start;
+    record._parentIndex = mapRecord->_parentIndex;
+    record._parentReversed = mapRecord->_parentReversed != 0;
+    record._bottomParseIndex = mapRecord->_bottomParseIndex;
+    record._nextParalogyIndex = mapRecord->_nextParalogyIndex;
+  }
+}
+
+void MMapGenome::setTopSegmentRecords(hal_index_t start,
+                                      const vector<TopSegmentRecord>& records)
+{
+  throw hal_exception("Cannot set segments in read-only mmap HAL file");
+}
+
+void MMapGenome::getBottomSegmentRecords(hal_index_t start, hal_size_t count,
+                                         vector<BottomSegmentRecord>& records,
+                                         vector<ChildRecord>& children) const
+{
+  if (start < 0 || start + count > _numBottomSegments)
+  {
+    throw hal_exception("Trying to read bottom segments out of range in " +
+                        _name);
+  }
+  records.resize(count);
+  children.resize(count * _numChildren);
+  for (hal_size_t i = 0; i < count; ++i)
+  {
+    const MMapBottomSegmentRecord* mapRecord = getBottomRecord(start + i);
+    BottomSegmentRecord& record = records[i];
+    record._startPosition = mapRecord->_start;
+    record._length = getBottomRecord(start + i + 1)->_start - mapRecord->_start;
+    record._topParseIndex = mapRecord->_topParseIndex;
+    for (hal_size_t child = 0; child < _numChildren; ++child)
+    {
+      const MMapBottomChildRecord* mapChild = 
+         getBottomChildRecord(start + i, child);
+      ChildRecord& childRecord = children[i * _numChildren + child];
+      childRecord._childIndex = mapChild->_childIndex;
+      childRecord._childReversed = mapChild->_childReversed != 0;
+    }
+  }
+}
+
+void MMapGenome::setBottomSegmentRecords(
+  hal_index_t start, const vector<BottomSegmentRecord>& records,
+  const vector<ChildRecord>& children)
+{
+  throw hal_exception("Cannot set segments in read-only mmap HAL file");
+}
+
+// SEGMENTED SEQUENCE INTERFACE
+
+const string& MMapGenome::getName() const
+{
+  return _name;
+}
+
+hal_size_t MMapGenome::getSequenceLength() const
+{
+  return _totalSequenceLength;
+}
+
+hal_size_t MMapGenome::getNumTopSegments() const
+{
+  return _numTopSegments;
+}
+
+hal_size_t MMapGenome::getNumBottomSegments() const
+{
+  return _numBottomSegments;
+}
+
+TopSegmentIteratorPtr MMapGenome::getTopSegmentIterator(hal_index_t position)
+{
+  assert(position <= (hal_index_t)getNumTopSegments());
+  MMapTopSegment* newSeg = new MMapTopSegment(this, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultTopSegmentIterator* newIt = new DefaultTopSegmentIterator(newSeg);
+  return TopSegmentIteratorPtr(newIt);
+}
+
+TopSegmentIteratorConstPtr MMapGenome::getTopSegmentIterator(
+  hal_index_t position) const
+{
+  return const_cast<MMapGenome*>(this)->getTopSegmentIterator(position);
+}
+
+TopSegmentIteratorConstPtr MMapGenome::getTopSegmentEndIterator() const
+{
+  return getTopSegmentIterator(getNumTopSegments());
+}
+
+BottomSegmentIteratorPtr MMapGenome::getBottomSegmentIterator(
+  hal_index_t position)
+{
+  assert(position <= (hal_index_t)getNumBottomSegments());
+  MMapBottomSegment* newSeg = new MMapBottomSegment(this, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultBottomSegmentIterator* newIt =
+     new DefaultBottomSegmentIterator(newSeg);
+  return BottomSegmentIteratorPtr(newIt);
+}
+
+BottomSegmentIteratorConstPtr MMapGenome::getBottomSegmentIterator(
+  hal_index_t position) const
+{
+  return const_cast<MMapGenome*>(this)->getBottomSegmentIterator(position);
+}
+
+BottomSegmentIteratorConstPtr MMapGenome::getBottomSegmentEndIterator() const
+{
+  return getBottomSegmentIterator(getNumBottomSegments());
+}
+
+DNAIteratorPtr MMapGenome::getDNAIterator(hal_index_t position)
+{
+  assert(_dnaLength == 0 || position / 2 <= (hal_index_t)_dnaLength);
+  MMapDNAIterator* newIt = new MMapDNAIterator(this, position);
+  return DNAIteratorPtr(newIt);
+}
+
+DNAIteratorConstPtr MMapGenome::getDNAIterator(hal_index_t position) const
+{
+  return const_cast<MMapGenome*>(this)->getDNAIterator(position);
+}
+
+DNAIteratorConstPtr MMapGenome::getDNAEndIterator() const
+{
+  return getDNAIterator(getSequenceLength());
+}
+
+ColumnIteratorConstPtr MMapGenome::getColumnIterator(
+  const set<const Genome*>* targets, hal_size_t maxInsertLength,
+  hal_index_t position, hal_index_t lastPosition, bool noDupes,
+  bool noAncestors, bool reverseStrand, bool unique, bool onlyOrthologs) const
+{
+  hal_index_t lastIdx = lastPosition;
+  if (lastPosition == NULL_INDEX)
+  {
+    lastIdx = (hal_index_t)(getSequenceLength() - 1);
+  }
+  if (position < 0 ||
+      lastPosition >= (hal_index_t)(getSequenceLength()))
+  {
+    stringstream ss;
+    ss << "MMapGenome::getColumnIterator: input indices "
+       << "(" << position << ", " << lastPosition << ") out of bounds";
+    throw hal_exception(ss.str());
+  }
+  const DefaultColumnIterator* newIt =
+     new DefaultColumnIterator(this, targets, position, lastIdx,
+                               maxInsertLength, noDupes, noAncestors,
+                               reverseStrand, unique, onlyOrthologs);
+  return ColumnIteratorConstPtr(newIt);
+}
+
+void MMapGenome::getString(string& outString) const
+{
+  getSubString(outString, 0, getSequenceLength());
+}
+
+void MMapGenome::setString(const string& inString)
+{
+  throw hal_exception("Cannot set DNA in read-only mmap HAL file");
+}
+
+void MMapGenome::getSubString(string& outString, hal_size_t start,
+                              hal_size_t length) const
+{
+  outString.resize(length);
+  MMapDNAIterator dnaIt(const_cast<MMapGenome*>(this), start);
+  dnaIt.readString(outString, length);
+}
+
+void MMapGenome::setSubString(const string& inString,
+                              hal_size_t start,
+                              hal_size_t length)
+{
+  throw hal_exception("Cannot set DNA in read-only mmap HAL file");
+}
+
+RearrangementPtr MMapGenome::getRearrangement(hal_index_t position,
+                                              hal_size_t gapLengthThreshold,
+                                              double nThreshold,
+                                              bool atomic) const
+{
+  assert(position >= 0 && position < (hal_index_t)getNumTopSegments());
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(position);
+  DefaultRearrangement* rea = new DefaultRearrangement(this,
+                                                       gapLengthThreshold,
+                                                       nThreshold,
+                                                       atomic);
+  rea->identifyFromLeftBreakpoint(top);
+  return RearrangementPtr(rea);
+}
+
+GappedTopSegmentIteratorConstPtr MMapGenome::getGappedTopSegmentIterator(
+  hal_index_t i, hal_size_t gapThreshold, bool atomic) const
+{
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(i);
+  DefaultGappedTopSegmentIterator* gt =
+     new DefaultGappedTopSegmentIterator(top, gapThreshold, atomic);
+  return GappedTopSegmentIteratorConstPtr(gt);
+}
+
+GappedBottomSegmentIteratorConstPtr MMapGenome::getGappedBottomSegmentIterator(
+  hal_index_t i, hal_size_t childIdx, hal_size_t gapThreshold,
+  bool atomic) const
+{
+  BottomSegmentIteratorConstPtr bot = getBottomSegmentIterator(i);
+  DefaultGappedBottomSegmentIterator* gb =
+     new DefaultGappedBottomSegmentIterator(bot, childIdx, gapThreshold,
+                                            atomic);
+  return GappedBottomSegmentIteratorConstPtr(gb);
+}
+
+// LOCAL NON-INTERFACE METHODS
+
+void MMapGenome::resetBranchCaches()
+{
+  _parentCache = NULL;
+  _childCache.assign(_numChildren, NULL);
+}
+
+MMapSequence* MMapGenome::getSequenceByIndex(hal_index_t index) const
+{
+  assert(index >= 0 && index < (hal_index_t)_numSequences);
+  // sequences are only created when asked for, so opening a genome
+  // with many contigs is cheap.  they are published with a
+  // compare-and-swap so that concurrent readers never need a lock
+  MMapSequence* sequence = _sequenceCache[index];
+  if (sequence == NULL)
+  {
+    MMapSequence* newSequence =
+       new MMapSequence(const_cast<MMapGenome*>(this), index);
+    sequence = __sync_val_compare_and_swap(&_sequenceCache[index],
+                                           (MMapSequence*)NULL, newSequence);
+    if (sequence == NULL)
+    {
+      sequence = newSequence;
+    }
+    else
+    {
+      delete newSequence;
+    }
+  }
+  return sequence;
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPGENOME_H
+#define _MMAPGENOME_H
+
+#include <vector>
+#include <cassert>
+#include "halGenome.h"
+#include "mmapFile.h"
+#include "mmapMetaData.h"
+#include "sequenceSiteIndex.h"
+#include "sequenceNameIndex.h"
+
+namespace hal {
+
+class MMapAlignment;
+class MMapSequence;
+/**
+ * Read-only memory-mapped implementation of hal::Genome.  All arrays
+ * are read in place from the mapped file.  The lazily-filled caches
+ * below are safe to fill from several reader threads at once.
+ */
+class MMapGenome : public Genome
+{
+   friend class MMapTopSegment;
+   friend class MMapBottomSegment;
+   friend class MMapDNAIterator;
+   friend class MMapSequence;
+   friend class MMapSequenceIterator;
+public:
+
+   MMapGenome(const std::string& name,
+              MMapAlignment* alignment,
+              const MMapFile* file,
+              const MMapGenomeHeader* header);
+
+   virtual ~MMapGenome();
+
+   // GENOME INTERFACE
+
+   const std::string& getName() const;
+
+   void setDimensions(
+     const std::vector<hal::Sequence::Info>& sequenceDimensions,
+     bool storeDNAArrays);
+
+   void updateTopDimensions(
+     const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
+
+   void updateBottomDimensions(
+     const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
+
+   hal_size_t getNumSequences() const;
+
+   Sequence* getSequence(const std::string& name);
+
+   const Sequence* getSequence(const std::string& name) const;
+
+   Sequence* getSequenceBySite(hal_size_t position);
+   const Sequence* getSequenceBySite(hal_size_t position) const;
+
+   SequenceIteratorPtr getSequenceIterator(
+     hal_index_t position);
+
+   SequenceIteratorConstPtr getSequenceIterator(
+     hal_index_t position) const;
+
+   SequenceIteratorConstPtr getSequenceEndIterator() const;
+
+   MetaData* getMetaData();
+
+   const MetaData* getMetaData() const;
+
+   Genome* getParent();
+
+   const Genome* getParent() const;
+
+   Genome* getChild(hal_size_t childIdx);
+
+   const Genome* getChild(hal_size_t childIdx) const;
+
+   hal_size_t getNumChildren() const;
+
+   hal_index_t getChildIndex(const Genome* child) const;
+
+   bool containsDNAArray() const;
+
+   const Alignment* getAlignment() const;
+
+   hal_size_t getGenomeId() const;
+
+   void getTopSegmentRecords(hal_index_t start, hal_size_t count,
+                             std::vector<TopSegmentRecord>& records) const;
+
+   void setTopSegmentRecords(hal_index_t start,
+                             const std::vector<TopSegmentRecord>& records);
+
+   void getBottomSegmentRecords(hal_index_t start, hal_size_t count,
+                                std::vector<BottomSegmentRecord>& records,
+                                std::vector<ChildRecord>& children) const;
+
+   void setBottomSegmentRecords(
+     hal_index_t start, const std::vector<BottomSegmentRecord>& records,
+     const std::vector<ChildRecord>& children);
+
+   // SEGMENTED SEQUENCE INTERFACE
+
+   hal_size_t getSequenceLength() const;
+
+   hal_size_t getNumTopSegments() const;
+
+   hal_size_t getNumBottomSegments() const;
+
+   TopSegmentIteratorPtr getTopSegmentIterator(
+     hal_index_t position);
+
+   TopSegmentIteratorConstPtr getTopSegmentIterator(
+     hal_index_t position) const;
+
+   TopSegmentIteratorConstPtr getTopSegmentEndIterator() const;
+
+   BottomSegmentIteratorPtr getBottomSegmentIterator(
+     hal_index_t position);
+
+   BottomSegmentIteratorConstPtr getBottomSegmentIterator(
+     hal_index_t position) const;
+
+   BottomSegmentIteratorConstPtr getBottomSegmentEndIterator() const;
+
+   DNAIteratorPtr getDNAIterator(hal_index_t position);
+
+   DNAIteratorConstPtr getDNAIterator(hal_index_t position) const;
+
+   DNAIteratorConstPtr getDNAEndIterator() const;
+
+   ColumnIteratorConstPtr getColumnIterator(const std::set<const Genome*>* targets,
+                                            hal_size_t maxInsertLength,
+                                            hal_index_t position,
+                                            hal_index_t lastPosition,
+                                            bool noDupes,
+                                            bool noAncestors,
+                                            bool reverseStrand,
+                                            bool unique,
+                                            bool onlyOrthologs) const;
+
+   void getString(std::string& outString) const;
+
+   void setString(const std::string& inString);
+
+   void getSubString(std::string& outString, hal_size_t start,
+                             hal_size_t length) const;
+
+   void setSubString(const std::string& intString,
+                             hal_size_t start,
+                             hal_size_t length);
+
+   RearrangementPtr getRearrangement(hal_index_t position,
+                                     hal_size_t gapLengthThreshold,
+                                     double nThreshold,
+                                     bool atomic = false) const;
+
+   GappedTopSegmentIteratorConstPtr getGappedTopSegmentIterator(
+     hal_index_t i, hal_size_t gapThreshold, bool atomic) const;
+
+   GappedBottomSegmentIteratorConstPtr getGappedBottomSegmentIterator(
+     hal_index_t i, hal_size_t childIdx, hal_size_t gapThreshold,
+     bool atomic) const;
+
+   // MMAP SPECIFIC
+   void resetBranchCaches();
+
+protected:
+
+   MMapSequence* getSequenceByIndex(hal_index_t index) const;
+
+   const MMapTopSegmentRecord* getTopRecord(hal_index_t index) const;
+   const MMapBottomSegmentRecord* getBottomRecord(hal_index_t index) const;
+   const MMapBottomChildRecord* getBottomChildRecord(hal_index_t index,
+                                                     hal_size_t child) const;
+
+protected:
+
+   MMapAlignment* _alignment;
+   const MMapFile* _file;
+   std::string _name;
+   hal_size_t _genomeId;
+   MMapMetaData* _metaData;
+   hal_size_t _totalSequenceLength;
+   hal_size_t _numSequences;
+   hal_size_t _numTopSegments;
+   hal_size_t _numBottomSegments;
+   hal_size_t _numChildren;
+   const MMapSequenceRecord* _sequenceRecords;
+   SequenceSiteIndex _siteIndex;
+   // sequence indexes sorted by name (see SequenceNameIndex)
+   const hal_size_t* _nameIndex;
+   const MMapTopSegmentRecord* _topRecords;
+   const char* _bottomRecords;
+   size_t _bottomRecordSize;
+   const unsigned char* _dna;
+   hal_size_t _dnaLength;
+
+   mutable Genome* _parentCache;
+   mutable std::vector<Genome*> _childCache;
+   mutable std::vector<MMapSequence*> _sequenceCache;
+   // index of the last sequence found by getSequenceBySite.  it is only
+   // a hint (checked before use) so threads can overwrite each other's
+   mutable hal_size_t _siteHint;
+};
+
+// INLINE members
+inline const MMapTopSegmentRecord*
+MMapGenome::getTopRecord(hal_index_t index) const
+{
+  assert(index >= 0 && index <= (hal_index_t)_numTopSegments);
+  return _topRecords + index;
+}
+
+inline const MMapBottomSegmentRecord*
+MMapGenome::getBottomRecord(hal_index_t index) const
+{
+  assert(index >= 0 && index <= (hal_index_t)_numBottomSegments);
+  return reinterpret_cast<const MMapBottomSegmentRecord*>(
+    _bottomRecords + index * _bottomRecordSize);
+}
+
+inline const MMapBottomChildRecord*
+MMapGenome::getBottomChildRecord(hal_index_t index, hal_size_t child) const
+{
+  assert(child < _numChildren);
+  return reinterpret_cast<const MMapBottomChildRecord*>(
+    getBottomRecord(index) + 1) + child;
+}
+
+}
+#endif
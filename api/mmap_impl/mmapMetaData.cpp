@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include "halCommon.h"
+#include "mmapMetaData.h"
+
+using namespace std;
+using namespace hal;
+
+MMapMetaData::MMapMetaData(const MMapFile* file, uint64_t offset)
+{
+  assert(file != NULL && file->isOpen() == true);
+  uint64_t numEntries = *file->toPointer<uint64_t>(offset);
+  const MMapMetaDataRecord* records = 
+     file->toPointer<MMapMetaDataRecord>(offset + sizeof(uint64_t), 
+                                         numEntries);
+  for (uint64_t i = 0; i < numEntries; ++i)
+  {
+    _map.insert(pair<string, string>(file->getString(records[i]._keyOffset),
+                                     file->getString(records[i]._valueOffset)));
+  }
+}
+
+MMapMetaData::~MMapMetaData()
+{
+
+}
+
+void MMapMetaData::set(const string& key, const string& value)
+{
+  throw hal_exception("Cannot set metadata in read-only mmap HAL file");
+}
+
+const string& MMapMetaData::get(const string& key) const
+{
+  assert (has(key) == true);
+  return _map.find(key)->second;
+}
+
+bool MMapMetaData::has(const string& key) const
+{
+  return _map.find(key) != _map.end();
+}
+
+const map<string, string>& MMapMetaData::getMap() const
+{
+  return _map;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include "mmapSequenceIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapSequenceIterator::MMapSequenceIterator(MMapGenome* genome, 
+                                           hal_index_t index) :
+  _index(index),
+  _genome(genome)
+{
+  
+}
+
+MMapSequenceIterator::~MMapSequenceIterator()
+{
+
+}
+   
+SequenceIteratorPtr MMapSequenceIterator::copy()
+{
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(_genome, _index);
+  return SequenceIteratorPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapSequenceIterator::copy() const
+{
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(_genome, _index);
+  return SequenceIteratorConstPtr(newIt);
+}
+
+void MMapSequenceIterator:: toNext() const
+{
+  ++_index;
+}
+
+void MMapSequenceIterator::toPrev() const
+{
+  --_index;
+}
+
+Sequence* MMapSequenceIterator::getSequence()
+{
+  assert(_index >= 0 && _index < (hal_index_t)_genome->getNumSequences());
+  // give cached pointer from genome (so it will not expire when 
+  // iterator moves!)
+  return _genome->getSequenceByIndex(_index);
+}
+
+const Sequence* MMapSequenceIterator::getSequence() const
+{
+  assert(_index >= 0 && _index < (hal_index_t)_genome->getNumSequences());
+  // give cached pointer from genome (so it will not expire when 
+  // iterator moves!)
+  return _genome->getSequenceByIndex(_index);
+}
+
+bool MMapSequenceIterator::equals(SequenceIteratorConstPtr other) const
+{
+  const MMapSequenceIterator* mmapOther = reinterpret_cast<
+     const MMapSequenceIterator*>(other.get());
+  assert(_genome == mmapOther->_genome);
+  return _index == mmapOther->_index;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include "mmapTopSegment.h"
+#include "mmapBottomSegment.h"
+#include "mmapDNAIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapTopSegment::MMapTopSegment(MMapGenome* genome,
+                               hal_index_t index) :
+  _index(index),
+  _genome(genome)
+{
+  assert(_index >= 0);
+}
+
+MMapTopSegment::~MMapTopSegment()
+{
+  
+}
+
+void MMapTopSegment::setCoordinates(hal_index_t startPos, hal_size_t length)
+{
+  throw hal_exception("Cannot set top segment coordinates in read-only "
+                      "mmap HAL file");
+}
+
+void MMapTopSegment::setParentIndex(hal_index_t parentIndex)
+{
+  throw hal_exception("Cannot set top segment parent in read-only "
+                      "mmap HAL file");
+}
+
+void MMapTopSegment::setParentReversed(bool isReversed)
+{
+  throw hal_exception("Cannot set top segment parent in read-only "
+                      "mmap HAL file");
+}
+
+void MMapTopSegment::setBottomParseIndex(hal_index_t parseIndex)
+{
+  throw hal_exception("Cannot set top segment parse index in read-only "
+                      "mmap HAL file");
+}
+
+void MMapTopSegment::setNextParalogyIndex(hal_index_t parIdx)
+{
+  throw hal_exception("Cannot set top segment paralogy index in read-only "
+                      "mmap HAL file");
+}
+   
+hal_offset_t MMapTopSegment::getBottomParseOffset() const
+{
+  assert(_index >= 0);
+  hal_offset_t offset = 0;
+  hal_index_t bottomIndex = getBottomParseIndex();
+  if (bottomIndex != NULL_INDEX)
+  {
+    MMapBottomSegment bs(_genome, bottomIndex);
+    assert(bs.getStartPosition() <= getStartPosition());
+    assert((hal_index_t)(bs.getStartPosition() + bs.getLength()) 
+           >= getStartPosition());
+    offset = getStartPosition() - bs.getStartPosition();
+  }
+  return offset;
+}
+
+void MMapTopSegment::getString(std::string& outString) const
+{
+  MMapDNAIterator di(_genome, getStartPosition());
+  di.readString(outString, getLength()); 
+}
+
+bool MMapTopSegment::isMissingData(double nThreshold) const
+{
+  if (nThreshold >= 1.0)
+  {
+    return false;
+  }  
+  MMapDNAIterator di(_genome, getStartPosition());
+  size_t length = getLength();
+  size_t maxNs = nThreshold * (double)length;
+  size_t Ns = 0;
+  char c;
+  for (size_t i = 0; i < length; ++i, di.toRight())
+  {
+    c = di.getChar();
+    if (c == 'N' || c == 'n')
+    {
+      ++Ns;
+    }
+    if (Ns > maxNs)
+    {
+      return true;
+    }
+    if ((length - i) < (maxNs - Ns))
+    {
+      break;
+    }
+  }
+  return false;
+}
+
+bool MMapTopSegment::isCanonicalParalog() const
+{
+  bool isCanon = false;
+  if (hasParent())
+  {
+    MMapGenome* parGenome = 
+       const_cast <MMapGenome*>(
+         dynamic_cast<const MMapGenome*>(_genome->getParent()));
+
+    MMapBottomSegment parent(parGenome, getParentIndex());
+    hal_index_t childGenomeIndex = parGenome->getChildIndex(_genome);
+    isCanon = parent.getChildIndex(childGenomeIndex) == _index;
+  }
+  return isCanon;
+}
+
+void MMapTopSegment::print(std::ostream& os) const
+{
+  os << "MMap Top Segment";
+}
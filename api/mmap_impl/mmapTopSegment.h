@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPTOPSEGMENT_H
+#define _MMAPTOPSEGMENT_H
+
+#include "halTopSegment.h"
+#include "halSequence.h"
+#include "mmapGenome.h"
+
+namespace hal {
+
+class MMapTopSegment : public TopSegment
+{
+public:
+
+   /** Constructor 
+    * @param genome Genome to which segment belongs
+    * @param index Index of segment in the genome's top segment array */
+   MMapTopSegment(MMapGenome* genome,
+                  hal_index_t index);
+
+   /** Destructor */
+   ~MMapTopSegment();
+
+   // SEGMENT INTERFACE
+   void setArrayIndex(Genome* genome, hal_index_t arrayIndex);
+   void setArrayIndex(const Genome* genome, hal_index_t arrayIndex) const;
+   const Genome* getGenome() const;
+   Genome* getGenome();
+   const Sequence* getSequence() const;
+   Sequence* getSequence();
+   hal_index_t getStartPosition() const;
+   hal_index_t getEndPosition() const;
+   hal_size_t getLength() const;
+   void getString(std::string& outString) const;
+   void setCoordinates(hal_index_t startPos, hal_size_t length);
+   hal_index_t getArrayIndex() const;
+   bool leftOf(hal_index_t genomePos) const;
+   bool rightOf(hal_index_t genomePos) const;
+   bool overlaps(hal_index_t genomePos) const;
+   bool isFirst() const;
+   bool isLast() const;
+   bool isMissingData(double nThreshold) const;
+   bool isTop() const;
+   hal_size_t getMappedSegments(
+     std::set<MappedSegmentConstPtr>& outSegments,
+     const Genome* tgtGenome,
+     const GenomeSet* genomesOnPath,
+     bool doDupes,
+     hal_size_t minLength,
+     const Genome *coalescenceLimit,
+     const Genome *mrca) const;
+   void print(std::ostream& os) const;
+
+   // TOP SEGMENT INTERFACE
+   hal_index_t getParentIndex() const;
+   bool hasParent() const;
+   void setParentIndex(hal_index_t parIdx);
+   bool getParentReversed() const;
+   void setParentReversed(bool isReversed);
+   hal_index_t getBottomParseIndex() const;
+   void setBottomParseIndex(hal_index_t botParseIdx);
+   hal_offset_t getBottomParseOffset() const;
+   bool hasParseDown() const;
+   hal_index_t getNextParalogyIndex() const;
+   bool hasNextParalogy() const;
+   void setNextParalogyIndex(hal_index_t parIdx);
+   hal_index_t getLeftParentIndex() const;
+   hal_index_t getRightParentIndex() const;
+   bool isCanonicalParalog() const;
+
+private:
+
+   const MMapTopSegmentRecord* getRecord() const;
+
+   mutable hal_index_t _index;
+   mutable MMapGenome* _genome;
+};
+
+//INLINE members
+inline const MMapTopSegmentRecord* MMapTopSegment::getRecord() const
+{
+  return _genome->getTopRecord(_index);
+}
+
+inline void MMapTopSegment::setArrayIndex(Genome* genome, 
+                                          hal_index_t arrayIndex)
+{
+  _genome = dynamic_cast<MMapGenome*>(genome);
+  assert(_genome != NULL);
+  assert(arrayIndex <= (hal_index_t)_genome->getNumTopSegments());
+  _index = arrayIndex;
+}
+
+inline void MMapTopSegment::setArrayIndex(const Genome* genome, 
+                                          hal_index_t arrayIndex) const
+{
+  const MMapGenome* mmapGenome = dynamic_cast<const MMapGenome*>(genome);
+  assert(mmapGenome != NULL);
+  _genome = const_cast<MMapGenome*>(mmapGenome);
+  assert(arrayIndex <= (hal_index_t)_genome->getNumTopSegments());
+  _index = arrayIndex;
+}
+
+inline hal_index_t MMapTopSegment::getStartPosition() const
+{
+  return getRecord()->_start;
+}
+
+inline hal_index_t MMapTopSegment::getEndPosition() const
+{
+  return getStartPosition() + (hal_index_t)(getLength() - 1);
+}
+
+inline hal_size_t MMapTopSegment::getLength() const
+{
+  const MMapTopSegmentRecord* record = getRecord();
+  return (record + 1)->_start - record->_start;
+}
+
+inline const Genome* MMapTopSegment::getGenome() const
+{
+  return _genome;
+}
+
+inline Genome* MMapTopSegment::getGenome()
+{
+  return _genome;
+}
+
+inline const Sequence* MMapTopSegment::getSequence() const
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline Sequence* MMapTopSegment::getSequence()
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline bool MMapTopSegment::hasParseDown() const
+{
+  return getBottomParseIndex() != NULL_INDEX;
+}
+
+inline hal_index_t MMapTopSegment::getNextParalogyIndex() const
+{
+  return getRecord()->_nextParalogyIndex;
+}
+
+inline bool MMapTopSegment::hasNextParalogy() const
+{
+  return getNextParalogyIndex() != NULL_INDEX;
+}
+
+inline hal_index_t MMapTopSegment::getParentIndex() const
+{
+  return getRecord()->_parentIndex;
+}
+
+inline bool MMapTopSegment::hasParent() const
+{
+  return getParentIndex() != NULL_INDEX;
+}
+
+inline bool MMapTopSegment::getParentReversed() const
+{
+  return getRecord()->_parentReversed != 0;
+}
+
+inline hal_index_t MMapTopSegment::getBottomParseIndex() const
+{
+  return getRecord()->_bottomParseIndex;
+}
+
+inline hal_index_t MMapTopSegment::getArrayIndex() const
+{
+  return _index;
+}
+
+inline bool MMapTopSegment::leftOf(hal_index_t genomePos) const
+{
+  return getEndPosition() < genomePos;
+}
+
+inline bool MMapTopSegment::rightOf(hal_index_t genomePos) const
+{
+  return getStartPosition() > genomePos;
+}
+
+inline bool MMapTopSegment::overlaps(hal_index_t genomePos) const
+{
+  return !leftOf(genomePos) && !rightOf(genomePos);
+}
+
+inline bool MMapTopSegment::isFirst() const
+{
+  assert(getSequence() != NULL);
+  return _index == 0 || 
+     _index == (hal_index_t)getSequence()->getTopSegmentArrayIndex();
+}
+
+inline bool MMapTopSegment::isLast() const
+{
+  assert(getSequence() != NULL);
+  return _index == (hal_index_t)_genome->getNumTopSegments() || 
+     _index == getSequence()->getTopSegmentArrayIndex() +
+     (hal_index_t)getSequence()->getNumTopSegments() - 1;
+}
+
+inline bool MMapTopSegment::isTop() const
+{
+  return true;
+}
+
+inline hal_size_t MMapTopSegment::getMappedSegments(
+  std::set<MappedSegmentConstPtr>& outSegments,
+  const Genome* tgtGenome,
+  const GenomeSet* genomesOnPath,
+  bool doDupes,
+  hal_size_t minLength,
+  const Genome *coalescenceLimit,
+  const Genome *mrca) const
+{
+  throw hal_exception("Internal error.   MMap Segment interface should "
+                      "at some point go through the sliced segment");
+}
+
+inline hal_index_t MMapTopSegment::getLeftParentIndex() const
+{
+  assert(isFirst() == false);
+  return _genome->getTopRecord(_index - 1)->_parentIndex;
+}
+
+inline hal_index_t MMapTopSegment::getRightParentIndex() const
+{
+  assert(isLast() == false);
+  return _genome->getTopRecord(_index + 1)->_parentIndex;
+}
+
+}
+
+#endif
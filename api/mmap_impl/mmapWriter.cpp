@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "hal.h"
+#include "hdf5DNA.h"
+#include "mmapFile.h"
+#include "sequenceSiteIndex.h"
+#include "sequenceNameIndex.h"
+
+using namespace std;
+using namespace hal;
+
+/** number of bases converted at once when copying the DNA */
+static const hal_size_t DNAChunkSize = 1 << 20;
+
+static uint64_t padToAlignment(ofstream& out)
+{
+  static const char zeros[8] = {0};
+  uint64_t pos = out.tellp();
+  if (pos % 8 != 0)
+  {
+    out.write(zeros, 8 - pos % 8);
+    pos += 8 - pos % 8;
+  }
+  return pos;
+}
+
+template <typename T>
+static uint64_t writeRecords(ofstream& out, const vector<T>& records)
+{
+  uint64_t offset = padToAlignment(out);
+  if (records.empty() == false)
+  {
+    out.write(reinterpret_cast<const char*>(&records[0]),
+              records.size() * sizeof(T));
+  }
+  return offset;
+}
+
+static uint64_t writeString(ofstream& out, const string& str)
+{
+  uint64_t offset = out.tellp();
+  out.write(str.c_str(), str.length() + 1);
+  return offset;
+}
+
+static uint64_t writeMetaData(ofstream& out, const MetaData* metaData)
+{
+  const map<string, string>& metaMap = metaData->getMap();
+  vector<MMapMetaDataRecord> records;
+  for (map<string, string>::const_iterator i = metaMap.begin();
+       i != metaMap.end(); ++i)
+  {
+    MMapMetaDataRecord record;
+    record._keyOffset = writeString(out, i->first);
+    record._valueOffset = writeString(out, i->second);
+    records.push_back(record);
+  }
+  uint64_t offset = padToAlignment(out);
+  uint64_t numEntries = records.size();
+  out.write(reinterpret_cast<const char*>(&numEntries), sizeof(numEntries));
+  writeRecords(out, records);
+  return offset;
+}
+
+static void writeSequences(ofstream& out, const Genome* genome,
+                           MMapGenomeHeader& header)
+{
+  vector<MMapSequenceRecord> records;
+  vector<hal_size_t> starts;
+  vector<string> names;
+  MMapSequenceRecord record;
+  memset(&record, 0, sizeof(record));
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = genome->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    record._start = sequence->getStartPosition();
+    record._topSegmentArrayIndex = sequence->getTopSegmentArrayIndex();
+    record._bottomSegmentArrayIndex = sequence->getBottomSegmentArrayIndex();
+    record._nameOffset = writeString(out, sequence->getName());
+    records.push_back(record);
+    starts.push_back(record._start);
+    names.push_back(sequence->getName());
+    // the sentinel record ends up one past the last sequence
+    record._start += sequence->getSequenceLength();
+    record._topSegmentArrayIndex += sequence->getNumTopSegments();
+    record._bottomSegmentArrayIndex += sequence->getNumBottomSegments();
+  }
+  record._nameOffset = 0;
+  records.push_back(record);
+  header._numSequences = records.size() - 1;
+  header._sequenceOffset = writeRecords(out, records);
+
+  vector<SequenceSiteRecord> siteRecords;
+  SequenceSiteIndex::layout(starts, siteRecords);
+  header._siteIndexOffset = writeRecords(out, siteRecords);
+
+  vector<hal_size_t> order;
+  SequenceNameIndex::layout(names, order);
+  header._nameIndexOffset = writeRecords(out, order);
+}
+
+static void writeTopSegments(ofstream& out, const Genome* genome,
+                             MMapGenomeHeader& header)
+{
+  header._numTopSegments = genome->getNumTopSegments();
+  vector<MMapTopSegmentRecord> records(header._numTopSegments + 1);
+  memset(&records[0], 0, records.size() * sizeof(MMapTopSegmentRecord));
+  // copy the sentinel too (it holds the end coordinate of the last
+  // segment), but only if there is an array to copy it from
+  hal_size_t numRecords = records.size();
+  if (header._numTopSegments == 0)
+  {
+    numRecords = 0;
+  }
+  TopSegmentIteratorConstPtr topIt = genome->getTopSegmentIterator();
+  for (hal_size_t i = 0; i < numRecords; ++i)
+  {
+    if (i > 0)
+    {
+      topIt->toRight();
+    }
+    const TopSegment* segment = topIt->getTopSegment();
+    MMapTopSegmentRecord& record = records[i];
+    record._start = segment->getStartPosition();
+    record._bottomParseIndex = segment->getBottomParseIndex();
+    record._nextParalogyIndex = segment->getNextParalogyIndex();
+    record._parentIndex = segment->getParentIndex();
+    record._parentReversed = segment->getParentReversed() ? 1 : 0;
+  }
+  header._topOffset = writeRecords(out, records);
+}
+
+static void writeBottomSegments(ofstream& out, const Genome* genome,
+                                MMapGenomeHeader& header)
+{
+  header._numBottomSegments = genome->getNumBottomSegments();
+  header._numChildren = genome->getNumChildren();
+  size_t recordSize = sizeof(MMapBottomSegmentRecord) +
+     header._numChildren * sizeof(MMapBottomChildRecord);
+  vector<char> records((header._numBottomSegments + 1) * recordSize, 0);
+  hal_size_t numRecords = header._numBottomSegments + 1;
+  if (header._numBottomSegments == 0)
+  {
+    numRecords = 0;
+  }
+  BottomSegmentIteratorConstPtr botIt = genome->getBottomSegmentIterator();
+  for (hal_size_t i = 0; i < numRecords; ++i)
+  {
+    if (i > 0)
+    {
+      botIt->toRight();
+    }
+    const BottomSegment* segment = botIt->getBottomSegment();
+    MMapBottomSegmentRecord* record =
+       reinterpret_cast<MMapBottomSegmentRecord*>(&records[i * recordSize]);
+    record->_start = segment->getStartPosition();
+    record->_topParseIndex = segment->getTopParseIndex();
+    MMapBottomChildRecord* children =
+       reinterpret_cast<MMapBottomChildRecord*>(record + 1);
+    for (hal_size_t j = 0; j < header._numChildren; ++j)
+    {
+      children[j]._childIndex = segment->getChildIndex(j);
+      children[j]._childReversed = segment->getChildReversed(j) ? 1 : 0;
+    }
+  }
+  header._bottomOffset = writeRecords(out, records);
+}
+
+static void writeDNA(ofstream& out, const Genome* genome,
+                     MMapGenomeHeader& header)
+{
+  header._dnaOffset = padToAlignment(out);
+  header._dnaLength = 0;
+  if (genome->containsDNAArray() == false)
+  {
+    return;
+  }
+  hal_size_t length = genome->getSequenceLength();
+  header._dnaLength = (length + 1) / 2;
+  string buffer;
+  vector<unsigned char> packed;
+  // chunk size is even so that local and global position parities agree
+  for (hal_size_t start = 0; start < length; start += DNAChunkSize)
+  {
+    hal_size_t chunkLength = min(DNAChunkSize, length - start);
+    genome->getSubString(buffer, start, chunkLength);
+    packed.assign((chunkLength + 1) / 2, 0);
+    for (hal_size_t i = 0; i < chunkLength; ++i)
+    {
+      HDF5DNA::pack(buffer[i], i, packed[i / 2]);
+    }
+    out.write(reinterpret_cast<const char*>(&packed[0]), packed.size());
+  }
+}
+
+static void writeGenome(ofstream& out, const Genome* genome,
+                        MMapGenomeHeader& header)
+{
+  header._nameOffset = writeString(out, genome->getName());
+  header._metaOffset = writeMetaData(out, genome->getMetaData());
+  header._sequenceLength = genome->getSequenceLength();
+  writeSequences(out, genome, header);
+  writeTopSegments(out, genome, header);
+  writeBottomSegments(out, genome, header);
+  writeDNA(out, genome, header);
+}
+
+void hal::writeMMapAlignment(AlignmentConstPtr alignment, const string& path)
+{
+  ofstream out(path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+  {
+    throw hal_exception("Unable to open " + path);
+  }
+
+  // breadth-first from the root so the genome table follows the tree
+  vector<string> genomeNames;
+  if (alignment->getNumGenomes() > 0)
+  {
+    deque<string> bfQueue;
+    bfQueue.push_back(alignment->getRootName());
+    while (bfQueue.empty() == false)
+    {
+      genomeNames.push_back(bfQueue.front());
+      bfQueue.pop_front();
+      vector<string> childNames = alignment->getChildNames(genomeNames.back());
+      bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+    }
+  }
+
+  // reserve space for the headers, which are filled in at the end
+  MMapFileHeader fileHeader;
+  memset(&fileHeader, 0, sizeof(fileHeader));
+  vector<MMapGenomeHeader> genomeHeaders(genomeNames.size());
+  if (genomeHeaders.empty() == false)
+  {
+    memset(&genomeHeaders[0], 0,
+           genomeHeaders.size() * sizeof(MMapGenomeHeader));
+  }
+  out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+  fileHeader._genomeTableOffset = writeRecords(out, genomeHeaders);
+
+  fileHeader._treeOffset = writeString(out, alignment->getNewickTree());
+  stringstream version;
+  version << HAL_VERSION;
+  fileHeader._versionOffset = writeString(out, version.str());
+  fileHeader._metaOffset = writeMetaData(out, alignment->getMetaData());
+
+  for (size_t i = 0; i < genomeNames.size(); ++i)
+  {
+    const Genome* genome = alignment->openGenome(genomeNames[i]);
+    writeGenome(out, genome, genomeHeaders[i]);
+    // keep only one genome's caches in memory at a time
+    alignment->closeGenome(genome);
+  }
+  fileHeader._fileSize = padToAlignment(out);
+
+  memcpy(fileHeader._magic, MMapFile::Magic, sizeof(fileHeader._magic));
+  fileHeader._byteOrderMark = MMapFile::ByteOrderMark;
+  fileHeader._formatVersion = MMapFile::FormatVersion;
+  fileHeader._numGenomes = genomeNames.size();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+  out.seekp(fileHeader._genomeTableOffset);
+  writeRecords(out, genomeHeaders);
+  out.close();
+  if (!out)
+  {
+    throw hal_exception("Error writing " + path);
+  }
+}
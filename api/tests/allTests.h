@@ -22,5 +22,7 @@ CuSuite* halColumnIteratorTestSuite();
 CuSuite* halRearrangementTestSuite();
 CuSuite* halMappedSegmentTestSuite();
 CuSuite* halGappedSegmentIteratorTestSuite();
+CuSuite* halMMapTestSuite();
+CuSuite* halBigWigWriterTestSuite();
 
 #endif
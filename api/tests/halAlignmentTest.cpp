@@ -11,6 +11,8 @@
 #include "halAlignmentInstanceTest.h"
 #include "halAlignment.h"
 #include "halGenome.h"
+#include "halGenomeTree.h"
+#include "halCommon.h"
 extern "C" {
 #include "commonC.h"
 }
@@ -144,6 +146,118 @@ void AlignmentTestEmpty::checkCallBack(hal::AlignmentConstPtr alignment)
   CuAssertTrue(_testCase, alignment->getNumGenomes() == 0);
 }
 
+void AlignmentTestGenomeTree::createCallBack(hal::AlignmentPtr alignment)
+{
+  alignment->addRootGenome("Root", 0);
+  alignment->addLeafGenome("Anc1", "Root", 1);
+  alignment->addLeafGenome("Leaf1", "Anc1", 1);
+  alignment->addLeafGenome("Leaf2", "Anc1", 1);
+  Genome* leaf3 = alignment->addLeafGenome("Leaf3", "Root", 1);
+  const GenomeTree* tree = alignment->getGenomeTree();
+  CuAssertTrue(_testCase, tree->getNumGenomes() == 5);
+  CuAssertTrue(_testCase, tree->getDepth(leaf3->getGenomeId()) == 1);
+
+  // the tree (and the ids of open genomes) must follow modifications
+  alignment->insertGenome("Anc0", "Root", "Leaf3", 0.5);
+  tree = alignment->getGenomeTree();
+  CuAssertTrue(_testCase, tree->getNumGenomes() == 6);
+  CuAssertTrue(_testCase, tree->getName(leaf3->getGenomeId()) == "Leaf3");
+  CuAssertTrue(_testCase, tree->getDepth(leaf3->getGenomeId()) == 2);
+}
+
+void AlignmentTestGenomeTree::checkCallBack(hal::AlignmentConstPtr alignment)
+{
+  const GenomeTree* tree = alignment->getGenomeTree();
+  CuAssertTrue(_testCase, tree->getNumGenomes() == 6);
+  CuAssertTrue(_testCase, tree->getId("Root") == 0);
+  CuAssertTrue(_testCase, tree->getParentId(0) == NULL_INDEX);
+  CuAssertTrue(_testCase, tree->getId("Blarg") == NULL_INDEX);
+
+  const char* names[] = {"Root", "Anc0", "Anc1", "Leaf1", "Leaf2", "Leaf3"};
+  for (size_t i = 0; i < 6; ++i)
+  {
+    const Genome* genome = alignment->openGenome(names[i]);
+    CuAssertTrue(_testCase, genome->getGenomeId() < 6);
+    CuAssertTrue(_testCase, tree->getName(genome->getGenomeId()) == names[i]);
+    CuAssertTrue(_testCase, 
+                 tree->isLeaf(genome->getGenomeId()) == (names[i][0] == 'L'));
+  }
+  hal_size_t root = tree->getId("Root");
+  hal_size_t anc0 = tree->getId("Anc0");
+  hal_size_t anc1 = tree->getId("Anc1");
+  hal_size_t leaf1 = tree->getId("Leaf1");
+  hal_size_t leaf2 = tree->getId("Leaf2");
+  hal_size_t leaf3 = tree->getId("Leaf3");
+
+  CuAssertTrue(_testCase, (hal_size_t)tree->getParentId(leaf3) == anc0);
+  CuAssertTrue(_testCase, tree->getNumChildren(anc1) == 2);
+  CuAssertTrue(_testCase, tree->getChildId(anc1, 0) == leaf1);
+  CuAssertTrue(_testCase, tree->getChildId(anc1, 1) == leaf2);
+  CuAssertTrue(_testCase, tree->getDepth(leaf2) == 2);
+  CuAssertTrue(_testCase, tree->isAncestor(root, leaf3));
+  CuAssertTrue(_testCase, tree->isAncestor(leaf3, leaf3));
+  CuAssertTrue(_testCase, !tree->isAncestor(anc1, leaf3));
+  CuAssertTrue(_testCase, !tree->isAncestor(leaf1, anc1));
+
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(leaf1, leaf2) == anc1);
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(leaf2, leaf1) == anc1);
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(leaf1, leaf3) == root);
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(anc0, leaf3) == anc0);
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(leaf2, leaf2) == leaf2);
+  CuAssertTrue(_testCase, tree->isOnPath(anc1, leaf1, leaf3));
+  CuAssertTrue(_testCase, tree->isOnPath(root, leaf1, leaf3));
+  CuAssertTrue(_testCase, !tree->isOnPath(leaf2, leaf1, leaf3));
+  CuAssertTrue(_testCase, !tree->isOnPath(root, leaf1, leaf2));
+
+  GenomeSet inputs(tree->getNumGenomes());
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(inputs) == NULL_INDEX);
+  inputs.insert(leaf1);
+  inputs.insert(leaf3);
+  CuAssertTrue(_testCase, tree->getLowestCommonAncestor(inputs) == 
+               (hal_index_t)root);
+  GenomeSet spanning(tree->getNumGenomes());
+  tree->getSpanningTree(inputs, spanning);
+  CuAssertTrue(_testCase, spanning.size() == 5);
+  CuAssertTrue(_testCase, !spanning.contains(leaf2));
+  GenomeSet subTree(tree->getNumGenomes());
+  tree->getSubTree(anc1, subTree);
+  CuAssertTrue(_testCase, subTree.size() == 3);
+  CuAssertTrue(_testCase, subTree.contains(leaf2) && !subTree.contains(root));
+
+  // the halCommon versions are built on the above
+  set<const Genome*> inputSet;
+  inputSet.insert(alignment->openGenome("Leaf1"));
+  inputSet.insert(alignment->openGenome("Leaf2"));
+  CuAssertTrue(_testCase, 
+               getLowestCommonAncestor(inputSet)->getName() == "Anc1");
+  set<const Genome*> outputSet;
+  getGenomesInSpanningTree(inputSet, outputSet);
+  CuAssertTrue(_testCase, outputSet.size() == 3);
+  inputSet.insert(alignment->openGenome("Leaf3"));
+  getGenomesInSpanningTree(inputSet, outputSet);
+  CuAssertTrue(_testCase, outputSet.size() == 6);
+  inputSet.erase(alignment->openGenome("Leaf1"));
+  GenomeSet pathSet;
+  getGenomesInSpanningTree(inputSet, pathSet);
+  CuAssertTrue(_testCase, pathSet.getNumGenomes() == tree->getNumGenomes());
+  CuAssertTrue(_testCase, pathSet.size() == 5);
+  CuAssertTrue(_testCase, pathSet.contains(anc1) && !pathSet.contains(leaf1));
+
+  // sets that span several words
+  GenomeSet bigSet(130);
+  CuAssertTrue(_testCase, bigSet.empty() && bigSet.last() == NULL_INDEX);
+  bigSet.insert(0);
+  bigSet.insert(64);
+  bigSet.insert(129);
+  CuAssertTrue(_testCase, bigSet.size() == 3 && bigSet.last() == 129);
+  CuAssertTrue(_testCase, bigSet.next(NULL_INDEX) == 0);
+  CuAssertTrue(_testCase, bigSet.next(0) == 64);
+  CuAssertTrue(_testCase, bigSet.next(64) == 129);
+  CuAssertTrue(_testCase, bigSet.next(129) == NULL_INDEX);
+  bigSet.erase(64);
+  CuAssertTrue(_testCase, !bigSet.contains(64) && bigSet.next(0) == 129);
+}
+
 void AlignmentTestBadPathError::createCallBack(hal::AlignmentPtr alignment)
 {
   
@@ -178,6 +292,12 @@ void halAlignmentTestEmpty(CuTest *testCase)
   tester.check(testCase);
 }
 
+void halAlignmentTestGenomeTree(CuTest *testCase)
+{
+  AlignmentTestGenomeTree tester;
+  tester.check(testCase);
+}
+
 void halAlignmentTestBadPathError(CuTest *testCase)
 {
   AlignmentTestBadPathError tester;
@@ -189,6 +309,7 @@ CuSuite* halAlignmentTestSuite(void)
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halAlignmentTestTrees);
   SUITE_ADD_TEST(suite, halAlignmentTestEmpty);
+  SUITE_ADD_TEST(suite, halAlignmentTestGenomeTree);
   SUITE_ADD_TEST(suite, halAlignmentTestBadPathError);
   return suite;
 }
@@ -53,6 +53,12 @@ struct AlignmentTestEmpty : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct AlignmentTestGenomeTree : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 struct AlignmentTestBadPathError : public AlignmentTest
 {
    void createCallBack(hal::AlignmentPtr alignment);
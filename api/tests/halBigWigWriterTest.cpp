@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <zlib.h>
+#include "allTests.h"
+#include "hal.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+struct BigWigInterval
+{
+   string _chrom;
+   uint32_t _start;
+   uint32_t _end;
+   float _value;
+   bool operator==(const BigWigInterval& other) const {
+     return _chrom == other._chrom && _start == other._start &&
+        _end == other._end && _value == other._value;
+   }
+};
+
+struct BigWigSummary
+{
+   uint32_t _chrom;
+   uint32_t _start;
+   uint32_t _end;
+   uint32_t _validCount;
+   float _min;
+   float _max;
+   float _sum;
+   float _sumSquares;
+};
+
+/** A leaf of an R-tree index: the range of a compressed block and where
+ * to find it */
+struct BigWigLeaf
+{
+   uint32_t _startChrom;
+   uint32_t _startBase;
+   uint32_t _endChrom;
+   uint32_t _endBase;
+   uint64_t _offset;
+   uint64_t _size;
+};
+
+struct BigWigZoomLevel
+{
+   uint32_t _reduction;
+   uint32_t _count;
+   vector<BigWigLeaf> _leaves;
+   vector<BigWigSummary> _summaries;
+};
+
+/** Just enough of a bigWig reader to check the writer: walk the
+ * chromosome B+ tree and the R-trees of the full data and of the zoom
+ * levels, and decompress every block */
+struct BigWigReader
+{
+   BigWigReader(const char* path)
+   {
+     ifstream file(path, ios::binary);
+     stringstream ss;
+     ss << file.rdbuf();
+     _data = ss.str();
+   }
+
+   template <typename T> static T get(const char* data, uint64_t offset)
+   {
+     T value;
+     memcpy(&value, data + offset, sizeof(T));
+     return value;
+   }
+
+   template <typename T> T get(uint64_t offset) const
+   {
+     return get<T>(_data.data(), offset);
+   }
+
+   void readChromTree(uint64_t offset, uint32_t keySize)
+   {
+     bool isLeaf = get<uint8_t>(offset) != 0;
+     uint16_t count = get<uint16_t>(offset + 2);
+     offset += 4;
+     for (uint16_t i = 0; i < count; ++i)
+     {
+       string key = _data.substr(offset, keySize).c_str();
+       offset += keySize;
+       if (isLeaf)
+       {
+         _chroms[get<uint32_t>(offset)] = key;
+         _chromLengths[key] = get<uint32_t>(offset + 4);
+         offset += 8;
+       }
+       else
+       {
+         readChromTree(get<uint64_t>(offset), keySize);
+         offset += 8;
+       }
+     }
+   }
+
+   void readRTree(uint64_t offset, vector<BigWigLeaf>& leaves) const
+   {
+     bool isLeaf = get<uint8_t>(offset) != 0;
+     uint16_t count = get<uint16_t>(offset + 2);
+     offset += 4;
+     for (uint16_t i = 0; i < count; ++i)
+     {
+       uint64_t childOffset = get<uint64_t>(offset + 16);
+       if (isLeaf == false)
+       {
+         readRTree(childOffset, leaves);
+         offset += 24;
+         continue;
+       }
+       BigWigLeaf leaf;
+       leaf._startChrom = get<uint32_t>(offset);
+       leaf._startBase = get<uint32_t>(offset + 4);
+       leaf._endChrom = get<uint32_t>(offset + 8);
+       leaf._endBase = get<uint32_t>(offset + 12);
+       leaf._offset = childOffset;
+       leaf._size = get<uint64_t>(offset + 24);
+       leaves.push_back(leaf);
+       offset += 32;
+     }
+   }
+
+   uLongf uncompressLeaf(const BigWigLeaf& leaf, vector<char>& buffer) const
+   {
+     buffer.resize(_bufSize);
+     uLongf length = _bufSize;
+     uncompress(reinterpret_cast<Bytef*>(&buffer[0]), &length,
+                reinterpret_cast<const Bytef*>(_data.data() + leaf._offset),
+                leaf._size);
+     return length;
+   }
+
+   void readSections(const vector<BigWigLeaf>& leaves)
+   {
+     vector<char> buffer;
+     for (size_t i = 0; i < leaves.size(); ++i)
+     {
+       uncompressLeaf(leaves[i], buffer);
+       const char* section = &buffer[0];
+       uint16_t numItems = get<uint16_t>(section, 22);
+       for (uint16_t j = 0; j < numItems; ++j)
+       {
+         BigWigInterval interval;
+         interval._chrom = _chroms[get<uint32_t>(section, 0)];
+         interval._start = get<uint32_t>(section, 24 + j * 12);
+         interval._end = get<uint32_t>(section, 28 + j * 12);
+         interval._value = get<float>(section, 32 + j * 12);
+         _intervals.push_back(interval);
+       }
+     }
+   }
+
+   void readZoomLevel(uint64_t headerOffset)
+   {
+     BigWigZoomLevel level;
+     level._reduction = get<uint32_t>(headerOffset);
+     level._count = get<uint32_t>(get<uint64_t>(headerOffset + 8));
+     readRTree(get<uint64_t>(headerOffset + 16) + 48, level._leaves);
+     vector<char> buffer;
+     for (size_t i = 0; i < level._leaves.size(); ++i)
+     {
+       uLongf length = uncompressLeaf(level._leaves[i], buffer);
+       for (uLongf j = 0; j + 32 <= length; j += 32)
+       {
+         BigWigSummary summary;
+         memcpy(&summary, &buffer[j], sizeof(summary));
+         level._summaries.push_back(summary);
+       }
+     }
+     _zoomLevels.push_back(level);
+   }
+
+   bool read()
+   {
+     if (_data.length() < 64 || get<uint32_t>(0) != 0x888FFC26)
+     {
+       return false;
+     }
+     uint64_t chromTree = get<uint64_t>(8);
+     readChromTree(chromTree + 32, get<uint32_t>(chromTree + 8));
+     _bufSize = get<uint32_t>(52);
+     vector<BigWigLeaf> leaves;
+     readRTree(get<uint64_t>(24) + 48, leaves);
+     readSections(leaves);
+     for (uint16_t i = 0; i < get<uint16_t>(6); ++i)
+     {
+       readZoomLevel(64 + i * 24);
+     }
+     return true;
+   }
+
+   string _data;
+   uint32_t _bufSize;
+   map<uint32_t, string> _chroms;
+   map<string, uint32_t> _chromLengths;
+   vector<BigWigInterval> _intervals;
+   vector<BigWigZoomLevel> _zoomLevels;
+};
+
+/** Check the summaries of a zoom level against the intervals they
+ * summarize, and the index against the summaries in each block */
+static void checkZoomLevel(CuTest* testCase, const BigWigReader& reader,
+                           const BigWigZoomLevel& level)
+{
+  CuAssertTrue(testCase, level._summaries.size() == level._count);
+  CuAssertTrue(testCase, level._leaves.empty() == false);
+  uint64_t bases = 0;
+  for (size_t i = 0; i < level._summaries.size(); ++i)
+  {
+    const BigWigSummary& summary = level._summaries[i];
+    CuAssertTrue(testCase, summary._start < summary._end);
+    CuAssertTrue(testCase, summary._end - summary._start <=
+                 level._reduction);
+    if (i > 0)
+    {
+      const BigWigSummary& prev = level._summaries[i - 1];
+      CuAssertTrue(testCase, prev._chrom < summary._chrom ||
+                   (prev._chrom == summary._chrom &&
+                    prev._end <= summary._start));
+    }
+    const string& chrom = reader._chroms.find(summary._chrom)->second;
+    uint32_t validCount = 0;
+    float minVal = 0;
+    float maxVal = 0;
+    double sum = 0;
+    double sumSquares = 0;
+    for (size_t j = 0; j < reader._intervals.size(); ++j)
+    {
+      const BigWigInterval& interval = reader._intervals[j];
+      uint32_t start = max(interval._start, summary._start);
+      uint32_t end = min(interval._end, summary._end);
+      if (interval._chrom != chrom || start >= end)
+      {
+        continue;
+      }
+      if (validCount == 0)
+      {
+        minVal = interval._value;
+        maxVal = interval._value;
+      }
+      validCount += end - start;
+      minVal = min(minVal, interval._value);
+      maxVal = max(maxVal, interval._value);
+      sum += (double)interval._value * (end - start);
+      sumSquares += (double)interval._value * interval._value *
+         (end - start);
+    }
+    CuAssertTrue(testCase, summary._validCount == validCount);
+    CuAssertTrue(testCase, summary._min == minVal);
+    CuAssertTrue(testCase, summary._max == maxVal);
+    CuAssertTrue(testCase, fabs(summary._sum - sum) < 1e-3 * (1 + sum));
+    CuAssertTrue(testCase, fabs(summary._sumSquares - sumSquares) <
+                 1e-3 * (1 + sumSquares));
+    bases += validCount;
+  }
+  uint64_t totalBases = 0;
+  for (size_t i = 0; i < reader._intervals.size(); ++i)
+  {
+    totalBases += reader._intervals[i]._end - reader._intervals[i]._start;
+  }
+  CuAssertTrue(testCase, bases == totalBases);
+
+  // each block of the index is bounded by its first and last summaries
+  size_t first = 0;
+  for (size_t i = 0; i < level._leaves.size(); ++i)
+  {
+    const BigWigLeaf& leaf = level._leaves[i];
+    vector<char> buffer;
+    size_t count = reader.uncompressLeaf(leaf, buffer) / 32;
+    CuAssertTrue(testCase, count > 0 &&
+                 first + count <= level._summaries.size());
+    const BigWigSummary& front = level._summaries[first];
+    const BigWigSummary& back = level._summaries[first + count - 1];
+    CuAssertTrue(testCase, leaf._startChrom == front._chrom &&
+                 leaf._startBase == front._start);
+    CuAssertTrue(testCase, leaf._endChrom == back._chrom &&
+                 leaf._endBase == back._end);
+    first += count;
+  }
+}
+
+static void halBigWigWriterTest(CuTest *testCase)
+{
+  char* path = getTempFile();
+  vector<BigWigInterval> intervals;
+  // small slots and blocks so that the trees have several levels
+  BigWigWriter writer(path, 5, 3);
+  for (size_t i = 0; i < 20; ++i)
+  {
+    stringstream name;
+    name << "seq" << (i * 7) % 20;
+    writer.setSequence(name.str(), 1000 + i);
+    for (uint32_t start = i; start < 1000; start += 10 + i % 3)
+    {
+      BigWigInterval interval;
+      interval._chrom = name.str();
+      interval._start = start;
+      interval._end = start + 1 + i % 5;
+      interval._value = (float)(start % 7) / 2.f;
+      writer.addInterval(interval._start, interval._end, interval._value);
+      intervals.push_back(interval);
+    }
+  }
+  writer.close();
+
+  BigWigReader reader(path);
+  CuAssertTrue(testCase, reader.read());
+  CuAssertTrue(testCase, reader._chroms.size() == 20);
+  CuAssertTrue(testCase, reader._chromLengths["seq7"] == 1001);
+  CuAssertTrue(testCase, reader._intervals == intervals);
+  CuAssertTrue(testCase, reader._zoomLevels.size() > 1);
+  for (size_t i = 0; i < reader._zoomLevels.size(); ++i)
+  {
+    const BigWigZoomLevel& level = reader._zoomLevels[i];
+    if (i > 0)
+    {
+      CuAssertTrue(testCase, level._reduction >
+                   reader._zoomLevels[i - 1]._reduction);
+      CuAssertTrue(testCase, level._count * 2 <=
+                   reader._zoomLevels[i - 1]._count);
+    }
+    checkZoomLevel(testCase, reader, level);
+  }
+  removeTempFile(path);
+}
+
+static void halBigWigWriterMergeTest(CuTest *testCase)
+{
+  char* path = getTempFile();
+  BigWigWriter writer(path);
+  writer.setSequence("chr1", 100);
+  writer.addInterval(0, 10, 1.);
+  writer.addInterval(10, 20, 1.);
+  writer.addInterval(20, 21, 2.);
+  writer.addInterval(30, 40, 2.);
+
+  bool threw = false;
+  try
+  {
+    writer.addInterval(35, 50, 3.);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(testCase, threw);
+  threw = false;
+  try
+  {
+    writer.setSequence("chr1", 100);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(testCase, threw);
+  writer.close();
+
+  BigWigReader reader(path);
+  CuAssertTrue(testCase, reader.read());
+  CuAssertTrue(testCase, reader._intervals.size() == 3);
+  CuAssertTrue(testCase, reader._intervals[0]._start == 0 &&
+               reader._intervals[0]._end == 20);
+  CuAssertTrue(testCase, reader._intervals[1]._start == 20 &&
+               reader._intervals[1]._end == 21);
+  removeTempFile(path);
+}
+
+CuSuite* halBigWigWriterTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halBigWigWriterTest);
+  SUITE_ADD_TEST(suite, halBigWigWriterMergeTest);
+  return suite;
+}
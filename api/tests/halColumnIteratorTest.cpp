@@ -312,6 +312,49 @@ void ColumnIteratorDupTest::checkCallBack(AlignmentConstPtr alignment)
   checkGenome(genome);
 }
 
+void ColumnIteratorFlatTest::checkGenome(const Genome* genome)
+{
+  assert(genome != NULL);
+  const Sequence* sequence = genome->getSequenceBySite(0);
+  // only ask one of the iterators for the map, so that the other one
+  // never builds it
+  ColumnIteratorConstPtr flatIterator = sequence->getColumnIterator();
+  ColumnIteratorConstPtr mapIterator = sequence->getColumnIterator();
+  for (size_t colNumber = 0; colNumber < genome->getSequenceLength(); 
+       flatIterator->toRight(), mapIterator->toRight(), ++colNumber)
+  {
+    const ColumnIterator::FlatColumn* flatColumn = 
+       flatIterator->getFlatColumn();
+    const ColumnIterator::ColumnMap* colMap = mapIterator->getColumnMap();
+    CuAssertTrue(_testCase, 
+                 mapIterator->getFlatColumn()->size() == flatColumn->size());
+
+    ColumnIterator::FlatColumn::const_iterator j = flatColumn->begin();
+    for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+         i != colMap->end(); ++i)
+    {
+      for (size_t k = 0; k < i->second->size(); ++k, ++j)
+      {
+        DNAIteratorConstPtr dnaIt = i->second->at(k);
+        CuAssertTrue(_testCase, j != flatColumn->end());
+        CuAssertTrue(_testCase, j->_sequence == i->first);
+        CuAssertTrue(_testCase, j->_position == dnaIt->getArrayIndex());
+        CuAssertTrue(_testCase, j->_reversed == dnaIt->getReversed());
+        CuAssertTrue(_testCase, j->_dna->getChar() == dnaIt->getChar());
+      }
+    }
+    CuAssertTrue(_testCase, j == flatColumn->end());
+  }
+}
+
+void ColumnIteratorFlatTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  validateAlignment(alignment);
+  checkGenome(alignment->openGenome("dad"));
+  checkGenome(alignment->openGenome("son1"));
+  checkGenome(alignment->openGenome("son2"));
+}
+
 void ColumnIteratorInvTest::createCallBack(AlignmentPtr alignment)
 {
   double branchLength = 1e-10;
@@ -1018,29 +1061,53 @@ void ColumnIteratorPositionCacheTest::checkCallBack(AlignmentConstPtr alignment)
   size_t sizes[] = {10, 100, 1000, 2000, 3000, 4000, 5000, 6000, 10000, 1000000};
   size_t entries = 10000;
   set<hal_index_t> truth;
-  PositionCache cache;
   srand(time(NULL));
 
-  for (size_t i = 0; i < trials; ++i)
+  PositionCache::Type types[] = {PositionCache::IntervalType, 
+                                 PositionCache::BitmapType};
+  for (size_t t = 0; t < 2; ++t)
   {
-    for (size_t j = 0; j < entries; ++j)
+    PositionCache cache(types[t]);
+    PositionCache intervalCache(PositionCache::IntervalType);
+    for (size_t i = 0; i < trials; ++i)
     {
-      hal_index_t val = (hal_index_t)rand() % sizes[i];
-      bool r = truth.insert(val).second;
-      bool r2 = cache.insert(val);
-      CuAssertTrue(_testCase, r == r2);
-      CuAssertTrue(_testCase, truth.size() == cache.size());
-    }
-    CuAssertTrue(_testCase, cache.check());
-    for (size_t j = 0; j < entries * 2; ++j)
-    {
-      hal_index_t val = (hal_index_t)rand() % sizes[i];
-      bool r = truth.find(val) != truth.end();
-      bool r2 = cache.find(val);
-      CuAssertTrue(_testCase, r == r2);
+      for (size_t j = 0; j < entries; ++j)
+      {
+        hal_index_t val = (hal_index_t)rand() % sizes[i];
+        bool r = truth.insert(val).second;
+        bool r2 = cache.insert(val);
+        intervalCache.insert(val);
+        CuAssertTrue(_testCase, r == r2);
+        CuAssertTrue(_testCase, truth.size() == cache.size());
+      }
+      CuAssertTrue(_testCase, cache.check());
+      for (size_t j = 0; j < entries * 2; ++j)
+      {
+        hal_index_t val = (hal_index_t)rand() % sizes[i];
+        bool r = truth.find(val) != truth.end();
+        bool r2 = cache.find(val);
+        CuAssertTrue(_testCase, r == r2);
+      }
+      PositionCache copy(cache);
+      CuAssertTrue(_testCase, copy.check());
+      CuAssertTrue(_testCase, *copy.getIntervalSet() == 
+                   *intervalCache.getIntervalSet());
+      // the assigned cache mustn't look at the blocks of the original
+      PositionCache assigned;
+      assigned = cache;
+      cache.clear();
+      CuAssertTrue(_testCase, assigned.getType() == types[t]);
+      CuAssertTrue(_testCase, assigned.size() == truth.size());
+      for (size_t j = 0; j < entries * 2; ++j)
+      {
+        hal_index_t val = (hal_index_t)rand() % sizes[i];
+        bool r = truth.find(val) != truth.end();
+        CuAssertTrue(_testCase, r == assigned.find(val));
+      }
+      truth.clear();
+      cache.clear();
+      intervalCache.clear();
     }
-    truth.clear();
-    cache.clear();
   }
 }
 
@@ -1083,6 +1150,19 @@ void halColumnIteratorDupTest(CuTest *testCase)
   } 
 }
 
+void halColumnIteratorFlatTest(CuTest *testCase)
+{
+  try 
+  {
+    ColumnIteratorFlatTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
 void halColumnIteratorInvTest(CuTest *testCase)
 {
   try 
@@ -1154,6 +1234,7 @@ CuSuite* halColumnIteratorTestSuite(void)
   SUITE_ADD_TEST(suite, halColumnIteratorBaseTest);
   SUITE_ADD_TEST(suite, halColumnIteratorDepthTest); 
   SUITE_ADD_TEST(suite, halColumnIteratorDupTest);
+  SUITE_ADD_TEST(suite, halColumnIteratorFlatTest);
   SUITE_ADD_TEST(suite, halColumnIteratorInvTest); 
   SUITE_ADD_TEST(suite, halColumnIteratorGapTest);
   SUITE_ADD_TEST(suite, halColumnIteratorMultiGapTest);
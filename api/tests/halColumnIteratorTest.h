@@ -57,6 +57,12 @@ struct ColumnIteratorMultiGapInvTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ColumnIteratorFlatTest : public ColumnIteratorDupTest
+{
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkGenome(const hal::Genome* genome);
+};
+
 struct ColumnIteratorPositionCacheTest : public AlignmentTest
 {
    void createCallBack(hal::AlignmentPtr alignment);
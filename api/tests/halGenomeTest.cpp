@@ -17,6 +17,7 @@
 #include "halMetaData.h"
 #include "halTopSegmentIterator.h"
 #include "halColumnIterator.h"
+#include "halAlignmentInstance.h"
 extern "C" {
 #include "commonC.h"
 }
@@ -145,6 +146,40 @@ void GenomeStringTest::checkCallBack(AlignmentConstPtr alignment)
   string genomeString;
   ancGenome->getString(genomeString);
   CuAssertTrue(_testCase, genomeString == _string);
+
+  // runs of odd lengths starting at odd offsets
+  hal_size_t offsets[3] = {0, 1, 1234567};
+  hal_size_t lengths[3] = {1, 33, 100001};
+  for (size_t i = 0; i < 3; ++i)
+  {
+    for (size_t j = 0; j < 3; ++j)
+    {
+      string subString;
+      ancGenome->getSubString(subString, offsets[i], lengths[j]);
+      CuAssertTrue(_testCase, subString == 
+                   _string.substr(offsets[i], lengths[j]));
+    }
+  }
+
+  PositionRuns maskedRuns;
+  getMaskedRuns(ancGenome, 1, _string.length() - 1, maskedRuns);
+  PositionRuns expectedRuns;
+  for (size_t i = 1; i < _string.length(); ++i)
+  {
+    if (isMasked(_string[i]) == true)
+    {
+      if (expectedRuns.empty() == false &&
+          expectedRuns.back().second + 1 == (hal_index_t)i)
+      {
+        ++expectedRuns.back().second;
+      }
+      else
+      {
+        expectedRuns.push_back(pair<hal_index_t, hal_index_t>(i, i));
+      }
+    }
+  }
+  CuAssertTrue(_testCase, maskedRuns == expectedRuns);
 }
 
 void GenomeCopyTest::createCallBack(AlignmentPtr alignment)
@@ -543,6 +578,242 @@ void GenomeCopySegmentsWhenSequencesOutOfOrderTest::checkCallBack(hal::Alignment
   remove(_path.c_str());
 }
 
+// every segment is one base long and gets different values, so that
+// records moved to the wrong place show up
+static Genome::TopSegmentRecord makeTopRecord(hal_size_t i, hal_size_t n)
+{
+  Genome::TopSegmentRecord record;
+  record._startPosition = i;
+  record._length = 1;
+  record._parentIndex = n - 1 - i;
+  record._parentReversed = i % 3 == 0;
+  record._bottomParseIndex = NULL_INDEX;
+  record._nextParalogyIndex = i % 5 == 0 && i + 1 < n ? 
+     (hal_index_t)i + 1 : NULL_INDEX;
+  return record;
+}
+
+static Genome::BottomSegmentRecord makeBottomRecord(hal_size_t i)
+{
+  Genome::BottomSegmentRecord record;
+  record._startPosition = i;
+  record._length = 1;
+  record._topParseIndex = NULL_INDEX;
+  return record;
+}
+
+static Genome::ChildRecord makeChildRecord(hal_size_t i, hal_size_t n)
+{
+  Genome::ChildRecord record;
+  record._childIndex = n - 1 - i;
+  record._childReversed = i % 3 == 0;
+  return record;
+}
+
+static bool operator==(const Genome::TopSegmentRecord& a,
+                       const Genome::TopSegmentRecord& b)
+{
+  return a._startPosition == b._startPosition && a._length == b._length &&
+     a._parentIndex == b._parentIndex && 
+     a._parentReversed == b._parentReversed &&
+     a._bottomParseIndex == b._bottomParseIndex &&
+     a._nextParalogyIndex == b._nextParalogyIndex;
+}
+
+static bool operator==(const Genome::BottomSegmentRecord& a,
+                       const Genome::BottomSegmentRecord& b)
+{
+  return a._startPosition == b._startPosition && a._length == b._length &&
+     a._topParseIndex == b._topParseIndex;
+}
+
+static bool operator==(const Genome::ChildRecord& a,
+                       const Genome::ChildRecord& b)
+{
+  return a._childIndex == b._childIndex && 
+     a._childReversed == b._childReversed;
+}
+
+// Test the segment record methods, with genomes that have more segments
+// than the copy methods move at a time
+void GenomeSegmentRecordTest::createCallBack(AlignmentPtr alignment)
+{
+  _numSegments = Genome::copyBlockSegments + 10;
+  hal_size_t n = _numSegments;
+  Genome* rootGenome = alignment->addRootGenome("root", 0);
+  Genome* leafGenome = alignment->addLeafGenome("leaf", "root", 0);
+  vector<Sequence::Info> seqVec(1);
+  seqVec[0] = Sequence::Info("Sequence", n, 0, n);
+  rootGenome->setDimensions(seqVec);
+  seqVec[0] = Sequence::Info("Sequence", n, n, 0);
+  leafGenome->setDimensions(seqVec);
+
+  // write the arrays in two runs, the second not starting at 0
+  vector<Genome::TopSegmentRecord> topRecords;
+  vector<Genome::BottomSegmentRecord> bottomRecords;
+  vector<Genome::ChildRecord> children;
+  hal_size_t split = 5;
+  for (hal_size_t i = 0; i < n; ++i)
+  {
+    if (i == split)
+    {
+      leafGenome->setTopSegmentRecords(0, topRecords);
+      rootGenome->setBottomSegmentRecords(0, bottomRecords, children);
+      topRecords.clear();
+      bottomRecords.clear();
+      children.clear();
+    }
+    topRecords.push_back(makeTopRecord(i, n));
+    bottomRecords.push_back(makeBottomRecord(i));
+    children.push_back(makeChildRecord(i, n));
+  }
+  leafGenome->setTopSegmentRecords(split, topRecords);
+  rootGenome->setBottomSegmentRecords(split, bottomRecords, children);
+
+  // runs that go past the end of the array
+  bool threw = false;
+  try
+  {
+    leafGenome->setTopSegmentRecords(n - 1, vector<Genome::TopSegmentRecord>(
+                                       2, makeTopRecord(0, n)));
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+  threw = false;
+  try
+  {
+    rootGenome->setBottomSegmentRecords(
+      n - 1, vector<Genome::BottomSegmentRecord>(2, makeBottomRecord(0)),
+      vector<Genome::ChildRecord>(2, makeChildRecord(0, n)));
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+}
+
+void GenomeSegmentRecordTest::checkRecords(const Genome* rootGenome,
+                                           const Genome* leafGenome)
+{
+  hal_size_t n = _numSegments;
+  CuAssertTrue(_testCase, leafGenome->getNumTopSegments() == n);
+  CuAssertTrue(_testCase, rootGenome->getNumBottomSegments() == n);
+  CuAssertTrue(_testCase, rootGenome->getNumChildren() == 1);
+
+  // what was written is what the segments see
+  TopSegmentIteratorConstPtr topIt = leafGenome->getTopSegmentIterator();
+  BottomSegmentIteratorConstPtr botIt = rootGenome->getBottomSegmentIterator();
+  for (hal_size_t i = 0; i < n; ++i)
+  {
+    Genome::TopSegmentRecord top = makeTopRecord(i, n);
+    CuAssertTrue(_testCase, topIt->getStartPosition() == top._startPosition);
+    CuAssertTrue(_testCase, topIt->getLength() == top._length);
+    CuAssertTrue(_testCase, topIt->getParentIndex() == top._parentIndex);
+    CuAssertTrue(_testCase, 
+                 topIt->getParentReversed() == top._parentReversed);
+    CuAssertTrue(_testCase, 
+                 topIt->getNextParalogyIndex() == top._nextParalogyIndex);
+    Genome::ChildRecord child = makeChildRecord(i, n);
+    CuAssertTrue(_testCase, botIt->getStartPosition() == (hal_index_t)i);
+    CuAssertTrue(_testCase, botIt->getLength() == 1);
+    CuAssertTrue(_testCase, botIt->getChildIndex(0) == child._childIndex);
+    CuAssertTrue(_testCase, 
+                 botIt->getChildReversed(0) == child._childReversed);
+    topIt->toRight();
+    botIt->toRight();
+  }
+
+  // whole arrays, then runs across the seams between the blocks of
+  // the copy methods and at the end of the arrays
+  hal_size_t starts[] = {0, Genome::copyBlockSegments - 3, n - 4};
+  hal_size_t counts[] = {n, 6, 4};
+  vector<Genome::TopSegmentRecord> topRecords;
+  vector<Genome::BottomSegmentRecord> bottomRecords;
+  vector<Genome::ChildRecord> children;
+  for (size_t run = 0; run < 3; ++run)
+  {
+    leafGenome->getTopSegmentRecords(starts[run], counts[run], topRecords);
+    rootGenome->getBottomSegmentRecords(starts[run], counts[run],
+                                        bottomRecords, children);
+    CuAssertTrue(_testCase, topRecords.size() == counts[run]);
+    CuAssertTrue(_testCase, bottomRecords.size() == counts[run]);
+    CuAssertTrue(_testCase, children.size() == counts[run]);
+    for (hal_size_t j = 0; j < counts[run]; ++j)
+    {
+      hal_size_t i = starts[run] + j;
+      CuAssertTrue(_testCase, topRecords[j] == makeTopRecord(i, n));
+      CuAssertTrue(_testCase, bottomRecords[j] == makeBottomRecord(i));
+      CuAssertTrue(_testCase, children[j] == makeChildRecord(i, n));
+    }
+  }
+
+  bool threw = false;
+  try
+  {
+    leafGenome->getTopSegmentRecords(n - 1, 2, topRecords);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+  threw = false;
+  try
+  {
+    rootGenome->getBottomSegmentRecords(n - 1, 2, bottomRecords, children);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+}
+
+void GenomeSegmentRecordTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  checkRecords(alignment->openGenome("root"), alignment->openGenome("leaf"));
+
+  // the mmap backend reads its own records
+  char* mmapPath = getTempFile();
+  writeMMapAlignment(alignment, mmapPath);
+  AlignmentConstPtr mmapAlignment =
+     openHalAlignmentReadOnly(mmapPath, CLParserConstPtr());
+  const Genome* mmapRootGenome = mmapAlignment->openGenome("root");
+  const Genome* mmapLeafGenome = mmapAlignment->openGenome("leaf");
+  checkRecords(mmapRootGenome, mmapLeafGenome);
+
+  // the copy methods move the records in several blocks
+  char* copyPath = getTempFile();
+  AlignmentPtr copyAlignment = getTestAlignmentInstances()[0];
+  copyAlignment->createNew(copyPath);
+  Genome* copyRootGenome = copyAlignment->addRootGenome("root", 0);
+  Genome* copyLeafGenome = copyAlignment->addLeafGenome("leaf", "root", 0);
+  hal_size_t n = _numSegments;
+  vector<Sequence::Info> seqVec(1);
+  seqVec[0] = Sequence::Info("Sequence", n, 0, n);
+  copyRootGenome->setDimensions(seqVec);
+  seqVec[0] = Sequence::Info("Sequence", n, n, 0);
+  copyLeafGenome->setDimensions(seqVec);
+  mmapRootGenome->copyBottomSegments(copyRootGenome);
+  mmapLeafGenome->copyTopSegments(copyLeafGenome);
+  checkRecords(copyRootGenome, copyLeafGenome);
+
+  copyAlignment->close();
+  removeTempFile(copyPath);
+  mmapAlignment->close();
+  removeTempFile(mmapPath);
+}
+
+void halGenomeSegmentRecordTest(CuTest *testCase)
+{
+  GenomeSegmentRecordTest tester;
+  tester.check(testCase);
+}
+
 void halGenomeCopySegmentsWhenSequencesOutOfOrderTest(CuTest *testCase)
 {
     GenomeCopySegmentsWhenSequencesOutOfOrderTest tester;
@@ -616,6 +887,7 @@ CuSuite* halGenomeTestSuite(void)
   // SUITE_ADD_TEST(suite, halGenomeStringTest);
 //  SUITE_ADD_TEST(suite, halGenomeCopyTest);
   SUITE_ADD_TEST(suite, halGenomeCopySegmentsWhenSequencesOutOfOrderTest);
+  SUITE_ADD_TEST(suite, halGenomeSegmentRecordTest);
   return suite;
 }
 
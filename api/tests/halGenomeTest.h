@@ -53,4 +53,13 @@ struct GenomeCopySegmentsWhenSequencesOutOfOrderTest : public AlignmentTest
    hal::AlignmentPtr _secondAlignment;
 };
 
+struct GenomeSegmentRecordTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkRecords(const hal::Genome* rootGenome, 
+                     const hal::Genome* leafGenome);
+   hal_size_t _numSegments;
+};
+
 #endif
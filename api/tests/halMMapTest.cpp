@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <deque>
+#include <pthread.h>
+#include "halAlignmentTest.h"
+#include "halMMapTest.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+void MMapSmallTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment,
+                        0.75,
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+  alignment->getMetaData()->set("mmapTestKey", "mmapTestValue");
+}
+
+void MMapSmallTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  char* mmapPath = getTempFile();
+  writeMMapAlignment(alignment, mmapPath);
+  AlignmentConstPtr mmapAlignment =
+     openHalAlignmentReadOnly(mmapPath, CLParserConstPtr());
+
+  CuAssertTrue(_testCase,
+               mmapAlignment->getNewickTree() == alignment->getNewickTree());
+  CuAssertTrue(_testCase,
+               mmapAlignment->getNumGenomes() == alignment->getNumGenomes());
+  CuAssertTrue(_testCase, mmapAlignment->getMetaData()->getMap() ==
+               alignment->getMetaData()->getMap());
+  CuAssertTrue(_testCase,
+               mmapAlignment->getMetaData()->get("mmapTestKey") ==
+               "mmapTestValue");
+
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    checkGenome(alignment->openGenome(name), mmapAlignment->openGenome(name));
+    vector<string> childNames = alignment->getChildNames(name);
+    CuAssertTrue(_testCase, childNames == mmapAlignment->getChildNames(name));
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+
+  validateAlignment(mmapAlignment);
+
+  // the file can't be opened for writing
+  bool threw = false;
+  try
+  {
+    openHalAlignment(mmapPath, CLParserConstPtr());
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+
+  mmapAlignment->close();
+  removeTempFile(mmapPath);
+}
+
+void MMapSmallTest::checkGenome(const Genome* genome,
+                                const Genome* mmapGenome)
+{
+  CuAssertTrue(_testCase, genome != NULL && mmapGenome != NULL);
+  CuAssertTrue(_testCase, mmapGenome->getName() == genome->getName());
+  CuAssertTrue(_testCase,
+               mmapGenome->getSequenceLength() == genome->getSequenceLength());
+  CuAssertTrue(_testCase,
+               mmapGenome->getNumSequences() == genome->getNumSequences());
+  CuAssertTrue(_testCase,
+               mmapGenome->getNumTopSegments() == genome->getNumTopSegments());
+  CuAssertTrue(_testCase, mmapGenome->getNumBottomSegments() ==
+               genome->getNumBottomSegments());
+  CuAssertTrue(_testCase,
+               mmapGenome->getNumChildren() == genome->getNumChildren());
+  CuAssertTrue(_testCase,
+               mmapGenome->containsDNAArray() == genome->containsDNAArray());
+  CuAssertTrue(_testCase, mmapGenome->getMetaData()->getMap() ==
+               genome->getMetaData()->getMap());
+
+  string dna, mmapDNA;
+  genome->getString(dna);
+  mmapGenome->getString(mmapDNA);
+  CuAssertTrue(_testCase, dna == mmapDNA);
+
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr mmapSeqIt = mmapGenome->getSequenceIterator();
+  for (hal_size_t i = 0; i < genome->getNumSequences(); ++i)
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    const Sequence* mmapSequence = mmapSeqIt->getSequence();
+    CuAssertTrue(_testCase, mmapSequence->getName() == sequence->getName());
+    CuAssertTrue(_testCase, mmapSequence->getStartPosition() ==
+                 sequence->getStartPosition());
+    CuAssertTrue(_testCase, mmapSequence->getSequenceLength() ==
+                 sequence->getSequenceLength());
+    CuAssertTrue(_testCase, mmapSequence->getTopSegmentArrayIndex() ==
+                 sequence->getTopSegmentArrayIndex());
+    CuAssertTrue(_testCase, mmapSequence->getNumTopSegments() ==
+                 sequence->getNumTopSegments());
+    CuAssertTrue(_testCase, mmapSequence->getBottomSegmentArrayIndex() ==
+                 sequence->getBottomSegmentArrayIndex());
+    CuAssertTrue(_testCase, mmapSequence->getNumBottomSegments() ==
+                 sequence->getNumBottomSegments());
+    CuAssertTrue(_testCase,
+                 mmapGenome->getSequence(sequence->getName()) == mmapSequence);
+    if (sequence->getSequenceLength() > 0)
+    {
+      CuAssertTrue(_testCase, mmapGenome->getSequenceBySite(
+                     mmapSequence->getEndPosition()) == mmapSequence);
+    }
+    seqIt->toNext();
+    mmapSeqIt->toNext();
+  }
+
+  TopSegmentIteratorConstPtr topIt = genome->getTopSegmentIterator();
+  TopSegmentIteratorConstPtr mmapTopIt = mmapGenome->getTopSegmentIterator();
+  for (hal_size_t i = 0; i < genome->getNumTopSegments(); ++i)
+  {
+    const TopSegment* top = topIt->getTopSegment();
+    const TopSegment* mmapTop = mmapTopIt->getTopSegment();
+    CuAssertTrue(_testCase,
+                 mmapTop->getStartPosition() == top->getStartPosition());
+    CuAssertTrue(_testCase, mmapTop->getLength() == top->getLength());
+    CuAssertTrue(_testCase,
+                 mmapTop->getParentIndex() == top->getParentIndex());
+    CuAssertTrue(_testCase,
+                 mmapTop->getParentReversed() == top->getParentReversed());
+    CuAssertTrue(_testCase,
+                 mmapTop->getBottomParseIndex() == top->getBottomParseIndex());
+    CuAssertTrue(_testCase, mmapTop->getNextParalogyIndex() ==
+                 top->getNextParalogyIndex());
+    topIt->toRight();
+    mmapTopIt->toRight();
+  }
+
+  BottomSegmentIteratorConstPtr botIt = genome->getBottomSegmentIterator();
+  BottomSegmentIteratorConstPtr mmapBotIt =
+     mmapGenome->getBottomSegmentIterator();
+  for (hal_size_t i = 0; i < genome->getNumBottomSegments(); ++i)
+  {
+    const BottomSegment* bot = botIt->getBottomSegment();
+    const BottomSegment* mmapBot = mmapBotIt->getBottomSegment();
+    CuAssertTrue(_testCase,
+                 mmapBot->getStartPosition() == bot->getStartPosition());
+    CuAssertTrue(_testCase, mmapBot->getLength() == bot->getLength());
+    CuAssertTrue(_testCase,
+                 mmapBot->getTopParseIndex() == bot->getTopParseIndex());
+    for (hal_size_t j = 0; j < genome->getNumChildren(); ++j)
+    {
+      CuAssertTrue(_testCase,
+                   mmapBot->getChildIndex(j) == bot->getChildIndex(j));
+      // the reversed flag of a missing child isn't set in HDF5 files
+      CuAssertTrue(_testCase, bot->getChildIndex(j) == NULL_INDEX ||
+                   mmapBot->getChildReversed(j) == bot->getChildReversed(j));
+    }
+    botIt->toRight();
+    mmapBotIt->toRight();
+  }
+}
+
+void MMapConcurrentReadTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment,
+                        0.75,
+                        0.1,
+                        6,
+                        10,
+                        2000,
+                        5,
+                        10);
+}
+
+/** What each reader thread checks, and whether it found a difference */
+struct MMapReaderData
+{
+   const Alignment* _alignment;
+   const vector<string>* _genomeNames;
+   const vector<string>* _dna;
+   const vector<vector<hal_index_t> >* _parentIndices;
+   size_t _offset;
+   bool _ok;
+};
+
+static void* mmapReaderThread(void* arg)
+{
+  MMapReaderData* data = static_cast<MMapReaderData*>(arg);
+  try
+  {
+    const vector<string>& names = *data->_genomeNames;
+    string dna;
+    // start each thread on a different genome so that they race to
+    // open genomes and fill their caches
+    for (size_t n = 0; n < names.size(); ++n)
+    {
+      size_t i = (n + data->_offset) % names.size();
+      const Genome* genome = data->_alignment->openGenome(names[i]);
+      genome->getString(dna);
+      data->_ok = data->_ok && dna == data->_dna->at(i);
+      
+      const vector<hal_index_t>& parentIndices = data->_parentIndices->at(i);
+      TopSegmentIteratorConstPtr topIt = genome->getTopSegmentIterator();
+      for (size_t j = 0; j < parentIndices.size(); ++j)
+      {
+        data->_ok = data->_ok && 
+           topIt->getTopSegment()->getParentIndex() == parentIndices[j];
+        if (topIt->hasParent() == true)
+        {
+          BottomSegmentIteratorConstPtr botIt = 
+             genome->getParent()->getBottomSegmentIterator();
+          botIt->toParent(topIt);
+          data->_ok = data->_ok && 
+             botIt->getArrayIndex() == parentIndices[j];
+        }
+        topIt->toRight();
+      }
+      
+      SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+      SequenceIteratorConstPtr seqEnd = genome->getSequenceEndIterator();
+      for (; seqIt != seqEnd; seqIt->toNext())
+      {
+        const Sequence* sequence = seqIt->getSequence();
+        data->_ok = data->_ok && 
+           genome->getSequence(sequence->getName()) == sequence;
+      }
+    }
+  }
+  catch (...)
+  {
+    data->_ok = false;
+  }
+  return NULL;
+}
+
+void MMapConcurrentReadTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  static const size_t numThreads = 8;
+  CuAssertTrue(_testCase, alignment->supportsConcurrentReads() == false);
+  char* mmapPath = getTempFile();
+  writeMMapAlignment(alignment, mmapPath);
+  AlignmentConstPtr mmapAlignment =
+     openHalAlignmentReadOnly(mmapPath, CLParserConstPtr());
+  CuAssertTrue(_testCase, mmapAlignment->supportsConcurrentReads() == true);
+
+  // expected values are read from the original alignment up front
+  vector<string> genomeNames;
+  vector<string> dna;
+  vector<vector<hal_index_t> > parentIndices;
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    genomeNames.push_back(bfQueue.front());
+    bfQueue.pop_front();
+    const Genome* genome = alignment->openGenome(genomeNames.back());
+    dna.push_back(string());
+    genome->getString(dna.back());
+    parentIndices.push_back(vector<hal_index_t>());
+    TopSegmentIteratorConstPtr topIt = genome->getTopSegmentIterator();
+    for (hal_size_t i = 0; i < genome->getNumTopSegments(); ++i)
+    {
+      parentIndices.back().push_back(topIt->getTopSegment()->getParentIndex());
+      topIt->toRight();
+    }
+    vector<string> childNames = alignment->getChildNames(genomeNames.back());
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+
+  vector<MMapReaderData> data(numThreads);
+  vector<pthread_t> threads(numThreads);
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    data[i]._alignment = mmapAlignment.get();
+    data[i]._genomeNames = &genomeNames;
+    data[i]._dna = &dna;
+    data[i]._parentIndices = &parentIndices;
+    data[i]._offset = i;
+    data[i]._ok = true;
+    CuAssertTrue(_testCase, pthread_create(&threads[i], NULL, 
+                                           mmapReaderThread, &data[i]) == 0);
+  }
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    pthread_join(threads[i], NULL);
+    CuAssertTrue(_testCase, data[i]._ok == true);
+  }
+
+  mmapAlignment->close();
+  removeTempFile(mmapPath);
+}
+
+void halMMapSmallTest(CuTest *testCase)
+{
+  try
+  {
+    MMapSmallTest tester;
+    tester.check(testCase);
+  }
+  catch (hal_exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+void halMMapConcurrentReadTest(CuTest *testCase)
+{
+  try
+  {
+    MMapConcurrentReadTest tester;
+    tester.check(testCase);
+  }
+  catch (hal_exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halMMapTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMMapSmallTest);
+  SUITE_ADD_TEST(suite, halMMapConcurrentReadTest);
+  return suite;
+}
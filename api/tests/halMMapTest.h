@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMMAPTEST_H
+#define _HALMMAPTEST_H
+
+#include <vector>
+#include "halAlignmentTest.h"
+#include "hal.h"
+#include "allTests.h"
+
+struct MMapSmallTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkGenome(const hal::Genome* genome, 
+                    const hal::Genome* mmapGenome);
+};
+
+struct MMapConcurrentReadTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+#endif
@@ -132,6 +132,17 @@ void SequenceIteratorTest::checkCallBack(AlignmentConstPtr alignment)
   {
     const Sequence* seq = seqIt->getSequence();
     hal_size_t i = seq->getArrayIndex();
+
+    // sequence 0 is empty so never found by site
+    if (i > 0)
+    {
+      hal_size_t start = seq->getStartPosition();
+      hal_size_t end = seq->getEndPosition();
+      CuAssertTrue(_testCase, ancGenome->getSequenceBySite(start) == seq);
+      CuAssertTrue(_testCase, ancGenome->getSequenceBySite(end) == seq);
+      CuAssertTrue(_testCase, 
+                   ancGenome->getSequenceBySite((start + end) / 2) == seq);
+    }
  
     TopSegmentIteratorConstPtr tsIt = seq->getTopSegmentIterator();
     hal_size_t numTopSegments = seq->getNumTopSegments();
@@ -161,6 +172,33 @@ void SequenceIteratorTest::checkCallBack(AlignmentConstPtr alignment)
       bsIt->toRight();
     }
   }
+
+  // jump around the genome so that the site lookups miss their last hit
+  hal_size_t length = ancGenome->getSequenceLength();
+  for (hal_size_t pos = 0; pos < length; pos += 99991)
+  {
+    const Sequence* seq = ancGenome->getSequenceBySite(length - 1 - pos);
+    CuAssertTrue(_testCase, seq != NULL);
+    CuAssertTrue(_testCase, (hal_index_t)(length - 1 - pos) >= 
+                 seq->getStartPosition() &&
+                 (hal_index_t)(length - 1 - pos) <= seq->getEndPosition());
+  }
+  CuAssertTrue(_testCase, ancGenome->getSequenceBySite(length) == NULL);
+
+  // the names sort in a different order than the sequences
+  for (hal_size_t i = 0; i < numSequences; i += 7)
+  {
+    std::stringstream ss;
+    ss << "sequence" << i;
+    const Sequence* seq = ancGenome->getSequence(ss.str());
+    CuAssertTrue(_testCase, seq != NULL);
+    CuAssertTrue(_testCase, seq->getArrayIndex() == (hal_index_t)i);
+    CuAssertTrue(_testCase, seq->getName() == ss.str());
+  }
+  CuAssertTrue(_testCase, ancGenome->getSequence("sequence1000") == NULL);
+  CuAssertTrue(_testCase, ancGenome->getSequence("sequence") == NULL);
+  CuAssertTrue(_testCase, ancGenome->getSequence("") == NULL);
+  CuAssertTrue(_testCase, ancGenome->getSequence("zzz") == NULL);
 }
 
 void SequenceUpdateTest::createCallBack(AlignmentPtr alignment)
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <set>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+// quick tool to count heap allocations per mapped base when calling 
+// getMappedSegments() on every top segment of a genome.  build it against
+// two versions of the library to compare them (all on one line):
+// h5c++ -O3 -I../lib mappedSegmentAllocs.cpp ../lib/halLib.a
+//   ../../sonLib/lib/sonLib.a -o mappedSegmentAllocs
+
+static size_t numAllocations = 0;
+
+void* operator new(size_t size)
+{
+  ++numAllocations;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p)
+{
+  free(p);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 4)
+  {
+    cerr << "usage : mappedSegmentAllocs <halFile> <srcGenome> <tgtGenome>"
+         << endl;
+    return 1;
+  }
+
+  try
+  {
+    CLParserPtr optionsParser = hdf5CLParserInstance(false);
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(argv[1], 
+                                                           optionsParser);
+    const Genome* srcGenome = alignment->openGenome(argv[2]);
+    const Genome* tgtGenome = alignment->openGenome(argv[3]);
+    if (srcGenome == NULL || tgtGenome == NULL)
+    {
+      cerr << "genome not found" << endl;
+      return 1;
+    }
+
+    hal_size_t numMappedBases = 0;
+    size_t startAllocations = numAllocations;
+    clock_t startTime = clock();
+    TopSegmentIteratorConstPtr topIt = srcGenome->getTopSegmentIterator();
+    TopSegmentIteratorConstPtr topEnd = srcGenome->getTopSegmentEndIterator();
+    set<MappedSegmentConstPtr> results;
+    for (; topIt != topEnd; topIt->toRight())
+    {
+      topIt->getMappedSegments(results, tgtGenome);
+      for (set<MappedSegmentConstPtr>::const_iterator i = results.begin();
+           i != results.end(); ++i)
+      {
+        numMappedBases += (*i)->getLength();
+      }
+      results.clear();
+    }
+    double seconds = (double)(clock() - startTime) / CLOCKS_PER_SEC;
+    size_t allocations = numAllocations - startAllocations;
+
+    cout << "mapped bases: " << numMappedBases << "\n"
+         << "heap allocations: " << allocations << "\n"
+         << "allocations per mapped base: " 
+         << (numMappedBases > 0 ? 
+             (double)allocations / numMappedBases : 0.) << "\n"
+         << "seconds: " << seconds << endl;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <sys/resource.h>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+// quick tool to time the column iterator with each type of PositionCache.
+// it visits every column of a genome the way hal2maf --unique does, so
+// all the other genomes' bases go through the visit cache.  run it once
+// per type, since the peak memory can't go back down (all on one line):
+// h5c++ -O3 -I../lib positionCacheColumns.cpp ../lib/halLib.a
+//   ../../sonLib/lib/sonLib.a -o positionCacheColumns
+
+int main(int argc, char** argv)
+{
+  if (argc != 4)
+  {
+    cerr << "usage : positionCacheColumns <halFile> <refGenome> "
+         << "<bitmap|interval>" << endl;
+    return 1;
+  }
+
+  try
+  {
+    CLParserPtr optionsParser = hdf5CLParserInstance(false);
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(argv[1],
+                                                           optionsParser);
+    const Genome* refGenome = alignment->openGenome(argv[2]);
+    if (refGenome == NULL)
+    {
+      cerr << "genome not found" << endl;
+      return 1;
+    }
+    PositionCache::setDefaultType(PositionCache::getTypeFromName(argv[3]));
+
+    hal_size_t numColumns = 0;
+    hal_size_t numCanonical = 0;
+    clock_t startTime = clock();
+    ColumnIteratorConstPtr colIt = refGenome->getColumnIterator(
+      NULL, 0, 0, NULL_INDEX, false, false, false, true);
+    while (true)
+    {
+      ++numColumns;
+      if (colIt->isCanonicalOnRef() == true)
+      {
+        ++numCanonical;
+      }
+      if (colIt->lastColumn() == true)
+      {
+        break;
+      }
+      colIt->toRight();
+    }
+    double seconds = (double)(clock() - startTime) / CLOCKS_PER_SEC;
+
+    hal_size_t numVisited = 0;
+    hal_size_t numIntervals = 0;
+    ColumnIterator::VisitCache* visitCache = colIt->getVisitCache();
+    for (ColumnIterator::VisitCache::const_iterator i = visitCache->begin();
+         i != visitCache->end(); ++i)
+    {
+      numVisited += i->second->size();
+      numIntervals += i->second->numIntervals();
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    cout << "columns: " << numColumns << "\n"
+         << "canonical columns: " << numCanonical << "\n"
+         << "visited bases: " << numVisited << "\n"
+         << "visited intervals: " << numIntervals << "\n"
+         << "seconds: " << seconds << "\n"
+         << "peak RSS (kB): " << usage.ru_maxrss << endl;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
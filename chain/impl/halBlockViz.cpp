@@ -6,6 +6,7 @@
 
 #include <deque>
 #include <cassert>
+#include <list>
 #include <map>
 #include <sstream>
 #include <cmath>
@@ -21,15 +22,7 @@
 #include "halLodManager.h"
 #include "halMafExport.h"
 
-#ifdef ENABLE_UDC
 #include <pthread.h>
-static pthread_mutex_t HAL_MUTEX;
-#define HAL_LOCK pthread_mutex_lock(&HAL_MUTEX);
-#define HAL_UNLOCK pthread_mutex_unlock(&HAL_MUTEX);
-#else
-#define HAL_LOCK
-#define HAL_UNLOCK
-#endif
 
 using namespace std;
 using namespace hal;
@@ -37,6 +30,538 @@ using namespace hal;
 typedef map<int, pair<string, LodManagerPtr> > HandleMap;
 static HandleMap handleMap;
 
+/** Opening and closing handles modifies the handle map, so they take
+ * this lock for writing.  Queries only take it for reading. */
+static pthread_rwlock_t HAL_HANDLE_LOCK = PTHREAD_RWLOCK_INITIALIZER;
+
+/** The HDF5 library is not reentrant, so queries on handles that don't
+ * support concurrent reads (ie everything but memory-mapped files) are 
+ * still serialized on this mutex.  Queries on memory-mapped handles
+ * run in parallel. */
+static pthread_mutex_t HAL_SERIAL_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+
+/** Exclusive access to the handle map for the life of the object */
+class HandleWriteLock
+{
+public:
+   HandleWriteLock() { pthread_rwlock_wrlock(&HAL_HANDLE_LOCK); }
+   ~HandleWriteLock() { pthread_rwlock_unlock(&HAL_HANDLE_LOCK); }
+};
+
+/** Shared access to the handle map, plus the serial mutex if the 
+ * given handle's alignments can't be read concurrently, for the life
+ * of the object */
+class HandleReadLock
+{
+public:
+   HandleReadLock(int handle);
+   ~HandleReadLock();
+private:
+   bool _serial;
+};
+
+HandleReadLock::HandleReadLock(int handle) : _serial(true)
+{
+  pthread_rwlock_rdlock(&HAL_HANDLE_LOCK);
+  HandleMap::iterator mapIt = handleMap.find(handle);
+  if (mapIt != handleMap.end() && mapIt->second.second.get() != NULL)
+  {
+    _serial = !mapIt->second.second->supportsConcurrentReads();
+  }
+  if (_serial == true)
+  {
+    pthread_mutex_lock(&HAL_SERIAL_MUTEX);
+  }
+}
+
+HandleReadLock::~HandleReadLock()
+{
+  if (_serial == true)
+  {
+    pthread_mutex_unlock(&HAL_SERIAL_MUTEX);
+  }
+  pthread_rwlock_unlock(&HAL_HANDLE_LOCK);
+}
+
+/** Collects the blocks and target dupes of a query, then packs them 
+ * into the single allocation of a hal_block_array_results_t */
+class BlockArrayBuilder
+{
+public:
+   BlockArrayBuilder();
+   void addBlock(const string& qChrom, hal_int_t tStart, hal_int_t qStart,
+                 hal_int_t size, char strand, const string* qSequence,
+                 const string* tSequence);
+   void addTargetDupes(const hal_target_dupe_list_t* dupes);
+   hal_block_array_results_t* pack() const;
+
+protected:
+
+   static const size_t NoString;
+
+   struct Block
+   {
+      size_t _qChrom;
+      hal_int_t _tStart;
+      hal_int_t _qStart;
+      hal_int_t _size;
+      char _strand;
+      size_t _qSequence;
+      size_t _tSequence;
+   };
+   struct TargetDupe
+   {
+      hal_int_t _id;
+      size_t _qChrom;
+      size_t _firstRange;
+      size_t _numRanges;
+   };
+
+   size_t internChrom(const string& chrom);
+   size_t addString(const string& str);
+
+   vector<Block> _blocks;
+   vector<TargetDupe> _dupes;
+   vector<hal_target_range_t> _ranges;
+   map<string, size_t> _chromIndex;
+   vector<size_t> _chroms;
+   /** all strings, each followed by a 0 */
+   string _strings;
+};
+
+const size_t BlockArrayBuilder::NoString = (size_t)-1;
+
+BlockArrayBuilder::BlockArrayBuilder()
+{
+}
+
+void BlockArrayBuilder::addBlock(const string& qChrom, hal_int_t tStart,
+                                 hal_int_t qStart, hal_int_t size, 
+                                 char strand, const string* qSequence,
+                                 const string* tSequence)
+{
+  Block block;
+  block._qChrom = internChrom(qChrom);
+  block._tStart = tStart;
+  block._qStart = qStart;
+  block._size = size;
+  block._strand = strand;
+  block._qSequence = qSequence != NULL ? addString(*qSequence) : NoString;
+  block._tSequence = tSequence != NULL ? addString(*tSequence) : NoString;
+  _blocks.push_back(block);
+}
+
+void BlockArrayBuilder::addTargetDupes(const hal_target_dupe_list_t* dupes)
+{
+  for (; dupes != NULL; dupes = dupes->next)
+  {
+    TargetDupe dupe;
+    dupe._id = dupes->id;
+    dupe._qChrom = internChrom(dupes->qChrom);
+    dupe._firstRange = _ranges.size();
+    for (const hal_target_range_t* range = dupes->tRange; range != NULL;
+         range = range->next)
+    {
+      _ranges.push_back(*range);
+    }
+    dupe._numRanges = _ranges.size() - dupe._firstRange;
+    _dupes.push_back(dupe);
+  }
+}
+
+size_t BlockArrayBuilder::internChrom(const string& chrom)
+{
+  map<string, size_t>::iterator i = _chromIndex.find(chrom);
+  if (i == _chromIndex.end())
+  {
+    i = _chromIndex.insert(pair<string, size_t>(chrom, _chroms.size())).first;
+    _chroms.push_back(addString(chrom));
+  }
+  return i->second;
+}
+
+size_t BlockArrayBuilder::addString(const string& str)
+{
+  size_t offset = _strings.length();
+  _strings.append(str.c_str(), str.length() + 1);
+  return offset;
+}
+
+// round offset in the arena up so that any of the arrays can start there
+static size_t alignOffset(size_t offset)
+{
+  size_t align = sizeof(hal_int_t);
+  return ((offset + align - 1) / align) * align;
+}
+
+hal_block_array_results_t* BlockArrayBuilder::pack() const
+{
+  // layout: results, blocks, dupes, ranges, chroms, strings
+  size_t blocksOffset = sizeof(hal_block_array_results_t);
+  size_t dupesOffset = alignOffset(
+    blocksOffset + _blocks.size() * sizeof(hal_array_block_t));
+  size_t rangesOffset = alignOffset(
+    dupesOffset + _dupes.size() * sizeof(hal_array_target_dupe_t));
+  size_t chromsOffset = alignOffset(
+    rangesOffset + _ranges.size() * sizeof(hal_target_range_t));
+  size_t stringsOffset = chromsOffset + _chroms.size() * sizeof(char*);
+  size_t bytes = stringsOffset + _strings.length();
+
+  char* arena = (char*)malloc(bytes);
+  if (arena == NULL)
+  {
+    throw hal_exception("Out of memory allocating block results");
+  }
+  hal_block_array_results_t* results = (hal_block_array_results_t*)arena;
+  results->numBlocks = _blocks.size();
+  results->blocks = (hal_array_block_t*)(arena + blocksOffset);
+  results->numTargetDupes = _dupes.size();
+  results->targetDupes = (hal_array_target_dupe_t*)(arena + dupesOffset);
+  results->numChroms = _chroms.size();
+  results->chroms = (const char**)(arena + chromsOffset);
+  results->bytes = bytes;
+  char* strings = arena + stringsOffset;
+  if (_strings.empty() == false)
+  {
+    memcpy(strings, _strings.data(), _strings.length());
+  }
+
+  for (size_t i = 0; i < _chroms.size(); ++i)
+  {
+    results->chroms[i] = strings + _chroms[i];
+  }
+  for (size_t i = 0; i < _blocks.size(); ++i)
+  {
+    const Block& block = _blocks[i];
+    hal_array_block_t& outBlock = results->blocks[i];
+    outBlock.qChrom = results->chroms[block._qChrom];
+    outBlock.tStart = block._tStart;
+    outBlock.qStart = block._qStart;
+    outBlock.size = block._size;
+    outBlock.strand = block._strand;
+    outBlock.qSequence = block._qSequence == NoString ? NULL :
+       strings + block._qSequence;
+    outBlock.tSequence = block._tSequence == NoString ? NULL :
+       strings + block._tSequence;
+  }
+  hal_target_range_t* ranges = (hal_target_range_t*)(arena + rangesOffset);
+  for (size_t i = 0; i < _ranges.size(); ++i)
+  {
+    ranges[i] = _ranges[i];
+    ranges[i].next = NULL;
+  }
+  for (size_t i = 0; i < _dupes.size(); ++i)
+  {
+    const TargetDupe& dupe = _dupes[i];
+    hal_array_target_dupe_t& outDupe = results->targetDupes[i];
+    outDupe.id = dupe._id;
+    outDupe.qChrom = results->chroms[dupe._qChrom];
+    outDupe.numRanges = dupe._numRanges;
+    outDupe.tRanges = ranges + dupe._firstRange;
+    for (size_t j = 1; j < dupe._numRanges; ++j)
+    {
+      outDupe.tRanges[j - 1].next = outDupe.tRanges + j;
+    }
+  }
+  return results;
+}
+
+// move a pointer into one copy of the arena to the same place in another
+template <typename T>
+static inline T* rebase(T* ptr, const void* from, void* to)
+{
+  if (ptr == NULL)
+  {
+    return NULL;
+  }
+  return (T*)((char*)to + ((const char*)ptr - (const char*)from));
+}
+
+static hal_block_array_results_t* copyBlockArrayResults(
+  const hal_block_array_results_t* results)
+{
+  hal_block_array_results_t* outResults = 
+     (hal_block_array_results_t*)malloc(results->bytes);
+  if (outResults == NULL)
+  {
+    throw hal_exception("Out of memory allocating block results");
+  }
+  memcpy(outResults, results, results->bytes);
+  outResults->blocks = rebase(outResults->blocks, results, outResults);
+  outResults->targetDupes = rebase(outResults->targetDupes, results,
+                                   outResults);
+  outResults->chroms = rebase(outResults->chroms, results, outResults);
+  for (hal_int_t i = 0; i < outResults->numChroms; ++i)
+  {
+    outResults->chroms[i] = rebase(outResults->chroms[i], results, 
+                                   outResults);
+  }
+  for (hal_int_t i = 0; i < outResults->numBlocks; ++i)
+  {
+    hal_array_block_t& block = outResults->blocks[i];
+    block.qChrom = rebase(block.qChrom, results, outResults);
+    block.qSequence = rebase(block.qSequence, results, outResults);
+    block.tSequence = rebase(block.tSequence, results, outResults);
+  }
+  for (hal_int_t i = 0; i < outResults->numTargetDupes; ++i)
+  {
+    hal_array_target_dupe_t& dupe = outResults->targetDupes[i];
+    dupe.qChrom = rebase(dupe.qChrom, results, outResults);
+    dupe.tRanges = rebase(dupe.tRanges, results, outResults);
+    for (hal_int_t j = 0; j < dupe.numRanges; ++j)
+    {
+      dupe.tRanges[j].next = rebase(dupe.tRanges[j].next, results, 
+                                    outResults);
+    }
+  }
+  return outResults;
+}
+
+/** Results of recent halGetBlocksInTargetRange() queries, so that
+ * redrawing the same window (which browsers do a lot) doesn't map it
+ * again.  Entries are keyed on the exact target range and all the query
+ * parameters that change the blocks (the alignment stands for the level
+ * of detail picked for the query length).  A window can't be pieced
+ * together from the results of other ranges: the mapping cuts blocks,
+ * finds adjacencies and numbers dupes relative to the whole range.
+ * find() returns copies, so that callers still own (and free) the 
+ * results they get.  The least recently used entries are evicted to 
+ * keep the total size under the limit set with halSetBlockCacheSize(). */
+class BlockCache
+{
+public:
+   struct Key
+   {
+      Key(int handle, const Alignment* alignment, const char* qSpecies,
+          const char* tSpecies, const char* tChrom, hal_int_t tStart,
+          hal_int_t tEnd, bool tReversed, bool getSequenceString,
+          hal_dup_type_t dupMode, bool mapBackAdjacencies,
+          const char* coalescenceLimitName);
+      bool operator<(const Key& other) const;
+      int _handle;
+      const Alignment* _alignment;
+      string _qSpecies;
+      string _tSpecies;
+      string _tChrom;
+      hal_int_t _tStart;
+      hal_int_t _tEnd;
+      bool _tReversed;
+      bool _getSequenceString;
+      hal_dup_type_t _dupMode;
+      bool _mapBackAdjacencies;
+      bool _hasCoalescenceLimit;
+      string _coalescenceLimitName;
+   };
+
+   BlockCache();
+   ~BlockCache();
+
+   /** copy of the cached results for key, or NULL if not cached */
+   hal_block_array_results_t* find(const Key& key);
+   /** add a copy of the results for key */
+   void insert(const Key& key, const hal_block_array_results_t* results);
+   /** remove all results for the handle (when it is closed) */
+   void eraseHandle(int handle);
+   void setMaxBytes(size_t maxBytes);
+   void getStats(hal_block_cache_stats_t* stats);
+
+   static const size_t DefaultMaxBytes;
+
+protected:
+
+   struct Entry
+   {
+      hal_block_array_results_t* _results;
+      size_t _bytes;
+      list<Key>::iterator _lruIt;
+   };
+   typedef map<Key, Entry> EntryMap;
+
+   void erase(EntryMap::iterator entryIt);
+   void evict();
+
+   EntryMap _entries;
+   /** most recently used key at the front */
+   list<Key> _lru;
+   size_t _bytes;
+   size_t _maxBytes;
+   hal_int_t _hits;
+   hal_int_t _misses;
+   hal_int_t _evictions;
+   pthread_mutex_t _mutex;
+};
+
+const size_t BlockCache::DefaultMaxBytes = 64 * 1024 * 1024;
+
+static BlockCache blockCache;
+
+BlockCache::Key::Key(int handle, const Alignment* alignment,
+                     const char* qSpecies, const char* tSpecies,
+                     const char* tChrom, hal_int_t tStart,
+                     hal_int_t tEnd, bool tReversed, 
+                     bool getSequenceString, hal_dup_type_t dupMode,
+                     bool mapBackAdjacencies,
+                     const char* coalescenceLimitName) :
+  _handle(handle),
+  _alignment(alignment),
+  _qSpecies(qSpecies),
+  _tSpecies(tSpecies),
+  _tChrom(tChrom),
+  _tStart(tStart),
+  _tEnd(tEnd),
+  _tReversed(tReversed),
+  _getSequenceString(getSequenceString),
+  _dupMode(dupMode),
+  _mapBackAdjacencies(mapBackAdjacencies),
+  _hasCoalescenceLimit(coalescenceLimitName != NULL),
+  _coalescenceLimitName(coalescenceLimitName != NULL ? 
+                        coalescenceLimitName : "")
+{
+}
+
+bool BlockCache::Key::operator<(const Key& other) const
+{
+  if (_handle != other._handle) return _handle < other._handle;
+  if (_alignment != other._alignment) return _alignment < other._alignment;
+  if (_tStart != other._tStart) return _tStart < other._tStart;
+  if (_tEnd != other._tEnd) return _tEnd < other._tEnd;
+  if (_tReversed != other._tReversed) return _tReversed < other._tReversed;
+  if (_getSequenceString != other._getSequenceString)
+  {
+    return _getSequenceString < other._getSequenceString;
+  }
+  if (_dupMode != other._dupMode) return _dupMode < other._dupMode;
+  if (_mapBackAdjacencies != other._mapBackAdjacencies) 
+  {
+    return _mapBackAdjacencies < other._mapBackAdjacencies;
+  }
+  if (_hasCoalescenceLimit != other._hasCoalescenceLimit)
+  {
+    return _hasCoalescenceLimit < other._hasCoalescenceLimit;
+  }
+  if (_tChrom != other._tChrom) return _tChrom < other._tChrom;
+  if (_qSpecies != other._qSpecies) return _qSpecies < other._qSpecies;
+  if (_tSpecies != other._tSpecies) return _tSpecies < other._tSpecies;
+  return _coalescenceLimitName < other._coalescenceLimitName;
+}
+
+BlockCache::BlockCache() : _bytes(0), _maxBytes(DefaultMaxBytes), 
+                           _hits(0), _misses(0), _evictions(0)
+{
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+BlockCache::~BlockCache()
+{
+  while (_entries.empty() == false)
+  {
+    erase(_entries.begin());
+  }
+  pthread_mutex_destroy(&_mutex);
+}
+
+hal_block_array_results_t* BlockCache::find(const Key& key)
+{
+  pthread_mutex_lock(&_mutex);
+  hal_block_array_results_t* results = NULL;
+  EntryMap::iterator entryIt = _entries.find(key);
+  if (entryIt != _entries.end())
+  {
+    ++_hits;
+    _lru.splice(_lru.begin(), _lru, entryIt->second._lruIt);
+    results = copyBlockArrayResults(entryIt->second._results);
+  }
+  else
+  {
+    ++_misses;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return results;
+}
+
+void BlockCache::insert(const Key& key, 
+                        const hal_block_array_results_t* results)
+{
+  pthread_mutex_lock(&_mutex);
+  // two threads can miss on the same key at once.  keep the first
+  if (_maxBytes > 0 && _entries.find(key) == _entries.end())
+  {
+    Entry entry;
+    entry._results = copyBlockArrayResults(results);
+    entry._bytes = results->bytes + sizeof(Entry) + sizeof(Key) + 
+       key._qSpecies.length() + key._tSpecies.length() + key._tChrom.length() + 
+       key._coalescenceLimitName.length();
+    if (entry._bytes <= _maxBytes)
+    {
+      _lru.push_front(key);
+      entry._lruIt = _lru.begin();
+      _entries.insert(pair<Key, Entry>(key, entry));
+      _bytes += entry._bytes;
+      evict();
+    }
+    else
+    {
+      halFreeBlockArrayResults(entry._results);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void BlockCache::eraseHandle(int handle)
+{
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator entryIt = _entries.begin();
+  while (entryIt != _entries.end())
+  {
+    EntryMap::iterator next = entryIt;
+    ++next;
+    if (entryIt->first._handle == handle)
+    {
+      erase(entryIt);
+    }
+    entryIt = next;
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void BlockCache::setMaxBytes(size_t maxBytes)
+{
+  pthread_mutex_lock(&_mutex);
+  _maxBytes = maxBytes;
+  evict();
+  pthread_mutex_unlock(&_mutex);
+}
+
+void BlockCache::getStats(hal_block_cache_stats_t* stats)
+{
+  pthread_mutex_lock(&_mutex);
+  stats->hits = _hits;
+  stats->misses = _misses;
+  stats->evictions = _evictions;
+  stats->numEntries = _entries.size();
+  stats->bytes = _bytes;
+  stats->maxBytes = _maxBytes;
+  pthread_mutex_unlock(&_mutex);
+}
+
+void BlockCache::erase(EntryMap::iterator entryIt)
+{
+  _bytes -= entryIt->second._bytes;
+  halFreeBlockArrayResults(entryIt->second._results);
+  _lru.erase(entryIt->second._lruIt);
+  _entries.erase(entryIt);
+}
+
+void BlockCache::evict()
+{
+  while (_bytes > _maxBytes)
+  {
+    assert(_lru.empty() == false);
+    erase(_entries.find(_lru.back()));
+    ++_evictions;
+  }
+}
+
 static int halOpenLodOrHal(char* inputPath, bool isLod, char **errStr);
 static void checkHandle(int handle);
 static void checkGenomes(int halHandle, 
@@ -49,18 +574,18 @@ static AlignmentConstPtr getExistingAlignment(int handle,
 static bool isAlignmentLod0(int handle, hal_size_t queryLength);
 static char* copyCString(const string& inString);
 
-static hal_block_results_t* readBlocks(AlignmentConstPtr seqAlignment,
-                                       const Sequence* tSequence,
-                                       hal_index_t absStart, 
-                                       hal_index_t absEnd,
-                                       bool tReversed,
-                                       const Genome* qGenome, 
-                                       bool getSequenceString,
-                                       bool doDupes, bool doTargetDupes,
-                                       bool doAdjes, const char *coalescenceLimitName);
+static hal_block_array_results_t* readBlocks(AlignmentConstPtr seqAlignment,
+                                             const Sequence* tSequence,
+                                             hal_index_t absStart, 
+                                             hal_index_t absEnd,
+                                             bool tReversed,
+                                             const Genome* qGenome, 
+                                             bool getSequenceString,
+                                             bool doDupes, bool doTargetDupes,
+                                             bool doAdjes, const char *coalescenceLimitName);
 
 static void readBlock(AlignmentConstPtr seqAlignment,
-                      hal_block_t* cur, 
+                      BlockArrayBuilder& builder, 
                       vector<MappedSegmentConstPtr>& fragments,                                        bool getSequenceString, const string& genomeName);
 
 static hal_target_dupe_list_t* processTargetDupes(BlockMapper& blockMapper,
@@ -88,7 +613,7 @@ extern "C" int halOpen(char* halFilePath, char **errStr)
 
 int halOpenLodOrHal(char* inputPath, bool isLod, char **errStr)
 {
-  HAL_LOCK
+  HandleWriteLock lock;
   int handle = -1;
   try
   {
@@ -147,13 +672,12 @@ int halOpenLodOrHal(char* inputPath, bool isLod, char **errStr)
     *errStr = stString_copy(ss.str().c_str());
     handle = -1;
   }
-  HAL_UNLOCK
   return handle;
 }
 
 extern "C" int halClose(int handle, char **errStr)
 {
-  HAL_LOCK
+  HandleWriteLock lock;
   int ret = 0;
   try
   {
@@ -165,6 +689,7 @@ extern "C" int halClose(int handle, char **errStr)
       throw hal_exception(ss.str());
     }
     handleMap.erase(mapIt);
+    blockCache.eraseHandle(handle);
   }
   catch(exception& e)
   {
@@ -188,7 +713,6 @@ extern "C" int halClose(int handle, char **errStr)
     *errStr = stString_copy(ss.str().c_str());
     ret = -1;
   }
-  HAL_UNLOCK
   return ret;
 }
 
@@ -232,6 +756,14 @@ extern "C" void halFreeTargetDupeLists(struct hal_target_dupe_list_t* dupes)
   }
 }
 
+extern "C" void halFreeBlockArrayResults(
+  struct hal_block_array_results_t* results)
+{
+  free(results);
+}
+
+// the linked lists are made from the array results, so that both 
+// share the cache
 extern "C" 
 struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
                                                       char* qSpecies,
@@ -246,8 +778,78 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
                                                       const char *coalescenceLimitName,
                                                       char **errStr)
 {
-  HAL_LOCK
-  hal_block_results_t* results = NULL;
+  hal_block_array_results_t* arrayResults = 
+     halGetBlocksInTargetRangeArray(halHandle, qSpecies, tSpecies, tChrom, 
+                                    tStart, tEnd, tReversed, seqMode, 
+                                    dupMode, mapBackAdjacencies, 
+                                    coalescenceLimitName, errStr);
+  if (arrayResults == NULL)
+  {
+    return NULL;
+  }
+
+  hal_block_results_t* results = 
+     (hal_block_results_t*)calloc(1, sizeof(hal_block_results_t));
+  hal_block_t** nextBlock = &results->mappedBlocks;
+  for (hal_int_t i = 0; i < arrayResults->numBlocks; ++i)
+  {
+    const hal_array_block_t& block = arrayResults->blocks[i];
+    hal_block_t* cur = (hal_block_t*)calloc(1, sizeof(hal_block_t));
+    cur->qChrom = copyCString(block.qChrom);
+    cur->tStart = block.tStart;
+    cur->qStart = block.qStart;
+    cur->size = block.size;
+    cur->strand = block.strand;
+    if (block.qSequence != NULL)
+    {
+      cur->qSequence = copyCString(block.qSequence);
+      cur->tSequence = copyCString(block.tSequence);
+    }
+    *nextBlock = cur;
+    nextBlock = &cur->next;
+  }
+
+  hal_target_dupe_list_t** nextDupes = &results->targetDupeBlocks;
+  for (hal_int_t i = 0; i < arrayResults->numTargetDupes; ++i)
+  {
+    const hal_array_target_dupe_t& dupe = arrayResults->targetDupes[i];
+    hal_target_dupe_list_t* cur = (hal_target_dupe_list_t*)calloc(
+      1, sizeof(hal_target_dupe_list_t));
+    cur->id = dupe.id;
+    cur->qChrom = copyCString(dupe.qChrom);
+    hal_target_range_t** nextRange = &cur->tRange;
+    for (hal_int_t j = 0; j < dupe.numRanges; ++j)
+    {
+      *nextRange = (hal_target_range_t*)calloc(1, sizeof(hal_target_range_t));
+      (*nextRange)->tStart = dupe.tRanges[j].tStart;
+      (*nextRange)->size = dupe.tRanges[j].size;
+      nextRange = &(*nextRange)->next;
+    }
+    *nextDupes = cur;
+    nextDupes = &cur->next;
+  }
+
+  halFreeBlockArrayResults(arrayResults);
+  return results;
+}
+
+extern "C" 
+struct hal_block_array_results_t *halGetBlocksInTargetRangeArray(
+  int halHandle,
+  char* qSpecies,
+  char* tSpecies,
+  char* tChrom,
+  hal_int_t tStart, 
+  hal_int_t tEnd,
+  hal_int_t tReversed,
+  hal_seqmode_type_t seqMode,
+  hal_dup_type_t dupMode,
+  int mapBackAdjacencies,
+  const char *coalescenceLimitName,
+  char **errStr)
+{
+  HandleReadLock lock(halHandle);
+  hal_block_array_results_t* results = NULL;
   try
   {
     hal_int_t rangeLength = tEnd - tStart;
@@ -318,12 +920,21 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
                                           true);
     }
 
-    results = readBlocks(seqAlignment, tSequence, absStart, absEnd, 
-                         tReversed != 0,
-                         qGenome,
-                         getSequenceString, dupMode != HAL_NO_DUPS, 
-                         dupMode == HAL_QUERY_AND_TARGET_DUPS,
-                         mapBackAdjacencies != 0, coalescenceLimitName);
+    BlockCache::Key cacheKey(halHandle, alignment.get(), qSpecies, tSpecies,
+                             tChrom, tStart, myEnd, tReversed != 0, 
+                             getSequenceString, dupMode,
+                             mapBackAdjacencies != 0, coalescenceLimitName);
+    results = blockCache.find(cacheKey);
+    if (results == NULL)
+    {
+      results = readBlocks(seqAlignment, tSequence, absStart, absEnd, 
+                           tReversed != 0,
+                           qGenome,
+                           getSequenceString, dupMode != HAL_NO_DUPS, 
+                           dupMode == HAL_QUERY_AND_TARGET_DUPS,
+                           mapBackAdjacencies != 0, coalescenceLimitName);
+      blockCache.insert(cacheKey, results);
+    }
   }
   catch(exception& e)
   {
@@ -347,7 +958,6 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
     *errStr = stString_copy(ss.str().c_str());
     results = NULL;
   }
-  HAL_UNLOCK
   return results;
 }
 
@@ -434,6 +1044,16 @@ struct hal_block_results_t *halGetBlocksInTargetRange_filterByChrom(int halHandl
     return results;
 }
 
+extern "C" void halSetBlockCacheSize(hal_int_t maxBytes)
+{
+  blockCache.setMaxBytes(maxBytes > 0 ? (size_t)maxBytes : 0);
+}
+
+extern "C" void halGetBlockCacheStats(struct hal_block_cache_stats_t* stats)
+{
+  blockCache.getStats(stats);
+}
+
 extern "C" hal_int_t halGetMAF(FILE* outFile,
                                int halHandle, 
                                hal_species_t* qSpeciesNames,
@@ -445,7 +1065,7 @@ extern "C" hal_int_t halGetMAF(FILE* outFile,
                                int doDupes,
                                char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   hal_int_t numBytes = 0;
   try
   {
@@ -526,13 +1146,12 @@ extern "C" hal_int_t halGetMAF(FILE* outFile,
     *errStr = stString_copy(ss.str().c_str());
     numBytes = -1;
   }
-  HAL_UNLOCK
   return numBytes;
 }
 
 extern "C" struct hal_species_t *halGetSpecies(int halHandle, char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   hal_species_t* head = NULL;
   try
   {
@@ -608,7 +1227,6 @@ extern "C" struct hal_species_t *halGetSpecies(int halHandle, char **errStr)
     *errStr = stString_copy(ss.str().c_str());
     head = NULL;
   }
-  HAL_UNLOCK
   return head;
 }
 
@@ -616,7 +1234,7 @@ extern "C" struct hal_species_t *halGetPossibleCoalescenceLimits(int halHandle,
                                                                  const char *qSpecies,
                                                                  const char *tSpecies,
                                                                  char **errStr) {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   hal_species_t* head = NULL;
   try
   {
@@ -684,7 +1302,6 @@ extern "C" struct hal_species_t *halGetPossibleCoalescenceLimits(int halHandle,
     *errStr = stString_copy(ss.str().c_str());
     head = NULL;
   }
-  HAL_UNLOCK
   return head;
 }
 
@@ -703,7 +1320,7 @@ extern "C" struct hal_chromosome_t *halGetChroms(int halHandle,
                                                  char* speciesName,
                                                  char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   hal_chromosome_t* head = NULL;
   try
   {
@@ -770,7 +1387,6 @@ extern "C" struct hal_chromosome_t *halGetChroms(int halHandle,
     *errStr = stString_copy(ss.str().c_str());
     head = NULL;
   }
-  HAL_UNLOCK
   return head;
 }
 
@@ -779,7 +1395,7 @@ extern "C" char *halGetDna(int halHandle,
                            hal_int_t start, hal_int_t end,
                            char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   char* dna = NULL;
   try
   {
@@ -835,13 +1451,12 @@ extern "C" char *halGetDna(int halHandle,
     *errStr = stString_copy(ss.str().c_str());
     dna = NULL;
   }
-  HAL_UNLOCK
   return dna;
 }
 
 extern "C" hal_int_t halGetMaxLODQueryLength(int halHandle, char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   hal_int_t ret = 0;
   try
   {
@@ -878,7 +1493,6 @@ extern "C" hal_int_t halGetMaxLODQueryLength(int halHandle, char **errStr)
     *errStr = stString_copy(ss.str().c_str());
     ret = -1;
   }
-  HAL_UNLOCK
   return ret;
 }
 
@@ -952,17 +1566,18 @@ char* copyCString(const string& inString)
   return outString;
 }
 
-hal_block_results_t* readBlocks(AlignmentConstPtr seqAlignment,
-                                const Sequence* tSequence,
-                                hal_index_t absStart, hal_index_t absEnd,
-                                bool tReversed,
-                                const Genome* qGenome, bool getSequenceString,
-                                bool doDupes, bool doTargetDupes, 
-                                bool doAdjes, const char *coalescenceLimitName)
+hal_block_array_results_t* readBlocks(AlignmentConstPtr seqAlignment,
+                                      const Sequence* tSequence,
+                                      hal_index_t absStart, hal_index_t absEnd,
+                                      bool tReversed,
+                                      const Genome* qGenome, 
+                                      bool getSequenceString,
+                                      bool doDupes, bool doTargetDupes, 
+                                      bool doAdjes, 
+                                      const char *coalescenceLimitName)
 {
   const Genome* tGenome = tSequence->getGenome();
   string qGenomeName = qGenome->getName();
-  hal_block_t* prev = NULL;
   BlockMapper blockMapper;
   if (qGenome == tGenome && coalescenceLimitName == NULL)
   {
@@ -996,8 +1611,6 @@ hal_block_results_t* readBlocks(AlignmentConstPtr seqAlignment,
   }
   blockMapper.map();
   BlockMapper::MSSet paraSet;
-  hal_size_t totalLength = 0;
-  hal_size_t reversedLength = 0;
   if (doDupes == true && qGenome != tGenome)
   {
     blockMapper.extractReferenceParalogies(paraSet);
@@ -1009,43 +1622,29 @@ hal_block_results_t* readBlocks(AlignmentConstPtr seqAlignment,
   targetCutSet.insert(blockMapper.getAbsRefFirst());
   targetCutSet.insert(blockMapper.getAbsRefLast());
 
-  hal_block_results_t* results = 
-     (hal_block_results_t*)calloc(1, sizeof(hal_block_results_t));
+  BlockArrayBuilder builder;
 
   for (BlockMapper::MSSet::iterator segMapIt = segMap.begin();
        segMapIt != segMap.end(); ++segMapIt)
   {
     assert((*segMapIt)->getSource()->getReversed() == false);
-    hal_block_t* cur = (hal_block_t*)calloc(1, sizeof(hal_block_t));
-    if (results->mappedBlocks == NULL)
-    {
-      results->mappedBlocks = cur;
-    }
-    else
-    {
-      prev->next = cur;
-    }
     BlockMapper::extractSegment(segMapIt, paraSet, fragments, &segMap,
                                 targetCutSet, queryCutSet);
-    readBlock(seqAlignment, cur, fragments, getSequenceString, qGenomeName);
-    totalLength += cur->size;
-    reversedLength += cur->strand == '-' ? cur->size : 0;
-    prev = cur;
+    readBlock(seqAlignment, builder, fragments, getSequenceString, 
+              qGenomeName);
   }
-  if (!paraSet.empty())
+  if (!paraSet.empty() && doTargetDupes == true)
   {
-    results->targetDupeBlocks = processTargetDupes(blockMapper, paraSet);
-  }
-  if (doTargetDupes == false && results->targetDupeBlocks != NULL)
-  {
-    halFreeTargetDupeLists(results->targetDupeBlocks);
-    results->targetDupeBlocks = NULL;
+    hal_target_dupe_list_t* targetDupes = processTargetDupes(blockMapper, 
+                                                             paraSet);
+    builder.addTargetDupes(targetDupes);
+    halFreeTargetDupeLists(targetDupes);
   }
-  return results;
+  return builder.pack();
 }
 
 void readBlock(AlignmentConstPtr seqAlignment,
-               hal_block_t* cur,  
+               BlockArrayBuilder& builder,  
                vector<MappedSegmentConstPtr>& fragments, 
                bool getSequenceString, const string& genomeName)
 {
@@ -1060,27 +1659,24 @@ void readBlock(AlignmentConstPtr seqAlignment,
   assert(firstRefSeg->getReversed() == false);
   assert(lastRefSeg->getReversed() == false);
   
-  cur->next = NULL;
-
   string seqBuffer = qSequence->getName();
   string qDnaBuffer;
   string tDnaBuffer;
   size_t prefix = 
      seqBuffer.find(genomeName + '.') != 0 ? 0 : genomeName.length() + 1;
-  cur->qChrom = (char*)malloc(seqBuffer.length() + 1 - prefix);
-  strcpy(cur->qChrom, seqBuffer.c_str() + prefix);
+  string qChrom = seqBuffer.substr(prefix);
 
-  cur->tStart = std::min(std::min(firstRefSeg->getStartPosition(), 
+  hal_int_t tStart = std::min(std::min(firstRefSeg->getStartPosition(), 
                                   firstRefSeg->getEndPosition()),
                          std::min(lastRefSeg->getStartPosition(),
                                   lastRefSeg->getEndPosition()));
-  cur->tStart -= tSequence->getStartPosition();
+  tStart -= tSequence->getStartPosition();
 
-  cur->qStart = std::min(std::min(firstQuerySeg->getStartPosition(), 
+  hal_int_t qStart = std::min(std::min(firstQuerySeg->getStartPosition(), 
                                   firstQuerySeg->getEndPosition()),
                          std::min(lastQuerySeg->getStartPosition(),
                                   lastQuerySeg->getEndPosition()));
-  cur->qStart -= qSequence->getStartPosition();
+  qStart -= qSequence->getStartPosition();
 
   hal_index_t tEnd = std::max(std::max(firstRefSeg->getStartPosition(), 
                                        firstRefSeg->getEndPosition()),
@@ -1088,14 +1684,12 @@ void readBlock(AlignmentConstPtr seqAlignment,
                                        lastRefSeg->getEndPosition()));
   tEnd -= tSequence->getStartPosition();
 
-  assert(cur->tStart >= 0);
-  assert(cur->qStart >= 0);
+  assert(tStart >= 0);
+  assert(qStart >= 0);
 
   assert(firstRefSeg->getLength() == firstQuerySeg->getLength());
-  cur->size = 1 + tEnd - cur->tStart;
-  cur->strand = firstQuerySeg->getReversed() ? '-' : '+';
-  cur->tSequence = NULL;
-  cur->qSequence = NULL;
+  hal_int_t size = 1 + tEnd - tStart;
+  char strand = firstQuerySeg->getReversed() ? '-' : '+';
   if (getSequenceString != 0)
   {
     const Genome* qSeqGenome = 
@@ -1135,16 +1729,18 @@ void readBlock(AlignmentConstPtr seqAlignment,
       throw hal_exception(ss.str());
     }
     
-    qSeqSequence->getSubString(qDnaBuffer, cur->qStart, cur->size);
-    tSeqSequence->getSubString(tDnaBuffer, cur->tStart, cur->size);
-    if (cur->strand == '-')
+    qSeqSequence->getSubString(qDnaBuffer, qStart, size);
+    tSeqSequence->getSubString(tDnaBuffer, tStart, size);
+    if (strand == '-')
     {
       reverseComplement(qDnaBuffer);
     }
-    cur->qSequence = (char*)malloc(qDnaBuffer.length() * sizeof(char) + 1);
-    cur->tSequence = (char*)malloc(tDnaBuffer.length() * sizeof(char) + 1);
-    strcpy(cur->qSequence, qDnaBuffer.c_str());
-    strcpy(cur->tSequence, tDnaBuffer.c_str());
+    builder.addBlock(qChrom, tStart, qStart, size, strand, &qDnaBuffer,
+                     &tDnaBuffer);
+  }
+  else
+  {
+    builder.addBlock(qChrom, tStart, qStart, size, strand, NULL, NULL);
   }
 }
 
@@ -1414,7 +2010,7 @@ extern "C" struct hal_metadata_t *halGetGenomeMetadata(int halHandle,
                                                        const char *genomeName,
                                                        char **errStr)
 {
-  HAL_LOCK
+  HandleReadLock lock(halHandle);
   struct hal_metadata_t *ret = NULL;
   try {
     AlignmentConstPtr alignment = 
@@ -1467,7 +2063,6 @@ extern "C" struct hal_metadata_t *halGetGenomeMetadata(int halHandle,
     *errStr = stString_copy(ss.str().c_str());
     ret = NULL;
   }
-  HAL_UNLOCK
   return ret;
 }
 
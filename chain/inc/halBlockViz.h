@@ -12,7 +12,12 @@ extern "C" {
 #endif
 
 /** This is all prototype code to evaluate how to get blocks streamed 
- * from HAL to the browser. Interface is speficied by Brian */
+ * from HAL to the browser. Interface is speficied by Brian 
+ *
+ * All functions can be called from several threads.  Queries on a handle
+ * whose files are all memory-mapped (see hal2mmap) run concurrently, 
+ * while queries on HDF5 handles are serialized (the HDF5 library is not
+ * reentrant).  Opening and closing handles waits for running queries. */
 
 /* keep integer type definition in one place */
 typedef long hal_int_t;
@@ -61,6 +66,46 @@ struct hal_block_t
    char *tSequence; // target DNA, if requested
 };
 
+/** Block in a hal_block_array_results_t.  The same as hal_block_t, but
+ * stored in an array instead of a list.  The strings belong to the
+ * results and must not be freed. */
+struct hal_array_block_t
+{
+   const char *qChrom;
+   hal_int_t tStart;
+   hal_int_t qStart;
+   hal_int_t size;
+   char strand;
+   const char *qSequence; // query DNA, if requested
+   const char *tSequence; // target DNA, if requested
+};
+
+/** Paralogous target ranges in a hal_block_array_results_t (see 
+ * hal_target_dupe_list_t). tRanges is an array of numRanges ranges 
+ * (their next pointers also link them in order). */
+struct hal_array_target_dupe_t
+{
+   hal_int_t id;
+   const char* qChrom;
+   hal_int_t numRanges;
+   struct hal_target_range_t* tRanges;
+};
+
+/** Same contents as hal_block_results_t, but in arrays that are all 
+ * stored in one allocation (of size bytes), so the results are freed 
+ * with one call to halFreeBlockArrayResults().  Query chromosome names
+ * are stored once, in chroms, and the qChrom fields point to them. */
+struct hal_block_array_results_t
+{
+   hal_int_t numBlocks;
+   struct hal_array_block_t* blocks;
+   hal_int_t numTargetDupes;
+   struct hal_array_target_dupe_t* targetDupes;
+   hal_int_t numChroms;
+   const char** chroms;
+   hal_int_t bytes;
+};
+
 /** Some information about a genome */
 struct hal_species_t
 {
@@ -88,6 +133,18 @@ struct hal_metadata_t
   char *value;
 };
 
+/** Counters of the cache of halGetBlocksInTargetRange results 
+ * (see halSetBlockCacheSize) */
+struct hal_block_cache_stats_t
+{
+   hal_int_t hits;
+   hal_int_t misses;
+   hal_int_t evictions;
+   hal_int_t numEntries;
+   hal_int_t bytes;
+   hal_int_t maxBytes;
+};
+
 /** Duplication mode toggler.  
  * HAL_NO_DUPS: No duplications computed
  * HAL_QUERY_DUPS: The same query range can map to multiple places in target
@@ -215,7 +272,9 @@ struct hal_species_t *halGetPossibleCoalescenceLimits(int halHandle,
  * @param errStr pointer to a string that contains an error message on
  * failure. If NULL, throws an exception on failure instead.
  * @return  block structure -- must be freed by halFreeBlockResults().
- * NULL on failure.
+ * NULL on failure.  Results are cached (see halSetBlockCacheSize) so
+ * repeating a query with the same parameters returns a copy of the 
+ * previous results without reading the alignment.
  */
 struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle, 
                                                       char* qSpecies,
@@ -279,6 +338,39 @@ struct hal_block_results_t *halGetBlocksInTargetRange_filterByChrom(int halHandl
                                                                     const char *coalescenceLimitName,
                                                                     char **errStr);
 
+/** Same as halGetBlocksInTargetRange, but the results are returned in 
+ * arrays instead of linked lists (see hal_block_array_results_t), which
+ * is much faster for queries returning many blocks.
+ * @return  block arrays -- must be freed by halFreeBlockArrayResults().
+ * NULL on failure. */
+struct hal_block_array_results_t *halGetBlocksInTargetRangeArray(
+   int halHandle,
+   char* qSpecies,
+   char* tSpecies,
+   char* tChrom,
+   hal_int_t tStart, 
+   hal_int_t tEnd,
+   hal_int_t tReversed,
+   hal_seqmode_type_t seqMode,
+   hal_dup_type_t dupMode,
+   int mapBackAdjacencies,
+   const char *coalescenceLimitName,
+   char **errStr);
+
+/** Free the results returned by halGetBlocksInTargetRangeArray */
+void halFreeBlockArrayResults(struct hal_block_array_results_t* results);
+
+/** Set the maximum amount of memory used to cache the results of 
+ * halGetBlocksInTargetRange (64MB by default).  The least recently used
+ * results are freed when it is exceeded.  Closing a handle frees all of 
+ * its cached results.
+ * @param maxBytes approximate maximum size of the cache.  0 disables it */
+void halSetBlockCacheSize(hal_int_t maxBytes);
+
+/** Get the counters of the cache of halGetBlocksInTargetRange results
+ * @param stats structure to fill in */
+void halGetBlockCacheStats(struct hal_block_cache_stats_t* stats);
+
 /** Read alignment into an output file in MAF format.  Interface very 
  * similar to halGetBlocksInTargetRange except multiple query species 
  * can be specified
@@ -4,12 +4,18 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <cstring>
 #include "halChainTests.h"
 #include "halBlockViz.h"
 #include "halBlockMapper.h"
 #include "halBottomSegmentTest.h"
 #include "halTopSegmentTest.h"
 #include "halChainGetBlocksTest.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
 
 using namespace std;
 using namespace hal;
@@ -434,6 +440,301 @@ void ChainGetBlocksSimpleLiftoverTest::checkCallBack(
   CuAssertTrue(_testCase, queSeg->getLength() == 10);    
 }
 
+void ChainGetBlocksCacheTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment,
+                        1.5,
+                        0.7,
+                        4,
+                        10,
+                        100,
+                        50,
+                        100,
+                        0);
+}
+
+static bool equalBlocks(const hal_array_block_t& b1, 
+                        const hal_array_block_t& b2)
+{
+  return strcmp(b1.qChrom, b2.qChrom) == 0 && b1.tStart == b2.tStart &&
+     b1.qStart == b2.qStart && b1.size == b2.size && 
+     b1.strand == b2.strand &&
+     (b1.qSequence == NULL) == (b2.qSequence == NULL) &&
+     (b1.qSequence == NULL || 
+      (strcmp(b1.qSequence, b2.qSequence) == 0 &&
+       strcmp(b1.tSequence, b2.tSequence) == 0));
+}
+
+static bool equalResults(const hal_block_array_results_t* r1,
+                         const hal_block_array_results_t* r2)
+{
+  if (r1->numBlocks != r2->numBlocks || 
+      r1->numTargetDupes != r2->numTargetDupes)
+  {
+    return false;
+  }
+  for (hal_int_t i = 0; i < r1->numBlocks; ++i)
+  {
+    if (equalBlocks(r1->blocks[i], r2->blocks[i]) == false)
+    {
+      return false;
+    }
+  }
+  for (hal_int_t i = 0; i < r1->numTargetDupes; ++i)
+  {
+    const hal_array_target_dupe_t& d1 = r1->targetDupes[i];
+    const hal_array_target_dupe_t& d2 = r2->targetDupes[i];
+    if (d1.id != d2.id || strcmp(d1.qChrom, d2.qChrom) != 0 || 
+        d1.numRanges != d2.numRanges)
+    {
+      return false;
+    }
+    for (hal_int_t j = 0; j < d1.numRanges; ++j)
+    {
+      if (d1.tRanges[j].tStart != d2.tRanges[j].tStart ||
+          d1.tRanges[j].size != d2.tRanges[j].size)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ChainGetBlocksCacheTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  // the block queries read the alignment from a file
+  char* path = getTempFile();
+  writeMMapAlignment(alignment, path);
+  const Genome* root = alignment->openGenome(alignment->getRootName());
+  const Genome* child = alignment->openGenome(
+    alignment->getChildNames(root->getName()).at(0));
+  const Sequence* tSequence = NULL;
+  // the child's duplications give target dupes when mapping to the root
+  SequenceIteratorConstPtr seqIt = child->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = child->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    if (tSequence == NULL || seqIt->getSequence()->getSequenceLength() >
+        tSequence->getSequenceLength())
+    {
+      tSequence = seqIt->getSequence();
+    }
+  }
+  CuAssertTrue(_testCase, tSequence->getSequenceLength() >= 2048);
+  string qSpecies = root->getName();
+  string tSpecies = child->getName();
+  string tChrom = tSequence->getName();
+
+  int handle = halOpen(path, NULL);
+  CuAssertTrue(_testCase, handle >= 0);
+  hal_block_cache_stats_t before;
+  hal_block_cache_stats_t after;
+
+  // windows that overlap or are shifted a little, as when panning, and
+  // don't line up with any power of two
+  const size_t numWindows = 6;
+  hal_int_t windows[numWindows][2] = {{137, 611}, {137, 611}, {200, 700}, 
+                                      {1000, 1333}, {0, 2047}, 
+                                      {1017, 1019}};
+  vector<hal_block_array_results_t*> cached(numWindows);
+  for (size_t i = 0; i < numWindows; ++i)
+  {
+    halGetBlockCacheStats(&before);
+    cached[i] = halGetBlocksInTargetRangeArray(
+      handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+      (char*)tChrom.c_str(), windows[i][0], windows[i][1], 0, 
+      HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_AND_TARGET_DUPS, 1, NULL, NULL);
+    halGetBlockCacheStats(&after);
+    // only the same window is found in the cache
+    bool repeated = i > 0 && windows[i - 1][0] == windows[i][0] && 
+       windows[i - 1][1] == windows[i][1];
+    CuAssertTrue(_testCase, after.misses == before.misses + 
+                 (repeated ? 0 : 1));
+    CuAssertTrue(_testCase, after.hits == before.hits + (repeated ? 1 : 0));
+  }
+
+  // the results, cached or not, are the same as mapping the windows 
+  // directly
+  halSetBlockCacheSize(0);
+  hal_int_t numTargetDupes = 0;
+  for (size_t i = 0; i < numWindows; ++i)
+  {
+    hal_block_array_results_t* uncached = halGetBlocksInTargetRangeArray(
+      handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+      (char*)tChrom.c_str(), windows[i][0], windows[i][1], 0, 
+      HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_AND_TARGET_DUPS, 1, NULL, NULL);
+    CuAssertTrue(_testCase, uncached->numBlocks > 0);
+    CuAssertTrue(_testCase, equalResults(cached[i], uncached));
+    numTargetDupes += uncached->numTargetDupes;
+    halFreeBlockArrayResults(cached[i]);
+    halFreeBlockArrayResults(uncached);
+  }
+  CuAssertTrue(_testCase, numTargetDupes > 0);
+  halSetBlockCacheSize(64 * 1024 * 1024);
+
+  // other query parameters don't share the cached results
+  hal_dup_type_t dupModes[] = {HAL_QUERY_AND_TARGET_DUPS, HAL_NO_DUPS};
+  for (size_t i = 0; i < 2; ++i)
+  {
+    halGetBlockCacheStats(&before);
+    hal_block_array_results_t* results = halGetBlocksInTargetRangeArray(
+      handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+      (char*)tChrom.c_str(), 0, 2047, 0, HAL_FORCE_LOD0_SEQUENCE, 
+      dupModes[i], 1, NULL, NULL);
+    halGetBlockCacheStats(&after);
+    CuAssertTrue(_testCase, after.misses == before.misses + 1);
+    CuAssertTrue(_testCase, (results->numTargetDupes == 0) == 
+                 (dupModes[i] == HAL_NO_DUPS));
+    halFreeBlockArrayResults(results);
+  }
+
+  halClose(handle, NULL);
+  removeTempFile(path);
+}
+
+// does ptr point into the allocation of the array results?
+static bool inResults(const void* ptr, const hal_block_array_results_t* r)
+{
+  return (const char*)ptr >= (const char*)r && 
+     (const char*)ptr < (const char*)r + r->bytes;
+}
+
+// are the array results the same as the list results, field for field,
+// with all their pointers into their own allocation?
+static bool sameResults(const hal_block_array_results_t* array,
+                        const hal_block_results_t* list)
+{
+  const hal_block_t* block = list->mappedBlocks;
+  for (hal_int_t i = 0; i < array->numBlocks; ++i, block = block->next)
+  {
+    const hal_array_block_t& arrayBlock = array->blocks[i];
+    if (block == NULL || inResults(&arrayBlock, array) == false ||
+        inResults(arrayBlock.qChrom, array) == false ||
+        strcmp(arrayBlock.qChrom, block->qChrom) != 0 || 
+        arrayBlock.tStart != block->tStart || 
+        arrayBlock.qStart != block->qStart || 
+        arrayBlock.size != block->size || 
+        arrayBlock.strand != block->strand ||
+        (arrayBlock.qSequence == NULL) != (block->qSequence == NULL) ||
+        (arrayBlock.tSequence == NULL) != (block->tSequence == NULL))
+    {
+      return false;
+    }
+    if (arrayBlock.qSequence != NULL &&
+        (inResults(arrayBlock.qSequence, array) == false || 
+         inResults(arrayBlock.tSequence, array) == false ||
+         strcmp(arrayBlock.qSequence, block->qSequence) != 0 ||
+         strcmp(arrayBlock.tSequence, block->tSequence) != 0))
+    {
+      return false;
+    }
+    // the query chromosome names are stored once
+    bool sharedChrom = false;
+    for (hal_int_t j = 0; j < array->numChroms; ++j)
+    {
+      sharedChrom = sharedChrom || array->chroms[j] == arrayBlock.qChrom;
+    }
+    if (sharedChrom == false)
+    {
+      return false;
+    }
+  }
+  if (block != NULL)
+  {
+    return false;
+  }
+
+  const hal_target_dupe_list_t* dupe = list->targetDupeBlocks;
+  for (hal_int_t i = 0; i < array->numTargetDupes; ++i, dupe = dupe->next)
+  {
+    const hal_array_target_dupe_t& arrayDupe = array->targetDupes[i];
+    if (dupe == NULL || inResults(&arrayDupe, array) == false ||
+        inResults(arrayDupe.qChrom, array) == false ||
+        arrayDupe.id != dupe->id || 
+        strcmp(arrayDupe.qChrom, dupe->qChrom) != 0)
+    {
+      return false;
+    }
+    const hal_target_range_t* range = dupe->tRange;
+    for (hal_int_t j = 0; j < arrayDupe.numRanges; ++j, range = range->next)
+    {
+      const hal_target_range_t& arrayRange = arrayDupe.tRanges[j];
+      const hal_target_range_t* next = 
+         j + 1 < arrayDupe.numRanges ? &arrayDupe.tRanges[j + 1] : NULL;
+      if (range == NULL || inResults(&arrayRange, array) == false ||
+          arrayRange.next != next ||
+          arrayRange.tStart != range->tStart || 
+          arrayRange.size != range->size)
+      {
+        return false;
+      }
+    }
+    if (range != NULL)
+    {
+      return false;
+    }
+  }
+  return dupe == NULL;
+}
+
+void ChainGetBlocksArrayTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  char* path = getTempFile();
+  writeMMapAlignment(alignment, path);
+  const Genome* root = alignment->openGenome(alignment->getRootName());
+  const Genome* child = alignment->openGenome(
+    alignment->getChildNames(root->getName()).at(0));
+  string qSpecies = root->getName();
+  string tSpecies = child->getName();
+
+  int handle = halOpen(path, NULL);
+  CuAssertTrue(_testCase, handle >= 0);
+  hal_int_t numBlocks = 0;
+  hal_int_t numTargetDupes = 0;
+  SequenceIteratorConstPtr seqIt = child->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = child->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    string tChrom = seqIt->getSequence()->getName();
+    hal_int_t length = seqIt->getSequence()->getSequenceLength();
+    hal_int_t windows[2][2] = {{0, length}, {length / 3, 2 * length / 3}};
+    for (size_t i = 0; i < 2; ++i)
+    {
+      if (windows[i][0] >= windows[i][1])
+      {
+        continue;
+      }
+      // the first query is mapped.  the list results and the second 
+      // array results are copied from the cache
+      hal_block_array_results_t* mapped = halGetBlocksInTargetRangeArray(
+        handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+        (char*)tChrom.c_str(), windows[i][0], windows[i][1], 0, 
+        HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_AND_TARGET_DUPS, 1, NULL, NULL);
+      hal_block_results_t* list = halGetBlocksInTargetRange(
+        handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+        (char*)tChrom.c_str(), windows[i][0], windows[i][1], 0, 
+        HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_AND_TARGET_DUPS, 1, NULL, NULL);
+      hal_block_array_results_t* copied = halGetBlocksInTargetRangeArray(
+        handle, (char*)qSpecies.c_str(), (char*)tSpecies.c_str(), 
+        (char*)tChrom.c_str(), windows[i][0], windows[i][1], 0, 
+        HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_AND_TARGET_DUPS, 1, NULL, NULL);
+      CuAssertTrue(_testCase, sameResults(mapped, list));
+      CuAssertTrue(_testCase, sameResults(copied, list));
+      numBlocks += mapped->numBlocks;
+      numTargetDupes += mapped->numTargetDupes;
+      halFreeBlockArrayResults(mapped);
+      halFreeBlockResults(list);
+      halFreeBlockArrayResults(copied);
+    }
+  }
+  CuAssertTrue(_testCase, numBlocks > 0);
+  CuAssertTrue(_testCase, numTargetDupes > 0);
+
+  halClose(handle, NULL);
+  removeTempFile(path);
+}
+
 void halChainGetBlocksSimpleTest(CuTest *testCase)
 {
   try 
@@ -538,6 +839,31 @@ void halChainGetBlocksSimpleLiftoverTest(CuTest *testCase)
   } 
 }
 
+void halChainGetBlocksCacheTest(CuTest *testCase)
+{
+  try 
+  {
+    ChainGetBlocksCacheTest tester;
+    tester.check(testCase);
+  }
+   catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
+void halChainGetBlocksArrayTest(CuTest *testCase)
+{
+  try 
+  {
+    ChainGetBlocksArrayTest tester;
+    tester.check(testCase);
+  }
+   catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
 
 CuSuite *halChainGetBlocksTestSuite(void)
 {
@@ -550,6 +876,8 @@ CuSuite *halChainGetBlocksTestSuite(void)
   SUITE_ADD_TEST(suite, halChainGetBlocksInversionOffsetQRefTest);
   SUITE_ADD_TEST(suite, halChainGetBlocksInversionOffsetQSisTest);
   SUITE_ADD_TEST(suite, halChainGetBlocksSimpleLiftoverTest);
+  SUITE_ADD_TEST(suite, halChainGetBlocksCacheTest);
+  SUITE_ADD_TEST(suite, halChainGetBlocksArrayTest);
   return suite;
 }
 
@@ -55,6 +55,17 @@ struct ChainGetBlocksSimpleLiftoverTest : public ChainGetBlocksSimpleTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ChainGetBlocksCacheTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+struct ChainGetBlocksArrayTest : public ChainGetBlocksCacheTest
+{
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 
 
 #endif
@@ -6,22 +6,50 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <pthread.h>
 #include "hal.h"
 
 using namespace std;
 using namespace hal;
 
+/** Whole contents of a genome of the input alignment, read by one
+ * thread so that several genomes can be read at once */
+struct GenomeData
+{
+   const Genome* _inGenome;
+   hal_size_t _numTopSegments;
+   hal_size_t _numBottomSegments;
+   string _dna;
+   vector<Genome::TopSegmentRecord> _topRecords;
+   vector<Genome::BottomSegmentRecord> _bottomRecords;
+   vector<Genome::ChildRecord> _children;
+   string _error;
+};
+
 static void getDimensions(AlignmentConstPtr outAlignment, const Genome* genome,
                           vector<Sequence::Info>& dimensions);
 
 static void copyGenome(const Genome* inGenome, Genome* outGenome);
 
+static void* readGenome(void* arg);
+
+static void writeGenome(GenomeData& data, Genome* outGenome);
+
+static void setBottomSegmentRecords(
+  Genome* outGenome, hal_index_t start,
+  vector<Genome::BottomSegmentRecord>& records,
+  const vector<Genome::ChildRecord>& children);
+
 static void extractTree(const AlignmentConstPtr inAlignment,
                         AlignmentPtr outAlignment, 
                         const string& rootName);
 
+static void getGenomeNames(const AlignmentConstPtr alignment,
+                           const string& rootName, vector<string>& names);
+
 static void extract(const AlignmentConstPtr inAlignment,
-                    AlignmentPtr outAlignment, const string& rootName);
+                    AlignmentPtr outAlignment, const string& rootName,
+                    hal_size_t numThreads);
 
 static CLParserPtr initParser()
 {
@@ -29,6 +57,11 @@ static CLParserPtr initParser()
   optionsParser->addArgument("inHalPath", "input hal file");
   optionsParser->addArgument("outHalPath", "output hal file");
   optionsParser->addOption("root", "root of subtree to extract", "\"\"");
+  optionsParser->addOption("numThreads", "number of genomes to read from "
+                           "the input at once (each is held in memory "
+                           "until it is written).  Only memory-mapped "
+                           "alignments (see hal2mmap) can be read by more "
+                           "than one thread", 1);
   return optionsParser;
 }
 
@@ -39,12 +72,18 @@ int main(int argc, char** argv)
   string inHalPath;
   string outHalPath;
   string rootName;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
     inHalPath = optionsParser->getArgument<string>("inHalPath");
     outHalPath = optionsParser->getArgument<string>("outHalPath");
     rootName = optionsParser->getOption<string>("root");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be > 0");
+    }
   }
   catch(exception& e)
   {
@@ -61,6 +100,13 @@ int main(int argc, char** argv)
     {
       throw hal_exception("input hal alignmenet is empty");
     }
+    if (numThreads > 1 && inAlignment->supportsConcurrentReads() == false)
+    {
+      cerr << "halExtract: Warning " << inHalPath << " cannot be read by "
+           << "more than one thread (convert it with hal2mmap to do so). "
+           << "--numThreads will be ignored" << endl;
+      numThreads = 1;
+    }
 
     AlignmentPtr outAlignment = hdf5AlignmentInstance();
     outAlignment->setOptionsFromParser(optionsParser);
@@ -70,14 +116,14 @@ int main(int argc, char** argv)
     {
       throw hal_exception("output hal alignmenet cannot be initialized");
     }
-    
+
     if (rootName == "\"\"" || inAlignment->getNumGenomes() == 0)
     {
       rootName = inAlignment->getRootName();
     }
 
     extractTree(inAlignment, outAlignment, rootName);
-    extract(inAlignment, outAlignment, rootName);
+    extract(inAlignment, outAlignment, rootName, numThreads);
   }
   catch(hal_exception& e)
   {
@@ -102,7 +148,7 @@ void getDimensions(AlignmentConstPtr outAlignment, const Genome* genome,
 
   bool root = outAlignment->getParentName(genome->getName()).empty();
   bool leaf = outAlignment->getChildNames(genome->getName()).empty();     
-  
+
   for (; seqIt != seqEndIt; seqIt->toNext())
   {
     const Sequence* sequence = seqIt->getSequence();
@@ -114,63 +160,93 @@ void getDimensions(AlignmentConstPtr outAlignment, const Genome* genome,
   }
 }
 
+// the genomes have the same sequences and children (in the same order)
+// in both alignments, so the arrays are copied as they are
 void copyGenome(const Genome* inGenome, Genome* outGenome)
 {
-  DNAIteratorConstPtr inDna = inGenome->getDNAIterator();
-  DNAIteratorPtr outDna = outGenome->getDNAIterator();
-  hal_size_t n = inGenome->getSequenceLength();
-  assert(n == outGenome->getSequenceLength());
-  for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), 
-          outDna->toRight())
-  {
-    outDna->setChar(inDna->getChar());
-  }
+  inGenome->copySequence(outGenome);
 
-  TopSegmentIteratorConstPtr inTop = inGenome->getTopSegmentIterator();
-  TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator();
-  n = outGenome->getNumTopSegments();
+  const hal_size_t blockSegments = Genome::copyBlockSegments;
+  vector<Genome::TopSegmentRecord> topRecords;
+  hal_size_t n = outGenome->getNumTopSegments();
   assert(n == 0 || n == inGenome->getNumTopSegments());
-  for (; (hal_size_t)inTop->getArrayIndex() < n; inTop->toRight(),
-          outTop->toRight())
+  for (hal_size_t start = 0; start < n; start += blockSegments)
   {
-    outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
-    outTop->setParentIndex(inTop->getParentIndex());
-    outTop->setParentReversed(inTop->getParentReversed());
-    outTop->setBottomParseIndex(inTop->getBottomParseIndex());
-    outTop->setNextParalogyIndex(inTop->getNextParalogyIndex());
+    hal_size_t count = min(blockSegments, n - start);
+    inGenome->getTopSegmentRecords(start, count, topRecords);
+    outGenome->setTopSegmentRecords(start, topRecords);
   }
 
-  BottomSegmentIteratorConstPtr inBot = inGenome->getBottomSegmentIterator();
-  BottomSegmentIteratorPtr outBot = outGenome->getBottomSegmentIterator();
+  vector<Genome::BottomSegmentRecord> bottomRecords;
+  vector<Genome::ChildRecord> children;
   n = outGenome->getNumBottomSegments();
   assert(n == 0 || n == inGenome->getNumBottomSegments());
-  hal_size_t nc = inGenome->getNumChildren();
-  assert(nc == outGenome->getNumChildren());
-  for (; (hal_size_t)inBot->getArrayIndex() < n; inBot->toRight(),
-          outBot->toRight())
+  assert(inGenome->getNumChildren() == outGenome->getNumChildren());
+  for (hal_size_t start = 0; start < n; start += blockSegments)
   {
-    outBot->setCoordinates(inBot->getStartPosition(), inBot->getLength());
-    for (hal_size_t child = 0; child < nc; ++child)
-    {
-      outBot->setChildIndex(child, inBot->getChildIndex(child));
-      outBot->setChildReversed(child, inBot->getChildReversed(child));
-    }
-    if (outGenome->getAlignment()->getRootName() == outGenome->getName())
+    hal_size_t count = min(blockSegments, n - start);
+    inGenome->getBottomSegmentRecords(start, count, bottomRecords, children);
+    setBottomSegmentRecords(outGenome, start, bottomRecords, children);
+  }
+
+  inGenome->copyMetadata(outGenome);
+}
+
+void* readGenome(void* arg)
+{
+  GenomeData* data = static_cast<GenomeData*>(arg);
+  try
+  {
+    const Genome* inGenome = data->_inGenome;
+    inGenome->getString(data->_dna);
+    if (data->_numTopSegments > 0)
     {
-      outBot->setTopParseIndex(NULL_INDEX);
+      inGenome->getTopSegmentRecords(0, data->_numTopSegments,
+                                     data->_topRecords);
     }
-    else
+    if (data->_numBottomSegments > 0)
     {
-      outBot->setTopParseIndex(inBot->getTopParseIndex());
+      inGenome->getBottomSegmentRecords(0, data->_numBottomSegments,
+                                        data->_bottomRecords,
+                                        data->_children);
     }
   }
+  catch (exception& e)
+  {
+    data->_error = e.what();
+  }
+  return NULL;
+}
 
-  const map<string, string>& meta = inGenome->getMetaData()->getMap();
-  map<string, string>::const_iterator i = meta.begin();
-  for (; i != meta.end(); ++i)
+void writeGenome(GenomeData& data, Genome* outGenome)
+{
+  outGenome->setString(data._dna);
+  if (data._numTopSegments > 0)
   {
-    outGenome->getMetaData()->set(i->first, i->second);
+    outGenome->setTopSegmentRecords(0, data._topRecords);
   }
+  if (data._numBottomSegments > 0)
+  {
+    setBottomSegmentRecords(outGenome, 0, data._bottomRecords,
+                            data._children);
+  }
+  data._inGenome->copyMetadata(outGenome);
+}
+
+// the root of the extracted tree has no top segments for its bottom
+// segments to point to, even if it had a parent in the input
+void setBottomSegmentRecords(Genome* outGenome, hal_index_t start,
+                             vector<Genome::BottomSegmentRecord>& records,
+                             const vector<Genome::ChildRecord>& children)
+{
+  if (outGenome->getParent() == NULL)
+  {
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+      records[i]._topParseIndex = NULL_INDEX;
+    }
+  }
+  outGenome->setBottomSegmentRecords(start, records, children);
 }
 
 static void extractTree(const AlignmentConstPtr inAlignment,
@@ -199,7 +275,7 @@ static void extractTree(const AlignmentConstPtr inAlignment,
 
   inAlignment->closeGenome(genome);
   outAlignment->closeGenome(newGenome);
-  
+
   vector<string> childNames = inAlignment->getChildNames(rootName);
   for (size_t i = 0; i < childNames.size(); ++i)
   {
@@ -207,27 +283,96 @@ static void extractTree(const AlignmentConstPtr inAlignment,
   }
 }
 
+void getGenomeNames(const AlignmentConstPtr alignment,
+                    const string& rootName, vector<string>& names)
+{
+  names.push_back(rootName);
+  vector<string> childNames = alignment->getChildNames(rootName);
+  for (size_t i = 0; i < childNames.size(); ++i)
+  {
+    getGenomeNames(alignment, childNames[i], names);
+  }
+}
 
 void extract(const AlignmentConstPtr inAlignment,
-             AlignmentPtr outAlignment, const string& rootName)
+             AlignmentPtr outAlignment, const string& rootName,
+             hal_size_t numThreads)
 {
-  const Genome* genome = inAlignment->openGenome(rootName);
-  Genome* newGenome = outAlignment->openGenome(rootName);
-  assert(newGenome != NULL);
+  vector<string> names;
+  getGenomeNames(inAlignment, rootName, names);
+
+  // the genomes are independent, so numThreads of them are read from the
+  // input at once.  they are then written one at a time since the output
+  // can only be written by one thread
+  for (size_t first = 0; first < names.size(); first += numThreads)
+  {
+    size_t numGenomes = min((size_t)numThreads, names.size() - first);
+    vector<const Genome*> genomes(numGenomes);
+    vector<Genome*> newGenomes(numGenomes);
+    for (size_t i = 0; i < numGenomes; ++i)
+    {
+      genomes[i] = inAlignment->openGenome(names[first + i]);
+      newGenomes[i] = outAlignment->openGenome(names[first + i]);
+      assert(newGenomes[i] != NULL);
+      vector<Sequence::Info> dimensions;
+      getDimensions(outAlignment, genomes[i], dimensions);
+      newGenomes[i]->setDimensions(dimensions);
+    }
 
-  vector<Sequence::Info> dimensions;
-  getDimensions(outAlignment, genome, dimensions);
-  newGenome->setDimensions(dimensions);
+    if (numGenomes == 1)
+    {
+      cout << "Extracting " << genomes[0]->getName() << endl;
+      copyGenome(genomes[0], newGenomes[0]);
+    }
+    else
+    {
+      vector<GenomeData> data(numGenomes);
+      vector<pthread_t> threads(numGenomes);
+      for (size_t i = 0; i < numGenomes; ++i)
+      {
+        data[i]._inGenome = genomes[i];
+        data[i]._numTopSegments = newGenomes[i]->getNumTopSegments();
+        data[i]._numBottomSegments = newGenomes[i]->getNumBottomSegments();
+      }
+      size_t numStarted = 0;
+      for (; numStarted < numGenomes; ++numStarted)
+      {
+        if (pthread_create(&threads[numStarted], NULL, readGenome,
+                           &data[numStarted]) != 0)
+        {
+          break;
+        }
+      }
+      // read whatever didn't get a thread here
+      for (size_t i = numStarted; i < numGenomes; ++i)
+      {
+        readGenome(&data[i]);
+      }
+      for (size_t i = 0; i < numStarted; ++i)
+      {
+        pthread_join(threads[i], NULL);
+      }
 
-  cout << "Extracting " << genome->getName() << endl;
-  copyGenome(genome, newGenome);  
+      for (size_t i = 0; i < numGenomes; ++i)
+      {
+        if (data[i]._error.empty() == false)
+        {
+          throw hal_exception(data[i]._error);
+        }
+        cout << "Extracting " << genomes[i]->getName() << endl;
+        writeGenome(data[i], newGenomes[i]);
+        // free each genome once it's written
+        string().swap(data[i]._dna);
+        vector<Genome::TopSegmentRecord>().swap(data[i]._topRecords);
+        vector<Genome::BottomSegmentRecord>().swap(data[i]._bottomRecords);
+        vector<Genome::ChildRecord>().swap(data[i]._children);
+      }
+    }
 
-  inAlignment->closeGenome(genome);
-  outAlignment->closeGenome(newGenome);
-  
-  vector<string> childNames = inAlignment->getChildNames(rootName);
-  for (size_t i = 0; i < childNames.size(); ++i)
-  {
-    extract(inAlignment, outAlignment, childNames[i]);
+    for (size_t i = 0; i < numGenomes; ++i)
+    {
+      inAlignment->closeGenome(genomes[i]);
+      outAlignment->closeGenome(newGenomes[i]);
+    }
   }
 }
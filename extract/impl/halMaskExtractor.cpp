@@ -9,6 +9,7 @@
 #include <string>
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
 #include "halMaskExtractor.h"
 
 using namespace std;
@@ -43,74 +44,63 @@ void MaskExtractor::extract(AlignmentConstPtr alignment,
     _sequence = seqIt->getSequence();
     if (_sequence->getSequenceLength() > 0)
     {
-      _posCache.clear();    
-      addMaskedBasesToCache();
-      extendCachedIntervals();
-      writeCachedIntervals();
+      _runs.clear();
+      addMaskedRuns();
+      extendRuns();
+      writeRuns();
     }
   }
 }
 
-void MaskExtractor::addMaskedBasesToCache()
+void MaskExtractor::addMaskedRuns()
 {
-  assert(_posCache.size() == 0);
-  DNAIteratorConstPtr dna = _sequence->getDNAIterator();
-  DNAIteratorConstPtr dnaEnd = _sequence->getDNAEndIterator();
-  for (; !dna->equals(dnaEnd); dna->toRight())
-  {
-    if (isMasked(dna->getChar()))
-    {
-      _posCache.insert(dna->getArrayIndex());
-    }
-  }
+  assert(_runs.size() == 0);
+  getMaskedRuns(_sequence, 0, _sequence->getSequenceLength(), _runs);
 }
 
-void MaskExtractor::extendCachedIntervals()
+void MaskExtractor::extendRuns()
 {
-  if (_extend == 0 && _extendPct == 0.)
+  if ((_extend == 0 && _extendPct == 0.) || _runs.empty() == true)
   {
     return;
   }
   assert(_extend == 0 || _extendPct == 0.);
 
-  hal_size_t start = (hal_size_t)_sequence->getStartPosition();
-  hal_size_t last = (hal_size_t)(start + _sequence->getSequenceLength()) - 1;
+  hal_index_t last = (hal_index_t)_sequence->getSequenceLength() - 1;
   
-  const PositionCache::IntervalSet* intervalSet = 
-     _posCache.getIntervalSet();
-  PositionCache::IntervalSet::const_iterator i;
-  vector<hal_index_t> padding;
-  for (i = intervalSet->begin(); i != intervalSet->end(); ++i)
+  // runs padded by a percentage of their length can reach past runs that
+  // come before them, so they are sorted again before being merged
+  for (size_t i = 0; i < _runs.size(); ++i)
   {
-    hal_size_t len = (hal_size_t)(i->first - i->second) + 1;
-    hal_size_t pad = _extend ? _extend : (hal_size_t)(_extendPct * len);
-    hal_size_t newFirst = max(start, i->second - pad);
-    for (hal_size_t j = newFirst; j < (hal_size_t)i->second; ++j)
+    hal_size_t len = (hal_size_t)(_runs[i].second - _runs[i].first) + 1;
+    hal_index_t pad = 
+       (hal_index_t)(_extend ? _extend : (hal_size_t)(_extendPct * len));
+    _runs[i].first = max((hal_index_t)0, _runs[i].first - pad);
+    _runs[i].second = min(last, _runs[i].second + pad);
+  }
+  sort(_runs.begin(), _runs.end());
+  size_t numMerged = 0;
+  for (size_t i = 1; i < _runs.size(); ++i)
+  {
+    if (_runs[i].first <= _runs[numMerged].second + 1)
     {
-      padding.push_back(j);
+      _runs[numMerged].second = max(_runs[numMerged].second, 
+                                    _runs[i].second);
     }
-    hal_size_t newLast = min(last, i->first + pad);
-    for (hal_size_t j = i->first + 1; j <= newLast; ++j)
+    else
     {
-      padding.push_back(j);
+      _runs[++numMerged] = _runs[i];
     }
   }
-  for (hal_size_t k = 0; k < padding.size(); ++k)
-  {
-    _posCache.insert(padding[k]);
-  }
+  _runs.resize(numMerged + 1);
 }
 
-void MaskExtractor::writeCachedIntervals()
+void MaskExtractor::writeRuns()
 {
-  hal_index_t start = _sequence->getStartPosition();
-  const PositionCache::IntervalSet* intervalSet = 
-     _posCache.getIntervalSet();
-  PositionCache::IntervalSet::const_iterator i;
-  for (i = intervalSet->begin(); i != intervalSet->end(); ++i)
+  for (size_t i = 0; i < _runs.size(); ++i)
   {
     *_bedStream << _sequence->getName() << '\t' 
-                << i->second - start << '\t'
-                << (i->first + 1) - start << '\n';
+                << _runs[i].first << '\t'
+                << _runs[i].second + 1 << '\n';
   }
 }
@@ -27,9 +27,9 @@ public:
 
 protected:
 
-   void addMaskedBasesToCache();
-   void extendCachedIntervals();
-   void writeCachedIntervals();
+   void addMaskedRuns();
+   void extendRuns();
+   void writeRuns();
 
 protected:
 
@@ -39,7 +39,8 @@ protected:
    std::ostream* _bedStream;
    hal_size_t _extend; 
    double _extendPct;
-   PositionCache _posCache;
+   // masked runs of the current sequence (in sequence coordinates)
+   PositionRuns _runs;
    
 };
 
@@ -1,6 +1,7 @@
 #include "hal.h"
 #include "hal4dExtract.h"
 #include "hal4dExtractTest.h"
+#include "halMaskExtractorTest.h"
 
 using namespace std;
 using namespace hal;
@@ -271,6 +272,7 @@ int hal4dExtractRunAllTests(void)
    CuString *output = CuStringNew();
    CuSuite* suite = CuSuiteNew();
    CuSuiteAddSuite(suite, hal4dExtractTestSuite());
+   CuSuiteAddSuite(suite, halMaskExtractorTestSuite());
    CuSuiteRun(suite);
    CuSuiteSummary(suite, output);
    CuSuiteDetails(suite, output);
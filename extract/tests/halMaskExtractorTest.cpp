@@ -0,0 +1,72 @@
+#include <sstream>
+#include "hal.h"
+#include "halMaskExtractor.h"
+#include "halMaskExtractorTest.h"
+
+using namespace std;
+using namespace hal;
+
+void MaskExtractorExtendTest::createCallBack(AlignmentPtr alignment)
+{
+  Genome *genome = alignment->addRootGenome("root");
+  vector<Sequence::Info> seqVec(1);
+  seqVec[0] = Sequence::Info("rootSequence", 40, 0, 0);
+  genome->setDimensions(seqVec);
+  // masked runs at 0-1, 6-7, 13-14, 18-19, 30 and 33-39
+  genome->setString("aaCGTAccGTACGttACGggACGTACGTACaCGttttttt");
+}
+
+void MaskExtractorExtendTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const Genome *genome = alignment->openGenome("root");
+  MaskExtractor mask;
+
+  stringstream outStream;
+  mask.extract(alignment, genome, &outStream, 0, 0.);
+  CuAssertTrue(_testCase, outStream.str() == 
+               "rootSequence\t0\t2\n"
+               "rootSequence\t6\t8\n"
+               "rootSequence\t13\t15\n"
+               "rootSequence\t18\t20\n"
+               "rootSequence\t30\t31\n"
+               "rootSequence\t33\t40\n");
+
+  // the run at 0 is clipped, the runs at 0 and 6 become adjacent, the
+  // runs at 13 and 18 overlap, and so do the runs at 30 and 33, the
+  // last of which is clipped at the end of the sequence
+  outStream.str("");
+  mask.extract(alignment, genome, &outStream, 2, 0.);
+  CuAssertTrue(_testCase, outStream.str() == 
+               "rootSequence\t0\t10\n"
+               "rootSequence\t11\t22\n"
+               "rootSequence\t28\t40\n");
+
+  // padded by their own length, the run at 33 reaches back past the
+  // one at 30
+  outStream.str("");
+  mask.extract(alignment, genome, &outStream, 0, 1.);
+  CuAssertTrue(_testCase, outStream.str() == 
+               "rootSequence\t0\t10\n"
+               "rootSequence\t11\t22\n"
+               "rootSequence\t26\t40\n");
+}
+
+void halMaskExtractorExtendTest(CuTest *testCase)
+{
+  try
+  {
+    MaskExtractorExtendTest tester;
+    tester.check(testCase);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halMaskExtractorTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMaskExtractorExtendTest);
+  return suite;
+}
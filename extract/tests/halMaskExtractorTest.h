@@ -0,0 +1,16 @@
+#ifndef _HALMASKEXTRACTORTEST_H
+#define _HALMASKEXTRACTORTEST_H
+#include "halAlignmentTest.h"
+
+extern "C" {
+#include "CuTest.h"
+}
+
+struct MaskExtractorExtendTest : public AlignmentTest
+{
+  void createCallBack(hal::AlignmentPtr alignment);
+  void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+CuSuite* halMaskExtractorTestSuite(void);
+#endif
@@ -11,11 +11,20 @@ include  ${sonLibRootPath}/include.mk
 
 dataSetsPath=/Users/hickey/Documents/Devel/genomes/datasets
 
-cflags += -I${sonLibPath} -fPIC
-cppflags += -I${sonLibPath} -fPIC
+cflags += -I${sonLibPath} -fPIC -pthread
+cppflags += -I${sonLibPath} -fPIC -pthread
+
+# unpack DNA strings with SSSE3 byte shuffles (see hdf5DNA.cpp).  only
+# enable if all the machines running the binaries support it
+ifdef ENABLE_SSSE3
+	cppflags += -mssse3
+endif
 
 basicLibs = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a
-basicLibsDependencies = ${basicLibs}
+basicLibsDependencies := ${basicLibs}
+
+# zlib compresses the blocks of bigWig files (see halBigWigWriter.h)
+basicLibs += -lz
 
 # hdf5 compilation is done through its wrappers.
 # we can speficy our own (sonlib) compilers with these variables:
@@ -35,8 +44,8 @@ ifdef ENABLE_UDC
 		SAMTABIXDIR = /hive/data/outside/samtabix/${MACHTYPE}
 	endif
 
-	cppflags += -DENABLE_UDC -I${KENTSRC}/src/inc -pthread
-	cflags += -I${KENTSRC}/src/inc -pthread
+	cppflags += -DENABLE_UDC -I${KENTSRC}/src/inc
+	cflags += -I${KENTSRC}/src/inc
 	basicLibs += ${KENTSRC}/src/lib/${MACHTYPE}/jkweb.a  ${SAMTABIXDIR}/libsamtabix.a -lssl -lcrypto
 endif
 
@@ -12,7 +12,14 @@
 using namespace std;
 using namespace hal;
 
-BlockLiftover::BlockLiftover() : Liftover()
+/** how many segments we scan to the right from the previous interval
+ * before giving up and searching for the new start from scratch */
+static const hal_size_t MaxSweepSegments = 32;
+
+BlockLiftover::BlockLiftover() : Liftover(),
+                                 _prevGlobalStart(NULL_INDEX),
+                                 _prevGlobalEnd(NULL_INDEX),
+                                 _prevFlip(false)
 {
 
 }
@@ -47,6 +54,42 @@ void BlockLiftover::visitBegin()
   inputSet.insert(_coalescenceLimit);
   inputSet.insert(_tgtGenome);
   getGenomesInSpanningTree(inputSet, _downwardPath);
+
+  _prevMappedSegments.clear();
+  _prevGlobalStart = NULL_INDEX;
+  _prevGlobalEnd = NULL_INDEX;
+}
+
+Liftover* BlockLiftover::createWorker() const
+{
+  return new BlockLiftover();
+}
+
+// move _refSeg to the (unsliced) segment containing globalStart.  when
+// intervals are sorted, this is usually at or just right of where the
+// previous interval left it, so we try scanning there first instead of
+// searching the whole genome again.
+void BlockLiftover::moveRefSeg(hal_index_t globalStart)
+{
+  if (_refSeg->getArrayIndex() >= 0 && 
+      _refSeg->getArrayIndex() < _lastIndex)
+  {
+    _refSeg->slice(0, 0);
+    for (hal_size_t i = 0; i < MaxSweepSegments &&
+            _refSeg->getStartPosition() <= globalStart; ++i)
+    {
+      if (_refSeg->getEndPosition() >= globalStart)
+      {
+        return;
+      }
+      _refSeg->toRight();
+      if (_refSeg->getArrayIndex() >= _lastIndex)
+      {
+        break;
+      }
+    }
+  }
+  _refSeg->toSite(globalStart, false);
 }
 
 void BlockLiftover::liftInterval(BedList& mappedBedLines)
@@ -56,32 +99,46 @@ void BlockLiftover::liftInterval(BedList& mappedBedLines)
   hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
   bool flip = _bedLine._strand == '-';
 
-  _refSeg->toSite(globalStart, false);
-  hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
-  hal_offset_t endOffset = 0;
-  if (globalEnd <= _refSeg->getEndPosition())
+  if (globalStart == _prevGlobalStart && globalEnd == _prevGlobalEnd &&
+      flip == _prevFlip)
   {
-    endOffset = _refSeg->getEndPosition() - globalEnd;
+    _mappedSegments.insert(_prevMappedSegments.begin(), 
+                           _prevMappedSegments.end());
   }
-  _refSeg->slice(startOffset, endOffset);
-
-  assert(_refSeg->getStartPosition() ==  globalStart);
-  assert(_refSeg->getEndPosition() <= globalEnd);
-
-  while (_refSeg->getArrayIndex() < _lastIndex &&
-         _refSeg->getStartPosition() <= globalEnd)
+  else
   {
-    if (flip == true)
+    moveRefSeg(globalStart);
+    hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
+    hal_offset_t endOffset = 0;
+    if (globalEnd <= _refSeg->getEndPosition())
     {
-      _refSeg->toReverseInPlace();
+      endOffset = _refSeg->getEndPosition() - globalEnd;
     }
-    _refSeg->getMappedSegments(_mappedSegments, _tgtGenome, &_downwardPath,
-                               _traverseDupes, 0, _coalescenceLimit, _mrca);
-    if (flip == true)
+    _refSeg->slice(startOffset, endOffset);
+    
+    assert(_refSeg->getStartPosition() ==  globalStart);
+    assert(_refSeg->getEndPosition() <= globalEnd);
+    
+    while (_refSeg->getArrayIndex() < _lastIndex &&
+           _refSeg->getStartPosition() <= globalEnd)
     {
-      _refSeg->toReverseInPlace();
+      if (flip == true)
+      {
+        _refSeg->toReverseInPlace();
+      }
+      _refSeg->getMappedSegments(_mappedSegments, _tgtGenome, &_downwardPath,
+                                 _traverseDupes, 0, _coalescenceLimit, _mrca);
+      if (flip == true)
+      {
+        _refSeg->toReverseInPlace();
+      }
+      _refSeg->toRight(globalEnd);
     }
-    _refSeg->toRight(globalEnd);
+    _prevMappedSegments.assign(_mappedSegments.begin(), 
+                               _mappedSegments.end());
+    _prevGlobalStart = globalStart;
+    _prevGlobalEnd = globalEnd;
+    _prevFlip = flip;
   }
 
   vector<MappedSegmentConstPtr> fragments;
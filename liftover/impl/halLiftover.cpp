@@ -6,22 +6,74 @@
 
 #include <deque>
 #include <cassert>
+#include <pthread.h>
 #include "halLiftover.h"
 
 using namespace std;
 using namespace hal;
 
+const hal_size_t Liftover::defaultBatchSize = 100000;
+
+/** order input lines by source coordinate, keeping input order for 
+ * ties so that duplicated intervals end up next to each other */
+struct BedLineIndexLess
+{
+   BedLineIndexLess(const vector<BedLine>& bedLines) : _bedLines(bedLines) {}
+   bool operator()(size_t i, size_t j) const
+   {
+     const BedLine& b1 = _bedLines[i];
+     const BedLine& b2 = _bedLines[j];
+     if (b1._chrName != b2._chrName)
+     {
+       return b1._chrName < b2._chrName;
+     }
+     if (b1._start != b2._start)
+     {
+       return b1._start < b2._start;
+     }
+     return b1._end < b2._end;
+   }
+   const vector<BedLine>& _bedLines;
+};
+
+/** a slice of a sorted batch, lifted by one of the pool's threads */
+struct Liftover::LiftoverJob
+{
+   vector<BedLine> _bedLines;
+   vector<BedList> _results;
+   string _error;
+};
+
+/** The threads started by convert(), each lifting with its own Liftover
+ * (the thread claims one when it starts), and the queue of jobs they 
+ * take their work from */
+struct Liftover::LiftoverPool
+{
+   vector<Liftover*> _liftovers;
+   size_t _numClaimed;
+   vector<pthread_t> _threads;
+   deque<LiftoverJob*> _jobs;
+   size_t _numPending;
+   bool _stop;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _jobReady;
+   pthread_cond_t _jobDone;
+};
+
 Liftover::Liftover() : _outBedStream(NULL),                       
                        _inBedVersion(-1), _outBedVersion(-1),
                        _outPSL(false), _outPSLWithName(false),
-                       _srcGenome(NULL), _tgtGenome(NULL)
+                       _srcGenome(NULL), _tgtGenome(NULL),
+                       _batchSize(1),
+                       _numThreads(1),
+                       _pool(NULL)
 {
 
 }
 
 Liftover::~Liftover()
 {
-
+  stopWorkers();
 }
 
 void Liftover::convert(AlignmentConstPtr alignment,
@@ -36,7 +88,8 @@ void Liftover::convert(AlignmentConstPtr alignment,
                        bool outPSL,
                        bool outPSLWithName,
                        const locale* inLocale,
-                       const Genome *coalescenceLimit)
+                       const Genome *coalescenceLimit,
+                       hal_size_t batchSize)
 {
   _srcGenome = srcGenome;
   _tgtGenome = tgtGenome;
@@ -49,6 +102,8 @@ void Liftover::convert(AlignmentConstPtr alignment,
   _outPSL = outPSL;
   _outPSLWithName = outPSLWithName;
   _inLocale = inLocale;
+  _batchSize = batchSize;
+  _batch.clear();
   _missedSet.clear();
   _tgtSet.clear();
   assert(_srcGenome && inBedStream && tgtGenome && outBedStream);
@@ -79,12 +134,27 @@ void Liftover::convert(AlignmentConstPtr alignment,
     _outBedVersion = _inBedVersion;
   }
 
-  if (firstLineStream != NULL)
+  startWorkers();
+  try
   {
-    scan(firstLineStream, _inBedVersion, inLocale);
-    delete firstLineStream;
+    if (firstLineStream != NULL)
+    {
+      scan(firstLineStream, _inBedVersion, inLocale);
+      delete firstLineStream;
+    }
+    scan(inBedStream, _inBedVersion, inLocale);
   }
-  scan(inBedStream, _inBedVersion, inLocale);
+  catch (...)
+  {
+    stopWorkers();
+    throw;
+  }
+  stopWorkers();
+}
+
+void Liftover::setNumThreads(hal_size_t numThreads)
+{
+  _numThreads = max(numThreads, (hal_size_t)1);
 }
 
 void Liftover::visitBegin()
@@ -92,6 +162,250 @@ void Liftover::visitBegin()
 }
 
 void Liftover::visitLine()
+{
+  if (_batchSize <= 1)
+  {
+    liftLine();
+    writeLineResults();
+  }
+  else
+  {
+    _batch.push_back(_bedLine);
+    if (_batch.size() >= _batchSize)
+    {
+      flushBatch();
+    }
+  }
+}
+
+void Liftover::visitEOF()
+{
+  flushBatch();
+}
+
+void Liftover::flushBatch()
+{
+  if (_batch.empty() == true)
+  {
+    return;
+  }
+  liftIntervals(_batch, _batchResults);
+  for (size_t i = 0; i < _batchResults.size(); ++i)
+  {
+    _outBedLines.swap(_batchResults[i]);
+    writeLineResults();
+  }
+  _batch.clear();
+  _batchResults.clear();
+}
+
+void Liftover::liftIntervals(const vector<BedLine>& bedLines,
+                             vector<BedList>& outBedLines)
+{
+  vector<size_t> order(bedLines.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+  stable_sort(order.begin(), order.end(), BedLineIndexLess(bedLines));
+
+  outBedLines.clear();
+  outBedLines.resize(bedLines.size());
+  if (_pool != NULL && bedLines.size() > 1)
+  {
+    liftIntervalsParallel(bedLines, order, outBedLines);
+    return;
+  }
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    _bedLine = bedLines[order[i]];
+    liftLine();
+    outBedLines[order[i]].swap(_outBedLines);
+  }
+}
+
+// each thread lifts a contiguous slice of the sorted batch, so that the
+// sweep along the source genome still works within every slice
+void Liftover::liftIntervalsParallel(const vector<BedLine>& bedLines,
+                                     const vector<size_t>& order,
+                                     vector<BedList>& outBedLines)
+{
+  size_t numJobs = min(_pool->_liftovers.size(), bedLines.size());
+  vector<LiftoverJob> jobs(numJobs);
+  for (size_t i = 0; i < numJobs; ++i)
+  {
+    size_t first = i * order.size() / numJobs;
+    size_t last = (i + 1) * order.size() / numJobs;
+    for (size_t j = first; j < last; ++j)
+    {
+      jobs[i]._bedLines.push_back(bedLines[order[j]]);
+    }
+  }
+
+  pthread_mutex_lock(&_pool->_mutex);
+  for (size_t i = 0; i < numJobs; ++i)
+  {
+    _pool->_jobs.push_back(&jobs[i]);
+  }
+  _pool->_numPending += numJobs;
+  pthread_cond_broadcast(&_pool->_jobReady);
+  while (_pool->_numPending > 0)
+  {
+    pthread_cond_wait(&_pool->_jobDone, &_pool->_mutex);
+  }
+  pthread_mutex_unlock(&_pool->_mutex);
+
+  size_t next = 0;
+  string error;
+  for (size_t i = 0; i < numJobs; ++i)
+  {
+    if (error.empty() == true)
+    {
+      error = jobs[i]._error;
+    }
+    for (size_t j = 0; j < jobs[i]._results.size(); ++j, ++next)
+    {
+      outBedLines[order[next]].swap(jobs[i]._results[j]);
+    }
+  }
+  if (error.empty() == false)
+  {
+    throw hal_exception(error);
+  }
+}
+
+void Liftover::startWorkers()
+{
+  if (_numThreads <= 1 || _batchSize <= 1)
+  {
+    return;
+  }
+  if (_srcGenome->getAlignment()->supportsConcurrentReads() == false)
+  {
+    throw hal_exception("Multithreaded liftover requires an alignment "
+                        "that supports concurrent reads (use hal2mmap to "
+                        "convert it)");
+  }
+  _pool = new LiftoverPool();
+  _pool->_numClaimed = 0;
+  _pool->_numPending = 0;
+  _pool->_stop = false;
+  pthread_mutex_init(&_pool->_mutex, NULL);
+  pthread_cond_init(&_pool->_jobReady, NULL);
+  pthread_cond_init(&_pool->_jobDone, NULL);
+
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    Liftover* liftover = createWorker();
+    if (liftover == NULL)
+    {
+      stopWorkers();
+      throw hal_exception("Multithreaded liftover not supported by this "
+                          "liftover method");
+    }
+    liftover->_alignment = _alignment;
+    liftover->_srcGenome = _srcGenome;
+    liftover->_tgtGenome = _tgtGenome;
+    liftover->_coalescenceLimit = _coalescenceLimit;
+    liftover->_addExtraColumns = _addExtraColumns;
+    liftover->_inBedVersion = _inBedVersion;
+    liftover->_outBedVersion = _outBedVersion;
+    liftover->_traverseDupes = _traverseDupes;
+    liftover->_outPSL = _outPSL;
+    liftover->_outPSLWithName = _outPSLWithName;
+    liftover->_inLocale = _inLocale;
+    liftover->_tgtSet = _tgtSet;
+    liftover->_missedSet = _missedSet;
+    liftover->visitBegin();
+    _pool->_liftovers.push_back(liftover);
+  }
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, liftWorker, _pool) != 0)
+    {
+      stopWorkers();
+      throw hal_exception("Error creating liftover thread");
+    }
+    _pool->_threads.push_back(thread);
+  }
+}
+
+void Liftover::stopWorkers()
+{
+  if (_pool == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&_pool->_mutex);
+  _pool->_stop = true;
+  pthread_cond_broadcast(&_pool->_jobReady);
+  pthread_mutex_unlock(&_pool->_mutex);
+  for (size_t i = 0; i < _pool->_threads.size(); ++i)
+  {
+    pthread_join(_pool->_threads[i], NULL);
+  }
+  for (size_t i = 0; i < _pool->_liftovers.size(); ++i)
+  {
+    _missedSet.insert(_pool->_liftovers[i]->_missedSet.begin(),
+                      _pool->_liftovers[i]->_missedSet.end());
+    delete _pool->_liftovers[i];
+  }
+  pthread_cond_destroy(&_pool->_jobDone);
+  pthread_cond_destroy(&_pool->_jobReady);
+  pthread_mutex_destroy(&_pool->_mutex);
+  delete _pool;
+  _pool = NULL;
+}
+
+void* Liftover::liftWorker(void* arg)
+{
+  LiftoverPool* pool = static_cast<LiftoverPool*>(arg);
+  pthread_mutex_lock(&pool->_mutex);
+  Liftover* liftover = pool->_liftovers[pool->_numClaimed++];
+  while (true)
+  {
+    while (pool->_jobs.empty() == true && pool->_stop == false)
+    {
+      pthread_cond_wait(&pool->_jobReady, &pool->_mutex);
+    }
+    if (pool->_jobs.empty() == true)
+    {
+      break;
+    }
+    LiftoverJob* job = pool->_jobs.front();
+    pool->_jobs.pop_front();
+    pthread_mutex_unlock(&pool->_mutex);
+
+    try
+    {
+      liftover->liftIntervals(job->_bedLines, job->_results);
+    }
+    catch (exception& e)
+    {
+      job->_error = e.what();
+    }
+    catch (...)
+    {
+      job->_error = "Error lifting over intervals";
+    }
+
+    pthread_mutex_lock(&pool->_mutex);
+    if (--pool->_numPending == 0)
+    {
+      pthread_cond_signal(&pool->_jobDone);
+    }
+  }
+  pthread_mutex_unlock(&pool->_mutex);
+  return NULL;
+}
+
+Liftover* Liftover::createWorker() const
+{
+  return NULL;
+}
+
+void Liftover::liftLine()
 {
   _outBedLines.clear();
   _srcSequence = _srcGenome->getSequence(_bedLine._chrName);
@@ -145,11 +459,6 @@ void Liftover::visitLine()
 
   cleanResults();
   _outBedLines.sort(BedLineSrcLess());
-  writeLineResults();
-}
-
-void Liftover::visitEOF()
-{
 }
 
 void Liftover::writeLineResults()
@@ -56,6 +56,17 @@ static CLParserPtr initParser()
                                " column entries to contain spaces.  if this"
                                " flag is not set, both spaces and tabs are"
                                " used to separate input columns.", false);
+  optionsParser->addOption("batchSize", "number of input lines that are "
+                           "read and then lifted together, in order of "
+                           "their source coordinates.  the output is "
+                           "always written in input order.  1 lifts each "
+                           "line as soon as it is read.",
+                           Liftover::defaultBatchSize);
+  optionsParser->addOption("numThreads", "number of threads used to lift "
+                           "each batch of input lines (see --batchSize).  "
+                           "Only memory-mapped alignments (see hal2mmap) "
+                           "can be read by more than one thread",
+                           1);
   optionsParser->setDescription("Map BED genome interval coordinates between "
                                 "two genomes.");
   return optionsParser;
@@ -79,6 +90,8 @@ int main(int argc, char** argv)
   bool outPSL;
   bool outPSLWithName;
   bool tab;
+  hal_size_t batchSize;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -96,6 +109,8 @@ int main(int argc, char** argv)
     outPSL = optionsParser->getFlag("outPSL");
     outPSLWithName = optionsParser->getFlag("outPSLWithName");
     tab = optionsParser->getFlag("tab");
+    batchSize = optionsParser->getOption<hal_size_t>("batchSize");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
   }
   catch(exception& e)
   {
@@ -186,10 +201,24 @@ int main(int argc, char** argv)
       assert(std::isspace(' ', *inLocale) == false);
     }
     
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be > 0");
+    }
+    if (numThreads > 1 && alignment->supportsConcurrentReads() == false)
+    {
+      cerr << "halLiftover: Warning " << halPath << " cannot be read by "
+           << "more than one thread (convert it with hal2mmap to do so). "
+           << "--numThreads will be ignored" << endl;
+      numThreads = 1;
+    }
+
     BlockLiftover liftover;
+    liftover.setNumThreads(numThreads);
     liftover.convert(alignment, srcGenome, srcBedPtr, tgtGenome, tgtBedPtr,
                      inBedVersion, outBedVersion, keepExtra, !noDupes,
-                     outPSL, outPSLWithName, inLocale, coalescenceLimit);
+                     outPSL, outPSLWithName, inLocale, coalescenceLimit,
+                     batchSize);
     
     delete inLocale;
 
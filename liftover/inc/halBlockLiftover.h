@@ -26,6 +26,8 @@ protected:
 
    void liftInterval(BedList& mappedBedLines);
    void visitBegin();
+   Liftover* createWorker() const;
+   void moveRefSeg(hal_index_t globalStart);
 
    void cleanTargetParalogies();
    void readPSLInfo(std::vector<MappedSegmentConstPtr>& fragments, 
@@ -37,8 +39,15 @@ protected:
    std::set<MappedSegmentConstPtr> _mappedSegments;
    SegmentIteratorConstPtr _refSeg;
    hal_index_t _lastIndex;
-   std::set<const Genome*> _downwardPath;
+   GenomeSet _downwardPath;
    const Genome *_mrca;
+
+   // mapping of the previous interval (in set order), reused if the next
+   // one is the same (which is common once the input is sorted)
+   std::vector<MappedSegmentConstPtr> _prevMappedSegments;
+   hal_index_t _prevGlobalStart;
+   hal_index_t _prevGlobalEnd;
+   bool _prevFlip;
 };
 
 }
@@ -35,15 +35,46 @@ public:
                 bool outPSL = false,
                 bool outPSLWithName = false,
                 const std::locale* inLocale = NULL,
-                const Genome *coalescenceLimit = NULL);
+                const Genome *coalescenceLimit = NULL,
+                hal_size_t batchSize = 1);
+
+   /** default number of input lines lifted together by halLiftover */
+   static const hal_size_t defaultBatchSize;
+
+   /** Split each batch of input lines (see convert()) among this many
+    * threads, which are started once per call to convert().  The 
+    * alignment must support concurrent reads, and the subclass must 
+    * implement createWorker() */
+   void setNumThreads(hal_size_t numThreads);
                    
 protected:
 
    typedef std::list<BedLine> BedList;
+   struct LiftoverJob;
+   struct LiftoverPool;
 
    virtual void visitBegin();
    virtual void visitLine();
    virtual void visitEOF();
+   /** lift _bedLine into _outBedLines (without writing anything) */
+   virtual void liftLine();
+   /** lift a batch of input lines in order of source position, so
+    * that consecutive intervals are close together in the source genome,
+    * and return their results in input order (one list per line) */
+   virtual void liftIntervals(const std::vector<BedLine>& bedLines,
+                              std::vector<BedList>& outBedLines);
+   void liftIntervalsParallel(const std::vector<BedLine>& bedLines,
+                              const std::vector<size_t>& order,
+                              std::vector<BedList>& outBedLines);
+   /** start the threads (each with its own liftover object from
+    * createWorker()) that lift the batches until stopWorkers() */
+   void startWorkers();
+   void stopWorkers();
+   static void* liftWorker(void* arg);
+   /** new, unconfigured instance of the same class to lift part of a 
+    * batch in another thread.  NULL if not supported */
+   virtual Liftover* createWorker() const;
+   void flushBatch();
    virtual void writeLineResults();
    virtual void assignBlocksToIntervals();
    virtual bool compatible(const BedLine& tgtBed, const BedLine& newBlock);
@@ -77,6 +108,12 @@ protected:
 
    ColumnIteratorConstPtr _colIt;
    std::set<std::string> _missedSet;
+
+   hal_size_t _batchSize;
+   hal_size_t _numThreads;
+   std::vector<BedLine> _batch;
+   std::vector<BedList> _batchResults;
+   LiftoverPool* _pool;
 };
 
 }
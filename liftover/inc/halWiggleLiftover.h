@@ -62,7 +62,7 @@ protected:
    const Genome* _srcGenome;
    const Genome* _tgtGenome;
    const Sequence* _srcSequence;
-   std::set<const Genome*> _tgtSet;
+   GenomeSet _tgtSet;
    std::set<MappedSegmentConstPtr> _mappedSegments;
    hal_index_t _lastIndex;
 
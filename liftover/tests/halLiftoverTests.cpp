@@ -8,6 +8,10 @@
 #include "halBlockLiftover.h"
 #include "halLiftoverTests.h"
 
+extern "C" {
+#include "commonC.h"
+}
+
 using namespace std;
 using namespace hal;
 
@@ -352,6 +356,112 @@ void BedLiftoverTest::testMultiBranchLifts(AlignmentConstPtr alignment)
   
 }
 
+// lifting in batches (sorted by source position) must give exactly the
+// same output, in the same order, as lifting line by line
+void BedLiftoverTest::testBatchLifts(AlignmentConstPtr alignment)
+{
+  const Genome *root = alignment->openGenome("root");
+  const Genome *leaf3 = alignment->openGenome("leaf3");
+  const Genome *leaf1 = alignment->openGenome("leaf1");
+
+  string bed("Sequence\t75\t100\tSEGMENT_5\t0\t+\n"
+             "Sequence\t10\t30\tSEGMENT_1\t0\t+\n"
+             "Sequence\t45\t65\tSEGMENT_3\t0\t-\n"
+             "Sequence\t10\t30\tSEGMENT_1_DUPE\t0\t+\n"
+             "Sequence\t0\t10\tSEGMENT_0\t0\t+\n"
+             "Sequence\t30\t45\tSEGMENT_2\t0\t+\n"
+             "Sequence\t45\t65\tSEGMENT_3_DUPE\t0\t-\n"
+             "Sequence\t65\t75\tSEGMENT_4\t0\t+\n");
+  
+  const Genome* srcGenomes[2] = {leaf3, root};
+  for (size_t i = 0; i < 2; ++i)
+  {
+    stringstream bedFile(bed);
+    stringstream outStream;
+    BlockLiftover liftover;
+    liftover.convert(alignment, srcGenomes[i], &bedFile, leaf1, &outStream);
+
+    for (hal_size_t batchSize = 2; batchSize < 10; batchSize += 3)
+    {
+      stringstream batchBedFile(bed);
+      stringstream batchOutStream;
+      BlockLiftover batchLiftover;
+      batchLiftover.convert(alignment, srcGenomes[i], &batchBedFile, leaf1, 
+                            &batchOutStream, -1, -1, false, true, false,
+                            false, NULL, NULL, batchSize);
+      CuAssertTrue(_testCase, batchOutStream.str() == outStream.str());
+    }
+  }
+}
+
+// splitting each batch among threads (which needs an alignment that
+// supports concurrent reads) must not change the output either
+void BedLiftoverTest::testThreadedLifts(AlignmentConstPtr alignment)
+{
+  char* mmapPath = getTempFile();
+  writeMMapAlignment(alignment, mmapPath);
+  AlignmentConstPtr mmapAlignment =
+     openHalAlignmentReadOnly(mmapPath, CLParserConstPtr());
+  const Genome *leaf1 = mmapAlignment->openGenome("leaf1");
+
+  string bed("Sequence\t75\t100\tSEGMENT_5\t0\t+\n"
+             "Sequence\t10\t30\tSEGMENT_1\t0\t+\n"
+             "Sequence\t45\t65\tSEGMENT_3\t0\t-\n"
+             "Sequence\t0\t10\tSEGMENT_0\t0\t+\n"
+             "Sequence\t30\t45\tSEGMENT_2\t0\t+\n"
+             "Sequence\t65\t75\tSEGMENT_4\t0\t+\n");
+
+  const char* srcNames[2] = {"leaf3", "root"};
+  for (size_t i = 0; i < 2; ++i)
+  {
+    const Genome* srcGenome = mmapAlignment->openGenome(srcNames[i]);
+    stringstream bedFile(bed);
+    stringstream outStream;
+    BlockLiftover liftover;
+    liftover.convert(mmapAlignment, srcGenome, &bedFile, leaf1, &outStream);
+    CuAssertTrue(_testCase, outStream.str().empty() == false);
+
+    // small batches go through the same threads one after another
+    hal_size_t batchSizes[] = {2, Liftover::defaultBatchSize};
+    for (hal_size_t numThreads = 2; numThreads < 8; numThreads += 2)
+    {
+      for (size_t j = 0; j < 2; ++j)
+      {
+        stringstream threadBedFile(bed);
+        stringstream threadOutStream;
+        BlockLiftover threadLiftover;
+        threadLiftover.setNumThreads(numThreads);
+        threadLiftover.convert(mmapAlignment, srcGenome, &threadBedFile, 
+                               leaf1, &threadOutStream, -1, -1, false, true,
+                               false, false, NULL, NULL, batchSizes[j]);
+        CuAssertTrue(_testCase, threadOutStream.str() == outStream.str());
+      }
+    }
+  }
+
+  // HDF5 alignments can't be read by several threads
+  bool threw = false;
+  try
+  {
+    stringstream bedFile(bed);
+    stringstream outStream;
+    BlockLiftover liftover;
+    liftover.setNumThreads(2);
+    liftover.convert(alignment, alignment->openGenome("leaf3"), &bedFile,
+                     alignment->openGenome("leaf1"), &outStream, -1, -1, 
+                     false, true, false, false, NULL, NULL, 
+                     Liftover::defaultBatchSize);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+
+  mmapAlignment->close();
+  removeTempFile(mmapPath);
+}
+
 void BedLiftoverTest::createCallBack(AlignmentPtr alignment)
 {
   setupSharedAlignment(alignment);
@@ -361,6 +471,8 @@ void BedLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
 {
   testOneBranchLifts(alignment);
   testMultiBranchLifts(alignment);
+  testBatchLifts(alignment);
+  testThreadedLifts(alignment);
 }
 
 /*
@@ -19,6 +19,8 @@ struct BedLiftoverTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
    void testOneBranchLifts(hal::AlignmentConstPtr alignment);
    void testMultiBranchLifts(hal::AlignmentConstPtr alignment);
+   void testBatchLifts(hal::AlignmentConstPtr alignment);
+   void testThreadedLifts(hal::AlignmentConstPtr alignment);
 };
 
 struct WiggleLiftoverTest : public AlignmentTest
@@ -34,7 +34,7 @@ const unsigned long LodManager::MaxAgeSec = 432000;
 // hal/lod/halLodInterpolate.py)
 const string LodManager::MaxLodToken = "max";
 
-LodManager::LodManager()
+LodManager::LodManager() : _concurrentReads(false)
 {
 
 }
@@ -127,6 +127,7 @@ void LodManager::loadLODFile(const string& lodPath,
   }
 
   checkMap(lodPath);
+  checkConcurrentReads();
 }
 
 void LodManager::loadSingeHALFile(const string& halPath,
@@ -137,12 +138,15 @@ void LodManager::loadSingeHALFile(const string& halPath,
                 0, PathAlign(halPath, AlignmentConstPtr())));
   _maxLodLowerBound = (hal_size_t)numeric_limits<hal_index_t>::max();
   checkMap(halPath);
+  checkConcurrentReads();
 }
 
 AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength,
                                            bool needDNA)
 {
   assert(_map.size() > 0);
+  // alignments are opened on demand, possibly by several threads
+  ScopedLock lock(_mutex);
   AlignmentMap::iterator mapIt;
   if (needDNA == true)
   {
@@ -164,12 +168,7 @@ AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength,
   }
   if (alignment.get() == NULL)
   {
-    alignment = hdf5AlignmentInstanceReadOnly();
-    if (_options.get() != NULL)
-    {
-      alignment->setOptionsFromParser(_options);
-    }
-    alignment->open(mapIt->second.first);
+    alignment = openHalAlignmentReadOnly(mapIt->second.first, _options);
     checkAlignment(mapIt->first, mapIt->second.first, alignment);
   }
   assert(mapIt->second.second.get() != NULL);
@@ -222,6 +221,20 @@ void LodManager::checkMap(const string& lodPath)
   }
 }
 
+void LodManager::checkConcurrentReads()
+{
+  _concurrentReads = true;
+  for (AlignmentMap::const_iterator mapIt = _map.begin(); 
+       mapIt != _map.end() && _concurrentReads == true; ++mapIt)
+  {
+    if (mapIt->first != _maxLodLowerBound &&
+        isMMapAlignmentFile(mapIt->second.first) == false)
+    {
+      _concurrentReads = false;
+    }
+  }
+}
+
 void LodManager::checkAlignment(hal_size_t minQuery,
                                 const string& path,
                                 AlignmentConstPtr alignment)
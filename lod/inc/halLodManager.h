@@ -51,6 +51,12 @@ public:
    /** Any query greater than this is disabled */
    hal_size_t getMaxQueryLength() const;
 
+   /** Check if every level of detail is stored in an alignment that
+    * supports concurrent reads (ie is memory-mapped).  In this case
+    * getAlignment() and all read-only queries on the alignments it 
+    * returns can be made from several threads at once. */
+   bool supportsConcurrentReads() const;
+
    /** Maximum age of a URL in seconds such that we dont try to 
     * preload headers for all the HAL files */
    static const unsigned long MaxAgeSec;
@@ -66,6 +72,7 @@ protected:
    void checkAlignment(hal_size_t minQuery, const std::string& path,
                        AlignmentConstPtr alignment);
    void preloadAlignments();
+   void checkConcurrentReads();
 
    typedef std::pair<std::string, AlignmentConstPtr> PathAlign;
    typedef std::map<hal_size_t, PathAlign> AlignmentMap;
@@ -73,6 +80,8 @@ protected:
    CLParserConstPtr _options;
    AlignmentMap _map;
    hal_size_t _maxLodLowerBound;
+   bool _concurrentReads;
+   Mutex _mutex;
 };
 
 inline hal_size_t LodManager::getMaxQueryLength() const 
@@ -80,6 +89,11 @@ inline hal_size_t LodManager::getMaxQueryLength() const
   return _maxLodLowerBound - 1;
 }
 
+inline bool LodManager::supportsConcurrentReads() const
+{
+  return _concurrentReads;
+}
+
 HAL_FORWARD_DEC_CLASS(LodManager)
 
 
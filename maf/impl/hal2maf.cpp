@@ -85,6 +85,23 @@ static CLParserPtr initParser()
                                false);
   optionsParser->addOptionFlag("onlyOrthologs", "make only orthologs to the "
                                "reference appear in the MAF blocks", false);
+  optionsParser->addOption("numThreads",
+                           "number of threads used to convert the reference "
+                           "range (requires --unique).  The range is split "
+                           "into shards of --shardLength bases that are "
+                           "converted in parallel, and the output is the "
+                           "same as with one thread.  Only memory-mapped "
+                           "alignments (see hal2mmap) can be read by more "
+                           "than one thread",
+                           1);
+  optionsParser->addOption("shardLength",
+                           "length of reference shards when using more than "
+                           "one thread",
+                           MafExport::defaultShardLength);
+  optionsParser->addOption("positionCache",
+                           "how the column iterator remembers visited bases "
+                           "(bitmap or interval)",
+                           "interval");
 
   optionsParser->setDescription("Convert hal database to maf.");
   return optionsParser;
@@ -112,6 +129,8 @@ int main(int argc, char** argv)
   bool printTree;
   bool onlyOrthologs;
   hal_index_t maxBlockLen;
+  hal_size_t numThreads;
+  hal_size_t shardLength;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -134,12 +153,24 @@ int main(int argc, char** argv)
     printTree = optionsParser->getFlag("printTree");
     maxBlockLen = optionsParser->getOption<hal_index_t>("maxBlockLen");
     onlyOrthologs = optionsParser->getFlag("onlyOrthologs");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    shardLength = optionsParser->getOption<hal_size_t>("shardLength");
+    PositionCache::setDefaultType(PositionCache::getTypeFromName(
+      optionsParser->getOption<string>("positionCache")));
 
     if (rootGenomeName != "\"\"" && targetGenomes != "\"\"")
     {
       throw hal_exception("--rootGenome and --targetGenomes options are "
                           "mutually exclusive");
     }
+    if (numThreads == 0 || shardLength == 0)
+    {
+      throw hal_exception("--numThreads and --shardLength must be > 0");
+    }
+    if (numThreads > 1 && unique == false && global == false)
+    {
+      throw hal_exception("--numThreads > 1 requires --unique");
+    }
   }
   catch(exception& e)
   {
@@ -155,6 +186,18 @@ int main(int argc, char** argv)
     {
       throw hal_exception("hal alignmenet is empty");
     }
+    if (numThreads > 1 && alignment->supportsConcurrentReads() == false)
+    {
+      cerr << "hal2maf: Warning " << halPath << " cannot be read by more "
+           << "than one thread (convert it with hal2mmap to do so). "
+           << "--numThreads will be ignored" << endl;
+      numThreads = 1;
+    }
+    if (numThreads > 1 && global == true)
+    {
+      cerr << "hal2maf: Warning --numThreads is not supported with "
+           << "--global and will be ignored" << endl;
+    }
     
     set<const Genome*> targetSet;
     const Genome* rootGenome = NULL;
@@ -251,6 +294,8 @@ int main(int argc, char** argv)
     mafExport.setMaxBlockLength(maxBlockLen);
     mafExport.setPrintTree(printTree);
     mafExport.setOnlyOrthologs(onlyOrthologs);
+    mafExport.setNumThreads(numThreads);
+    mafExport.setShardLength(shardLength);
 
     ifstream refTargetsStream;
     if (refTargetsPath != "\"\"")
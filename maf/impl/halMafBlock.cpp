@@ -93,6 +93,28 @@ void MafBlock::resetEntries()
   }  
 }
 
+void MafBlock::clearEntries()
+{
+  for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+  {
+    delete i->second;
+  }
+  _entries.clear();
+  _reference = _entries.end();
+  _refIndex = NULL_INDEX;
+}
+
+void MafBlock::getEntryUsage(
+  vector<pair<const Sequence*, hal_size_t> >& usage) const
+{
+  usage.clear();
+  for (Entries::const_iterator i = _entries.begin(); i != _entries.end(); ++i)
+  {
+    usage.push_back(pair<const Sequence*, hal_size_t>(
+                      i->first, i->second->_lastUsed));
+  }
+}
+
 void MafBlock::initEntry(MafBlockEntry* entry, const Sequence* sequence, 
                          DNAIteratorConstPtr dna, bool clearSequence)
 {
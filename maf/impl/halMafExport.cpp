@@ -6,12 +6,104 @@
 
 #include <deque>
 #include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <pthread.h>
 #include "halMafExport.h"
 
 using namespace std;
 using namespace hal;
 
-MafExport::MafExport() : _maxRefGap(0), _noDupes(false), _printTree(false)
+const hal_size_t MafExport::defaultShardLength = 100000;
+
+/** Column maps (and block entries) are cleared out on the first block
+ * started in each window of this many maximum block lengths of the
+ * reference */
+static const hal_index_t defragmentBlockLengths = 10;
+
+static hal_index_t getGenomePosition(ColumnIteratorConstPtr colIt)
+{
+  return colIt->getReferenceSequence()->getStartPosition() +
+     colIt->getReferenceSequencePosition();
+}
+
+/** Besides the columns, the blocks depend on the sequences left in the
+ * column map and on the entries the MafBlock keeps from earlier blocks.
+ * Both are taken right after a block is started. */
+struct BlockHistory
+{
+   bool operator==(const BlockHistory& other) const
+   {
+     return _sequences == other._sequences && 
+        _entryUsage == other._entryUsage;
+   }
+   vector<const Sequence*> _sequences;
+   vector<pair<const Sequence*, hal_size_t> > _entryUsage;
+};
+
+/** State shared by the threads of convertRangeParallel.  Workers claim
+ * shards in reference order but can't get more than _window shards
+ * ahead of the writer, which bounds the amount of finished output held
+ * in memory while waiting its turn. */
+struct MafExport::ShardQueue
+{
+   const MafExport* _exporter;
+   const SegmentedSequence* _seq;
+   const set<const Genome*>* _targets;
+   hal_index_t _startPosition;
+   hal_index_t _lastPosition;
+   // genome coordinate of _startPosition
+   hal_index_t _genomeStart;
+   hal_size_t _shardLength;
+   hal_size_t _numShards;
+   hal_size_t _window;
+   hal_size_t _nextShard;
+   hal_size_t _nextWrite;
+   vector<ShardState*> _output;
+   string _error;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _shardDone;
+   pthread_cond_t _shardWritten;
+};
+
+/** A shard's column iterator, its open block and the blocks it has 
+ * finished.  Columns are only converted by the shard that contains 
+ * their left-most reference position, so a shard gives the same blocks
+ * as a serial conversion from the first block it starts on the same 
+ * column, and with the same history, as the serial conversion.  The
+ * writer finds that block by carrying on the previous shard past its end
+ * (see convertShard()). */
+struct MafExport::ShardState
+{
+   ShardState(hal_index_t maxBlockLength) : _mafBlock(maxBlockLength),
+                                            _appendCount(0),
+                                            _pending(true),
+                                            _done(false),
+                                            _key(NULL_INDEX, 0),
+                                            _defragmentWindow(NULL_INDEX) {}
+   ColumnIteratorConstPtr _colIt;
+   MafBlock _mafBlock;
+   hal_size_t _appendCount;
+   // the iterator is on a column that hasn't been converted yet
+   bool _pending;
+   bool _done;
+   ColumnKey _key;
+   hal_index_t _defragmentWindow;
+   stringstream _output;
+   // first column of each block, its history and where it starts in 
+   // _output (the last block is still open)
+   vector<ColumnKey> _blockKeys;
+   vector<BlockHistory> _blockHistories;
+   vector<size_t> _blockOffsets;
+};
+
+MafExport::MafExport() : _maxRefGap(0), _noDupes(false), 
+                         _noAncestors(false), _ucscNames(false),
+                         _unique(false), _append(false), _printTree(false),
+                         _onlyOrthologs(false),
+                         _maxBlockLength(MafBlock::defaultMaxLength),
+                         _numThreads(1),
+                         _shardLength(defaultShardLength)
 {
 
 }
@@ -53,6 +145,7 @@ void MafExport::setAppend(bool append)
 
 void MafExport::setMaxBlockLength(hal_index_t maxLength)
 {
+  _maxBlockLength = maxLength;
   _mafBlock.setMaxLength(maxLength);
 }
 
@@ -66,6 +159,20 @@ void MafExport::setOnlyOrthologs(bool onlyOrthologs)
   _onlyOrthologs = onlyOrthologs;
 }
 
+void MafExport::setNumThreads(hal_size_t numThreads)
+{
+  _numThreads = max(numThreads, (hal_size_t)1);
+}
+
+void MafExport::setShardLength(hal_size_t shardLength)
+{
+  if (shardLength == 0)
+  {
+    throw hal_exception("MAF shard length must be > 0");
+  }
+  _shardLength = shardLength;
+}
+
 void MafExport::writeHeader()
 {
   assert(_mafStream != NULL);
@@ -106,6 +213,28 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
     writeHeader();
   }
 
+  if (_numThreads > 1)
+  {
+    if (_unique == false)
+    {
+      throw hal_exception("Multithreaded MAF export is only supported with "
+                          "the unique option");
+    }
+    convertRangeParallel(mafStream, seq, startPosition, lastPosition, 
+                         targets);
+  }
+  else
+  {
+    convertRange(mafStream, seq, startPosition, lastPosition, targets);
+  }
+}
+
+void MafExport::convertRange(ostream& mafStream,
+                             const SegmentedSequence* seq,
+                             hal_index_t startPosition,
+                             hal_index_t lastPosition,
+                             const set<const Genome*>& targets)
+{
   ColumnIteratorConstPtr colIt = seq->getColumnIterator(&targets,
                                                         _maxRefGap, 
                                                         startPosition,
@@ -118,14 +247,15 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
 
 
   hal_size_t appendCount = 0;
+  hal_index_t defragmentWindow = NULL_INDEX;
   if (_unique == false || colIt->isCanonicalOnRef() == true)
   {
+    defragment(colIt, _mafBlock, defragmentWindow);
     _mafBlock.initBlock(colIt, _ucscNames, _printTree);
     assert(_mafBlock.canAppendColumn(colIt) == true);
     _mafBlock.appendColumn(colIt);
     ++appendCount;
   }
-  size_t numBlocks = 0;
   while (colIt->lastColumn() == false)
   {
     colIt->toRight();
@@ -133,21 +263,17 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
     {
       if (appendCount == 0)
       {
+        defragment(colIt, _mafBlock, defragmentWindow);
         _mafBlock.initBlock(colIt, _ucscNames, _printTree);
         assert(_mafBlock.canAppendColumn(colIt) == true);
       }
       if (_mafBlock.canAppendColumn(colIt) == false)
       {
-        // erase empty entries from the column.  helps when there are 
-        // millions of sequences (ie from fastas with lots of scaffolds)
-        if (numBlocks++ % 1000 == 0)
-        {
-          colIt->defragment();
-        }
         if (appendCount > 0)
         {
           mafStream << _mafBlock << '\n';
         }
+        defragment(colIt, _mafBlock, defragmentWindow);
         _mafBlock.initBlock(colIt, _ucscNames, _printTree);
         assert(_mafBlock.canAppendColumn(colIt) == true);
       }
@@ -164,6 +290,326 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
   }
 }
 
+void MafExport::convertRangeParallel(ostream& mafStream,
+                                     const SegmentedSequence* seq,
+                                     hal_index_t startPosition,
+                                     hal_index_t lastPosition,
+                                     const set<const Genome*>& targets)
+{
+  if (_alignment->supportsConcurrentReads() == false)
+  {
+    throw hal_exception("Multithreaded MAF export requires an alignment "
+                        "that supports concurrent reads (use hal2mmap to "
+                        "convert it)");
+  }
+  hal_size_t length = lastPosition - startPosition + 1;
+  const Sequence* sequence = dynamic_cast<const Sequence*>(seq);
+
+  ShardQueue queue;
+  queue._exporter = this;
+  queue._seq = seq;
+  queue._targets = &targets;
+  queue._startPosition = startPosition;
+  queue._lastPosition = lastPosition;
+  queue._genomeStart = startPosition;
+  if (sequence != NULL)
+  {
+    queue._genomeStart += sequence->getStartPosition();
+  }
+  queue._shardLength = _shardLength;
+  queue._numShards = (length + _shardLength - 1) / _shardLength;
+  queue._window = 2 * _numThreads;
+  queue._nextShard = 0;
+  queue._nextWrite = 0;
+  queue._output.assign(queue._numShards, NULL);
+  pthread_mutex_init(&queue._mutex, NULL);
+  pthread_cond_init(&queue._shardDone, NULL);
+  pthread_cond_init(&queue._shardWritten, NULL);
+
+  vector<pthread_t> threads(min(_numThreads, queue._numShards));
+  size_t numStarted = 0;
+  for (; numStarted < threads.size(); ++numStarted)
+  {
+    if (pthread_create(&threads[numStarted], NULL, shardWorker, &queue) != 0)
+    {
+      pthread_mutex_lock(&queue._mutex);
+      queue._error = "Error creating MAF export thread";
+      pthread_mutex_unlock(&queue._mutex);
+      break;
+    }
+  }
+
+  // write the shards back in order as they are finished.  the previous
+  // shard is carried on into each new one until they start a block on 
+  // the same column, and the new shard takes over from there
+  ShardState* carry = NULL;
+  pthread_mutex_lock(&queue._mutex);
+  while (numStarted > 0 && queue._nextWrite < queue._numShards && 
+         queue._error.empty() == true)
+  {
+    ShardState* state = queue._output[queue._nextWrite];
+    if (state == NULL)
+    {
+      pthread_cond_wait(&queue._shardDone, &queue._mutex);
+      continue;
+    }
+    queue._output[queue._nextWrite] = NULL;
+    hal_index_t shardLast = min(
+      queue._genomeStart + (hal_index_t)((queue._nextWrite + 1) * 
+                                         _shardLength) - 1,
+      queue._genomeStart + (hal_index_t)length - 1);
+    pthread_mutex_unlock(&queue._mutex);
+
+    string error;
+    try
+    {
+      size_t offset = 0;
+      if (carry != NULL)
+      {
+        size_t sync = convertShard(*carry, shardLast, state);
+        mafStream << carry->_output.str();
+        if (sync < state->_blockKeys.size())
+        {
+          offset = state->_blockOffsets[sync];
+          delete carry;
+          carry = NULL;
+        }
+        else
+        {
+          delete state;
+          state = NULL;
+        }
+      }
+      if (state != NULL)
+      {
+        string output = state->_output.str();
+        mafStream.write(output.data() + offset, output.length() - offset);
+        carry = state;
+      }
+      carry->_output.str(string());
+      carry->_output.clear();
+      carry->_blockKeys.clear();
+      carry->_blockHistories.clear();
+      carry->_blockOffsets.clear();
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+
+    pthread_mutex_lock(&queue._mutex);
+    if (error.empty() == false && queue._error.empty() == true)
+    {
+      queue._error = error;
+    }
+    ++queue._nextWrite;
+    pthread_cond_broadcast(&queue._shardWritten);
+  }
+  // wake up any workers still waiting for room in the window
+  pthread_cond_broadcast(&queue._shardWritten);
+  pthread_mutex_unlock(&queue._mutex);
+
+  for (size_t i = 0; i < numStarted; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  for (size_t i = 0; i < queue._output.size(); ++i)
+  {
+    delete queue._output[i];
+  }
+  pthread_cond_destroy(&queue._shardWritten);
+  pthread_cond_destroy(&queue._shardDone);
+  pthread_mutex_destroy(&queue._mutex);
+
+  if (queue._error.empty() == true && carry != NULL && 
+      carry->_appendCount > 0)
+  {
+    mafStream << carry->_mafBlock << endl;
+  }
+  delete carry;
+  if (queue._error.empty() == false)
+  {
+    throw hal_exception(queue._error);
+  }
+}
+
+// Same as the loop of convertRange() with the unique option, but one
+// column at a time so that it can be stopped at lastPosition (a genome
+// coordinate) and picked up again later.  If next is given, also stop
+// when a block is started on the same column, and with the same history,
+// as one of next's blocks, and return its index.  Otherwise returns the
+// number of next's blocks (or 0)
+size_t MafExport::convertShard(ShardState& state, hal_index_t lastPosition,
+                               const ShardState* next) const
+{
+  ColumnIteratorConstPtr& colIt = state._colIt;
+  BlockHistory history;
+  while (state._done == false)
+  {
+    if (state._pending == false)
+    {
+      if (colIt->lastColumn() == true)
+      {
+        state._done = true;
+        break;
+      }
+      colIt->toRight();
+      state._pending = true;
+    }
+    hal_index_t position = getGenomePosition(colIt);
+    if (position > lastPosition)
+    {
+      break;
+    }
+    state._pending = false;
+    if (colIt->isCanonicalOnRef() == false)
+    {
+      continue;
+    }
+    if (position == state._key.first)
+    {
+      ++state._key.second;
+    }
+    else
+    {
+      state._key = ColumnKey(position, 0);
+    }
+
+    if (state._appendCount > 0 && 
+        state._mafBlock.canAppendColumn(colIt) == true)
+    {
+      state._mafBlock.appendColumn(colIt);
+      ++state._appendCount;
+      continue;
+    }
+    if (state._appendCount > 0)
+    {
+      state._output << state._mafBlock << '\n';
+      state._appendCount = 0;
+    }
+    defragment(colIt, state._mafBlock, state._defragmentWindow);
+    state._mafBlock.initBlock(colIt, _ucscNames, _printTree);
+    assert(state._mafBlock.canAppendColumn(colIt) == true);
+
+    const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+    history._sequences.clear();
+    for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+         i != colMap->end(); ++i)
+    {
+      history._sequences.push_back(i->first);
+    }
+    state._mafBlock.getEntryUsage(history._entryUsage);
+    if (next != NULL)
+    {
+      vector<ColumnKey>::const_iterator i = 
+         lower_bound(next->_blockKeys.begin(), next->_blockKeys.end(), 
+                     state._key);
+      if (i != next->_blockKeys.end() && *i == state._key &&
+          next->_blockHistories[i - next->_blockKeys.begin()] == history)
+      {
+        return i - next->_blockKeys.begin();
+      }
+    }
+    else
+    {
+      state._blockKeys.push_back(state._key);
+      state._blockHistories.push_back(history);
+      state._blockOffsets.push_back((size_t)state._output.tellp());
+    }
+    state._mafBlock.appendColumn(colIt);
+    ++state._appendCount;
+  }
+  return next != NULL ? next->_blockKeys.size() : 0;
+}
+
+// erase empty entries from the column map, and the entries kept by the
+// block, on the first block started in each window of the reference.
+// helps when there are millions of sequences (ie from fastas with lots of
+// scaffolds).  unlike a count of blocks, the windows are the same in 
+// every shard of convertRangeParallel(), and the shards' blocks don't
+// depend on anything before them once they've been through one
+void MafExport::defragment(ColumnIteratorConstPtr colIt, MafBlock& mafBlock,
+                           hal_index_t& lastWindow) const
+{
+  hal_index_t window = getGenomePosition(colIt) / 
+     (defragmentBlockLengths * max(_maxBlockLength, (hal_index_t)1));
+  if (window != lastWindow)
+  {
+    colIt->defragment();
+    mafBlock.clearEntries();
+    lastWindow = window;
+  }
+}
+
+void* MafExport::shardWorker(void* arg)
+{
+  ShardQueue* queue = static_cast<ShardQueue*>(arg);
+  pthread_mutex_lock(&queue->_mutex);
+  while (true)
+  {
+    while (queue->_nextShard < queue->_numShards &&
+           queue->_error.empty() == true &&
+           queue->_nextShard >= queue->_nextWrite + queue->_window)
+    {
+      pthread_cond_wait(&queue->_shardWritten, &queue->_mutex);
+    }
+    if (queue->_nextShard >= queue->_numShards || 
+        queue->_error.empty() == false)
+    {
+      break;
+    }
+    hal_size_t shard = queue->_nextShard++;
+    pthread_mutex_unlock(&queue->_mutex);
+
+    hal_index_t start = queue->_startPosition + 
+       (hal_index_t)(shard * queue->_shardLength);
+    hal_index_t genomeLast = queue->_genomeStart + 
+       (hal_index_t)((shard + 1) * queue->_shardLength) - 1;
+    const MafExport* exporter = queue->_exporter;
+    ShardState* state = NULL;
+    string error;
+    try
+    {
+      // the iterator runs to the end of the whole range so that the 
+      // writer can carry the shard on into the next one
+      state = new ShardState(exporter->_maxBlockLength);
+      state->_colIt = queue->_seq->getColumnIterator(queue->_targets,
+                                                     exporter->_maxRefGap,
+                                                     start,
+                                                     queue->_lastPosition,
+                                                     exporter->_noDupes,
+                                                     exporter->_noAncestors,
+                                                     false, // reverseStrand
+                                                     true,  // unique
+                                                     exporter->_onlyOrthologs);
+      exporter->convertShard(*state, genomeLast, NULL);
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+    catch (...)
+    {
+      error = "Error converting MAF shard";
+    }
+    if (error.empty() == false)
+    {
+      delete state;
+      state = NULL;
+    }
+
+    pthread_mutex_lock(&queue->_mutex);
+    if (state == NULL && queue->_error.empty() == true)
+    {
+      queue->_error = error;
+    }
+    queue->_output[shard] = state;
+    pthread_cond_broadcast(&queue->_shardDone);
+  }
+  pthread_mutex_unlock(&queue->_mutex);
+  return NULL;
+}
+
 void MafExport::convertEntireAlignment(ostream& mafStream,
                                        AlignmentConstPtr alignment)
 {
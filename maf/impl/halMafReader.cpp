@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "halMafReader.h"
+
+using namespace std;
+using namespace hal;
+
+const size_t MafReader::defaultBufferSize = 16 * 1024 * 1024;
+
+MafReader::MafReader(size_t bufferSize) :
+  _bufferSize(bufferSize),
+  _map(NULL),
+  _mapSize(0),
+  _gzFile(NULL),
+  _bufferEnd(0),
+  _chunkEnd(0),
+  _chunkOffset(0),
+  _eof(true),
+  _done(true)
+{
+  assert(bufferSize > 0);
+}
+
+MafReader::~MafReader()
+{
+  close();
+}
+
+void MafReader::open(const string& mafPath)
+{
+  close();
+  _path = mafPath;
+  struct stat fileStat;
+  if (stat(mafPath.c_str(), &fileStat) != 0)
+  {
+    throw hal_exception("Unable to open " + mafPath + ": " + strerror(errno));
+  }
+
+  // zlib reads uncompressed data as is, so it is also used for pipes
+  // and other files that can't be mapped
+  if (S_ISREG(fileStat.st_mode) && !isGzipFile(mafPath))
+  {
+    _mapSize = fileStat.st_size;
+    if (_mapSize > 0)
+    {
+      int fd = ::open(mafPath.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+        throw hal_exception("Unable to open " + mafPath + ": " +
+                            strerror(errno));
+      }
+      void* base = mmap(NULL, _mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (base == MAP_FAILED)
+      {
+        throw hal_exception("Unable to mmap " + mafPath + ": " +
+                            strerror(errno));
+      }
+      _map = static_cast<char*>(base);
+      madvise(_map, _mapSize, MADV_SEQUENTIAL);
+    }
+    _done = _mapSize == 0;
+  }
+  else
+  {
+    _gzFile = gzopen(mafPath.c_str(), "rb");
+    if (_gzFile == NULL)
+    {
+      throw hal_exception("Unable to open " + mafPath);
+    }
+    gzbuffer(_gzFile, 1024 * 1024);
+    _buffer.resize(_bufferSize);
+    _eof = false;
+    _done = false;
+  }
+}
+
+void MafReader::close()
+{
+  if (_map != NULL)
+  {
+    munmap(_map, _mapSize);
+    _map = NULL;
+  }
+  if (_gzFile != NULL)
+  {
+    gzclose(_gzFile);
+    _gzFile = NULL;
+  }
+  _mapSize = 0;
+  vector<char>().swap(_buffer);
+  _bufferEnd = 0;
+  _chunkEnd = 0;
+  _chunkOffset = 0;
+  _eof = true;
+  _done = true;
+}
+
+bool MafReader::nextChunk(const char*& begin, const char*& end)
+{
+  if (_done == true)
+  {
+    return false;
+  }
+  if (_map != NULL)
+  {
+    begin = _map;
+    end = _map + _mapSize;
+    _done = true;
+    return true;
+  }
+
+  // drop the previous chunk, keeping the start of the next block
+  _chunkOffset += _chunkEnd;
+  if (_chunkEnd > 0)
+  {
+    memmove(&_buffer[0], &_buffer[_chunkEnd], _bufferEnd - _chunkEnd);
+    _bufferEnd -= _chunkEnd;
+    _chunkEnd = 0;
+  }
+  while (true)
+  {
+    fillBuffer();
+    if (_eof == true)
+    {
+      _chunkEnd = _bufferEnd;
+      _done = true;
+      break;
+    }
+    _chunkEnd = findLastBlockStart();
+    if (_chunkEnd > 0)
+    {
+      break;
+    }
+    // a single block fills the buffer
+    _buffer.resize(_buffer.size() * 2);
+  }
+  if (_chunkEnd == 0)
+  {
+    return false;
+  }
+  begin = &_buffer[0];
+  end = begin + _chunkEnd;
+  return true;
+}
+
+bool MafReader::isDone() const
+{
+  return _done;
+}
+
+static inline bool isBlockStart(const char* pos, const char* end)
+{
+  return pos[-1] == '\n' && pos[0] == 'a' && 
+     (pos + 1 == end || pos[1] == ' ' || pos[1] == '\t' || 
+      pos[1] == '\r' || pos[1] == '\n');
+}
+
+const char* MafReader::findBlockStart(const char* begin, const char* end)
+{
+  const char* pos = begin;
+  while (pos < end)
+  {
+    pos = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (pos == NULL)
+    {
+      break;
+    }
+    ++pos;
+    if (pos < end && isBlockStart(pos, end))
+    {
+      return pos;
+    }
+  }
+  return end;
+}
+
+bool MafReader::isGzipFile(const string& path)
+{
+  unsigned char magic[2];
+  ifstream inFile(path.c_str(), ios::in | ios::binary);
+  if (!inFile || !inFile.read(reinterpret_cast<char*>(magic), 2))
+  {
+    return false;
+  }
+  return magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+void MafReader::fillBuffer()
+{
+  while (_eof == false && _bufferEnd < _buffer.size())
+  {
+    size_t request = min(_buffer.size() - _bufferEnd, (size_t)1 << 30);
+    int bytesRead = gzread(_gzFile, &_buffer[_bufferEnd], (unsigned)request);
+    if (bytesRead < 0)
+    {
+      int errnum;
+      throw hal_exception("Error reading " + _path + ": " +
+                          gzerror(_gzFile, &errnum));
+    }
+    _bufferEnd += bytesRead;
+    _eof = bytesRead == 0;
+  }
+}
+
+// start of the last line of the buffer that begins with an "a" token
+// (as long as it isn't the first line), or 0 if there is none
+size_t MafReader::findLastBlockStart() const
+{
+  // the character after the "a" has to be read to know it is a token
+  const char* bufferEnd = &_buffer[0] + _bufferEnd;
+  for (size_t i = _bufferEnd - 2; i > 0 && i < _bufferEnd; --i)
+  {
+    if (isBlockStart(&_buffer[i], bufferEnd))
+    {
+      return i;
+    }
+  }
+  return 0;
+}
@@ -8,13 +8,30 @@
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <pthread.h>
 #include "halMafScanDimensions.h"
 
 using namespace std;
 using namespace hal;
 
 
-MafScanDimensions::MafScanDimensions() : MafScanner()
+const hal_size_t MafScanDimensions::defaultRangeLength = 16 * 1024 * 1024;
+
+// a range of whole blocks for a thread to scan
+struct MafScanDimensions::Range
+{
+   MafScanDimensions* _scanner;
+   const char* _begin;
+   const char* _end;
+   hal_size_t _offset;
+   string _error;
+};
+
+MafScanDimensions::MafScanDimensions() : 
+  MafScanner(),
+  _numThreads(1),
+  _rangeLength(defaultRangeLength),
+  _collectRows(false)
 {
   assert(sizeof(ArrayInfo) == sizeof(hal_size_t));
 }
@@ -35,11 +52,147 @@ void MafScanDimensions::scan(const string& mafPath, const set<string>& targets)
   }
   _dimMap.clear();
 
-  MafScanner::scan(mafPath, targets);
+  if (_numThreads > 1)
+  {
+    _targets = targets;
+    scanParallel(mafPath);
+  }
+  else
+  {
+    MafScanner::scan(mafPath, targets);
+  }
 
   updateArrayIndices();
 }
 
+void MafScanDimensions::setNumThreads(hal_size_t numThreads)
+{
+  _numThreads = max(numThreads, (hal_size_t)1);
+}
+
+void MafScanDimensions::setRangeLength(hal_size_t rangeLength)
+{
+  _rangeLength = max(rangeLength, (hal_size_t)1);
+}
+
+void MafScanDimensions::scanParallel(const string& mafPath)
+{
+  _numBlocks = 0;
+  MafReader reader(max(MafReader::defaultBufferSize, 
+                       (size_t)(_numThreads * _rangeLength)));
+  reader.open(mafPath);
+  vector<MafScanDimensions*> scanners(_numThreads);
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    scanners[i] = new MafScanDimensions();
+    scanners[i]->_targets = _targets;
+    scanners[i]->_collectRows = true;
+  }
+  vector<Range> ranges(_numThreads);
+  vector<pthread_t> threads(_numThreads);
+  
+  try
+  {
+    const char* chunk;
+    const char* chunkEnd;
+    while (reader.nextChunk(chunk, chunkEnd))
+    {
+      const char* pos = chunk;
+      while (pos < chunkEnd)
+      {
+        // cut a range for each thread at block boundaries
+        size_t numRanges = 0;
+        for (; numRanges < _numThreads && pos < chunkEnd; ++numRanges)
+        {
+          Range& range = ranges[numRanges];
+          range._scanner = scanners[numRanges];
+          range._begin = pos;
+          range._end = (hal_size_t)(chunkEnd - pos) > _rangeLength ?
+             MafReader::findBlockStart(pos + _rangeLength, chunkEnd) : 
+             chunkEnd;
+          range._offset = reader.getChunkOffset() + (pos - chunk);
+          range._error.clear();
+          pos = range._end;
+        }
+
+        size_t numStarted = 0;
+        for (; numStarted < numRanges; ++numStarted)
+        {
+          if (pthread_create(&threads[numStarted], NULL, rangeWorker,
+                             &ranges[numStarted]) != 0)
+          {
+            break;
+          }
+        }
+        // scan whatever didn't get a thread here
+        for (size_t i = numStarted; i < numRanges; ++i)
+        {
+          rangeWorker(&ranges[i]);
+        }
+        for (size_t i = 0; i < numStarted; ++i)
+        {
+          pthread_join(threads[i], NULL);
+        }
+
+        // add the rows in file order, so it's as if they were scanned
+        // by a single thread
+        for (size_t i = 0; i < numRanges; ++i)
+        {
+          if (ranges[i]._error.empty() == false)
+          {
+            throw hal_exception(ranges[i]._error);
+          }
+          const vector<RowDimensions>& rowDims = 
+             ranges[i]._scanner->_rowDimensions;
+          for (size_t j = 0; j < rowDims.size(); ++j)
+          {
+            addRowDimensions(rowDims[j]);
+          }
+          _numBlocks += ranges[i]._scanner->_numBlocks;
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    for (size_t i = 0; i < scanners.size(); ++i)
+    {
+      delete scanners[i];
+    }
+    throw;
+  }
+  for (size_t i = 0; i < scanners.size(); ++i)
+  {
+    delete scanners[i];
+  }
+  reader.close();
+}
+
+void* MafScanDimensions::rangeWorker(void* arg)
+{
+  Range* range = static_cast<Range*>(arg);
+  MafScanDimensions* scanner = range->_scanner;
+  try
+  {
+    scanner->_rowDimensions.clear();
+    scanner->_numBlocks = 0;
+    scanner->_rows = 0;
+    scanner->_blockPosition = range->_offset;
+    scanner->scanChunk(range->_begin, range->_end, range->_offset);
+    // ranges end where a block begins
+    scanner->endBlock();
+  }
+  catch (exception& e)
+  {
+    range->_error = e.what();
+  }
+  catch (...)
+  {
+    range->_error = "Error scanning MAF";
+  }
+  return NULL;
+}
+
 const MafScanDimensions::DimMap& MafScanDimensions::getDimensions() const
 {
   return _dimMap;
@@ -121,153 +274,172 @@ void MafScanDimensions::updateDimensionsFromBlock()
 {
   assert(_rows > 0 && !_block.empty());
   size_t length = _block[0]._line.length();
+  RowDimensions blockRowDims;
   for (size_t i = 0; i < _rows; ++i)
   {
-    Row& row = _block[i];
-    pair<string, Record*> newRec(row._sequenceName, NULL);
-    pair<DimMap::iterator, bool> result = _dimMap.insert(newRec);
-    Record*& rec = result.first->second;
-    pair<hal_size_t, ArrayInfo> startIndex;
-    startIndex.first = 0;
-    startIndex.second._index = 0; 
-    startIndex.second._count = 1;
-    startIndex.second._written = 0;
-    startIndex.second._empty = 0;
-    if (result.second == false && row._srcLength != rec->_length)
-    {
-      assert(rec != NULL);
-      stringstream ss;
-      ss << "conflicting length for sequence " << row._sequenceName << ": "
-         << "was scanned once as " << row._srcLength << " then again as "
-         << rec->_length;
-      throw hal_exception(ss.str());
-    }
-    else if (result.second == true)
+    if (_collectRows == true)
     {
-      rec = new Record(); 
-      startIndex.first = 0;
-      startIndex.second._empty = 1;
-      rec->_startMap.insert(startIndex);
-      startIndex.second._empty = 0;
-      rec->_numSegments = 0;
+      _rowDimensions.resize(_rowDimensions.size() + 1);
     }
-    rec->_length = row._srcLength;
-    
+    RowDimensions& dims = _collectRows ? _rowDimensions.back() : blockRowDims;
+    Row& row = _block[i];
+    dims._sequenceName = row._sequenceName;
+    dims._srcLength = row._srcLength;
+    dims._length = row._length;
+    dims._position = FilePosition(_blockPosition, i);
+    dims._numCuts = 0;
+
     if (row._length > 0)
     {
       // add the begnning of the line as a segment start position
       // also add the last + 1 segments as a start position if in range
-      hal_size_t start = row._startPosition;
-      hal_size_t end = start + row._length;
+      dims._start = row._startPosition;
+      dims._end = dims._start + row._length;
       if (row._strand == '-')
       {
-        start = row._srcLength - 1 - (row._startPosition + row._length - 1);
-        end = row._srcLength - row._startPosition;
+        dims._start = 
+           row._srcLength - 1 - (row._startPosition + row._length - 1);
+        dims._end = row._srcLength - row._startPosition;
       }
-      startIndex.first = start;
-      pair<StartMap::iterator, bool> smResult = 
-         rec->_startMap.insert(startIndex);
-      StartMap::iterator smIt = smResult.first;
-      bool bad = false;
-
-      // check for duplication / inconsistency:
-      // 1) new interval lands on start position of existing interval
-      // existing is unchanged but we don't do anything else. 
-      if (smResult.second == false && smIt->second._empty == 0)
+
+      size_t numGaps = 0;
+      for (size_t j = 0; j < length; ++j)
       {
-        bad = true;
+        if (row._line[j] == '-')
+        {
+          ++numGaps;
+        }
+        // valid segmentation between j-1 and j:
+        // we count the segment beginning at j if it's not at the
+        // start of the row.
+        else if (_mask[j] == true && j > numGaps)
+        {
+          ++dims._numCuts;
+        }
       }
+    }
 
-      // 2) new interval overlaps with existing interval
-      // set count to 0 if new, ignore otherwise
-      StartMap::iterator next = smIt;
-      ++next;
-      while (next != rec->_startMap.end() && !bad)
+    if (_collectRows == false)
+    {
+      addRowDimensions(dims);
+    }
+  }
+}
+
+void MafScanDimensions::addRowDimensions(const RowDimensions& dims)
+{
+  pair<string, Record*> newRec(dims._sequenceName, NULL);
+  pair<DimMap::iterator, bool> result = _dimMap.insert(newRec);
+  Record*& rec = result.first->second;
+  pair<hal_size_t, ArrayInfo> startIndex;
+  startIndex.first = 0;
+  startIndex.second._index = 0; 
+  startIndex.second._count = 1;
+  startIndex.second._written = 0;
+  startIndex.second._empty = 0;
+  if (result.second == false && dims._srcLength != rec->_length)
+  {
+    assert(rec != NULL);
+    stringstream ss;
+    ss << "conflicting length for sequence " << dims._sequenceName << ": "
+       << "was scanned once as " << dims._srcLength << " then again as "
+       << rec->_length;
+    throw hal_exception(ss.str());
+  }
+  else if (result.second == true)
+  {
+    rec = new Record(); 
+    startIndex.first = 0;
+    startIndex.second._empty = 1;
+    rec->_startMap.insert(startIndex);
+    startIndex.second._empty = 0;
+    rec->_numSegments = 0;
+  }
+  rec->_length = dims._srcLength;
+    
+  if (dims._length > 0)
+  {
+    startIndex.first = dims._start;
+    pair<StartMap::iterator, bool> smResult = 
+       rec->_startMap.insert(startIndex);
+    StartMap::iterator smIt = smResult.first;
+    bool bad = false;
+
+    // check for duplication / inconsistency:
+    // 1) new interval lands on start position of existing interval
+    // existing is unchanged but we don't do anything else. 
+    if (smResult.second == false && smIt->second._empty == 0)
+    {
+      bad = true;
+    }
+
+    // 2) new interval overlaps with existing interval
+    // set count to 0 if new, ignore otherwise
+    StartMap::iterator next = smIt;
+    ++next;
+    while (next != rec->_startMap.end() && !bad)
+    {
+      if (next->second._count > 0)
       {
-        if (next->second._count > 0)
+        if (smIt->first + dims._length > next->first)
         {
-          if (smIt->first + row._length > next->first)
-          {
-            bad = true;
-          }
-          else
-          {
-            break;
-          }
+          bad = true;
+        }
+        else
+        {
+          break;
         }
-        ++next;
       }
+      ++next;
+    }
 
-      // 3) new interval overlaps a previous interval that is not 
-      // empty
-      if (!bad && smResult.second == true && smIt != rec->_startMap.begin())
+    // 3) new interval overlaps a previous interval that is not 
+    // empty
+    if (!bad && smResult.second == true && smIt != rec->_startMap.begin())
+    {
+      StartMap::iterator prev = smIt;
+      --prev;
+      while (!bad)
       {
-        StartMap::iterator prev = smIt;
-        --prev;
-        while (!bad)
+        if (prev->second._count > 0)
         {
-          if (prev->second._count > 0)
+          if (prev->second._empty == 0)
           {
-            if (prev->second._empty == 0)
-            {
-              bad = true;
-            }
-            else
-            {
-              break;
-            }
+            bad = true;
           }
-          if (prev == rec->_startMap.begin())
+          else
           {
             break;
           }
-          --prev;
         }
+        if (prev == rec->_startMap.begin())
+        {
+          break;
+        }
+        --prev;
       }
+    }
 
-      if (bad == true)
+    if (bad == true)
+    {
+      if (smResult.second == true)
       {
-        if (smResult.second == true)
-        {
-          rec->_startMap.erase(smIt);
-        }
-        rec->_badPosSet.insert(FilePosition(_mafFile.tellg(), i));
+        rec->_startMap.erase(smIt);
       }
-      else
+      rec->_badPosSet.insert(dims._position);
+    }
+    else
+    {
+      smIt->second._empty = 0;
+      assert(smIt->second._count == 1);
+      if (dims._end < dims._srcLength)
       {
-        smIt->second._empty = 0;
-        assert(smIt->second._count == 1);
-        if (end < row._srcLength)
-        {
-          startIndex.first = end;
-          startIndex.second._empty = 1;
-          startIndex.second._count = 1;
-          pair<StartMap::iterator, bool> endResult = 
-             rec->_startMap.insert(startIndex);              
-        }
-
-        size_t numGaps = 0;
-        hal_size_t interiorStart;
-
-        for (size_t j = 0; j < length; ++j)
-        {
-          if (row._line[j] == '-')
-          {
-            ++numGaps;
-          }
-          // valid segmentation between j-1 and j:
-          // we add the start coordinate of the segment beginning at 
-          // j in forward segment coordinates.  
-          else if (_mask[j] == true && (row._line[j] != '-'))
-          {
-            interiorStart = start + j - numGaps;
-            if (interiorStart > start)
-            {
-              ++smIt->second._count;
-            }
-          }
-        }
+        startIndex.first = dims._end;
+        startIndex.second._empty = 1;
+        startIndex.second._count = 1;
+        rec->_startMap.insert(startIndex);
       }
+      smIt->second._count += dims._numCuts;
     }
   }
 }
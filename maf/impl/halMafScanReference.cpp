@@ -46,7 +46,7 @@ void MafScanReference::sLine()
   }
   
   _name = genomeName(row._sequenceName);
-  _mafFile.seekg(0, ios_base::end);
+  stop();
 }
 
 void MafScanReference::end()
@@ -4,6 +4,7 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
@@ -15,7 +16,13 @@ using namespace std;
 using namespace hal;
 
 
-MafScanner::MafScanner()
+MafScanner::MafScanner() :
+  _rows(0),
+  _numBlocks(0),
+  _blockPosition(0),
+  _chunk(NULL),
+  _chunkOffset(0),
+  _stopped(false)
 {
 
 }
@@ -25,73 +32,57 @@ MafScanner::~MafScanner()
 
 }
 
-void MafScanner::scan(const string& mafFilePath, const set<string>& targets)
+static inline bool isSpace(char c)
 {
-  _targets = targets;
-  _mafFile.open(mafFilePath.c_str());
-  _numBlocks = 0;
+  return c == ' ' || c == '\t' || c == '\r';
+}
 
-  if (!_mafFile)
+// get the next whitespace-delimited token of the line [pos, end)
+static inline bool nextToken(const char*& pos, const char* end, 
+                             const char*& token, size_t& length)
+{
+  for (; pos < end && isSpace(*pos); ++pos);
+  token = pos;
+  for (; pos < end && !isSpace(*pos); ++pos);
+  length = pos - token;
+  return length > 0;
+}
+
+static inline bool parseSize(const char* token, size_t length, 
+                             hal_size_t& value)
+{
+  value = 0;
+  for (size_t i = 0; i < length; ++i)
   {
-    throw runtime_error("error opening path: " + mafFilePath);
+    if (token[i] < '0' || token[i] > '9')
+    {
+      return false;
+    }
+    value = value * 10 + (token[i] - '0');
   }
-  
+  return length > 0;
+}
+
+void MafScanner::scan(const string& mafFilePath, const set<string>& targets)
+{
+  _targets = targets;
+  _mafFile.open(mafFilePath);
+  _numBlocks = 0;
+  _blockPosition = 0;
+  _stopped = false;
   _rows = 0;
   _block.clear();
-  string buffer;
-  while (!_mafFile.eof() && _mafFile.good())
-  {
-    buffer.clear();
-    _mafFile >> buffer;
-    if (buffer == "a")
-    {
-      if (_rows > 0)
-      {
-        updateMask();
-        aLine();
-        ++_numBlocks;
-        nextLine();
-      }
-      _rows = 0;
-    }
-    else if (buffer == "s")
-    {
-      ++_rows;
-      if (_rows > _block.size())
-      {
-        _block.resize(_rows);
-      }
-      Row& row = _block[_rows - 1];
-      _mafFile >> row._sequenceName >> row._startPosition >> row._length 
-               >> row._strand >> row._srcLength >> row._line;
-      if (_mafFile.bad() || _mafFile.fail())
-      {
-        throw hal_exception("error parsing sequence " + row._sequenceName);
-      }
-      if (_rows > 1 && row._line.length() != _block[_rows - 2]._line.length())
-      {
-        stringstream ss;
-        ss << "two lines in same block have different lengths: " 
-           << row._sequenceName << " " << row._startPosition << " and "
-           << _block[_rows - 2]._sequenceName << " " 
-           << _block[_rows - 2]._startPosition;
-        throw hal_exception(ss.str());
-      }
 
-      if (_targets.size() > 1 && // (will always include reference) 
-          _targets.find(genomeName(row._sequenceName)) == _targets.end())
-      {
-        // genome not in targets, pretend like it never happened. 
-        --_rows;
-      }
-      else
-      {
-        sLine();
-      }
-    }
-    else
+  const char* chunk;
+  const char* chunkEnd;
+  while (!_stopped && _mafFile.nextChunk(chunk, chunkEnd))
+  {
+    scanChunk(chunk, chunkEnd, _mafFile.getChunkOffset());
+    // the rows point into the chunk, so the block has to be visited
+    // before the next one is read.  (chunks end just before "a" lines)
+    if (!_stopped && !_mafFile.isDone())
     {
-      nextLine();
+      endBlock();
     }
   }
   if (_rows > 0)
@@ -103,12 +94,99 @@ void MafScanner::scan(const string& mafFilePath, const set<string>& targets)
   _mafFile.close();
 }
 
-void MafScanner::nextLine()
+void MafScanner::scanChunk(const char* begin, const char* end, 
+                           hal_size_t offset)
 {
-  while (!_mafFile.eof() && !_mafFile.bad() && _mafFile.peek() != '\n')
+  _chunk = begin;
+  _chunkOffset = offset;
+  const char* pos = begin;
+  while (!_stopped && pos < end)
   {
-    _mafFile.get();
+    const char* lineEnd = 
+       static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (lineEnd == NULL)
+    {
+      lineEnd = end;
+    }
+    scanLine(pos, lineEnd);
+    pos = lineEnd + 1;
+  }
+}
+
+void MafScanner::scanLine(const char* pos, const char* end)
+{
+  const char* token;
+  size_t length;
+  if (nextToken(pos, end, token, length) && length == 1)
+  {
+    if (*token == 'a')
+    {
+      endBlock();
+      _blockPosition = _chunkOffset + (token - _chunk);
+    }
+    else if (*token == 's')
+    {
+      scanRow(pos, end);
+    }
+  }
+}
+
+void MafScanner::scanRow(const char* pos, const char* end)
+{
+  ++_rows;
+  if (_rows > _block.size())
+  {
+    _block.resize(_rows);
+  }
+  Row& row = _block[_rows - 1];
+  const char* token;
+  size_t length;
+  bool ok = nextToken(pos, end, token, length);
+  row._sequenceName.assign(token, length);
+  ok = ok && nextToken(pos, end, token, length) && 
+     parseSize(token, length, row._startPosition);
+  ok = ok && nextToken(pos, end, token, length) && 
+     parseSize(token, length, row._length);
+  ok = ok && nextToken(pos, end, token, length) && length == 1;
+  row._strand = ok ? *token : '\0';
+  ok = ok && nextToken(pos, end, token, length) && 
+     parseSize(token, length, row._srcLength);
+  ok = ok && nextToken(pos, end, row._line._data, row._line._length);
+  if (!ok)
+  {
+    throw hal_exception("error parsing sequence " + row._sequenceName);
+  }
+  if (_rows > 1 && row._line.length() != _block[_rows - 2]._line.length())
+  {
+    stringstream ss;
+    ss << "two lines in same block have different lengths: " 
+       << row._sequenceName << " " << row._startPosition << " and "
+       << _block[_rows - 2]._sequenceName << " " 
+       << _block[_rows - 2]._startPosition;
+    throw hal_exception(ss.str());
   }
+
+  if (_targets.size() > 1 && // (will always include reference) 
+      _targets.find(genomeName(row._sequenceName)) == _targets.end())
+  {
+    // genome not in targets, pretend like it never happened. 
+    --_rows;
+  }
+  else
+  {
+    sLine();
+  }
+}
+
+void MafScanner::endBlock()
+{
+  if (_rows > 0)
+  {
+    updateMask();
+    aLine();
+    ++_numBlocks;
+  }
+  _rows = 0;
 }
 
 // the mask stores a bit for every column where a gap begins in any row
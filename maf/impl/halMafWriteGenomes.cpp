@@ -234,7 +234,8 @@ void MafWriteGenomes::initBlockInfo(size_t col)
       // every chunk)
       if (_block[i]._strand == '-')
       {
-        _blockInfo[i]._gapComp = _block[i]._line;
+        _blockInfo[i]._gapComp.assign(_block[i]._line._data,
+                                      _block[i]._line._length);
         reverseGaps(_blockInfo[i]._gapComp);
       }
       else
@@ -259,7 +260,7 @@ void MafWriteGenomes::initBlockInfo(size_t col)
 
   for (size_t i = 0; i < _rows; ++i)
   {
-    std::string& line = _block[i]._line;
+    const Line& line = _block[i]._line;
     Row& row = _block[i];
     RowInfo& rowInfo = _blockInfo[i];
     if (line[col] == '-')
@@ -285,7 +286,7 @@ void MafWriteGenomes::initBlockInfo(size_t col)
         if (mapIt != startMap.end() &&
             mapIt->second._written == 0 &&
             mapIt->second._empty == 0 && 
-            posSet.find(FilePosition(_mafFile.tellg(), i)) == posSet.end())
+            posSet.find(FilePosition(_blockPosition, i)) == posSet.end())
         {
           rowInfo._arrayIndex = mapIt->second._index;
 
@@ -390,7 +391,8 @@ void MafWriteGenomes::convertSegments(size_t col)
       // at last minute
       hal_index_t genStart = rowInfo._start;
       hal_index_t rowSeqOffset = col;
-      const string& rowLine = row._strand == '-' ? rowInfo._gapComp : row._line;
+      const char* rowLine = row._strand == '-' ? rowInfo._gapComp.c_str() :
+         row._line._data;
 
       seq = genome->getSequence(sequenceName(row._sequenceName));
       assert(seq != NULL);
@@ -446,7 +448,8 @@ void MafWriteGenomes::convertSegments(size_t col)
       }
 
       seq->setSubString(
-        rowLine.substr(rowSeqOffset, rowInfo._length), genStart, rowInfo._length);
+        string(rowLine + rowSeqOffset, rowInfo._length), genStart, 
+        rowInfo._length);
 
     }
   }
@@ -585,7 +588,19 @@ void MafWriteGenomes::sLine()
   {
     row._startPosition =
        row._srcLength - 1 - (row._startPosition + row._length - 1);
-    reverseComplement(row._line);
+    // the row's text is read-only, so it is reversed into a buffer
+    // that is reused by the same row of the following blocks
+    if (_rowText.size() < _rows)
+    {
+      _rowText.resize(_rows);
+    }
+    vector<char>& text = _rowText[_rows - 1];
+    text.assign(row._line._data, row._line._data + row._line._length);
+    if (!text.empty())
+    {
+      reverseComplement(&text[0], text.size());
+      row._line._data = &text[0];
+    }
   }
 }
 
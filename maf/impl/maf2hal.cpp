@@ -17,7 +17,7 @@ using namespace hal;
 static CLParserPtr initParser()
 {
   CLParserPtr optionsParser = hdf5CLParserInstance(true);
-  optionsParser->addArgument("mafFile", "output maf file");
+  optionsParser->addArgument("mafFile", "input maf file (can be gzipped)");
   optionsParser->addArgument("halFile", "input hal file");
   optionsParser->addOption("refGenome", "name of reference genome in MAF "
                            "(first found if empty)",
@@ -31,6 +31,10 @@ static CLParserPtr initParser()
                                " reference must alaready be present in hal"
                                " dabase as a leaf.",
                                false);
+  optionsParser->addOption("numThreads",
+                           "number of threads used for the first pass "
+                           "over the maf (which scans its dimensions)",
+                           1);
                            
   optionsParser->setDescription("import maf into hal database.");
   return optionsParser;
@@ -44,6 +48,7 @@ int main(int argc, char** argv)
   string refGenomeName;
   string targetGenomes;
   bool append;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -52,6 +57,11 @@ int main(int argc, char** argv)
     refGenomeName = optionsParser->getOption<string>("refGenome");
     targetGenomes = optionsParser->getOption<string>("targetGenomes");
     append = optionsParser->getFlag("append");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be > 0");
+    }
   }
   catch(exception& e)
   {
@@ -111,6 +121,7 @@ int main(int argc, char** argv)
     targetSet.insert(refGenomeName);
 
     MafScanDimensions dScan;
+    dScan.setNumThreads(numThreads);
     dScan.scan(mafPath, targetSet);
 
     string prevGenome, curGenome;
@@ -67,6 +67,16 @@ public:
    void appendColumn(ColumnIteratorConstPtr col);
    bool canAppendColumn(hal::ColumnIteratorConstPtr col);
    void setMaxLength(hal_index_t maxLen);
+
+   /** Delete all the entries, including those kept for reuse.  Only
+    * call between blocks */
+   void clearEntries();
+
+   /** Get the sequence of each entry and the number of blocks it has
+    * gone unused.  Entries are kept from block to block, so these decide
+    * (with the column map) whether later columns can be appended */
+   void getEntryUsage(
+     std::vector<std::pair<const Sequence*, hal_size_t> >& usage) const;
    
 protected:
    
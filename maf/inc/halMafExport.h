@@ -23,6 +23,11 @@ public:
 
    virtual ~MafExport();
 
+   /** Convert a range of a reference genome or sequence to MAF.  If
+    * more than one thread is set (see setNumThreads()), the range is cut
+    * into shards that are converted in parallel and written back in
+    * reference order.  The output is the same as with one thread, but
+    * more than one thread is only supported with the unique option. */
    void convertSegmentedSequence(std::ostream& mafStream,
                                  AlignmentConstPtr alignment,
                                  const SegmentedSequence* seq,
@@ -46,11 +51,45 @@ public:
    void setMaxBlockLength(hal_index_t maxLength);
    void setPrintTree(bool printTree);
    void setOnlyOrthologs(bool onlyOrthologs);
+   /** Number of threads used by convertSegmentedSequence.  More than 
+    * one requires an alignment that supports concurrent reads */
+   void setNumThreads(hal_size_t numThreads);
+   /** Length of the reference shards converted by each thread */
+   void setShardLength(hal_size_t shardLength);
+
+   static const hal_size_t defaultShardLength;
 
 protected:
 
+   struct ShardQueue;
+   struct ShardState;
+
+   /** Reference position of a column and the number of columns (with
+    * insertions) converted before it at that position */
+   typedef std::pair<hal_index_t, hal_size_t> ColumnKey;
+
    void writeHeader();
 
+   void convertRange(std::ostream& mafStream,
+                     const SegmentedSequence* seq,
+                     hal_index_t startPosition,
+                     hal_index_t lastPosition,
+                     const std::set<const Genome*>& targets);
+
+   void convertRangeParallel(std::ostream& mafStream,
+                             const SegmentedSequence* seq,
+                             hal_index_t startPosition,
+                             hal_index_t lastPosition,
+                             const std::set<const Genome*>& targets);
+
+   size_t convertShard(ShardState& state, hal_index_t lastPosition,
+                       const ShardState* next) const;
+
+   void defragment(ColumnIteratorConstPtr colIt, MafBlock& mafBlock,
+                   hal_index_t& lastWindow) const;
+
+   static void* shardWorker(void* arg);
+
 protected:
 
    AlignmentConstPtr _alignment;
@@ -64,6 +103,9 @@ protected:
    bool _append;
    bool _printTree;
    bool _onlyOrthologs;
+   hal_index_t _maxBlockLength;
+   hal_size_t _numThreads;
+   hal_size_t _shardLength;
 };
 
 }
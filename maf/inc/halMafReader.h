@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMAFREADER_H
+#define _HALMAFREADER_H
+
+#include <string>
+#include <vector>
+#include "hal.h"
+
+struct gzFile_s;
+
+namespace hal {
+
+/** Read the text of a MAF file in chunks that can be parsed in place.
+ * The text is read-only.  Plain files are memory-mapped (PROT_READ) and
+ * returned as a single chunk.  Gzipped files are decompressed into a
+ * large buffer and returned a chunk at a time, each made of whole
+ * alignment blocks (they are split just before lines beginning with
+ * "a"), so the text of a block is never split across chunks. */
+class MafReader
+{
+public:
+   MafReader(size_t bufferSize = defaultBufferSize);
+   ~MafReader();
+
+   void open(const std::string& mafPath);
+   void close();
+
+   /** Get the next chunk of text as [begin, end).  It stays valid until
+    * the next call.  Returns false once the whole file has been read */
+   bool nextChunk(const char*& begin, const char*& end);
+
+   /** Check if the last chunk has been returned */
+   bool isDone() const;
+
+   /** Position of the current chunk in the (uncompressed) file */
+   hal_size_t getChunkOffset() const { return _chunkOffset; }
+
+   /** Get the first line in (begin, end) that begins with an "a" token
+    * (so starts a block), or end if there is none */
+   static const char* findBlockStart(const char* begin, const char* end);
+
+   /** Check if a file begins with the gzip magic bytes */
+   static bool isGzipFile(const std::string& path);
+
+   static const size_t defaultBufferSize;
+
+protected:
+
+   void fillBuffer();
+   size_t findLastBlockStart() const;
+
+protected:
+
+   std::string _path;
+   size_t _bufferSize;
+   char* _map;
+   size_t _mapSize;
+   gzFile_s* _gzFile;
+   std::vector<char> _buffer;
+   size_t _bufferEnd;
+   size_t _chunkEnd;
+   hal_size_t _chunkOffset;
+   bool _eof;
+   bool _done;
+
+private:
+   MafReader(const MafReader&);
+   MafReader& operator=(const MafReader&);
+};
+
+}
+
+#endif
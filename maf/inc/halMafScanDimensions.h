@@ -18,7 +18,11 @@
 namespace hal {
 
 /** Parse a MAF file line by line, getting some dimension stats
- * and maybe checking for some errros. */
+ * and maybe checking for some errros.  With more than one thread, the
+ * file is cut into ranges of whole blocks that are parsed in parallel.
+ * The rows of each range are then added to the dimensions in file
+ * order, so the result (including which rows are dupes) is the same as
+ * with one thread. */
 class MafScanDimensions : public MafScanner
 {
 public:
@@ -32,7 +36,7 @@ public:
    };
    typedef std::map<hal_size_t, ArrayInfo> StartMap;
 
-   typedef std::pair<std::streampos, size_t> FilePosition;
+   typedef std::pair<hal_size_t, size_t> FilePosition;
    typedef std::set<FilePosition> PosSet;
 
    struct Record 
@@ -51,17 +55,50 @@ public:
    void scan(const std::string& mafPath, 
              const std::set<std::string>& targetSet);
    const DimMap& getDimensions() const;
+   void setNumThreads(hal_size_t numThreads);
+   /** Set the amount of text scanned by each thread at a time */
+   void setRangeLength(hal_size_t rangeLength);
+
+   static const hal_size_t defaultRangeLength;
    
 protected:
+
+   // what a row adds to the dimensions, which can be computed
+   // independently of the other blocks
+   struct RowDimensions
+   {
+      std::string _sequenceName;
+      hal_size_t _srcLength;
+      hal_size_t _length;
+      // forward strand interval
+      hal_size_t _start;
+      hal_size_t _end;
+      // number of segments that start inside the row
+      hal_size_t _numCuts;
+      FilePosition _position;
+   };
+
+   struct Range;
+
    void aLine();
    void sLine();
    void end();
    void updateDimensionsFromBlock();
+   void addRowDimensions(const RowDimensions& dims);
    void updateArrayIndices();
+   void scanParallel(const std::string& mafPath);
+
+   static void* rangeWorker(void* arg);
 
 protected:
       
    DimMap _dimMap;
+   hal_size_t _numThreads;
+   hal_size_t _rangeLength;
+   // rows of the range are kept here instead of being added to _dimMap
+   // when scanning in parallel
+   bool _collectRows;
+   std::vector<RowDimensions> _rowDimensions;
 };
 
 }
@@ -14,12 +14,16 @@
 #include <vector>
 #include <string>
 #include "hal.h"
+#include "halMafReader.h"
 
 namespace hal {
 
 /** Parse a MAF file line by line 
  * written independently from the maf export, and it's too much of a 
- * bother to reuse any of that code. */
+ * bother to reuse any of that code.  The file is read through a 
+ * MafReader (so it can be gzipped) and parsed in place: the alignment
+ * text of each row points into the reader's buffer instead of being
+ * copied. */
 class MafScanner
 {
 public:
@@ -31,13 +35,26 @@ public:
    static std::string genomeName(const std::string& fullName);
    static std::string sequenceName(const std::string& fullName);
 
+   /** Alignment text of a row.  It is only valid until the block has
+    * been visited.  It points into the (read-only) text of the file,
+    * so a scanner that changes a row has to copy it elsewhere and
+    * point _data there */
+   struct Line {
+      const char* _data;
+      size_t _length;
+      size_t length() const { return _length; }
+      char operator[](size_t i) const { return _data[i]; }
+      std::string substr(size_t pos, size_t n) const {
+        return std::string(_data + pos, n); }
+   };
+
    struct Row {
       std::string _sequenceName;
       hal_size_t _startPosition;
       hal_size_t _length;
       char _strand;
       hal_size_t _srcLength;
-      std::string _line;
+      Line _line;
    };
    typedef std::vector<Row> Block;
    typedef std::vector<bool> Mask;
@@ -46,17 +63,29 @@ protected:
    virtual void aLine() = 0;
    virtual void sLine() = 0;
    virtual void end() = 0;
-   void nextLine();
+   /** Scan the text [begin, end) found at offset in the file */
+   void scanChunk(const char* begin, const char* end, hal_size_t offset);
+   void scanLine(const char* pos, const char* end);
+   void scanRow(const char* pos, const char* end);
+   void endBlock();
    void updateMask();
+   /** Stop scanning after the current line */
+   void stop() { _stopped = true; }
 
 
-   std::ifstream _mafFile;
+   MafReader _mafFile;
    std::set<std::string> _targets;
    
    Block _block;
    size_t _rows;
    Mask _mask;
    hal_size_t _numBlocks;
+   // position of the current block's "a" line in the file, which 
+   // identifies it in the different passes
+   hal_size_t _blockPosition;
+   const char* _chunk;
+   hal_size_t _chunkOffset;
+   bool _stopped;
 };
 
 }
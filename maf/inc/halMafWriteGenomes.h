@@ -103,6 +103,9 @@ private:
    BottomSegmentIteratorPtr _bottomSegment, _refBottom;
    std::map<Genome*, hal_size_t> _childIdxMap;
    ParaMap _paraMap;
+   // reverse-complemented text of the "-" strand rows of the block.  a
+   // deque so that adding rows doesn't move the text of the others
+   std::deque<std::vector<char> > _rowText;
 };
 
 }
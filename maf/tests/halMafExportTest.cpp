@@ -4,14 +4,140 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
-#include "halMafTests.h"
+#include <sstream>
+#include "halMafExportTest.h"
 #include "halMafExport.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
 
 using namespace std;
 using namespace hal;
 
+void MafExportParallelTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment,
+                        0.75,
+                        _maxBranchLength,
+                        5,
+                        10,
+                        2000,
+                        5,
+                        10,
+                        _seed);
+}
+
+void MafExportParallelTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  hal_size_t shardLength = 500;
+  char* mmapPath = getTempFile();
+  writeMMapAlignment(alignment, mmapPath);
+  AlignmentConstPtr mmapAlignment =
+     openHalAlignmentReadOnly(mmapPath, CLParserConstPtr());
+  const Genome* genome = alignment->openGenome(alignment->getRootName());
+  const Genome* mmapGenome = 
+     mmapAlignment->openGenome(alignment->getRootName());
+  set<const Genome*> targets;
+
+  // the threads must give the same output as one thread, including 
+  // where blocks are cut at the ends of the shards.  short blocks
+  // give many more cuts to line up.  the threads create their own 
+  // genome objects, so this also checks that the rows are ordered the
+  // same way whatever alignment instance they come from (as does
+  // comparing with the HDF5 alignment)
+  hal_index_t maxBlockLengths[] = {MafBlock::defaultMaxLength, 7};
+  for (size_t i = 0; i < 2; ++i)
+  {
+    stringstream serialStream;
+    MafExport serialExport;
+    serialExport.setUnique(true);
+    serialExport.setMaxBlockLength(maxBlockLengths[i]);
+    serialExport.convertSegmentedSequence(serialStream, alignment, 
+                                          genome, 0, 0, targets);
+
+    stringstream parallelStream;
+    MafExport parallelExport;
+    parallelExport.setUnique(true);
+    parallelExport.setMaxBlockLength(maxBlockLengths[i]);
+    parallelExport.setNumThreads(4);
+    parallelExport.setShardLength(shardLength);
+    parallelExport.convertSegmentedSequence(parallelStream, mmapAlignment, 
+                                            mmapGenome, 0, 0, targets);
+
+    CuAssertTrue(_testCase, serialStream.str().empty() == false);
+    CuAssertTrue(_testCase, parallelStream.str() == serialStream.str());
+  }
+
+  MafExport parallelExport;
+  parallelExport.setUnique(true);
+  parallelExport.setNumThreads(4);
+  parallelExport.setShardLength(shardLength);
+
+  // HDF5 alignments can't be read by several threads
+  bool threw = false;
+  try
+  {
+    stringstream hdf5Stream;
+    parallelExport.convertSegmentedSequence(hdf5Stream, alignment, genome,
+                                            0, 0, targets);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+
+  // and shards can only be lined up with the unique option
+  threw = false;
+  try
+  {
+    stringstream nonUniqueStream;
+    parallelExport.setUnique(false);
+    parallelExport.convertSegmentedSequence(nonUniqueStream, mmapAlignment,
+                                            mmapGenome, 0, 0, targets);
+  }
+  catch (hal_exception& e)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw);
+
+  mmapAlignment->close();
+  removeTempFile(mmapPath);
+}
+
+void halMafExportParallelTest(CuTest *testCase)
+{
+  try
+  {
+    // a few alignments, as the shards line up differently in each (the
+    // seeds give non-empty root genomes)
+    int seeds[] = {0, 5, 6, 8, 32};
+    for (size_t i = 0; i < 5; ++i)
+    {
+      MafExportParallelTest tester;
+      tester._seed = seeds[i];
+      tester._maxBranchLength = 0.1;
+      tester.check(testCase);
+    }
+    // longer branches give paralogies, so blocks with several rows
+    // from the same genome
+    MafExportParallelTest tester;
+    tester._seed = 6;
+    tester._maxBranchLength = 0.7;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite *halMafExportTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMafExportParallelTest);
   return suite;
 }
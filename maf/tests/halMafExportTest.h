@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALMAFEXPORTTEST_H
+#define _HALMAFEXPORTTEST_H
+
+#include <vector>
+#include "halAlignmentTest.h"
+#include "hal.h"
+#include "halMafTests.h"
+
+struct MafExportParallelTest : public AlignmentTest
+{
+   int _seed;
+   double _maxBranchLength;
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <deque>
+#include <cstdio>
+#include <sstream>
+#include <zlib.h>
+#include "halMafTests.h"
+#include "halMafReader.h"
+#include "halMafScanner.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+static string makeMaf()
+{
+  stringstream ss;
+  ss << "##maf version=1\n# comment\n\n";
+  for (size_t b = 0; b < 200; ++b)
+  {
+    ss << "a score=" << b << "\n";
+    for (size_t r = 0; r < 1 + b % 4; ++r)
+    {
+      ss << "s g" << r << ".c" << b % 3 << " " << b * 10 << " 5 "
+         << (r % 2 ? '-' : '+') << " 100000\tAC" << (b % 2 ? "-G" : "G")
+         << "GT\r\n";
+    }
+    ss << "i g0.c0 C 0 I 3\n\n";
+  }
+  // no newline at the end of the file
+  ss << "a\ns g0.c0 5000 3 + 100000 ACG";
+  return ss.str();
+}
+
+static void writeMaf(const string& maf, const char* path, bool gzipped)
+{
+  if (gzipped)
+  {
+    gzFile gzOut = gzopen(path, "wb");
+    gzwrite(gzOut, maf.data(), maf.length());
+    gzclose(gzOut);
+  }
+  else
+  {
+    FILE* out = fopen(path, "w");
+    fwrite(maf.data(), 1, maf.length(), out);
+    fclose(out);
+  }
+}
+
+// print every block that gets visited
+struct MafPrintScanner : public MafScanner
+{
+   void aLine() { print(); }
+   void sLine()
+   {
+     Row& row = _block[_rows - 1];
+     if (row._strand == '-')
+     {
+       if (_rowText.size() < _rows)
+       {
+         _rowText.resize(_rows);
+       }
+       string& text = _rowText[_rows - 1];
+       text.assign(row._line._data, row._line._length);
+       reverseComplement(text);
+       row._line._data = text.data();
+     }
+   }
+   void end() { print(); }
+   void print()
+   {
+     _out << _blockPosition << " " << _rows << "\n";
+     for (size_t i = 0; i < _rows; ++i)
+     {
+       Row& row = _block[i];
+       _out << row._sequenceName << " " << row._startPosition << " "
+            << row._length << " " << row._strand << " " << row._srcLength
+            << " " << row._line.substr(0, row._line.length()) << "\n";
+     }
+   }
+   stringstream _out;
+   deque<string> _rowText;
+};
+
+static void halMafReaderChunkTest(CuTest *testCase)
+{
+  string maf = makeMaf();
+  char* path = getTempFile();
+  writeMaf(maf, path, true);
+
+  // small buffer so that it gets split (and grown for big blocks)
+  MafReader reader(100);
+  reader.open(path);
+  string text;
+  const char* begin;
+  const char* end;
+  size_t numChunks = 0;
+  while (reader.nextChunk(begin, end))
+  {
+    CuAssertTrue(testCase, reader.getChunkOffset() == text.length());
+    CuAssertTrue(testCase, numChunks == 0 || *begin == 'a');
+    text.append(begin, end);
+    ++numChunks;
+  }
+  CuAssertTrue(testCase, reader.isDone());
+  CuAssertTrue(testCase, numChunks > 1);
+  CuAssertTrue(testCase, text == maf);
+  reader.close();
+  removeTempFile(path);
+}
+
+static void halMafReaderScanTest(CuTest *testCase)
+{
+  string maf = makeMaf();
+  char* path = getTempFile();
+  char* gzPath = getTempFile();
+  writeMaf(maf, path, false);
+  writeMaf(maf, gzPath, true);
+  CuAssertTrue(testCase, !MafReader::isGzipFile(path));
+  CuAssertTrue(testCase, MafReader::isGzipFile(gzPath));
+
+  MafPrintScanner scanner;
+  scanner.scan(path, set<string>());
+  MafPrintScanner gzScanner;
+  gzScanner.scan(gzPath, set<string>());
+  CuAssertTrue(testCase, scanner.getNumBlocks() == 201);
+  CuAssertTrue(testCase, gzScanner.getNumBlocks() == 201);
+  CuAssertTrue(testCase, scanner._out.str() == gzScanner._out.str());
+  // reverse strand rows are complemented in place without touching
+  // the file
+  CuAssertTrue(testCase, scanner._out.str().find(
+                 "g1.c1 10 5 - 100000 AC-CGT\n") != string::npos);
+  CuAssertTrue(testCase, scanner._out.str().find(
+                 "g0.c0 5000 3 + 100000 ACG\n") != string::npos);
+  MafPrintScanner rescanner;
+  rescanner.scan(path, set<string>());
+  CuAssertTrue(testCase, scanner._out.str() == rescanner._out.str());
+  removeTempFile(path);
+  removeTempFile(gzPath);
+}
+
+CuSuite* halMafReaderTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMafReaderChunkTest);
+  SUITE_ADD_TEST(suite, halMafReaderScanTest);
+  return suite;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <zlib.h>
+#include "halMafTests.h"
+#include "halMafScanDimensions.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+// random blocks whose rows often overlap, so some of them are dupes
+static string makeRandomMaf()
+{
+  srand(7);
+  stringstream ss;
+  ss << "##maf version=1\n";
+  for (size_t b = 0; b < 2000; ++b)
+  {
+    ss << "a\n";
+    size_t numRows = 1 + rand() % 5;
+    size_t width = 5 + rand() % 20;
+    string gaps(width, '.');
+    for (size_t r = 0; r < numRows; ++r)
+    {
+      for (size_t i = 0; i < width; ++i)
+      {
+        gaps[i] = rand() % 4 == 0 ? '-' : 'A';
+      }
+      size_t length = width - count(gaps.begin(), gaps.end(), '-');
+      ss << "s g" << r << ".c" << rand() % 3 << " " << rand() % 4900 << " "
+         << length << " " << (rand() % 2 ? '+' : '-') << " 5000 " << gaps
+         << "\n";
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+static bool sameDimensions(const MafScanDimensions::DimMap& dims1,
+                           const MafScanDimensions::DimMap& dims2)
+{
+  if (dims1.size() != dims2.size())
+  {
+    return false;
+  }
+  MafScanDimensions::DimMap::const_iterator i = dims1.begin();
+  MafScanDimensions::DimMap::const_iterator j = dims2.begin();
+  for (; i != dims1.end(); ++i, ++j)
+  {
+    const MafScanDimensions::Record* rec1 = i->second;
+    const MafScanDimensions::Record* rec2 = j->second;
+    if (i->first != j->first || rec1->_length != rec2->_length ||
+        rec1->_numSegments != rec2->_numSegments ||
+        rec1->_badPosSet != rec2->_badPosSet ||
+        rec1->_startMap.size() != rec2->_startMap.size())
+    {
+      return false;
+    }
+    MafScanDimensions::StartMap::const_iterator k = rec1->_startMap.begin();
+    MafScanDimensions::StartMap::const_iterator l = rec2->_startMap.begin();
+    for (; k != rec1->_startMap.end(); ++k, ++l)
+    {
+      if (k->first != l->first || k->second._index != l->second._index ||
+          k->second._count != l->second._count ||
+          k->second._empty != l->second._empty)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void halMafScanDimensionsParallelTest(CuTest *testCase)
+{
+  string maf = makeRandomMaf();
+  char* path = getTempFile();
+  FILE* out = fopen(path, "w");
+  fwrite(maf.data(), 1, maf.length(), out);
+  fclose(out);
+  char* gzPath = getTempFile();
+  gzFile gzOut = gzopen(gzPath, "wb");
+  gzwrite(gzOut, maf.data(), maf.length());
+  gzclose(gzOut);
+
+  set<string> targets;
+  MafScanDimensions scanner;
+  scanner.scan(path, targets);
+  CuAssertTrue(testCase, scanner.getNumBlocks() == 2000);
+  hal_size_t numBad = 0;
+  const MafScanDimensions::DimMap& dimMap = scanner.getDimensions();
+  for (MafScanDimensions::DimMap::const_iterator i = dimMap.begin();
+       i != dimMap.end(); ++i)
+  {
+    numBad += i->second->_badPosSet.size();
+  }
+  CuAssertTrue(testCase, numBad > 0);
+
+  for (size_t numThreads = 2; numThreads < 5; ++numThreads)
+  {
+    // small ranges so that every thread gets a few blocks at a time
+    MafScanDimensions parallelScanner;
+    parallelScanner.setNumThreads(numThreads);
+    parallelScanner.setRangeLength(500 * numThreads);
+    parallelScanner.scan(numThreads % 2 ? gzPath : path, targets);
+    CuAssertTrue(testCase, parallelScanner.getNumBlocks() == 2000);
+    CuAssertTrue(testCase, sameDimensions(dimMap,
+                                          parallelScanner.getDimensions()));
+  }
+  removeTempFile(path);
+  removeTempFile(gzPath);
+}
+
+CuSuite* halMafScanDimensionsTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMafScanDimensionsParallelTest);
+  return suite;
+}
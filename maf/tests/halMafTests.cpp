@@ -11,6 +11,8 @@ int halMafRunAllTests(void) {
   CuSuite* suite = CuSuiteNew();
   CuSuiteAddSuite(suite, halMafExportTestSuite());
   CuSuiteAddSuite(suite, halMafBlockTestSuite());
+  CuSuiteAddSuite(suite, halMafReaderTestSuite());
+  CuSuiteAddSuite(suite, halMafScanDimensionsTestSuite());
   CuSuiteRun(suite);
   CuSuiteSummary(suite, output);
   CuSuiteDetails(suite, output);
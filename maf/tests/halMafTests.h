@@ -15,5 +15,7 @@ extern "C" {
 
 CuSuite *halMafExportTestSuite();
 CuSuite *halMafBlockTestSuite();
+CuSuite *halMafReaderTestSuite();
+CuSuite *halMafScanDimensionsTestSuite();
 
 #endif
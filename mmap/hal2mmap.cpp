@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+static CLParserPtr initParser()
+{
+  CLParserPtr optionsParser = hdf5CLParserInstance(false);
+  optionsParser->addArgument("inHalPath", "input hal file");
+  optionsParser->addArgument("outMMapPath", "output memory-mapped hal file");
+  optionsParser->setDescription("Convert a hal database to the read-only "
+                                "memory-mapped format.  The output can be "
+                                "given to any tool in place of the original "
+                                "file, and the OS page cache is shared among "
+                                "all processes reading it.");
+  return optionsParser;
+}
+
+int main(int argc, char** argv)
+{
+  CLParserPtr optionsParser = initParser();
+
+  string halPath;
+  string mmapPath;
+  try
+  {
+    optionsParser->parseOptions(argc, argv);
+    halPath = optionsParser->getArgument<string>("inHalPath");
+    mmapPath = optionsParser->getArgument<string>("outMMapPath");
+  }
+  catch(exception& e)
+  {
+    cerr << e.what() << endl;
+    optionsParser->printUsage(cerr);
+    exit(1);
+  }
+
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath, 
+                                                           optionsParser);
+    if (alignment->getNumGenomes() == 0)
+    {
+      throw hal_exception("input hal alignment is empty");
+    }
+    writeMMapAlignment(alignment, mmapPath);
+  }
+  catch(hal_exception& e)
+  {
+    cerr << "hal exception caught: " << e.what() << endl;
+    return 1;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -54,7 +54,8 @@ def getHalPhyloPCmd(options):
              opt == 'step' or
              opt == 'refBed' or
              opt == 'subtree' or
-             opt == 'prec')):
+             opt == 'prec' or
+             opt == 'numThreads')):
             if val is not True:
                 cmd += ' --%s %s' % (opt, str(val))
             else:
@@ -274,6 +275,10 @@ def main(argv=None):
     hppGrp.add_argument("--prec",
                         help="Number of decimal places in wig output", type=int,
                         default=None)
+    hppGrp.add_argument("--numThreads",
+                        help="Number of threads used by each halPhyloP "
+                        "process (memory-mapped HAL files only)", type=int,
+                        default=None)
 
     args = parser.parse_args()
 
@@ -5,14 +5,52 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <algorithm>
+#include <pthread.h>
 #include "halPhyloP.h"
 
 using namespace std;
 using namespace hal;
 
-PhyloP::PhyloP() : _mod(NULL), _softMaskDups(false), _maskAllDups(false),
+const hal_size_t PhyloP::defaultChunkLength = 100000;
+const hal_size_t PhyloP::defaultPatternCacheSize = 1000000;
+
+/** The threads started by processRangeParallel, each scoring with its
+ * own PhyloP from _workers (the thread claims one when it starts), and
+ * the range they are working on.  Workers claim chunks in reference
+ * order but can't get more than _window chunks ahead of the writer,
+ * which bounds the number of finished scores held in memory while
+ * waiting their turn. */
+struct PhyloP::ChunkPool
+{
+   vector<PhyloP*> _phyloPs;
+   size_t _numClaimed;
+   vector<pthread_t> _threads;
+   bool _stop;
+   const Sequence* _sequence;
+   hal_index_t _start;
+   hal_index_t _last;
+   hal_size_t _step;
+   hal_size_t _chunkLength;
+   hal_size_t _numChunks;
+   hal_size_t _window;
+   hal_size_t _nextChunk;
+   hal_size_t _nextWrite;
+   hal_size_t _numBusy;
+   vector<vector<double>*> _output;
+   string _error;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _chunkReady;
+   pthread_cond_t _chunkDone;
+};
+
+PhyloP::PhyloP() : _mod(NULL), _bigWig(NULL), _bigWigSequence(NULL),
+                   _softMaskDups(false), _maskAllDups(false),
                    _seqnameHash(NULL), _colfitdata(NULL), _mode(CONACC),
-                   _msa(NULL)
+                   _msa(NULL), _numThreads(1), 
+                   _chunkLength(defaultChunkLength), _pool(NULL),
+                   _patternCacheSize(defaultPatternCacheSize),
+                   _numColumns(0), _numCacheHits(0)
 {
   
 }
@@ -37,6 +75,16 @@ void PhyloP::clear()
     hsh_free(_seqnameHash);
   }
   _targetSet.clear();
+  _colIt = ColumnIteratorConstPtr();
+  stopWorkers();
+  for (size_t i = 0; i < _workers.size(); ++i)
+  {
+    delete _workers[i];
+  }
+  _workers.clear();
+  _patternCache.clear();
+  _numColumns = 0;
+  _numCacheHits = 0;
 
   // need to free _mod?
 
@@ -47,12 +95,19 @@ void PhyloP::init(AlignmentConstPtr alignment, const string& modFilePath,
                   bool softMaskDups, 
                   const string& dupType,
                   const string& phyloPMode,
-		  const string &subtree)
+                  const string &subtree,
+                  BigWigWriter* bigWig)
 {
   clear();
   _alignment = alignment;
   _softMaskDups = (int)softMaskDups;
   _outStream = outStream;
+  _bigWig = bigWig;
+  _bigWigSequence = NULL;
+  _modFilePath = modFilePath;
+  _dupType = dupType;
+  _phyloPMode = phyloPMode;
+  _subtree = subtree;
 
   if (dupType == "ambiguous")
   {
@@ -168,6 +223,58 @@ void PhyloP::init(AlignmentConstPtr alignment, const string& modFilePath,
   _colfitdata->tupleidx = 0;
 }
 
+void PhyloP::setNumThreads(hal_size_t numThreads)
+{
+  numThreads = max(numThreads, (hal_size_t)1);
+  if (numThreads != _numThreads)
+  {
+    stopWorkers();
+  }
+  _numThreads = numThreads;
+}
+
+void PhyloP::setChunkLength(hal_size_t chunkLength)
+{
+  if (chunkLength == 0)
+  {
+    throw hal_exception("PhyloP chunk length must be > 0");
+  }
+  _chunkLength = chunkLength;
+}
+
+void PhyloP::setPatternCacheSize(hal_size_t patternCacheSize)
+{
+  _patternCacheSize = patternCacheSize;
+  for (size_t i = 0; i < _workers.size(); ++i)
+  {
+    _workers[i]->setPatternCacheSize(patternCacheSize);
+  }
+  if (_patternCache.size() > _patternCacheSize)
+  {
+    _patternCache.clear();
+  }
+}
+
+hal_size_t PhyloP::getNumColumns() const
+{
+  hal_size_t numColumns = _numColumns;
+  for (size_t i = 0; i < _workers.size(); ++i)
+  {
+    numColumns += _workers[i]->getNumColumns();
+  }
+  return numColumns;
+}
+
+hal_size_t PhyloP::getNumCacheHits() const
+{
+  hal_size_t numCacheHits = _numCacheHits;
+  for (size_t i = 0; i < _workers.size(); ++i)
+  {
+    numCacheHits += _workers[i]->getNumCacheHits();
+  }
+  return numCacheHits;
+}
+
 /** Given a Sequence (chromosome) and a (sequence-relative) coordinate
  * range, print the phyloP wiggle with respect to the genomes
  * in the target set 
@@ -227,6 +334,27 @@ void PhyloP::processSequence(const Sequence* sequence,
   string sequenceName = sequence->getName();
   string genomeName = genome->getName();
 
+  if (_bigWig != NULL)
+  {
+    if (sequence != _bigWigSequence)
+    {
+      _bigWig->setSequence(sequenceName, seqLen);
+      _bigWigSequence = sequence;
+    }
+  }
+  else
+  {
+    // note wig coordinates are 1-based for some reason so we shift to right
+    *_outStream << "fixedStep chrom=" << sequenceName << " start=" 
+                << start + 1 << " step=" << step << "\n";
+  }
+
+  if (_numThreads > 1 && length > _chunkLength)
+  {
+    processRangeParallel(sequence, start, last - 1, step);
+    return;
+  }
+
   /** The ColumnIterator is fundamental structure used in this example to
    * traverse the alignment.  It essientially generates the multiple alignment
    * on the fly according to the given reference (in this case the target
@@ -240,10 +368,6 @@ void PhyloP::processSequence(const Sequence* sequence,
                                  0, pos,
                                  last - 1);
 
-  // note wig coordinates are 1-based for some reason so we shift to right
-  *_outStream << "fixedStep chrom=" << sequenceName << " start=" << start + 1
-              << " step=" << step << "\n";
-  
   /** Since the column iterator stores coordinates in Genome coordinates
    * internally, we have to switch back to genome coordinates.  */
   // convert to genome coordinates
@@ -251,13 +375,13 @@ void PhyloP::processSequence(const Sequence* sequence,
   last += sequence->getStartPosition();
   while (pos <= last)
   {
-    /** ColumnIterator::ColumnMap maps a Sequence to a list of bases
-     * the bases in the map form the alignment column.  Some sequences
-     * in the map can have no bases (for efficiency reasons) */ 
-    const ColumnIterator::ColumnMap* cmap = colIt->getColumnMap();
-    double pval = this->pval(cmap);
+    /** ColumnIterator::FlatColumn lists the bases of the alignment
+     * column, grouped by Sequence.  It is much cheaper to build than
+     * the ColumnMap returned by getColumnMap() */ 
+    const ColumnIterator::FlatColumn* column = colIt->getFlatColumn();
+    double pval = this->pval(column);
 
-    *_outStream << pval << '\n';
+    writeScore(pos - sequence->getStartPosition(), pval);
     
     /** lastColumn checks if we are at the last column (inclusive)
      * in range.  So we need to check at end of iteration instead
@@ -292,59 +416,309 @@ void PhyloP::processSequence(const Sequence* sequence,
   }
 }
 
+void PhyloP::scoreRange(const Sequence* sequence, hal_index_t start,
+                        hal_index_t last, hal_size_t step,
+                        vector<double>& scores)
+{
+  hal_index_t startPosition = sequence->getStartPosition();
+  if (_colIt.get() == NULL || 
+      _colIt->getReferenceGenome() != sequence->getGenome())
+  {
+    _colIt = sequence->getColumnIterator(&_targetSet, 0, start, last);
+  }
+  else
+  {
+    _colIt->toSite(start + startPosition, last + startPosition, true);
+  }
+  for (hal_index_t pos = start; pos <= last; pos += step)
+  {
+    if (pos > start && step == 1)
+    {
+      _colIt->toRight();
+      if ((pos + startPosition) % 1000 == 0)
+      {
+        _colIt->defragment();
+      }
+    }
+    else if (pos > start)
+    {
+      _colIt->toSite(pos + startPosition, last + startPosition);
+    }
+    scores.push_back(pval(_colIt->getFlatColumn()));
+    if (_colIt->lastColumn() == true)
+    {
+      break;
+    }
+  }
+}
+
+void PhyloP::processRangeParallel(const Sequence* sequence, 
+                                  hal_index_t start, hal_index_t last,
+                                  hal_size_t step)
+{
+  startWorkers();
+  hal_size_t length = last - start + 1;
+
+  pthread_mutex_lock(&_pool->_mutex);
+  _pool->_sequence = sequence;
+  _pool->_start = start;
+  _pool->_last = last;
+  _pool->_step = step;
+  // chunks start on a step so that they sample the same positions as 
+  // a single thread would
+  _pool->_chunkLength = ((_chunkLength + step - 1) / step) * step;
+  _pool->_numChunks = 
+     (length + _pool->_chunkLength - 1) / _pool->_chunkLength;
+  _pool->_window = 2 * _numThreads;
+  _pool->_nextChunk = 0;
+  _pool->_nextWrite = 0;
+  _pool->_output.assign(_pool->_numChunks, NULL);
+  _pool->_error.clear();
+  pthread_cond_broadcast(&_pool->_chunkReady);
+
+  // write the chunks back in order as they are finished
+  string error;
+  while (_pool->_nextWrite < _pool->_numChunks && 
+         _pool->_error.empty() == true && error.empty() == true)
+  {
+    vector<double>* scores = _pool->_output[_pool->_nextWrite];
+    if (scores == NULL)
+    {
+      pthread_cond_wait(&_pool->_chunkDone, &_pool->_mutex);
+      continue;
+    }
+    hal_index_t pos = start + 
+       (hal_index_t)(_pool->_nextWrite * _pool->_chunkLength);
+    _pool->_output[_pool->_nextWrite++] = NULL;
+    pthread_cond_broadcast(&_pool->_chunkReady);
+    pthread_mutex_unlock(&_pool->_mutex);
+    try
+    {
+      for (size_t i = 0; i < scores->size(); ++i, pos += step)
+      {
+        writeScore(pos, scores->at(i));
+      }
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+    delete scores;
+    pthread_mutex_lock(&_pool->_mutex);
+  }
+  // if something failed, stop handing out chunks and wait for the 
+  // threads to finish the ones they are scoring
+  if (error.empty() == false && _pool->_error.empty() == true)
+  {
+    _pool->_error = error;
+  }
+  _pool->_nextChunk = _pool->_numChunks;
+  while (_pool->_numBusy > 0)
+  {
+    pthread_cond_wait(&_pool->_chunkDone, &_pool->_mutex);
+  }
+  for (size_t i = 0; i < _pool->_output.size(); ++i)
+  {
+    delete _pool->_output[i];
+  }
+  _pool->_output.clear();
+  error = _pool->_error;
+  pthread_mutex_unlock(&_pool->_mutex);
+
+  if (error.empty() == false)
+  {
+    throw hal_exception(error);
+  }
+}
+
+void PhyloP::startWorkers()
+{
+  if (_pool != NULL)
+  {
+    return;
+  }
+  if (_alignment->supportsConcurrentReads() == false)
+  {
+    throw hal_exception("Multithreaded phyloP requires an alignment "
+                        "that supports concurrent reads (use hal2mmap to "
+                        "convert it)");
+  }
+  while (_workers.size() < _numThreads)
+  {
+    PhyloP* phyloP = new PhyloP();
+    _workers.push_back(phyloP);
+    phyloP->init(_alignment, _modFilePath, NULL, _softMaskDups != 0,
+                 _dupType, _phyloPMode, _subtree);
+    phyloP->setPatternCacheSize(_patternCacheSize);
+  }
+
+  _pool = new ChunkPool();
+  _pool->_phyloPs.assign(_workers.begin(), _workers.begin() + _numThreads);
+  _pool->_numClaimed = 0;
+  _pool->_stop = false;
+  _pool->_numChunks = 0;
+  _pool->_nextChunk = 0;
+  _pool->_nextWrite = 0;
+  _pool->_window = 0;
+  _pool->_numBusy = 0;
+  pthread_mutex_init(&_pool->_mutex, NULL);
+  pthread_cond_init(&_pool->_chunkReady, NULL);
+  pthread_cond_init(&_pool->_chunkDone, NULL);
+
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, chunkWorker, _pool) != 0)
+    {
+      stopWorkers();
+      throw hal_exception("Error creating phyloP thread");
+    }
+    _pool->_threads.push_back(thread);
+  }
+}
+
+void PhyloP::stopWorkers()
+{
+  if (_pool == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&_pool->_mutex);
+  _pool->_stop = true;
+  pthread_cond_broadcast(&_pool->_chunkReady);
+  pthread_mutex_unlock(&_pool->_mutex);
+  for (size_t i = 0; i < _pool->_threads.size(); ++i)
+  {
+    pthread_join(_pool->_threads[i], NULL);
+  }
+  pthread_cond_destroy(&_pool->_chunkDone);
+  pthread_cond_destroy(&_pool->_chunkReady);
+  pthread_mutex_destroy(&_pool->_mutex);
+  delete _pool;
+  _pool = NULL;
+}
+
+void* PhyloP::chunkWorker(void* arg)
+{
+  ChunkPool* pool = static_cast<ChunkPool*>(arg);
+  pthread_mutex_lock(&pool->_mutex);
+  PhyloP* phyloP = pool->_phyloPs[pool->_numClaimed++];
+  while (true)
+  {
+    while (pool->_stop == false &&
+           (pool->_nextChunk >= pool->_numChunks ||
+            pool->_error.empty() == false ||
+            pool->_nextChunk >= pool->_nextWrite + pool->_window))
+    {
+      pthread_cond_wait(&pool->_chunkReady, &pool->_mutex);
+    }
+    if (pool->_stop == true)
+    {
+      break;
+    }
+    hal_size_t chunk = pool->_nextChunk++;
+    ++pool->_numBusy;
+    const Sequence* sequence = pool->_sequence;
+    hal_size_t step = pool->_step;
+    hal_index_t start = pool->_start + 
+       (hal_index_t)(chunk * pool->_chunkLength);
+    hal_index_t last = min(start + (hal_index_t)pool->_chunkLength - 1,
+                           pool->_last);
+    pthread_mutex_unlock(&pool->_mutex);
+
+    vector<double>* scores = new vector<double>();
+    string error;
+    try
+    {
+      phyloP->scoreRange(sequence, start, last, step, *scores);
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+    catch (...)
+    {
+      error = "Error computing phyloP scores";
+    }
+    if (error.empty() == false)
+    {
+      delete scores;
+      scores = NULL;
+    }
+
+    pthread_mutex_lock(&pool->_mutex);
+    if (scores == NULL && pool->_error.empty() == true)
+    {
+      pool->_error = error;
+    }
+    pool->_output[chunk] = scores;
+    --pool->_numBusy;
+    pthread_cond_broadcast(&pool->_chunkDone);
+  }
+  pthread_mutex_unlock(&pool->_mutex);
+  return NULL;
+}
+
+void PhyloP::writeScore(hal_index_t pos, double pval)
+{
+  if (_bigWig != NULL)
+  {
+    // each sample of the wiggle covers one base
+    _bigWig->addInterval(pos, pos + 1, pval);
+  }
+  else
+  {
+    *_outStream << pval << '\n';
+  }
+}
+
 // compute phyloP score for a particular alignment column, return pval
-double PhyloP::pval(const ColumnIterator::ColumnMap *cmap) 
+double PhyloP::pval(const ColumnIterator::FlatColumn *column) 
 {
+  ++_numColumns;
   for (int i=0; i < _msa->nseqs; i++) 
   {
     _msa->ss->col_tuples[0][i] = '*';
   }
   
-  for (ColumnIterator::ColumnMap::const_iterator it = cmap->begin(); 
-       it != cmap->end(); ++it) 
+  for (ColumnIterator::FlatColumn::const_iterator it = column->begin(); 
+       it != column->end(); ++it) 
   {
-    const Sequence *sequence = it->first;
-    const Genome *genome = sequence->getGenome();
+    const Genome *genome = it->_sequence->getGenome();
     int spec = hsh_get_int(_seqnameHash, genome->getName().c_str());
     if (spec < 0)
     {
       continue;
     }
-    ColumnIterator::DNASet* dnaSet = it->second;
-    for (ColumnIterator::DNASet::const_iterator j = dnaSet->begin(); 
-         j != dnaSet->end(); ++j) 
+    char base = toupper(it->_dna->getChar());
+    if (_msa->ss->col_tuples[0][spec] == '*')
     {
-      DNAIteratorConstPtr dna = *j;
-      char base = toupper(dna->getChar());
-      if (_msa->ss->col_tuples[0][spec] == '*')
-      {
-	_msa->ss->col_tuples[0][spec] = base;
-      }
-      else 
+      _msa->ss->col_tuples[0][spec] = base;
+    }
+    else 
+    {
+      if (_maskAllDups && _softMaskDups == 0) 
+      {  //hard mask, all dups
+        return 0.0;  // duplication; mask this base
+      } 
+      else if (_maskAllDups) 
+      {  // soft mask, all dups
+        _msa->ss->col_tuples[0][spec] = 'N';
+      } 
+      else if (_msa->ss->col_tuples[0][spec] != base) 
       {
-	if (_maskAllDups && _softMaskDups == 0) 
-        {  //hard mask, all dups
-	  return 0.0;  // duplication; mask this base
-	} 
-        else if (_maskAllDups) 
-        {  // soft mask, all dups
-	  _msa->ss->col_tuples[0][spec] = 'N';
-	} 
-        else if (_msa->ss->col_tuples[0][spec] != base) 
+        if (_softMaskDups == 0) 
         {
-	  if (_softMaskDups == 0) 
-          {
-	    return 0.0;
-          }
-	  else 
-          {
-            _msa->ss->col_tuples[0][spec] ='N';
-          }
-	} 
+          return 0.0;
+        }
         else 
         {
-	  _msa->ss->col_tuples[0][spec] = base;
-	}
+          _msa->ss->col_tuples[0][spec] ='N';
+        }
+      } 
+      else 
+      {
+        _msa->ss->col_tuples[0][spec] = base;
       }
     }
   }
@@ -356,6 +730,21 @@ double PhyloP::pval(const ColumnIterator::ColumnMap *cmap)
       _msa->ss->col_tuples[0][i] = 'N';
     }
   }
+
+  // the score only depends on the bases of the column, of which there
+  // are far fewer combinations than columns
+  string pattern;
+  if (_patternCacheSize > 0)
+  {
+    pattern.assign(_msa->ss->col_tuples[0], _msa->nseqs);
+    map<string, double>::const_iterator cacheIt = 
+       _patternCache.find(pattern);
+    if (cacheIt != _patternCache.end())
+    {
+      ++_numCacheHits;
+      return cacheIt->second;
+    }
+  }
   
   //finally, compute the score!
   double alt_lnl, null_lnl, this_scale, delta_lnl, pval;
@@ -430,6 +819,11 @@ double PhyloP::pval(const ColumnIterator::ColumnMap *cmap)
     pval *= -1; /* mark as acceleration */
   }
 
+  if (_patternCacheSize > 0 && _patternCache.size() < _patternCacheSize)
+  {
+    _patternCache.insert(pair<string, double>(pattern, pval));
+  }
+
   // print out parameters for debugging
 //    cout << _msa->ss->col_tuples[0] << " " << _mod->scale << " " << alt_lnl << " " << null_lnl << " " << delta_lnl << " " << pval << " ";
 
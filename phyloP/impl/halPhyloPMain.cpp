@@ -71,6 +71,31 @@ static CLParserPtr initParser()
 			   "conservation/acceleration in this subtree "
 			   "relative to the rest of the tree", "\"\"");
   optionsParser->addOption("prec", "Number of decimal places in wig output", 3);
+  optionsParser->addOption("outBigWig", "write a bigWig file to this path "
+                           "instead of a wiggle to outWiggle (which is "
+                           "then not written).  With --refBed, the BED "
+                           "file must be sorted", "\"\"");
+  optionsParser->addOption("numThreads",
+                           "number of threads used to score the reference "
+                           "range.  The range is split into chunks of "
+                           "--chunkLength bases that are written in order. "
+                           " Only memory-mapped alignments (see hal2mmap) "
+                           "can be read by more than one thread",
+                           1);
+  optionsParser->addOption("chunkLength",
+                           "length of reference chunks when using more than "
+                           "one thread",
+                           PhyloP::defaultChunkLength);
+  optionsParser->addOption("patternCacheSize",
+                           "maximum number of distinct alignment column "
+                           "patterns whose scores are remembered (per "
+                           "thread), so that repeated columns are scored "
+                           "only once.  0 disables the cache",
+                           PhyloP::defaultPatternCacheSize);
+  optionsParser->addOptionFlag("cacheStats",
+                               "print the number of columns scored and "
+                               "pattern cache hits to stderr at the end",
+                               false);
   
   optionsParser->setDescription("Make PhyloP wiggle plot for a genome.");
   return optionsParser;
@@ -82,6 +107,7 @@ int main(int argc, char** argv)
   string modPath;
   string halPath;
   string wigPath;
+  string bigWigPath;
   string refGenomeName;
   string refSequenceName;
   string dupType;
@@ -92,6 +118,10 @@ int main(int argc, char** argv)
   hal_size_t step;
   string refBedPath;
   hal_size_t prec;
+  hal_size_t numThreads;
+  hal_size_t chunkLength;
+  hal_size_t patternCacheSize;
+  bool cacheStats;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -109,6 +139,16 @@ int main(int argc, char** argv)
     std::transform(dupMask.begin(), dupMask.end(), dupMask.begin(), ::tolower);
     refBedPath = optionsParser->getOption<string>("refBed");
     prec = optionsParser->getOption<hal_size_t>("prec");
+    bigWigPath = optionsParser->getOption<string>("outBigWig");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    chunkLength = optionsParser->getOption<hal_size_t>("chunkLength");
+    patternCacheSize = 
+       optionsParser->getOption<hal_size_t>("patternCacheSize");
+    cacheStats = optionsParser->getFlag("cacheStats");
+    if (numThreads == 0 || chunkLength == 0)
+    {
+      throw hal_exception("--numThreads and --chunkLength must be > 0");
+    }
   }
   catch(exception& e)
   {
@@ -117,6 +157,7 @@ int main(int argc, char** argv)
     exit(1);
   }
 
+  BigWigWriter* bigWig = NULL;
   try
   {
     /** Everything begins with the alignment object, which is created
@@ -130,6 +171,13 @@ int main(int argc, char** argv)
     {
       throw hal_exception("input hal alignmenet is empty");
     }
+    if (numThreads > 1 && alignment->supportsConcurrentReads() == false)
+    {
+      cerr << "halPhyloP: Warning " << halPath << " cannot be read by more "
+           << "than one thread (convert it with hal2mmap to do so). "
+           << "--numThreads will be ignored" << endl;
+      numThreads = 1;
+    }
 
     /** Open the reference genome */
     const Genome* refGenome = NULL;
@@ -162,7 +210,11 @@ int main(int argc, char** argv)
 
     ofstream ofile;
     ostream& outStream = wigPath == "stdout" ? cout : ofile;
-    if (wigPath != "stdout")
+    if (bigWigPath != "\"\"")
+    {
+      bigWig = new BigWigWriter(bigWigPath);
+    }
+    else if (wigPath != "stdout")
     {
       ofile.open(wigPath.c_str());
       if (!ofile)
@@ -178,7 +230,10 @@ int main(int argc, char** argv)
     
     PhyloP phyloP;
     phyloP.init(alignment, modPath, &outStream, dupMask == "soft" , dupType,
-		"CONACC", subtree);
+                "CONACC", subtree, bigWig);
+    phyloP.setNumThreads(numThreads);
+    phyloP.setChunkLength(chunkLength);
+    phyloP.setPatternCacheSize(patternCacheSize);
 
     ifstream refBedStream;
     if (refBedPath != "\"\"")
@@ -201,18 +256,31 @@ int main(int argc, char** argv)
     {
       printGenome(&phyloP, refGenome, refSequence, start, length, step);
     }
+    if (bigWig != NULL)
+    {
+      bigWig->close();
+    }
+    if (cacheStats == true)
+    {
+      cerr << "halPhyloP: " << phyloP.getNumCacheHits() << " of "
+           << phyloP.getNumColumns() << " columns scored from the "
+           << "pattern cache" << endl;
+    }
   }
   catch(hal_exception& e)
   {
     cerr << "hal exception caught: " << e.what() << endl;
+    delete bigWig;
     return 1;
   }
   catch(exception& e)
   {
     cerr << "Exception caught: " << e.what() << endl;
+    delete bigWig;
     return 1;
   }
 
+  delete bigWig;
   return 0;
 }
 
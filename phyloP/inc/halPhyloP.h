@@ -9,7 +9,9 @@
 #define _HALPHYLOP_H
 
 #include <cstdlib>
+#include <map>
 #include <string>
+#include <vector>
 #include "hal.h"
 
 extern "C"{
@@ -41,23 +43,75 @@ public:
     * entire tree. Otherwise, subtree names a branch to perform test on
     * subtree relative to rest of tree. The subtree includes all children
     * of the named node as well as the branch leading to the node.
+    * @param bigWig If not NULL, the scores are written to it instead of
+    * to outStream.  The sequences must then be processed in order and 
+    * each sequence only once, or in increasing, non-overlapping ranges.
     */
    void init(AlignmentConstPtr alignment, const std::string& modFilePath,
              std::ostream* outStream,
              bool softMaskDups = true, 
              const std::string& dupType = "ambiguous",
              const std::string& phyloPMode = "CONACC",
-             const std::string& subtree = "\"\"");
+             const std::string& subtree = "\"\"",
+             BigWigWriter* bigWig = NULL);
 
+   /** Print the scores of a sequence-relative range.  If more than one
+    * thread is set (see setNumThreads()), the range is cut into chunks
+    * that are scored in parallel and written back in order.  Each chunk
+    * is scanned as if the chunks had been given separately.  The threads
+    * are started by the first such range and kept until the next init()
+    * or the destructor. */
    void processSequence(const Sequence* sequence,
                         hal_index_t start,
                         hal_size_t length,
                         hal_size_t step);
 
+   /** Number of threads used by processSequence.  More than one 
+    * requires an alignment that supports concurrent reads.  Must be set
+    * before the threads are started */
+   void setNumThreads(hal_size_t numThreads);
+   /** Number of reference bases scored by a thread at a time */
+   void setChunkLength(hal_size_t chunkLength);
+
+   /** Maximum number of distinct column patterns whose scores are
+    * remembered (per thread).  0 disables the cache */
+   void setPatternCacheSize(hal_size_t patternCacheSize);
+
+   /** Number of columns scored so far (by all threads) */
+   hal_size_t getNumColumns() const;
+   /** Number of these columns whose score was found in the pattern 
+    * cache */
+   hal_size_t getNumCacheHits() const;
+
+   static const hal_size_t defaultChunkLength;
+   static const hal_size_t defaultPatternCacheSize;
+
 protected:
 
+   struct ChunkPool;
+
    // return phyloP score 
-   double pval(const ColumnIterator::ColumnMap *cmap);  
+   double pval(const ColumnIterator::FlatColumn *column);  
+
+   /** Score the (sequence-relative) positions start, start + step, ...
+    * up to last (inclusive).  The column iterator of the previous range
+    * is moved to the new one (with its visit cache cleared), so this is
+    * the same as using a new one */
+   void scoreRange(const Sequence* sequence, hal_index_t start,
+                   hal_index_t last, hal_size_t step,
+                   std::vector<double>& scores);
+
+   void processRangeParallel(const Sequence* sequence, hal_index_t start,
+                             hal_index_t last, hal_size_t step);
+
+   /** start the threads (each with its own PhyloP from _workers) that
+    * score the chunks of processRangeParallel until stopWorkers() */
+   void startWorkers();
+   void stopWorkers();
+   static void* chunkWorker(void* arg);
+
+   // write the score of a sequence-relative position
+   void writeScore(hal_index_t pos, double pval);
 
    void clear();
 
@@ -68,6 +122,8 @@ protected:
    TreeModel* _modcpy;
    std::set<const Genome*> _targetSet;
    std::ostream* _outStream;
+   BigWigWriter* _bigWig;
+   const Sequence* _bigWigSequence;
   
    // 1 default = soft mask, if 0 use hard mask (mask entire column)
    int _softMaskDups;  
@@ -81,6 +137,25 @@ protected:
    List *_outsideNodes;
    mode_type _mode;
    MSA* _msa;
+
+   // init() parameters, to give each thread its own copy of the model
+   std::string _modFilePath;
+   std::string _dupType;
+   std::string _phyloPMode;
+   std::string _subtree;
+   hal_size_t _numThreads;
+   hal_size_t _chunkLength;
+   std::vector<PhyloP*> _workers;
+   ChunkPool* _pool;
+   ColumnIteratorConstPtr _colIt;
+
+   // scores of the columns seen so far, keyed by their bases (one per
+   // species, after duplication masking).  the masking options are
+   // fixed by init(), which clears the cache
+   std::map<std::string, double> _patternCache;
+   hal_size_t _patternCacheSize;
+   hal_size_t _numColumns;
+   hal_size_t _numCacheHits;
 };
 
 }
@@ -0,0 +1,556 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cctype>
+#include <algorithm>
+#include <pthread.h>
+#include "halPairwiseStats.h"
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t PairwiseStats::defaultChunkLength = 1000000;
+
+/** Totals of a reference (or of one thread's chunks of it).  Indexed by
+ * genome id, except for the all-leaves coverage histograms which are
+ * indexed by (to leaf) * numLeaves + (from leaf) */
+struct PairwiseStats::Counts
+{
+   vector<char> _seen;
+   vector<hal_size_t> _numID;
+   vector<hal_size_t> _numSites;
+   vector<vector<hal_size_t> > _coverage;
+
+   void add(const Counts& other)
+   {
+     for (size_t i = 0; i < _seen.size(); ++i)
+     {
+       _seen[i] = _seen[i] || other._seen[i];
+       _numID[i] += other._numID[i];
+       _numSites[i] += other._numSites[i];
+     }
+     for (size_t i = 0; i < _coverage.size(); ++i)
+     {
+       const vector<hal_size_t>& otherHist = other._coverage[i];
+       if (_coverage[i].size() < otherHist.size())
+       {
+         _coverage[i].resize(otherHist.size(), 0);
+       }
+       for (size_t j = 0; j < otherHist.size(); ++j)
+       {
+         _coverage[i][j] += otherHist[j];
+       }
+     }
+   }
+};
+
+/** Scratch counts of the current column, indexed by genome id.  Only the
+ * _touched genomes are non-zero, and are reset after each column */
+struct PairwiseStats::ColumnCounts
+{
+   vector<hal_size_t> _count;
+   vector<hal_size_t> _sites;
+   vector<hal_size_t> _identical;
+   vector<size_t> _touched;
+   vector<size_t> _entryIds;
+   vector<char> _entryBases;
+};
+
+/** A range (in genome coordinates) of the reference genome (or of one
+ * leaf for the all-leaves coverage) */
+struct PairwiseStats::Chunk
+{
+   const Genome* _genome;
+   size_t _genomeId;
+   bool _allLeaves;
+   hal_index_t _start;
+   hal_index_t _last;
+};
+
+/** Threads take the next chunk until there are none left */
+struct PairwiseStats::ChunkQueue
+{
+   const PairwiseStats* _stats;
+   const vector<Chunk>* _chunks;
+   size_t _nextChunk;
+   Mutex _mutex;
+   vector<Counts> _counts;
+   vector<string> _errors;
+   vector<size_t> _threadIds;
+};
+
+PairwiseStats::PairwiseStats(AlignmentConstPtr alignment) :
+  _alignment(alignment),
+  _numLeaves(0),
+  _numThreads(1),
+  _chunkLength(defaultChunkLength),
+  _refGenome(NULL),
+  _counts(NULL)
+{
+  if (_alignment->getNumGenomes() == 0)
+  {
+    return;
+  }
+  const GenomeTree* tree = _alignment->getGenomeTree();
+  for (hal_size_t id = 0; id < tree->getNumGenomes(); ++id)
+  {
+    const Genome* genome = _alignment->openGenome(tree->getName(id));
+    if (genome == NULL)
+    {
+      throw hal_exception("Genome " + tree->getName(id) + " not found");
+    }
+    assert(genome->getGenomeId() == id);
+    _genomes.push_back(genome);
+    if (tree->isLeaf(id) == true)
+    {
+      _leafIds.push_back(_numLeaves++);
+    }
+    else
+    {
+      _leafIds.push_back(NULL_INDEX);
+    }
+  }
+}
+
+PairwiseStats::~PairwiseStats()
+{
+  delete _counts;
+}
+
+void PairwiseStats::setNumThreads(hal_size_t numThreads)
+{
+  _numThreads = max(numThreads, (hal_size_t)1);
+}
+
+void PairwiseStats::setChunkLength(hal_size_t chunkLength)
+{
+  if (chunkLength == 0)
+  {
+    throw hal_exception("PairwiseStats chunk length must be > 0");
+  }
+  _chunkLength = chunkLength;
+}
+
+void PairwiseStats::computeReference(const Genome* refGenome)
+{
+  _refGenome = refGenome;
+  vector<Chunk> chunks;
+  addChunks(refGenome, false, chunks);
+  compute(chunks);
+}
+
+void PairwiseStats::computeAllLeaves()
+{
+  _refGenome = NULL;
+  vector<Chunk> chunks;
+  for (size_t i = 0; i < _genomes.size(); ++i)
+  {
+    if (_leafIds[i] != NULL_INDEX)
+    {
+      addChunks(_genomes[i], true, chunks);
+    }
+  }
+  compute(chunks);
+}
+
+void PairwiseStats::addChunks(const Genome* genome, bool allLeaves,
+                              vector<Chunk>& chunks) const
+{
+  hal_size_t length = genome->getSequenceLength();
+  // a single thread walks each genome in one go
+  hal_size_t chunkLength = _numThreads > 1 ? _chunkLength : length;
+  for (hal_size_t start = 0; start < length; start += chunkLength)
+  {
+    Chunk chunk;
+    chunk._genome = genome;
+    chunk._genomeId = genome->getGenomeId();
+    chunk._allLeaves = allLeaves;
+    chunk._start = (hal_index_t)start;
+    chunk._last = (hal_index_t)min(start + chunkLength, length) - 1;
+    chunks.push_back(chunk);
+  }
+}
+
+void PairwiseStats::compute(const vector<Chunk>& chunks)
+{
+  if (_numThreads > 1 && _alignment->supportsConcurrentReads() == false)
+  {
+    throw hal_exception("Multithreaded halStats requires an alignment "
+                        "that supports concurrent reads (use hal2mmap to "
+                        "convert it)");
+  }
+  size_t numThreads = max(min(_numThreads, (hal_size_t)chunks.size()),
+                          (hal_size_t)1);
+  ChunkQueue queue;
+  queue._stats = this;
+  queue._chunks = &chunks;
+  queue._nextChunk = 0;
+  queue._counts.resize(numThreads);
+  queue._errors.resize(numThreads);
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    Counts& counts = queue._counts[i];
+    counts._seen.assign(_genomes.size(), 0);
+    counts._numID.assign(_genomes.size(), 0);
+    counts._numSites.assign(_genomes.size(), 0);
+    counts._coverage.resize(_refGenome != NULL ? _genomes.size() :
+                            _numLeaves * _numLeaves);
+    queue._threadIds.push_back(i);
+  }
+
+  if (numThreads == 1)
+  {
+    chunkWorker(&queue);
+  }
+  else
+  {
+    vector<pthread_t> threads(numThreads);
+    size_t numStarted = 0;
+    for (; numStarted < numThreads; ++numStarted)
+    {
+      if (pthread_create(&threads[numStarted], NULL, chunkWorker,
+                         &queue) != 0)
+      {
+        // the threads that did start will do all the chunks
+        break;
+      }
+    }
+    if (numStarted == 0)
+    {
+      throw hal_exception("Error creating halStats thread");
+    }
+    for (size_t i = 0; i < numStarted; ++i)
+    {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    if (queue._errors[i].empty() == false)
+    {
+      throw hal_exception(queue._errors[i]);
+    }
+  }
+  for (size_t i = 1; i < numThreads; ++i)
+  {
+    queue._counts[0].add(queue._counts[i]);
+  }
+  delete _counts;
+  _counts = new Counts();
+  swap(*_counts, queue._counts[0]);
+}
+
+void* PairwiseStats::chunkWorker(void* arg)
+{
+  ChunkQueue* queue = static_cast<ChunkQueue*>(arg);
+  const PairwiseStats* stats = queue->_stats;
+  size_t threadId;
+  {
+    ScopedLock lock(queue->_mutex);
+    threadId = queue->_threadIds.back();
+    queue->_threadIds.pop_back();
+  }
+  Counts& counts = queue->_counts[threadId];
+  ColumnCounts column;
+  column._count.assign(stats->_genomes.size(), 0);
+  column._sites.assign(stats->_genomes.size(), 0);
+  column._identical.assign(stats->_genomes.size(), 0);
+  try
+  {
+    while (true)
+    {
+      size_t chunk;
+      {
+        ScopedLock lock(queue->_mutex);
+        if (queue->_nextChunk >= queue->_chunks->size())
+        {
+          break;
+        }
+        chunk = queue->_nextChunk++;
+      }
+      stats->countChunk(queue->_chunks->at(chunk), column, counts);
+    }
+  }
+  catch (exception& e)
+  {
+    queue->_errors[threadId] = e.what();
+  }
+  catch (...)
+  {
+    queue->_errors[threadId] = "Error computing pairwise stats";
+  }
+  if (queue->_errors[threadId].empty() == false)
+  {
+    // stop the other threads
+    ScopedLock lock(queue->_mutex);
+    queue->_nextChunk = queue->_chunks->size();
+  }
+  return NULL;
+}
+
+void PairwiseStats::countChunk(const Chunk& chunk, ColumnCounts& column,
+                               Counts& counts) const
+{
+  // every reference position is visited (no unique option), so that
+  // the chunks are independent.  the columns that contain more than one
+  // reference position are only counted once by countColumn()
+  ColumnIteratorConstPtr colIt =
+     chunk._genome->getColumnIterator(NULL, 0, chunk._start, chunk._last,
+                                      false, chunk._allLeaves);
+  while (true)
+  {
+    hal_index_t refPos = colIt->getReferenceSequencePosition() +
+       colIt->getReferenceSequence()->getStartPosition();
+    countColumn(chunk, refPos, colIt->getFlatColumn(), column, counts);
+    if (colIt->getReferenceSequencePosition() % 1000 == 0)
+    {
+      colIt->defragment();
+    }
+    if (colIt->lastColumn())
+    {
+      // Break here--the column iterator will crash if we try to go further.
+      break;
+    }
+    colIt->toRight();
+  }
+}
+
+void PairwiseStats::countColumn(const Chunk& chunk, hal_index_t refPos,
+                                const ColumnIterator::FlatColumn* flatColumn,
+                                ColumnCounts& column, Counts& counts) const
+{
+  size_t refId = chunk._genomeId;
+  hal_index_t refLeafId = _leafIds[refId];
+  char refBase = 'N';
+  hal_index_t leftmostRefPos = refPos;
+  bool hasEarlierLeaf = false;
+
+  // entries are grouped by sequence, so only look up each genome once
+  const Sequence* sequence = NULL;
+  size_t id = 0;
+  column._entryIds.clear();
+  column._entryBases.clear();
+  for (ColumnIterator::FlatColumn::const_iterator entryIt =
+          flatColumn->begin(); entryIt != flatColumn->end(); ++entryIt)
+  {
+    if (entryIt->_sequence != sequence)
+    {
+      sequence = entryIt->_sequence;
+      id = sequence->getGenome()->getGenomeId();
+    }
+    if (column._count[id]++ == 0)
+    {
+      column._touched.push_back(id);
+    }
+    char base = toupper(entryIt->_dna->getChar());
+    column._entryIds.push_back(id);
+    column._entryBases.push_back(base);
+    if (id == refId)
+    {
+      hal_index_t pos = entryIt->_dna->getArrayIndex();
+      if (pos == refPos)
+      {
+        refBase = base;
+      }
+      leftmostRefPos = min(leftmostRefPos, pos);
+    }
+    else if (chunk._allLeaves == true && _leafIds[id] != NULL_INDEX &&
+             _leafIds[id] < refLeafId)
+    {
+      hasEarlierLeaf = true;
+    }
+  }
+
+  if (chunk._allLeaves == false)
+  {
+    // identity with the reference, unless it is N or duplicated.  only
+    // genomes with a single (non-N) base in the column count
+    if (refBase != 'N')
+    {
+      for (size_t i = 0; i < column._entryIds.size(); ++i)
+      {
+        if (column._entryBases[i] != 'N')
+        {
+          ++column._sites[column._entryIds[i]];
+          if (column._entryBases[i] == refBase)
+          {
+            ++column._identical[column._entryIds[i]];
+          }
+        }
+      }
+      if (column._sites[refId] == 1)
+      {
+        for (size_t i = 0; i < column._touched.size(); ++i)
+        {
+          size_t genomeId = column._touched[i];
+          if (column._sites[genomeId] > 0)
+          {
+            counts._seen[genomeId] = 1;
+          }
+          if (column._sites[genomeId] == 1)
+          {
+            ++counts._numSites[genomeId];
+            counts._numID[genomeId] += column._identical[genomeId];
+          }
+        }
+      }
+    }
+    // coverage of the leaves (and reference) by the reference
+    if (leftmostRefPos == refPos)
+    {
+      hal_size_t refCount = column._count[refId];
+      for (size_t i = 0; i < column._touched.size(); ++i)
+      {
+        size_t genomeId = column._touched[i];
+        if (_leafIds[genomeId] == NULL_INDEX && genomeId != refId)
+        {
+          continue;
+        }
+        vector<hal_size_t>& histogram = counts._coverage[genomeId];
+        if (histogram.size() < column._count[genomeId])
+        {
+          histogram.resize(column._count[genomeId], 0);
+        }
+        for (hal_size_t j = 0; j < column._count[genomeId]; ++j)
+        {
+          histogram[j] += refCount;
+        }
+      }
+    }
+  }
+  else if (hasEarlierLeaf == false && leftmostRefPos == refPos)
+  {
+    // coverage between all pairs of leaves in the column
+    for (size_t i = 0; i < column._touched.size(); ++i)
+    {
+      size_t toId = column._touched[i];
+      if (_leafIds[toId] == NULL_INDEX)
+      {
+        continue;
+      }
+      for (size_t j = 0; j < column._touched.size(); ++j)
+      {
+        size_t fromId = column._touched[j];
+        if (_leafIds[fromId] == NULL_INDEX)
+        {
+          continue;
+        }
+        vector<hal_size_t>& histogram = counts._coverage[
+          _leafIds[toId] * _numLeaves + _leafIds[fromId]];
+        if (histogram.size() < column._count[fromId])
+        {
+          histogram.resize(column._count[fromId], 0);
+        }
+        for (hal_size_t k = 0; k < column._count[fromId]; ++k)
+        {
+          histogram[k] += column._count[toId];
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < column._touched.size(); ++i)
+  {
+    size_t genomeId = column._touched[i];
+    column._count[genomeId] = 0;
+    column._sites[genomeId] = 0;
+    column._identical[genomeId] = 0;
+  }
+  column._touched.clear();
+}
+
+void PairwiseStats::printPercentID(ostream& os) const
+{
+  os << "Genome, % ID, numID, numSites" << endl;
+  for (size_t i = 0; _counts != NULL && i < _genomes.size(); ++i)
+  {
+    if (_counts->_seen[i])
+    {
+      hal_size_t numID = _counts->_numID[i];
+      hal_size_t numSites = _counts->_numSites[i];
+      os << _genomes[i]->getName() << ", " << ((double) numID)/numSites
+         << ", " << numID << ", " << numSites << endl;
+    }
+  }
+}
+
+void PairwiseStats::printCoverage(ostream& os) const
+{
+  vector<string> names;
+  vector<const vector<hal_size_t>*> histograms;
+  for (size_t i = 0; _counts != NULL && _refGenome != NULL &&
+          i < _genomes.size(); ++i)
+  {
+    if (_counts->_coverage[i].empty() == false)
+    {
+      names.push_back(_genomes[i]->getName());
+      histograms.push_back(&_counts->_coverage[i]);
+    }
+  }
+  printHistograms(os, "Genome", names, histograms);
+}
+
+void PairwiseStats::printAllCoverage(ostream& os) const
+{
+  vector<string> names;
+  vector<const vector<hal_size_t>*> histograms;
+  for (size_t from = 0; _counts != NULL && _refGenome == NULL &&
+          from < _genomes.size(); ++from)
+  {
+    for (size_t to = 0; _leafIds[from] != NULL_INDEX &&
+            to < _genomes.size(); ++to)
+    {
+      if (_leafIds[to] == NULL_INDEX)
+      {
+        continue;
+      }
+      const vector<hal_size_t>& histogram = _counts->_coverage[
+        _leafIds[to] * _numLeaves + _leafIds[from]];
+      if (histogram.empty() == false)
+      {
+        names.push_back(_genomes[from]->getName() + ", " +
+                        _genomes[to]->getName());
+        histograms.push_back(&histogram);
+      }
+    }
+  }
+  printHistograms(os, "FromGenome, ToGenome", names, histograms);
+}
+
+void PairwiseStats::printHistograms(
+  ostream& os, const string& header, const vector<string>& names,
+  const vector<const vector<hal_size_t>*>& histograms)
+{
+  hal_size_t maxHistLength = 0;
+  for (size_t i = 0; i < histograms.size(); ++i)
+  {
+    maxHistLength = max(maxHistLength, (hal_size_t)histograms[i]->size());
+  }
+  os << header;
+  for (hal_size_t i = 0; i < maxHistLength; i++)
+  {
+    os << ", sitesCovered" << i + 1 << "Times";
+  }
+  os << endl;
+  for (size_t i = 0; i < histograms.size(); ++i)
+  {
+    os << names[i];
+    for (hal_size_t j = 0; j < maxHistLength; j++)
+    {
+      if (j < histograms[i]->size())
+      {
+        os << ", " << (double) histograms[i]->at(j);
+      }
+      else
+      {
+        os << ", " << 0;
+      }
+    }
+    os << endl;
+  }
+}
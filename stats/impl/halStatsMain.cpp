@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <iostream>
 #include "halStats.h"
+#include "halPairwiseStats.h"
 
 using namespace std;
 using namespace hal;
@@ -38,12 +39,13 @@ static void printGenomeMetaData(ostream &os, AlignmentConstPtr alignment,
 static void printChromSizes(ostream& os, AlignmentConstPtr alignment, 
                             const string& genomeName);
 static void printPercentID(ostream& os, AlignmentConstPtr alignment,
-                           const string& genomeName);
+                           const string& genomeName, hal_size_t numThreads);
 static void printCoverage(ostream& os, AlignmentConstPtr alignment,
-                                 const string& genomeName);
+                          const string& genomeName, hal_size_t numThreads);
 static void printSegments(ostream& os, AlignmentConstPtr alignment,
                           const string& genomeName, bool top);
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment);
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             hal_size_t numThreads);
 
 int main(int argc, char** argv)
 {
@@ -115,6 +117,12 @@ int main(int argc, char** argv)
   optionsParser->addOptionFlag("allCoverage",
                                "print histogram of coverage from all genomes to"
                                " all genomes", false);
+  optionsParser->addOption("numThreads",
+                           "number of threads used by --percentID, "
+                           "--coverage and --allCoverage.  Only "
+                           "memory-mapped alignments (see hal2mmap) can be "
+                           "read by more than one thread",
+                           1);
 
 
   string path;
@@ -139,6 +147,7 @@ int main(int argc, char** argv)
   string topSegments;
   string bottomSegments;
   bool allCoverage;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -164,6 +173,11 @@ int main(int argc, char** argv)
     topSegments = optionsParser->getOption<string>("topSegments");
     bottomSegments = optionsParser->getOption<string>("bottomSegments");
     allCoverage = optionsParser->getFlag("allCoverage");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be > 0");
+    }
 
     size_t optCount = listGenomes == true ? 1 : 0;
     if (sequencesFromGenome != "\"\"") ++optCount;
@@ -206,6 +220,13 @@ int main(int argc, char** argv)
   try
   {
     AlignmentConstPtr alignment = openHalAlignmentReadOnly(path, optionsParser);
+    if (numThreads > 1 && alignment->supportsConcurrentReads() == false)
+    {
+      cerr << "halStats: Warning " << path << " cannot be read by more "
+           << "than one thread (convert it with hal2mmap to do so). "
+           << "--numThreads will be ignored" << endl;
+      numThreads = 1;
+    }
 
     if (listGenomes == true && alignment->getNumGenomes() > 0)
     {
@@ -273,10 +294,10 @@ int main(int argc, char** argv)
     }
     else if (percentID != "\"\"")
     {
-      printPercentID(cout, alignment, percentID);
+      printPercentID(cout, alignment, percentID, numThreads);
     }
     else if (coverage != "\"\"") {
-      printCoverage(cout, alignment, coverage);
+      printCoverage(cout, alignment, coverage, numThreads);
     }
     else if (topSegments != "\"\"") {
       printSegments(cout, alignment, topSegments, true);
@@ -284,7 +305,7 @@ int main(int argc, char** argv)
     else if (bottomSegments != "\"\"") {
       printSegments(cout, alignment, bottomSegments, false);
     } else if (allCoverage) {
-      printAllCoverage(cout, alignment);
+      printAllCoverage(cout, alignment, numThreads);
     }
     else
     {
@@ -654,196 +675,29 @@ void printChromSizes(ostream& os, AlignmentConstPtr alignment,
 }
 
 void printPercentID(ostream& os, AlignmentConstPtr alignment,
-                    const string& genomeName)
+                    const string& genomeName, hal_size_t numThreads)
 {
   const Genome *refGenome = alignment->openGenome(genomeName);
   if (!refGenome) {
     throw hal_exception("Genome " + genomeName + " does not exist.");
   }
-
-  ColumnIteratorPtr colIt = refGenome->getColumnIterator();
-  // A bit sloppy, but a mapping from genome to (# identical bases, # aligned sites)
-  // The # of aligned sites is necessary since a) not all sites are aligned and
-  // b) we don't consider anything containing N's to be aligned.
-  map<const Genome *, pair<hal_size_t *, hal_size_t *> > genomeStats;
-  while(1) {
-    // Get DNA for this site in reference
-    DNAIteratorConstPtr refDnaIt = refGenome->getDNAIterator(colIt->getReferenceSequencePosition() + colIt->getReferenceSequence()->getStartPosition());
-    char refDna = toupper(refDnaIt->getChar());
-    
-    const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-    map <const Genome *, pair<hal_size_t *, hal_size_t *> > tempGenomeStats;
-    for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-         colMapIt != cmap->end(); colMapIt++) {
-      if (colMapIt->second->empty()) {
-        // There are empty entries in the column map.
-        continue;
-      }
-      const Genome *genome = colMapIt->first->getGenome();
-      const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-      assert(dnaSet->size() == 1);
-      for (hal_size_t i = 0; i < dnaSet->size(); i++) {
-        DNAIteratorConstPtr dnaIt = dnaSet->at(i);
-        char otherDna = toupper(dnaIt->getChar());
-        if (refDna != 'N' && otherDna != 'N') {
-          if (!tempGenomeStats.count(genome)) {
-            // initialize the map for this genome if necessary.
-            tempGenomeStats[genome] = make_pair(new hal_size_t, new hal_size_t);
-            *tempGenomeStats[genome].first = 0;
-            *tempGenomeStats[genome].second = 0;
-          }
-          hal_size_t *tempNumID = tempGenomeStats[genome].first;
-          hal_size_t *tempNumSites = tempGenomeStats[genome].second;
-          if (refDna == otherDna) {
-            (*tempNumID)++;
-          }
-          (*tempNumSites)++;
-        }
-      }
-    }
-    if (refDna != 'N' && *tempGenomeStats[refGenome].second == 1) {
-      // If there isn't a duplication in the reference then we count
-      // this column.
-      for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator it = tempGenomeStats.begin();
-           it != tempGenomeStats.end(); it++) {
-        const Genome *genome = it->first;
-        if (!genomeStats.count(genome)) {
-          // initialize the map for this genome if necessary.
-          genomeStats[genome] = make_pair(new hal_size_t, new hal_size_t);
-          *genomeStats[genome].first = 0;
-          *genomeStats[genome].second = 0;
-        }
-        hal_size_t *tempNumID = it->second.first;
-        hal_size_t *tempNumSites = it->second.second;
-        if (*tempNumSites == 1) {
-          // only count for the ID ratio if there's only 1 site for
-          // this genome in the column.
-          hal_size_t *numID = genomeStats[genome].first;
-          hal_size_t *numSites = genomeStats[genome].second;
-          assert(*tempNumID == 1 || *tempNumID == 0);
-          assert(*tempNumSites == 1);
-          if (*tempNumID == 1) {
-            (*numID)++;
-          }
-          (*numSites)++;
-        }
-      }
-    }
-    // clean up temporary counts.
-    for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator it = tempGenomeStats.begin();
-         it != tempGenomeStats.end(); it++) {
-      delete it->second.first;
-      delete it->second.second;
-    }
-    if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-      colIt->defragment();
-    }
-    if (colIt->lastColumn()) {
-      // Break here--the column iterator will crash if we try to go further.
-      break;
-    }
-    colIt->toRight();
-  }
-  os << "Genome, % ID, numID, numSites" << endl;
-  for (map<const Genome *, pair<hal_size_t *, hal_size_t *> >::iterator statsIt = genomeStats.begin();
-       statsIt != genomeStats.end(); statsIt++) {
-    string name = statsIt->first->getName();
-    hal_size_t numID = *statsIt->second.first;
-    hal_size_t numSites = *statsIt->second.second;
-    os << name << ", " << ((double) numID)/numSites << ", " << numID <<
-      ", " << numSites << endl;
-    delete statsIt->second.first;
-    delete statsIt->second.second;
-  }
+  PairwiseStats pairwiseStats(alignment);
+  pairwiseStats.setNumThreads(numThreads);
+  pairwiseStats.computeReference(refGenome);
+  pairwiseStats.printPercentID(os);
 }
 
 void printCoverage(ostream& os, AlignmentConstPtr alignment,
-                          const string& genomeName)
+                   const string& genomeName, hal_size_t numThreads)
 {
   const Genome *refGenome = alignment->openGenome(genomeName);
   if (!refGenome) {
     throw hal_exception("Genome " + genomeName + " does not exist.");
   }
-
-  ColumnIteratorPtr colIt = refGenome->getColumnIterator(NULL, 0, 0,
-                                                         NULL_INDEX, false,
-                                                         false, false, true);
-  map<const Genome *, vector<hal_size_t> *> histograms;
-  while(1) {
-    const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-    // Temporary collecting of per-genome sites mapped, since it's
-    // organized in the column map by sequence, not genome.
-    map<const Genome *, hal_size_t> numSitesMapped;
-    for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-         colMapIt != cmap->end(); colMapIt++) {
-      if (colMapIt->second->empty()) {
-        // There are empty entries in the column map.
-        continue;
-      }
-      const Genome *genome = colMapIt->first->getGenome();
-      if (genome->getNumChildren() == 0 || genome == refGenome) {
-          // We only care about coverage from leaf genomes, but if
-          // the reference is an ancestor we need to keep track of its
-          // coverage too.
-          if (!numSitesMapped.count(genome)) {
-              // Initialize map entry
-              numSitesMapped[genome] = 0;
-          }
-          const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-          numSitesMapped[genome] = numSitesMapped[genome] + dnaSet->size();
-      }
-    }
-    for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
-         it != numSitesMapped.end(); it++) {
-      if (!histograms.count(it->first)) {
-        // Initialize map
-        histograms[it->first] = new vector<hal_size_t>;
-      }
-      vector<hal_size_t> *histogram = histograms[it->first];
-      if (histogram->size() < it->second) {
-        histogram->resize(it->second, 0);
-      }
-      for (hal_size_t i = 0; i < it->second; i++) {
-        (*histogram)[i] = histogram->at(i) + numSitesMapped[refGenome];
-      }
-    }
-    if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-      colIt->defragment();
-    }
-    if (colIt->lastColumn()) {
-      // Break here--the column iterator will crash if we try to go further.
-      break;
-    }
-    colIt->toRight();
-  }
-  hal_size_t maxHistLength = 0;
-  for (map<const Genome *, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    vector <hal_size_t> *histogram = histIt->second;
-    if (histogram->size() > maxHistLength) {
-      maxHistLength = histogram->size();
-    }
-  }
-
-  os << "Genome";
-  for (hal_size_t i = 0; i < maxHistLength; i++) {
-    os << ", sitesCovered" << i + 1 << "Times";
-  }
-  os << endl;
-  for (map<const Genome *, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    string name = histIt->first->getName();
-    os << name;
-    vector <hal_size_t> *histogram = histIt->second;
-    for(hal_size_t i = 0; i < maxHistLength; i++) {
-      if (i < histogram->size()) {
-        os << ", " << (double) histogram->at(i);
-      } else {
-        os << ", " << 0;
-      }
-    }
-    os << endl;
-  }
+  PairwiseStats pairwiseStats(alignment);
+  pairwiseStats.setNumThreads(numThreads);
+  pairwiseStats.computeReference(refGenome);
+  pairwiseStats.printCoverage(os);
 }
 
 static void printSegments(ostream& os, AlignmentConstPtr alignment,
@@ -883,113 +737,11 @@ static void printSegments(ostream& os, AlignmentConstPtr alignment,
 }
 
 // Print coverage for all leaves vs. all leaves efficiently.
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment)
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             hal_size_t numThreads)
 {
-  vector<string> leafNames = alignment->getLeafNamesBelow(alignment->getRootName());
-  vector<const Genome *> leafGenomes;
-  for (hal_size_t i = 0; i < leafNames.size(); i++) {
-    const Genome *genome = alignment->openGenome(leafNames[i]);
-    assert(genome != NULL);
-    leafGenomes.push_back(genome);
-  }
-  ColumnIterator::VisitCache visitCache;
-  map<pair<const Genome *, const Genome *>, vector<hal_size_t> *> histograms;
-  for (hal_size_t i = 0; i < leafGenomes.size(); i++) {
-    const Genome *genome = leafGenomes[i];
-    // Follow paralogies, but ignore ancestors.
-    ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0,
-                                                        NULL_INDEX, false,
-                                                        true, false, true);
-    colIt->setVisitCache(&visitCache);
-    // So that we don't accidentally visit the first column if it's
-    // already been visited.
-    colIt->toSite(0, genome->getSequenceLength() - 1);
-    while(1) {
-      const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-      // Temporary collecting of per-genome sites mapped, since it's
-      // organized in the column map by sequence, not genome.
-      map<const Genome *, hal_size_t> numSitesMapped;
-      for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-           colMapIt != cmap->end(); colMapIt++) {
-        if (colMapIt->second->empty()) {
-          // There are empty entries in the column map.
-          continue;
-        }
-        const Genome *genome = colMapIt->first->getGenome();
-        if (!numSitesMapped.count(genome)) {
-          // Initialize map entry
-          numSitesMapped[genome] = 0;
-        }
-        const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-        numSitesMapped[genome] = numSitesMapped[genome] + dnaSet->size();
-      }
-      // O(n^2) in the number of genomes in the column -- doesn't seem
-      // like there is a better way, since coverage isn't quite
-      // symmetric.
-      for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
-           it != numSitesMapped.end(); it++) {
-        for(map<const Genome *, hal_size_t>::const_iterator it2 = numSitesMapped.begin();
-           it2 != numSitesMapped.end(); it2++) {
-          pair<const Genome *, const Genome *> key = make_pair(it->first, it2->first);
-          if (!histograms.count(key)) {
-            // Initialize map
-            histograms[key] = new vector<hal_size_t>;
-          }
-          vector<hal_size_t> *histogram = histograms[key];
-          if (histogram->size() < it2->second) {
-            histogram->resize(it2->second, 0);
-          }
-          for (hal_size_t i = 0; i < it2->second; i++) {
-            (*histogram)[i] = histogram->at(i) + numSitesMapped[it->first];
-          }
-        }
-      }
-      if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-        colIt->defragment();
-      }
-      if (colIt->lastColumn()) {
-        // Break here--the column iterator will crash if we try to go further.
-        break;
-      }
-      colIt->toRight();
-    }
-    // Copy over the updated visit cache information so we can supply it to the next genome.
-    visitCache.clear();
-    ColumnIterator::VisitCache *newVisitCache = colIt->getVisitCache();
-    for(ColumnIterator::VisitCache::iterator it = newVisitCache->begin();
-        it != newVisitCache->end(); it++) {
-      visitCache[it->first] = new PositionCache(*it->second);
-    }
-  }
-
-  hal_size_t maxHistLength = 0;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    vector <hal_size_t> *histogram = histIt->second;
-    if (histogram->size() > maxHistLength) {
-      maxHistLength = histogram->size();
-    }
-  }
-
-  os << "FromGenome, ToGenome";
-  for (hal_size_t i = 0; i < maxHistLength; i++) {
-    os << ", sitesCovered" << i + 1 << "Times";
-  }
-  os << endl;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
-       histIt != histograms.end(); histIt++) {
-    string fromName = histIt->first.second->getName();
-    string toName = histIt->first.first->getName();
-    os << fromName;
-    os << ", " << toName;
-    vector <hal_size_t> *histogram = histIt->second;
-    for(hal_size_t i = 0; i < maxHistLength; i++) {
-      if (i < histogram->size()) {
-        os << ", " << (double) histogram->at(i);
-      } else {
-        os << ", " << 0;
-      }
-    }
-    os << endl;
-  }
+  PairwiseStats pairwiseStats(alignment);
+  pairwiseStats.setNumThreads(numThreads);
+  pairwiseStats.computeAllLeaves();
+  pairwiseStats.printAllCoverage(os);
 }
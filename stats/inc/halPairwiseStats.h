@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALPAIRWISESTATS_H
+#define _HALPAIRWISESTATS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "hal.h"
+
+namespace hal {
+
+/** Percent identity and coverage histograms between genomes, counted in
+ * a single walk along the columns of the alignment.  Genomes are
+ * identified by their GenomeTree ids (preorder from the root) so that
+ * the counts of a column are kept in plain arrays instead of maps.  The
+ * walk is split into chunks of reference positions that are counted by
+ * separate threads and summed at the end. */
+class PairwiseStats
+{
+public:
+
+   PairwiseStats(AlignmentConstPtr alignment);
+   virtual ~PairwiseStats();
+
+   /** More than one thread requires an alignment that supports
+    * concurrent reads */
+   void setNumThreads(hal_size_t numThreads);
+   void setChunkLength(hal_size_t chunkLength);
+
+   /** Count the identity and coverage of refGenome with all genomes,
+    * as printed by printPercentID() and printCoverage().  Only columns
+    * where the reference base is neither N nor duplicated count for the
+    * identity.  Coverage is counted for leaves and refGenome, once per
+    * column (at its left-most reference position). */
+   void computeReference(const Genome* refGenome);
+
+   /** Count the coverage between all pairs of leaves, as printed by
+    * printAllCoverage().  Each column is counted once, from the first
+    * leaf (in id order) that it contains, at its left-most position in
+    * that leaf. */
+   void computeAllLeaves();
+
+   void printPercentID(std::ostream& os) const;
+   void printCoverage(std::ostream& os) const;
+   void printAllCoverage(std::ostream& os) const;
+
+   static const hal_size_t defaultChunkLength;
+
+protected:
+
+   struct Counts;
+   struct ColumnCounts;
+   struct Chunk;
+   struct ChunkQueue;
+
+   void compute(const std::vector<Chunk>& chunks);
+   void countChunk(const Chunk& chunk, ColumnCounts& column,
+                   Counts& counts) const;
+   void countColumn(const Chunk& chunk, hal_index_t refPos,
+                    const ColumnIterator::FlatColumn* flatColumn,
+                    ColumnCounts& column, Counts& counts) const;
+   void addChunks(const Genome* genome, bool allLeaves,
+                  std::vector<Chunk>& chunks) const;
+
+   static void* chunkWorker(void* arg);
+   static void printHistograms(
+     std::ostream& os, const std::string& header,
+     const std::vector<std::string>& names,
+     const std::vector<const std::vector<hal_size_t>*>& histograms);
+
+protected:
+
+   AlignmentConstPtr _alignment;
+   // indexed by GenomeTree id (Genome::getGenomeId())
+   std::vector<const Genome*> _genomes;
+   // index of each genome among the leaves, or -1 for ancestors
+   std::vector<hal_index_t> _leafIds;
+   hal_size_t _numLeaves;
+   hal_size_t _numThreads;
+   hal_size_t _chunkLength;
+   const Genome* _refGenome;
+   Counts* _counts;
+
+private:
+   PairwiseStats(const PairwiseStats&);
+   PairwiseStats& operator=(const PairwiseStats&);
+};
+
+}
+
+#endif